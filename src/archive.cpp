@@ -0,0 +1,353 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    ROM images in zip and gzip archives.
+    See archive.h.
+
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "archive.h"
+#include "inflate.h"
+#include "unif.h"
+
+
+typedef unsigned char uchar;
+
+
+#define GZIP_HDR_SIZE                       10
+#define GZIP_TRAILER_SIZE                   8
+#define GZIP_FLAG_HCRC                      0x02
+#define GZIP_FLAG_EXTRA                     0x04
+#define GZIP_FLAG_NAME                      0x08
+#define GZIP_FLAG_COMMENT                   0x10
+#define GZIP_FLAG_RESERVED                  0xE0
+
+#define ZIP_LOCAL_HDR_SIZE                  30
+#define ZIP_CENTRAL_HDR_SIZE                46
+#define ZIP_END_SIZE                        22
+#define ZIP_MAX_COMMENT                     0xFFFF
+#define ZIP_FLAG_ENCRYPTED                  0x0001
+#define ZIP_ZIP64                           0xFFFFFFFF
+
+
+static const char *const rom_extensions[] = { ".nes", ".unf", ".unif" };
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for archive.cpp
+//
+
+static unsigned int read_le16( const uchar *p );
+static unsigned int read_le32( const uchar *p );
+static bool has_rom_extension( const char *name, size_t length );
+static void copy_name( archive_member *member, const char *name, size_t length );
+static bool find_gzip_member( const image_t *archive, archive_member *member );
+static bool find_zip_member( const image_t *archive, archive_member *member );
+static image_off_t find_zip_end( const image_t *archive );
+
+
+
+//----------------------------------------------------------------------
+//
+//      check for the signatures of gzip and zip files
+//
+int archive_kind( const void *buf, size_t size )
+{
+    const uchar *p = (const uchar *)buf;
+
+    if( size >= 3 && p[0] == 0x1F && p[1] == 0x8B && p[2] == ARCHIVE_DEFLATED )
+        return ARCHIVE_GZIP;
+    if( size >= 4 && memcmp( p, "PK\x03\x04", 4 ) == 0 )
+        return ARCHIVE_ZIP;
+    return ARCHIVE_NONE;
+}
+
+const char *archive_kind_name( int kind )
+{
+    switch( kind )
+    {
+    case ARCHIVE_GZIP:  return "gzip";
+    case ARCHIVE_ZIP:   return "zip";
+    default:            return "none";
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      finds the ROM image in an archive
+//
+bool archive_find_member( const image_t *archive, archive_member *member )
+{
+    memset( member, 0, sizeof(*member) );
+    member->kind = archive_kind( archive->data, (size_t)archive->size );
+
+    switch( member->kind )
+    {
+    case ARCHIVE_GZIP:  return find_gzip_member( archive, member );
+    case ARCHIVE_ZIP:   return find_zip_member( archive, member );
+    default:            return false;
+    }
+}
+
+// the header, optional fields, the deflate stream and CRC32/size
+static bool find_gzip_member( const image_t *archive, archive_member *member )
+{
+    const uchar *p = archive->data;
+    image_off_t offset = GZIP_HDR_SIZE;
+    image_off_t end = archive->size - GZIP_TRAILER_SIZE;
+    uchar flags;
+
+    if( archive->size < GZIP_HDR_SIZE + GZIP_TRAILER_SIZE )
+        return false;
+    flags = p[3];
+    if( flags & GZIP_FLAG_RESERVED )
+        return false;
+
+    if( flags & GZIP_FLAG_EXTRA )
+    {
+        if( offset + 2 > end )
+            return false;
+        offset += 2 + read_le16( p + offset );
+    }
+    if( flags & GZIP_FLAG_NAME )
+    {
+        const uchar *name = p + offset;
+        const uchar *nul = offset < end ? (const uchar *)memchr( name, 0, (size_t)(end - offset) ) : NULL;
+
+        if( nul == NULL )
+            return false;
+        copy_name( member, (const char *)name, nul - name );
+        offset += nul - name + 1;
+    }
+    if( flags & GZIP_FLAG_COMMENT )
+    {
+        const uchar *nul = offset < end ? (const uchar *)memchr( p + offset, 0, (size_t)(end - offset) ) : NULL;
+
+        if( nul == NULL )
+            return false;
+        offset = nul - p + 1;
+    }
+    if( flags & GZIP_FLAG_HCRC )
+        offset += 2;
+    if( offset > end )
+        return false;
+
+    // the size is modulo 4G, ROM images are far smaller
+    member->method = ARCHIVE_DEFLATED;
+    member->offset = offset;
+    member->packed_size = end - offset;
+    member->crc = read_le32( p + end );
+    member->size = read_le32( p + end + 4 );
+    return true;
+}
+
+// walks the central directory, the local header is only used
+// for the offset of the data
+static bool find_zip_member( const image_t *archive, archive_member *member )
+{
+    image_off_t end = find_zip_end( archive );
+    image_off_t offset, dir_end, found = -1, last = -1;
+    const uchar *p;
+    int roms = 0, files = 0;
+
+    if( end < 0 )
+        return false;
+    p = archive->data + end;
+    offset = read_le32( p + 16 );
+    dir_end = offset + read_le32( p + 12 );
+    if( dir_end > end )
+        return false;
+
+    while( offset + ZIP_CENTRAL_HDR_SIZE <= dir_end )
+    {
+        const uchar *entry = archive->data + offset;
+        const char *name = (const char *)entry + ZIP_CENTRAL_HDR_SIZE;
+        image_off_t length = read_le16( entry + 28 );
+
+        if( memcmp( entry, "PK\x01\x02", 4 ) != 0 || offset + ZIP_CENTRAL_HDR_SIZE + length > dir_end )
+            return false;
+
+        // directories have no data
+        if( length > 0 && name[length - 1] != '/' )
+        {
+            files++;
+            last = offset;
+            if( has_rom_extension( name, (size_t)length ) )
+            {
+                roms++;
+                found = offset;
+            }
+        }
+        offset += ZIP_CENTRAL_HDR_SIZE + length + read_le16( entry + 30 ) + read_le16( entry + 32 );
+    }
+
+    if( roms != 1 && !(roms == 0 && files == 1) )
+        return false;
+    if( found < 0 )
+        found = last;
+
+    const uchar *entry = archive->data + found;
+    unsigned int local = read_le32( entry + 42 );
+
+    member->method = read_le16( entry + 10 );
+    member->crc = read_le32( entry + 16 );
+    member->packed_size = read_le32( entry + 20 );
+    member->size = read_le32( entry + 24 );
+    copy_name( member, (const char *)entry + ZIP_CENTRAL_HDR_SIZE, read_le16( entry + 28 ) );
+
+    if( (read_le16( entry + 8 ) & ZIP_FLAG_ENCRYPTED)
+        || (member->method != ARCHIVE_STORED && member->method != ARCHIVE_DEFLATED)
+        || member->packed_size == ZIP_ZIP64 || member->size == ZIP_ZIP64 || local == ZIP_ZIP64 )
+        return false;
+
+    if( local + ZIP_LOCAL_HDR_SIZE > archive->size || memcmp( archive->data + local, "PK\x03\x04", 4 ) != 0 )
+        return false;
+    member->offset = local + ZIP_LOCAL_HDR_SIZE + read_le16( archive->data + local + 26 ) + read_le16( archive->data + local + 28 );
+    return member->offset + member->packed_size <= archive->size;
+}
+
+// the end of central directory record, behind it there's only the
+// archive comment
+static image_off_t find_zip_end( const image_t *archive )
+{
+    image_off_t lowest = archive->size - ZIP_END_SIZE - ZIP_MAX_COMMENT;
+
+    for( image_off_t offset=archive->size - ZIP_END_SIZE; offset>=0 && offset>=lowest; offset-- )
+    {
+        const uchar *p = archive->data + offset;
+
+        if( memcmp( p, "PK\x05\x06", 4 ) == 0 && offset + ZIP_END_SIZE + read_le16( p + 20 ) == archive->size )
+            return offset;
+    }
+    return -1;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      decompresses a member from the archive view to 'buf'
+//
+bool archive_extract( const image_t *archive, const archive_member *member, void *buf, size_t size )
+{
+    const uchar *data = image_slice( archive, member->offset, member->packed_size );
+    bool whole = (image_off_t)size == member->size;
+    size_t written;
+
+    if( data == NULL || (image_off_t)size > member->size )
+        return false;
+
+    if( member->method == ARCHIVE_STORED )
+    {
+        if( member->packed_size != member->size )
+            return false;
+        memcpy( buf, data, size );
+    }
+    else if( !inflate_stream( data, (size_t)member->packed_size, (uchar *)buf, size, !whole, &written ) || written != size )
+        return false;
+
+    return !whole || hash_crc32( 0, buf, size ) == member->crc;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      opens the ROM image of the view: the member of an archive,
+//      then a UNIF or an iNES image
+//
+const char *rom_open( image_t *img, ines_ctx *ctx, void **buffer )
+{
+    archive_member member;
+    unif_index index;
+    image_off_t size;
+    void *ines;
+
+    *buffer = NULL;
+    if( archive_kind( img->data, (size_t)img->size ) != ARCHIVE_NONE )
+    {
+        if( !archive_find_member( img, &member ) )
+            return "no single ROM image in the archive";
+        if( (*buffer = malloc( (size_t)member.size )) == NULL )
+            return "out of memory";
+        if( !archive_extract( img, &member, *buffer, (size_t)member.size ) )
+            return "broken archive (CRC32 mismatch or damaged stream)";
+        image_release( img );
+        image_from_buffer( img, *buffer, member.size );
+    }
+
+    if( !unif_is_unif_image( img->data, (size_t)img->size ) )
+        return ines_init( ctx, img ) ? NULL : "not an iNES ROM image";
+
+    if( !unif_index_image( img, &index ) )
+        return "broken UNIF ROM image";
+    if( unif_init( ctx, img, &index ) )
+        return NULL;
+
+    // PRG or CHR-ROM split into chunks
+    size = unif_ines_size( &index );
+    if( (ines = malloc( (size_t)size )) == NULL )
+        return "out of memory";
+    unif_to_ines( img, &index, (uchar *)ines );
+    image_release( img );
+    free( *buffer );
+    *buffer = ines;
+    image_from_buffer( img, ines, size );
+    ines_init( ctx, img );
+    memcpy( ctx->board, index.board, sizeof(ctx->board) );
+    return NULL;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      little helpers
+//
+static unsigned int read_le16( const uchar *p )
+{
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int read_le32( const uchar *p )
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static bool has_rom_extension( const char *name, size_t length )
+{
+    for( size_t i=0; i<sizeof(rom_extensions)/sizeof(rom_extensions[0]); i++ )
+    {
+        size_t n = strlen( rom_extensions[i] );
+        size_t j;
+
+        if( length < n )
+            continue;
+        for( j=0; j<n && tolower( (uchar)name[length - n + j] ) == rom_extensions[i][j]; j++ )
+            ;
+        if( j == n )
+            return true;
+    }
+    return false;
+}
+
+static void copy_name( archive_member *member, const char *name, size_t length )
+{
+    if( length >= ARCHIVE_NAME_SIZE )
+        length = ARCHIVE_NAME_SIZE - 1;
+    memcpy( member->name, name, length );
+    member->name[length] = '\0';
+}
@@ -0,0 +1,90 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    ROM images in zip and gzip archives.
+
+    archive_find_member() finds the ROM image in the mapped archive:
+    the single member of a gzip file, or the single member of a zip
+    file named *.nes, *.unf or *.unif (a zip file holding exactly one
+    file counts as well, whatever its name). The member is then
+    decompressed by archive_extract() straight from the archive view
+    into the caller's buffer, which becomes the image view; there are
+    no temporary files and no intermediate buffers. Stored members are
+    copied, deflated ones decoded by inflate.cpp. The CRC32 of the
+    archive is checked against the extracted image.
+
+    Encrypted members, zip64 archives and compression methods other
+    than deflate aren't supported.
+
+    rom_open() is what the loader and the tools use to open any ROM
+    image: it extracts archives, then initializes the context of an
+    iNES or UNIF image (see unif.h).
+
+*/
+
+
+#ifndef _ARCHIVE_H
+#define _ARCHIVE_H
+
+#include "image.h"
+#include "hash.h"
+#include "ines.h"
+
+
+// archive formats
+enum
+{
+    ARCHIVE_NONE,
+    ARCHIVE_GZIP,
+    ARCHIVE_ZIP
+};
+
+// compression methods of zip and gzip
+#define ARCHIVE_STORED                      0
+#define ARCHIVE_DEFLATED                    8
+
+// member names kept, NUL included
+#define ARCHIVE_NAME_SIZE                   256
+
+
+typedef struct _archive_member_t {
+
+    int kind;                               // ARCHIVE_...
+    int method;                             // ARCHIVE_STORED or ARCHIVE_DEFLATED
+    char name[ARCHIVE_NAME_SIZE];           // "" if a gzip file has no name
+    image_off_t offset;                     // of the compressed data in the archive
+    image_off_t packed_size;
+    image_off_t size;                       // of the ROM image
+    crc32_t crc;
+
+} archive_member;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for archive.cpp
+//
+
+int archive_kind( const void *buf, size_t size ); // ARCHIVE_NONE for anything else
+const char *archive_kind_name( int kind );
+
+// false if there isn't exactly one ROM image in the archive
+bool archive_find_member( const image_t *archive, archive_member *member );
+
+// extracts the first 'size' bytes of a member, the whole member
+// (size == member->size) is checked against its CRC32
+bool archive_extract( const image_t *archive, const archive_member *member, void *buf, size_t size );
+
+// initializes the context of an iNES or UNIF image, also in an archive.
+// extracted and put together images go to a malloc()ed '*buffer' that
+// replaces the view, the old view is released. the caller has to
+// image_release() the view and free() '*buffer', also on errors.
+// returns NULL or the error
+const char *rom_open( image_t *img, ines_ctx *ctx, void **buffer );
+
+#endif // _ARCHIVE_H
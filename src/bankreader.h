@@ -0,0 +1,277 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    cached access to the ROM image stored in the database, for
+    plugins and scripts that read the same banks over and over
+    (bank switching, cross-bank searches).
+
+    A bank reader keeps the last few pages it fetched from the
+    page store (pagestore.h), decompressed resp. read from the ROM
+    file, and hands out spans pointing into its cache instead of
+    copying. Pages are cached by the page holding their data, so
+    mirrored banks share one entry. When all entries are in use,
+    the least recently used one is replaced.
+
+        ines_bank_reader reader;
+        ines_span bank;
+
+        if( ines_reader_open( &reader, 8 ) )
+        {
+            if( ines_reader_prg_bank( &reader, 5, PRG_ROM_8K_BANK_SIZE, &bank ) )
+                ... bank.data[0] .. bank.data[bank.size - 1] ...
+            ines_reader_close( &reader );
+        }
+
+    A span stays valid until the reader fetches capacity other
+    pages or is closed. The header is read once, on first use.
+    After the database has been changed (e.g. the ROM reloaded),
+    ines_reader_flush() drops everything cached.
+
+*/
+
+
+#ifndef _BANKREADER_H
+#define _BANKREADER_H
+
+#include "pagestore.h"
+
+
+// bytes of a page in the reader's cache
+typedef struct _ines_span_t {
+
+    const uchar *data;
+    uval_t size;
+
+} ines_span;
+
+
+// a cache entry
+typedef struct _ines_cached_page_t {
+
+    int ref;                                // page holding the data, -1 if unused
+    unsigned long used;                     // reader tick of the last use
+    uval_t size;
+    uchar *data;                            // PRG_PAGE_SIZE bytes
+
+} ines_cached_page;
+
+
+typedef struct _ines_bank_reader_t {
+
+    int capacity;
+    ines_cached_page *pages;
+    unsigned long tick;
+    long hits;
+    long misses;
+
+    bool have_hdr;
+    ines_hdr hdr;
+
+} ines_bank_reader;
+
+
+
+//----------------------------------------------------------------------
+//
+//      drops the cached pages and the header
+//
+inline void ines_reader_flush( ines_bank_reader *r )
+{
+    for( int i=0; i<r->capacity; i++ )
+        r->pages[i].ref = -1;
+    r->have_hdr = false;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      sets up a reader caching up to 'capacity' pages
+//
+inline bool ines_reader_open( ines_bank_reader *r, int capacity )
+{
+    memset( r, 0, sizeof(*r) );
+    if( capacity < 1 )
+        return false;
+
+    r->pages = (ines_cached_page *)qalloc( capacity * sizeof(ines_cached_page) );
+    if( r->pages == NULL )
+        return false;
+    memset( r->pages, 0, capacity * sizeof(ines_cached_page) );
+    r->capacity = capacity;
+
+    for( int i=0; i<capacity; i++ )
+    {
+        r->pages[i].data = (uchar *)qalloc( PRG_PAGE_SIZE );
+        if( r->pages[i].data == NULL )
+        {
+            r->capacity = i;
+            break;
+        }
+    }
+    if( r->capacity == 0 )
+    {
+        qfree( r->pages );
+        r->pages = NULL;
+        return false;
+    }
+
+    ines_reader_flush( r );
+    return true;
+}
+
+
+
+inline void ines_reader_close( ines_bank_reader *r )
+{
+    for( int i=0; i<r->capacity; i++ )
+        qfree( r->pages[i].data );
+    qfree( r->pages );
+    memset( r, 0, sizeof(*r) );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      the iNES header the ROM was loaded with (INES_HDR_NODE),
+//      NULL if there is none
+//
+inline const ines_hdr *ines_reader_header( ines_bank_reader *r )
+{
+    if( !r->have_hdr )
+    {
+        netnode node( INES_HDR_NODE );
+        size_t size = INES_HDR_SIZE;
+
+        if( node == BADNODE || node.getblob( &r->hdr, &size, 0, 'I' ) == NULL || size != INES_HDR_SIZE )
+            return NULL;
+        r->have_hdr = true;
+    }
+    return &r->hdr;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      a page of the page store by its index. the page is
+//      fetched unless it or a page with the same data is cached
+//
+inline bool ines_reader_page( ines_bank_reader *r, int index, ines_span *span )
+{
+    ines_page_info info;
+    ines_cached_page *victim;
+    int i;
+
+    if( !ines_get_page_info( index, &info ) || info.size > PRG_PAGE_SIZE )
+        return false;
+
+    r->tick++;
+    victim = &r->pages[0];
+    for( i=0; i<r->capacity; i++ )
+    {
+        ines_cached_page *page = &r->pages[i];
+
+        if( page->ref == (int)info.ref )
+        {
+            page->used = r->tick;
+            r->hits++;
+            span->data = page->data;
+            span->size = page->size;
+            return true;
+        }
+        if( page->ref < 0 || (victim->ref >= 0 && page->used < victim->used) )
+            victim = page;
+    }
+
+    r->misses++;
+    victim->ref = -1;
+    if( !ines_get_page( index, victim->data, PRG_PAGE_SIZE ) )
+        return false;
+    victim->ref = (int)info.ref;
+    victim->used = r->tick;
+    victim->size = info.size;
+
+    span->data = victim->data;
+    span->size = victim->size;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      typed access to the trainer, the 16k PRG-ROM and the 8k
+//      CHR-ROM pages, numbers are counted from 0
+//
+inline bool ines_reader_trainer( ines_bank_reader *r, ines_span *span )
+{
+    int index = ines_find_page( INES_PAGE_TRAINER, 0 );
+
+    return index >= 0 && ines_reader_page( r, index, span );
+}
+
+inline bool ines_reader_prg( ines_bank_reader *r, uval_t number, ines_span *span )
+{
+    int index = ines_find_page( INES_PAGE_PRG, number );
+
+    return index >= 0 && ines_reader_page( r, index, span );
+}
+
+inline bool ines_reader_chr( ines_bank_reader *r, uval_t number, ines_span *span )
+{
+    int index = ines_find_page( INES_PAGE_CHR, number );
+
+    return index >= 0 && ines_reader_page( r, index, span );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      a PRG bank as a mapper switches it: bank 'bank' of 'size'
+//      bytes, 1k to 16k (e.g. PRG_ROM_8K_BANK_SIZE). 32k banks are
+//      two 16k banks, 2*n and 2*n+1
+//
+inline bool ines_reader_prg_bank( ines_bank_reader *r, uval_t bank, uval_t size, ines_span *span )
+{
+    unsigned long long offset = (unsigned long long)bank * size;
+    ines_span page;
+
+    if( size == 0 || size > PRG_PAGE_SIZE || PRG_PAGE_SIZE % size != 0 ||
+        !ines_reader_prg( r, (uval_t)(offset / PRG_PAGE_SIZE), &page ) ||
+        offset % PRG_PAGE_SIZE + size > page.size )
+        return false;
+
+    span->data = page.data + offset % PRG_PAGE_SIZE;
+    span->size = size;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      a CHR bank of 'size' bytes, 1k to 8k
+//
+inline bool ines_reader_chr_bank( ines_bank_reader *r, uval_t bank, uval_t size, ines_span *span )
+{
+    unsigned long long offset = (unsigned long long)bank * size;
+    ines_span page;
+
+    if( size == 0 || size > CHR_PAGE_SIZE || CHR_PAGE_SIZE % size != 0 ||
+        !ines_reader_chr( r, (uval_t)(offset / CHR_PAGE_SIZE), &page ) ||
+        offset % CHR_PAGE_SIZE + size > page.size )
+        return false;
+
+    span->data = page.data + offset % CHR_PAGE_SIZE;
+    span->size = size;
+    return true;
+}
+
+#endif // _BANKREADER_H
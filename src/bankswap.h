@@ -0,0 +1,212 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    swapping PRG banks in place.
+
+    The loader maps the PRG banks chosen by ines_plan() to the CPU
+    windows at $8000-$FFFF and records them as the resident banks
+    of these windows. ines_swap_prg_bank() shows another bank in a
+    window without reloading all of it: the incoming bank is taken
+    from the page store (pagestore.h) and compared with the bytes
+    in the database eight bytes at a time, and only the runs of
+    differing bytes are undefined and written. Code, names and
+    comments on bytes the two banks have in common are kept, which
+    for banks sharing library code, tables or a vector stub is most
+    of the window.
+
+    Runs closer together than INES_SWAP_GAP bytes are written as
+    one, so banks differing all over don't take a database call per
+    byte. Bytes that are the same in both banks keep the file offset
+    of the bank they were loaded from.
+
+    The resident banks are kept in BANK_NUM_8000 (windows below
+    $C000) and BANK_NUM_C000 (the others), indexed by the CPU address
+    of the window:
+
+        'R'  1 + number of the resident bank, counted in banks of
+             the window's size
+        'Z'  size of the window, 8k or 16k
+
+*/
+
+
+#ifndef _BANKSWAP_H
+#define _BANKSWAP_H
+
+#include "pagestore.h"
+
+
+#define INES_SWAP_GAP                       8
+
+
+// what a swap has written
+typedef struct _ines_swap_result_t {
+
+    uval_t bytes;                           // bytes written, including merged gaps
+    int ranges;
+
+} ines_swap_result;
+
+
+
+//----------------------------------------------------------------------
+//
+//      name of the node holding the resident bank of a window
+//
+inline const char *ines_bank_num_node( ea_t window )
+{
+    return window < PRG_ROM_BANK_C000 ? BANK_NUM_8000 : BANK_NUM_C000;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      records 'bank' as shown in the window at 'window'
+//
+inline void ines_set_resident_bank( ea_t window, uval_t size, uval_t bank )
+{
+    netnode node;
+
+    node.create( ines_bank_num_node( window ) );
+    node.altset( window, bank + 1, BANK_NUM_TAG_RESIDENT );
+    node.altset( window, size, BANK_NUM_TAG_RESIDENT_SIZE );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      finds the window containing 'ea' and the bank it shows.
+//      returns false if 'ea' isn't inside a window with a
+//      resident bank
+//
+inline bool ines_get_resident_bank( ea_t ea, ea_t *window, uval_t *size, uval_t *bank )
+{
+    if( ea < ROM_START_ADDRESS || ea >= ROM_START_ADDRESS + ROM_SIZE )
+        return false;
+
+    // windows start on 8k boundaries
+    for( ea_t start = ea & ~(PRG_ROM_8K_BANK_SIZE - 1); start >= ROM_START_ADDRESS; start -= PRG_ROM_8K_BANK_SIZE )
+    {
+        netnode node( ines_bank_num_node( start ) );
+        uval_t resident, length;
+
+        if( node == BADNODE )
+            continue;
+        resident = node.altval( start, BANK_NUM_TAG_RESIDENT );
+        length = node.altval( start, BANK_NUM_TAG_RESIDENT_SIZE );
+        if( resident == 0 || ea >= start + length )
+            continue;
+
+        *window = start;
+        *size = length;
+        *bank = resident - 1;
+        return true;
+    }
+    return false;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      finds the end of the run of differing bytes starting at 'i',
+//      runs less than INES_SWAP_GAP bytes apart are joined
+//
+inline uval_t ines_swap_run_end( const uchar *a, const uchar *b, uval_t i, uval_t size )
+{
+    uval_t end = i;
+
+    while( i < size )
+    {
+        if( a[i] != b[i] )
+        {
+            end = ++i;
+            continue;
+        }
+        if( i - end >= INES_SWAP_GAP )
+            break;
+        i++;
+    }
+    return end;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      shows PRG bank 'bank' in the window at 'window', writing
+//      only the bytes that differ from the resident bank
+//
+inline bool ines_swap_prg_bank( ea_t window, uval_t bank, ines_swap_result *res )
+{
+    uchar page[PRG_PAGE_SIZE], resident[PRG_PAGE_SIZE];
+    netnode node( ines_bank_num_node( window ) );
+    ines_page_info info;
+    const uchar *incoming;
+    uval_t size, offset, i;
+    int index;
+
+    res->bytes = 0;
+    res->ranges = 0;
+
+    if( node == BADNODE || node.altval( window, BANK_NUM_TAG_RESIDENT ) == 0 )
+        return false;
+    size = node.altval( window, BANK_NUM_TAG_RESIDENT_SIZE );
+    if( size == 0 || size > PRG_PAGE_SIZE || PRG_PAGE_SIZE % size != 0 )
+        return false;
+
+    // 8k banks are halves of a 16k page
+    offset = (bank % (PRG_PAGE_SIZE / size)) * size;
+    index = ines_find_page( INES_PAGE_PRG, bank / (PRG_PAGE_SIZE / size) );
+    if( index < 0 || !ines_get_page_info( index, &info ) || info.size < offset + size ||
+        !ines_get_page( index, page, sizeof(page) ) )
+        return false;
+    incoming = page + offset;
+
+    // a window that has never been loaded differs everywhere
+    if( !get_many_bytes( window, resident, size ) )
+    {
+        for( i=0; i<size; i++ )
+            resident[i] = (uchar)~incoming[i];
+    }
+
+    for( i=0; i<size; )
+    {
+        uval_t end;
+
+        // skip equal words, then equal bytes
+        for( ; i + 8 <= size; i += 8 )
+        {
+            unsigned long long a, b;
+
+            memcpy( &a, incoming + i, 8 );
+            memcpy( &b, resident + i, 8 );
+            if( a != b )
+                break;
+        }
+        while( i < size && incoming[i] == resident[i] )
+            i++;
+        if( i >= size )
+            break;
+
+        end = ines_swap_run_end( incoming, resident, i, size );
+        do_unknown_range( window + i, end - i, false );
+        if( mem2base( incoming + i, window + i, window + end, info.offset + offset + i ) != 1 )
+            return false;
+
+        res->bytes += end - i;
+        res->ranges++;
+        i = end;
+    }
+
+    node.altset( window, bank + 1, BANK_NUM_TAG_RESIDENT );
+    return true;
+}
+
+#endif // _BANKSWAP_H
@@ -0,0 +1,646 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    bank switch detection.
+    See bankswitch.h.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bankswitch.h"
+#include "m6502.h"
+
+
+// initial room for switches, grows as needed
+#define SWITCHES_PER_PAGE                   16
+
+// MMC1 writes per register and the bit that resets the shift register
+#define MMC1_SERIAL_WRITES                  5
+#define MMC1_RESET                          0x80
+
+// CHR registers of VRC2/4, each one written as two nibbles
+#define VRC_CHR_REGS                        8
+
+#define K *0x400
+
+
+// bank number fields of a latch value
+typedef struct _latch_fields_t {
+
+    ushort number;                          // mapper
+    uchar prg_shift;
+    uchar prg_mask;                         // 0: no PRG field
+    uchar chr_shift;
+    uchar chr_mask;                         // 0: no CHR field
+
+} latch_fields;
+
+// latches with both fields, mappers that aren't listed switch
+// PRG or CHR banks with the whole value (see latch_write())
+static const latch_fields latch_fields_table[] =
+{
+    //  #  PRG        CHR
+    {   6, 2, 0x0F,   0, 0x03 },            // FFE F4xxx
+    {   7, 0, 0x07,   0, 0x00 },            // AOROM, bit 4 selects the name table
+    {  11, 0, 0x03,   4, 0x0F },            // Color Dreams
+    {  66, 4, 0x03,   0, 0x03 },            // GNROM
+    {  78, 0, 0x07,   4, 0x0F }             // Irem 74HC161 32
+};
+
+
+// state of a scan, the register values and partial switches
+// are those of the straight-line code up to the current write
+typedef struct _switch_scan_t {
+
+    const ines_ctx *ctx;
+    bankswitch_list *list;
+    unsigned int offset;                    // of the current instruction
+    m6502_regs regs;
+
+    int serial_count;                       // MMC1 writes so far
+    int serial_bits;
+    bool serial_known;
+
+    short select;                           // MMC3 bank select
+
+    short swap_mode;                        // VRC4 PRG swap mode
+    short chr_nibbles[VRC_CHR_REGS][2];     // VRC2/4 CHR bank nibbles, low and high
+
+} switch_scan;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for bankswitch.cpp
+//
+
+static bool scan_page( switch_scan *scan, const uchar *data, long size, unsigned int offset );
+static void reset_flow( switch_scan *scan );
+static bool add_switch( switch_scan *scan, ushort reg, uchar kind, ushort window, unsigned int size, long bank, short value );
+static bool add_prg( switch_scan *scan, ushort reg, ushort window, unsigned int size, short bank, short value );
+static bool add_chr( switch_scan *scan, ushort reg, ushort window, unsigned int size, short bank, short value );
+static bool add_mode( switch_scan *scan, ushort reg, const char *what, short value );
+
+static bool register_write( switch_scan *scan, ushort address, short value );
+static bool latch_write( switch_scan *scan, ushort address, short value );
+static bool serial_write( switch_scan *scan, ushort address, short value );
+static bool select_data_write( switch_scan *scan, ushort address, short value );
+static bool mmc3_data( switch_scan *scan, ushort address, short value );
+static bool fme7_data( switch_scan *scan, ushort address, short value );
+static bool direct_write( switch_scan *scan, ushort address, short value );
+static bool mmc2_write( switch_scan *scan, ushort address, short value );
+static bool vrc24_write( switch_scan *scan, ushort address, short value );
+static bool vrc6_write( switch_scan *scan, ushort address, short value );
+static int vrc24_subregister( ushort mapper, ushort address );
+
+
+
+//----------------------------------------------------------------------
+//
+//      finds the bank switches of all PRG pages
+//
+bool bankswitch_scan( const ines_ctx *ctx, bankswitch_list *list )
+{
+    switch_scan scan;
+    image_off_t prg_offset = ines_prg_offset( ctx );
+    bool ok = true;
+
+    memset( list, 0, sizeof(*list) );
+    if( ctx->desc->regs == MAPPER_REGS_NONE )
+        return true;
+
+    memset( &scan, 0, sizeof(scan) );
+    scan.ctx = ctx;
+    scan.list = list;
+
+    for( int page=0; page<ctx->prg_pages && ok; page++ )
+    {
+        image_off_t start = (image_off_t)page * PRG_PAGE_SIZE;
+        long size = (long)(ctx->prg_size - start < PRG_PAGE_SIZE ? ctx->prg_size - start : PRG_PAGE_SIZE);
+        const uchar *data = image_slice( ctx->image, prg_offset + start, size );
+
+        // offsets are 32 bit, see ioscan_image()
+        if( data == NULL || start + size > 0xFFFFFFFFLL )
+            break;
+
+        scan.swap_mode = M6502_UNKNOWN;
+        ok = scan_page( &scan, data, size, (unsigned int)start );
+    }
+
+    if( !ok )
+        bankswitch_free( list );
+    return ok;
+}
+
+void bankswitch_free( bankswitch_list *list )
+{
+    free( list->switches );
+    memset( list, 0, sizeof(*list) );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      decodes a page one instruction after the other and hands
+//      every absolute store to the mapper's register decoder
+//
+static bool scan_page( switch_scan *scan, const uchar *data, long size, unsigned int offset )
+{
+    long pos, len;
+
+    m6502_forget( &scan->regs );
+    reset_flow( scan );
+
+    for( pos=0; pos<size; pos+=len )
+    {
+        uchar opcode = data[pos];
+
+        len = m6502_op_lengths[opcode];
+        if( pos + len > size )
+            break;
+
+        if( opcode == M6502_STA_ABS || opcode == M6502_STX_ABS || opcode == M6502_STY_ABS )
+        {
+            ushort address = (ushort)(data[pos + 1] | (data[pos + 2] << 8));
+
+            scan->offset = offset + (unsigned int)pos;
+            if( !register_write( scan, address, m6502_stored( &scan->regs, opcode ) ) )
+                return false;
+        }
+
+        m6502_track( &scan->regs, data + pos );
+        if( m6502_ends_flow( opcode ) || opcode == M6502_JSR )
+            reset_flow( scan );
+    }
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      forgets partial switches at the end of straight-line code
+//
+static void reset_flow( switch_scan *scan )
+{
+    scan->serial_count = 0;
+    scan->select = M6502_UNKNOWN;
+    for( int i=0; i<VRC_CHR_REGS; i++ )
+        scan->chr_nibbles[i][0] = scan->chr_nibbles[i][1] = M6502_UNKNOWN;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      appends a switch to the list. bank numbers wrap around
+//      at the number of banks, like the unused address lines of
+//      the mapper do
+//
+static bool add_switch( switch_scan *scan, ushort reg, uchar kind, ushort window, unsigned int size, long bank, short value )
+{
+    bankswitch_list *list = scan->list;
+    bank_switch *sw;
+
+    if( list->count == list->size )
+    {
+        long count = list->size ? list->size * 2 : SWITCHES_PER_PAGE;
+        bank_switch *switches = (bank_switch *)realloc( list->switches, count * sizeof(bank_switch) );
+
+        if( switches == NULL )
+            return false;
+        list->switches = switches;
+        list->size = count;
+    }
+
+    if( bank != BANKSW_UNKNOWN && size != 0 )
+    {
+        image_off_t rom = kind == BANKSW_PRG ? scan->ctx->prg_size : scan->ctx->chr_size;
+        long banks = (long)(rom / size);
+
+        if( banks > 0 )
+            bank %= banks;
+    }
+
+    sw = &list->switches[list->count++];
+    memset( sw, 0, sizeof(*sw) );
+    sw->offset = scan->offset;
+    sw->reg = reg;
+    sw->kind = kind;
+    sw->window = window;
+    sw->size = size;
+    sw->bank = bank;
+    sw->value = value;
+    return true;
+}
+
+static bool add_prg( switch_scan *scan, ushort reg, ushort window, unsigned int size, short bank, short value )
+{
+    return add_switch( scan, reg, BANKSW_PRG, window, size, bank, value );
+}
+
+static bool add_chr( switch_scan *scan, ushort reg, ushort window, unsigned int size, short bank, short value )
+{
+    return add_switch( scan, reg, BANKSW_CHR, window, size, bank, value );
+}
+
+static bool add_mode( switch_scan *scan, ushort reg, const char *what, short value )
+{
+    if( !add_switch( scan, reg, BANKSW_MODE, 0, 0, BANKSW_UNKNOWN, value ) )
+        return false;
+    scan->list->switches[scan->list->count - 1].what = what;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      explains a store to 'address', 'value' is the byte stored
+//      or M6502_UNKNOWN
+//
+static bool register_write( switch_scan *scan, ushort address, short value )
+{
+    switch( scan->ctx->desc->regs )
+    {
+    case MAPPER_REGS_LATCH:
+        return latch_write( scan, address, value );
+
+    case MAPPER_REGS_SERIAL:
+        return serial_write( scan, address, value );
+
+    case MAPPER_REGS_SELECT_DATA:
+        return select_data_write( scan, address, value );
+
+    case MAPPER_REGS_DIRECT:
+        return direct_write( scan, address, value );
+
+    default:
+        return true;
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      UNROM, CNROM, GNROM, ...: the value holds the bank numbers
+//
+static bool latch_write( switch_scan *scan, ushort address, short value )
+{
+    const mapper_desc *desc = scan->ctx->desc;
+    latch_fields fields = { desc->number, 0, 0, 0, 0 };
+
+    if( address < desc->reg_start || address > desc->reg_end )
+        return true;
+
+    if( desc->switches & MAPPER_SWITCH_PRG )
+        fields.prg_mask = 0xFF;
+    else
+        fields.chr_mask = 0xFF;
+    for( size_t i=0; i<sizeof(latch_fields_table)/sizeof(latch_fields_table[0]); i++ )
+        if( latch_fields_table[i].number == desc->number )
+            fields = latch_fields_table[i];
+
+    if( fields.prg_mask != 0 &&
+        !add_prg( scan, address, ROM_START_ADDRESS, desc->prg_window,
+                  value == M6502_UNKNOWN ? BANKSW_UNKNOWN : (value >> fields.prg_shift) & fields.prg_mask, value ) )
+        return false;
+    if( fields.chr_mask != 0 &&
+        !add_chr( scan, address, PATTERN_TABLE_0_ADDRESS, desc->chr_window,
+                  value == M6502_UNKNOWN ? BANKSW_UNKNOWN : (value >> fields.chr_shift) & fields.chr_mask, value ) )
+        return false;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      MMC1: five writes shift a value in, bit 0 first. the address
+//      of the fifth write selects the register, a write with bit 7
+//      set resets the shift register. assumes the usual PRG mode 3
+//      (16k at $8000, last bank fixed at $C000) and 4k CHR banks
+//
+static bool serial_write( switch_scan *scan, ushort address, short value )
+{
+    short bits;
+
+    if( address < ROM_START_ADDRESS )
+        return true;
+
+    if( value != M6502_UNKNOWN && (value & MMC1_RESET) )
+    {
+        scan->serial_count = 0;
+        return true;
+    }
+
+    if( scan->serial_count == 0 )
+    {
+        scan->serial_bits = 0;
+        scan->serial_known = true;
+    }
+    if( value == M6502_UNKNOWN )
+        scan->serial_known = false;
+    else
+        scan->serial_bits |= (value & 1) << scan->serial_count;
+
+    if( ++scan->serial_count < MMC1_SERIAL_WRITES )
+        return true;
+
+    scan->serial_count = 0;
+    bits = scan->serial_known ? (short)scan->serial_bits : (short)M6502_UNKNOWN;
+
+    switch( address & 0xE000 )
+    {
+    case 0x8000:
+        return add_mode( scan, address, "control register", bits );
+    case 0xA000:
+        return add_chr( scan, address, PATTERN_TABLE_0_ADDRESS, 4 K, bits, bits );
+    case 0xC000:
+        return add_chr( scan, address, PATTERN_TABLE_1_ADDRESS, 4 K, bits, bits );
+    default:
+        return add_prg( scan, address, ROM_START_ADDRESS, 16 K, bits == M6502_UNKNOWN ? bits : bits & 0x0F, bits );
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      MMC3, Rambo-1, FME-7: a register number, then its value
+//
+static bool select_data_write( switch_scan *scan, ushort address, short value )
+{
+    const mapper_desc *desc = scan->ctx->desc;
+
+    switch( desc->number )
+    {
+    case 4:
+    case 64:
+        // $8000-$9FFF, select at even and data at odd addresses
+        if( (address & 0xE000) != 0x8000 )
+            return true;
+        if( (address & 1) == 0 )
+        {
+            scan->select = value;
+            return true;
+        }
+        return mmc3_data( scan, address, value );
+
+    case 69:
+        // command at $8000-$9FFF, parameter at $A000-$BFFF
+        if( (address & 0xE000) == 0x8000 )
+        {
+            scan->select = value;
+            return true;
+        }
+        if( (address & 0xE000) == 0xA000 )
+            return fme7_data( scan, address, value );
+        return true;
+
+    default:
+        if( address < desc->reg_start || address > desc->reg_end )
+            return true;
+        return add_switch( scan, address, BANKSW_REG, 0, 0, BANKSW_UNKNOWN, value );
+    }
+}
+
+// R0-R1: 2k CHR, R2-R5: 1k CHR, R6-R7: 8k PRG. Rambo-1 adds the
+// 1k CHR banks R8-R9 and the 8k PRG bank R15
+static bool mmc3_data( switch_scan *scan, ushort address, short value )
+{
+    short select = scan->select;
+
+    if( select == M6502_UNKNOWN )
+        return add_switch( scan, address, BANKSW_REG, 0, 0, BANKSW_UNKNOWN, value );
+
+    ushort chr_2k = (select & 0x80) ? 0x1000 : 0x0000;
+    ushort chr_1k = chr_2k ^ 0x1000;
+    bool prg_swap = (select & 0x40) != 0;
+
+    switch( select & (scan->ctx->desc->number == 64 ? 0x0F : 0x07) )
+    {
+    case 0: case 1:
+        return add_chr( scan, address, chr_2k + (select & 1) * 2 K, 2 K, value == M6502_UNKNOWN ? value : value >> 1, value );
+    case 2: case 3: case 4: case 5:
+        return add_chr( scan, address, chr_1k + ((select & 7) - 2) * 1 K, 1 K, value, value );
+    case 6:
+        return add_prg( scan, address, prg_swap ? 0xC000 : 0x8000, 8 K, value, value );
+    case 7:
+        return add_prg( scan, address, 0xA000, 8 K, value, value );
+    case 8:
+        return add_chr( scan, address, chr_2k + 1 K, 1 K, value, value );
+    case 9:
+        return add_chr( scan, address, chr_2k + 3 K, 1 K, value, value );
+    case 15:
+        return add_prg( scan, address, prg_swap ? 0x8000 : 0xC000, 8 K, value, value );
+    default:
+        return true;
+    }
+}
+
+// commands 0-7: 1k CHR, 8: 8k PRG at $6000 (ROM or RAM), 9-B: 8k PRG
+static bool fme7_data( switch_scan *scan, ushort address, short value )
+{
+    short command = scan->select;
+
+    if( command == M6502_UNKNOWN )
+        return add_switch( scan, address, BANKSW_REG, 0, 0, BANKSW_UNKNOWN, value );
+
+    command &= 0x0F;
+    if( command < 8 )
+        return add_chr( scan, address, command * 1 K, 1 K, value, value );
+    if( command == 8 )
+        return add_prg( scan, address, SRAM_START_ADDRESS, 8 K, value == M6502_UNKNOWN ? value : value & 0x3F, value );
+    if( command <= 0x0B )
+        return add_prg( scan, address, ROM_START_ADDRESS + (command - 9) * 8 K, 8 K, value == M6502_UNKNOWN ? value : value & 0x3F, value );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      one address per register
+//
+static bool direct_write( switch_scan *scan, ushort address, short value )
+{
+    const mapper_desc *desc = scan->ctx->desc;
+
+    switch( desc->number )
+    {
+    case 9:
+    case 10:
+        return mmc2_write( scan, address, value );
+
+    case 21:
+    case 22:
+    case 23:
+        return vrc24_write( scan, address, value );
+
+    case 24:
+        return vrc6_write( scan, address, value );
+
+    default:
+        if( address < desc->reg_start || address > desc->reg_end )
+            return true;
+        return add_switch( scan, address, BANKSW_REG, 0, 0, BANKSW_UNKNOWN, value );
+    }
+}
+
+// MMC2/4: PRG at $A000, two CHR banks per pattern table, one of
+// which is shown depending on the last tile fetched ($FD or $FE)
+static bool mmc2_write( switch_scan *scan, ushort address, short value )
+{
+    unsigned int prg_size = scan->ctx->desc->number == 9 ? 8 K : 16 K;
+
+    switch( address & 0xF000 )
+    {
+    case 0xA000:
+        return add_prg( scan, address, ROM_START_ADDRESS, prg_size, value, value );
+    case 0xB000:
+    case 0xC000:
+        return add_chr( scan, address, PATTERN_TABLE_0_ADDRESS, 4 K, value, value );
+    case 0xD000:
+    case 0xE000:
+        return add_chr( scan, address, PATTERN_TABLE_1_ADDRESS, 4 K, value, value );
+    default:
+        return true;
+    }
+}
+
+// VRC2/4: PRG at $8000 (or $C000 in VRC4 swap mode) and $A000,
+// 1k CHR banks at $B000-$E003 written as low and high nibble
+static bool vrc24_write( switch_scan *scan, ushort address, short value )
+{
+    ushort mapper = scan->ctx->desc->number;
+    int sub = vrc24_subregister( mapper, address );
+
+    switch( address & 0xF000 )
+    {
+    case 0x8000:
+        return add_prg( scan, address, scan->swap_mode == 1 ? 0xC000 : 0x8000, 8 K, value == M6502_UNKNOWN ? value : value & 0x1F, value );
+
+    case 0x9000:
+        // VRC4 only, VRC2 mirrors the mirroring register there
+        if( sub != 2 || mapper == 22 )
+            return true;
+        scan->swap_mode = value == M6502_UNKNOWN ? value : (value >> 1) & 1;
+        return add_mode( scan, address, "PRG swap mode", value );
+
+    case 0xA000:
+        return add_prg( scan, address, 0xA000, 8 K, value == M6502_UNKNOWN ? value : value & 0x1F, value );
+
+    case 0xB000:
+    case 0xC000:
+    case 0xD000:
+    case 0xE000:
+    {
+        int reg = ((address >> 12) - 0xB) * 2 + (sub >> 1);
+        int half = sub & 1;
+        short *nibbles = scan->chr_nibbles[reg];
+        short bank = M6502_UNKNOWN;
+
+        nibbles[half] = value == M6502_UNKNOWN ? value : value & 0x0F;
+        if( nibbles[0] != M6502_UNKNOWN && nibbles[1] != M6502_UNKNOWN )
+        {
+            bank = nibbles[0] | (nibbles[1] << 4);
+            // VRC2a ignores the lowest bit
+            if( mapper == 22 )
+                bank >>= 1;
+        }
+
+        if( !add_chr( scan, address, reg * 1 K, 1 K, bank, value ) )
+            return false;
+        scan->list->switches[scan->list->count - 1].part = half ? BANKSW_PART_HIGH : BANKSW_PART_LOW;
+        return true;
+    }
+
+    default:
+        return true;
+    }
+}
+
+// register within a group of four, from the address lines the
+// board connects to the chip (both variants of a mapper number)
+static int vrc24_subregister( ushort mapper, ushort address )
+{
+    switch( mapper )
+    {
+    case 21:                                // VRC4a A1 A2, VRC4c A6 A7
+        return ((address >> 1) | (address >> 6)) & 3;
+    case 22:                                // VRC2a A1 A0
+        return ((address >> 1) & 1) | ((address & 1) << 1);
+    default:                                // VRC2b A0 A1, VRC4e A2 A3
+        return (address | (address >> 2)) & 3;
+    }
+}
+
+// VRC6: 16k PRG at $8000, 8k PRG at $C000, 1k CHR at $D000-$E003
+static bool vrc6_write( switch_scan *scan, ushort address, short value )
+{
+    int sub = address & 3;
+
+    switch( address & 0xF000 )
+    {
+    case 0x8000:
+        return add_prg( scan, address, 0x8000, 16 K, value, value );
+    case 0xC000:
+        return add_prg( scan, address, 0xC000, 8 K, value, value );
+    case 0xD000:
+        return add_chr( scan, address, sub * 1 K, 1 K, value, value );
+    case 0xE000:
+        return add_chr( scan, address, (4 + sub) * 1 K, 1 K, value, value );
+    default:
+        return true;
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      describes a switch in a line
+//
+void bankswitch_describe( const ines_ctx *ctx, const bank_switch *sw, char *buf, size_t size )
+{
+    const char *mapper = ines_get_mapper_name( ctx->mapper );
+    char bank[16], value[8];
+    const char *part = sw->part == BANKSW_PART_LOW ? " (low nibble)" : sw->part == BANKSW_PART_HIGH ? " (high nibble)" : "";
+
+    if( sw->bank == BANKSW_UNKNOWN )
+        snprintf( bank, sizeof(bank), "?" );
+    else
+        snprintf( bank, sizeof(bank), "%ld", sw->bank );
+    if( sw->value == BANKSW_UNKNOWN )
+        snprintf( value, sizeof(value), "?" );
+    else
+        snprintf( value, sizeof(value), "$%02X", sw->value );
+
+    switch( sw->kind )
+    {
+    case BANKSW_PRG:
+        snprintf( buf, size, "%s: %uk PRG bank %s -> $%04X", mapper, sw->size / (1 K), bank, sw->window );
+        break;
+    case BANKSW_CHR:
+        snprintf( buf, size, "%s: %uk CHR bank %s -> PPU $%04X%s", mapper, sw->size / (1 K), bank, sw->window, part );
+        break;
+    case BANKSW_MODE:
+        snprintf( buf, size, "%s: %s = %s", mapper, sw->what, value );
+        break;
+    default:
+        snprintf( buf, size, "%s: mapper register $%04X = %s", mapper, sw->reg, value );
+        break;
+    }
+}
@@ -0,0 +1,97 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    bank switch detection.
+
+    bankswitch_scan() makes a linear pass over all PRG pages, like
+    ioscan_image(), and explains the absolute stores to the bank
+    registers of the image's mapper (see mapper_desc.regs):
+
+        latch           a single write, split into PRG and CHR
+                        bank numbers (UNROM, CNROM, GNROM, ...)
+        serial          five writes of one bit each, the fifth
+                        write selects the register (MMC1)
+        select/data     a register number, then its bank number
+                        (MMC3, Rambo-1, FME-7)
+        direct          one address per register. the VRC2/4 CHR
+                        bank numbers are split into two nibbles at
+                        neighbouring addresses, which are put back
+                        together (VRC2/4/6, MMC2/4)
+
+    Writes to the bank registers of other mappers are listed as
+    plain register writes. The values written are tracked with
+    m6502_track(), a bank number is known if all writes making
+    up a switch store constant values in straight-line code. A
+    switch is reported at the write that completes it.
+
+*/
+
+
+#ifndef _BANKSWITCH_H
+#define _BANKSWITCH_H
+
+#include "ines.h"
+
+
+// kinds of bank switches
+enum
+{
+    BANKSW_PRG = 1,                         // PRG bank into a CPU window
+    BANKSW_CHR,                             // CHR bank into a PPU window
+    BANKSW_MODE,                            // mapper mode or control register
+    BANKSW_REG                              // register of a mapper that isn't decoded
+};
+
+// parts of a bank number written
+enum
+{
+    BANKSW_PART_ALL,
+    BANKSW_PART_LOW,                        // low nibble (VRC2/4 CHR banks)
+    BANKSW_PART_HIGH
+};
+
+// bank number or value that isn't known
+#define BANKSW_UNKNOWN                      -1
+
+
+typedef struct _bank_switch_t {
+
+    unsigned int offset;                    // of the completing write, from the start of PRG-ROM
+    ushort reg;                             // address written
+    uchar kind;                             // BANKSW_...
+    uchar part;                             // BANKSW_PART_...
+    ushort window;                          // CPU (PRG) or PPU (CHR) address switched
+    unsigned int size;                      // of the window, 0 for BANKSW_MODE/REG
+    long bank;                              // in window sized banks or BANKSW_UNKNOWN
+    short value;                            // last byte written or BANKSW_UNKNOWN
+    const char *what;                       // name of a BANKSW_MODE register
+
+} bank_switch;
+
+
+typedef struct _bankswitch_list_t {
+
+    long count;
+    long size;
+    bank_switch *switches;                  // in file order
+
+} bankswitch_list;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for bankswitch.cpp
+//
+
+bool bankswitch_scan( const ines_ctx *ctx, bankswitch_list *list );
+void bankswitch_free( bankswitch_list *list );
+
+// e.g. "MMC 3: 8k PRG bank 5 -> $A000"
+void bankswitch_describe( const ines_ctx *ctx, const bank_switch *sw, char *buf, size_t size );
+
+#endif // _BANKSWITCH_H
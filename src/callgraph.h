@@ -0,0 +1,152 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    querying the cross-bank call graph.
+
+    The loader records every JSR and JMP abs of all PRG banks in
+    INES_CALLS_NODE (see callscan.h and nes.h). Locations are given
+    as PRG bank, counted like the overlays, and CPU address. The
+    references to a target have consecutive numbers, so asking for
+    the callers of a location takes two altvals plus two per
+    caller, however large the ROM is:
+
+        ines_call_ref refs[64];
+        uval_t bank;
+        ea_t address;
+
+        if( ines_find_call_location( get_screen_ea(), &bank, &address ) )
+        {
+            int n = ines_get_callers( bank, address, refs, qnumber(refs) );
+            ...
+        }
+
+    Callers whose target bank isn't known (the target is in a window
+    several banks are switched into, see callscan.h) are listed
+    under INES_CALLS_ANY_BANK and the target address.
+
+*/
+
+
+#ifndef _CALLGRAPH_H
+#define _CALLGRAPH_H
+
+#include "bankswap.h"
+
+
+// a JSR or JMP referring to a location
+typedef struct _ines_call_ref_t {
+
+    uval_t bank;
+    ea_t address;                           // CPU address
+    uchar opcode;                           // JSR or JMP abs
+
+} ines_call_ref;
+
+
+
+//----------------------------------------------------------------------
+//
+//      number of references and of targets, 0 if the database
+//      has no call graph
+//
+inline long ines_call_count( void )
+{
+    netnode node( INES_CALLS_NODE );
+
+    return node == BADNODE ? 0 : (long)node.altval( 0, INES_CALLS_TAG_COUNT );
+}
+
+inline long ines_call_target_count( void )
+{
+    netnode node( INES_CALLS_NODE );
+
+    return node == BADNODE ? 0 : (long)node.altval( 1, INES_CALLS_TAG_COUNT );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      target number 't', targets are ordered by bank and address
+//
+inline bool ines_get_call_target( long t, uval_t *bank, ea_t *address )
+{
+    netnode node( INES_CALLS_NODE );
+    uval_t key;
+
+    if( node == BADNODE || t < 0 || t >= (long)node.altval( 1, INES_CALLS_TAG_COUNT ) )
+        return false;
+
+    key = node.altval( t, INES_CALLS_TAG_TARGET );
+    *bank = INES_CALLS_KEY_BANK( key );
+    *address = INES_CALLS_KEY_ADDRESS( key );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      fills up to 'max' callers of a location and returns how
+//      many there are
+//
+inline int ines_get_callers( uval_t bank, ea_t address, ines_call_ref *refs, int max )
+{
+    netnode node( INES_CALLS_NODE );
+    uval_t key = INES_CALLS_KEY( bank, address );
+    uval_t first, degree;
+
+    if( node == BADNODE )
+        return 0;
+    first = node.altval( key, INES_CALLS_TAG_FIRST );
+    if( first == 0 )
+        return 0;
+    degree = node.altval( key, INES_CALLS_TAG_DEGREE );
+
+    for( uval_t i=0; i<degree && (int)i<max; i++ )
+    {
+        uval_t from = node.altval( first - 1 + i, INES_CALLS_TAG_FROM );
+
+        refs[i].bank = INES_CALLS_KEY_BANK( from );
+        refs[i].address = INES_CALLS_KEY_ADDRESS( from );
+        refs[i].opcode = (uchar)node.altval( first - 1 + i, INES_CALLS_TAG_OPCODE );
+    }
+    return (int)degree;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      the bank and CPU address of a linear address in an overlay
+//      or in a window at $8000-$FFFF with a resident bank
+//
+inline bool ines_find_call_location( ea_t ea, uval_t *bank, ea_t *address )
+{
+    netnode node( INES_CALLS_NODE );
+    uval_t size, resident, bank_size;
+    ea_t window;
+
+    if( node == BADNODE || (bank_size = node.altval( 2, INES_CALLS_TAG_COUNT )) == 0 )
+        return false;
+
+    if( INES_OVERLAY_INDEX( ea ) >= 0 )
+    {
+        *bank = INES_OVERLAY_INDEX( ea );
+        *address = ea & 0xFFFF;
+        return true;
+    }
+
+    // resident banks may be larger than the banks of the graph
+    if( !ines_get_resident_bank( ea, &window, &size, &resident ) )
+        return false;
+    *bank = (resident * size + (ea - window)) / bank_size;
+    *address = ea;
+    return true;
+}
+
+#endif // _CALLGRAPH_H
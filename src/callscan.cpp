@@ -0,0 +1,304 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    cross-bank call graph.
+    See callscan.h.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "callscan.h"
+#include "m6502.h"
+
+
+// initial room for references, grows as needed
+#define REFS_PER_BANK                       64
+
+// 8k slots of the ROM area
+#define ROM_SLOTS                           ( ROM_SIZE / PRG_ROM_8K_BANK_SIZE )
+
+// a slot more than one bank can be switched into
+#define SWITCHED                            -1
+
+
+// where the banks are
+typedef struct _bank_layout_t {
+
+    long size;                              // bytes per bank
+    int parts;                              // banks switched together, 2 for 32k windows
+    long slot_bank[ROM_SLOTS];              // only bank at a slot or SWITCHED
+
+} bank_layout;
+
+
+// references found so far, in bank order
+typedef struct _ref_list_t {
+
+    long count;
+    long size;
+    callscan_ref *refs;
+
+} ref_list;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for callscan.cpp
+//
+
+static void plan_layout( const ines_ctx *plan, bank_layout *layout );
+static unsigned int target_key( const bank_layout *layout, const ines_bank *bank, long index, ushort target );
+static bool add_ref( ref_list *list, unsigned int from, unsigned int to, unsigned int offset, uchar opcode );
+static bool scan_bank( ref_list *list, const bank_layout *layout, const ines_bank *bank, long index, const uchar *data, unsigned int offset );
+static int compare_refs( const void *a, const void *b );
+static bool build_rows( callscan_graph *graph );
+
+
+
+//----------------------------------------------------------------------
+//
+//      builds the call graph of all PRG banks
+//
+bool callscan_image( const ines_ctx *ctx, callscan_graph *graph )
+{
+    ines_ctx plan = *ctx;
+    bank_layout layout;
+    ref_list list;
+    bool ok = true;
+
+    memset( graph, 0, sizeof(*graph) );
+    memset( &list, 0, sizeof(list) );
+
+    // banks are numbered and placed like the overlays
+    ines_plan_overlays( &plan );
+    plan_layout( &plan, &layout );
+    graph->bank_size = layout.size;
+
+    for( int i=0; i<plan.overlay_count && ok; i++ )
+    {
+        ines_bank bank;
+        const uchar *data;
+
+        if( !ines_get_overlay( &plan, i, &bank ) || (data = ines_bank_data( ctx, &bank )) == NULL )
+            break;
+
+        ok = scan_bank( &list, &layout, &bank, i, data, (unsigned int)(bank.offset - ines_prg_offset( ctx )) );
+        graph->banks++;
+    }
+
+    if( ok && list.count > 1 )
+        qsort( list.refs, list.count, sizeof(callscan_ref), compare_refs );
+
+    graph->count = list.count;
+    graph->refs = list.refs;
+    ok = ok && build_rows( graph );
+    if( !ok )
+        callscan_free( graph );
+    return ok;
+}
+
+void callscan_free( callscan_graph *graph )
+{
+    free( graph->refs );
+    free( graph->targets );
+    free( graph->first );
+    memset( graph, 0, sizeof(*graph) );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      binary search for a target
+//
+long callscan_find( const callscan_graph *graph, unsigned int key )
+{
+    long low = 0, high = graph->target_count;
+
+    while( low < high )
+    {
+        long mid = low + (high - low) / 2;
+
+        if( graph->targets[mid] < key )
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low < graph->target_count && graph->targets[low] == key ? low : -1;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      finds the 8k slots of $8000-$FFFF only one bank can be at
+//
+static void plan_layout( const ines_ctx *plan, bank_layout *layout )
+{
+    int candidates[ROM_SLOTS];
+
+    memset( candidates, 0, sizeof(candidates) );
+    layout->size = plan->desc->prg_window > PRG_ROM_BANK_SIZE ? PRG_ROM_BANK_SIZE : plan->desc->prg_window;
+    layout->parts = plan->desc->prg_window > PRG_ROM_BANK_SIZE ? plan->desc->prg_window / PRG_ROM_BANK_SIZE : 1;
+    for( int s=0; s<ROM_SLOTS; s++ )
+        layout->slot_bank[s] = SWITCHED;
+
+    for( int i=0; i<plan->overlay_count; i++ )
+    {
+        ines_bank bank;
+
+        if( !ines_get_overlay( plan, i, &bank ) )
+            break;
+        for( long a=bank.address; a<bank.address + layout->size && a<ROM_START_ADDRESS + ROM_SIZE; a+=PRG_ROM_8K_BANK_SIZE )
+        {
+            int s = (int)((a - ROM_START_ADDRESS) / PRG_ROM_8K_BANK_SIZE);
+
+            if( candidates[s]++ == 0 )
+                layout->slot_bank[s] = i;
+            else
+                layout->slot_bank[s] = SWITCHED;
+        }
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      the bank a JSR/JMP in bank 'index' reaches at 'target'
+//
+static unsigned int target_key( const bank_layout *layout, const ines_bank *bank, long index, ushort target )
+{
+    long slot;
+
+    if( target >= bank->address && target < bank->address + layout->size )
+        return INES_CALLS_KEY( index, target );
+    if( target < ROM_START_ADDRESS )
+        return INES_CALLS_KEY( INES_CALLS_ANY_BANK, target );
+
+    // the other half of a 32k window
+    if( layout->parts > 1 )
+        return INES_CALLS_KEY( index - index % layout->parts + (target - ROM_START_ADDRESS) / layout->size, target );
+
+    slot = layout->slot_bank[(target - ROM_START_ADDRESS) / PRG_ROM_8K_BANK_SIZE];
+    return INES_CALLS_KEY( slot != SWITCHED ? slot : INES_CALLS_ANY_BANK, target );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      appends a reference to the list
+//
+static bool add_ref( ref_list *list, unsigned int from, unsigned int to, unsigned int offset, uchar opcode )
+{
+    if( list->count == list->size )
+    {
+        long size = list->size ? list->size * 2 : REFS_PER_BANK;
+        callscan_ref *refs = (callscan_ref *)realloc( list->refs, size * sizeof(callscan_ref) );
+
+        if( refs == NULL )
+            return false;
+        list->refs = refs;
+        list->size = size;
+    }
+
+    callscan_ref *ref = &list->refs[list->count++];
+    ref->from = from;
+    ref->to = to;
+    ref->offset = offset;
+    ref->opcode = opcode;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      decodes a bank one instruction after the other
+//
+static bool scan_bank( ref_list *list, const bank_layout *layout, const ines_bank *bank, long index, const uchar *data, unsigned int offset )
+{
+    long pos, len, size = (long)bank->size;
+
+    for( pos=0; pos<size; pos+=len )
+    {
+        uchar opcode = data[pos];
+
+        len = m6502_op_lengths[opcode];
+        if( pos + len > size )
+            break;
+        if( opcode != M6502_JSR && opcode != M6502_JMP_ABS )
+            continue;
+
+        ushort target = (ushort)(data[pos + 1] | (data[pos + 2] << 8));
+        if( !add_ref( list, INES_CALLS_KEY( index, bank->address + pos ), target_key( layout, bank, index, target ),
+                      offset + (unsigned int)pos, opcode ) )
+            return false;
+    }
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      orders references by target, then by caller
+//
+static int compare_refs( const void *a, const void *b )
+{
+    const callscan_ref *x = (const callscan_ref *)a;
+    const callscan_ref *y = (const callscan_ref *)b;
+
+    if( x->to != y->to )
+        return x->to < y->to ? -1 : 1;
+    if( x->from != y->from )
+        return x->from < y->from ? -1 : 1;
+    return 0;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      fills targets[] and the row pointers from the sorted
+//      references and counts the cross-bank ones
+//
+static bool build_rows( callscan_graph *graph )
+{
+    long t = 0;
+
+    for( long i=0; i<graph->count; i++ )
+        if( i == 0 || graph->refs[i].to != graph->refs[i - 1].to )
+            graph->target_count++;
+
+    graph->targets = (unsigned int *)malloc( (graph->target_count ? graph->target_count : 1) * sizeof(unsigned int) );
+    graph->first = (long *)malloc( (graph->target_count + 1) * sizeof(long) );
+    if( graph->targets == NULL || graph->first == NULL )
+        return false;
+
+    for( long i=0; i<graph->count; i++ )
+    {
+        const callscan_ref *ref = &graph->refs[i];
+        unsigned int bank = INES_CALLS_KEY_BANK( ref->to );
+
+        if( i == 0 || ref->to != graph->refs[i - 1].to )
+        {
+            graph->targets[t] = ref->to;
+            graph->first[t++] = i;
+        }
+        if( bank != INES_CALLS_ANY_BANK && bank != INES_CALLS_KEY_BANK( ref->from ) )
+            graph->cross++;
+    }
+    graph->first[t] = graph->count;
+    return true;
+}
@@ -0,0 +1,79 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    cross-bank call graph.
+
+    callscan_image() sweeps every PRG bank, not only the banks
+    loaded into the database, like ioscan_image() and records each
+    JSR and JMP abs with the bank and CPU address of the instruction
+    and of its target (INES_CALLS_KEY()). Banks are numbered like the
+    PRG overlays (ines_get_overlay()): in the mapper's PRG window
+    size, 32k windows split into 16k halves, and every bank is
+    assumed at the CPU address of its overlay. The bank of a target
+    is
+
+        - the bank of the instruction if the target lies in its
+          window, or the other half of its 32k window,
+        - the only bank that can be at the target address, which
+          is the case for the mapper's fixed banks,
+        - INES_CALLS_ANY_BANK if the target is outside of PRG-ROM
+          or in a window several banks are switched into.
+
+    The graph is kept by target in compressed sparse row form:
+    targets[] holds the distinct targets in ascending order, the
+    references to targets[t] are refs[first[t]]..refs[first[t+1]-1],
+    ordered by caller. Like in the I/O register index, data inside
+    the banks is decoded as well and may add a few references that
+    are never executed.
+
+*/
+
+
+#ifndef _CALLSCAN_H
+#define _CALLSCAN_H
+
+#include "ines.h"
+
+
+// a JSR or JMP abs
+typedef struct _callscan_ref_t {
+
+    unsigned int from;                      // INES_CALLS_KEY() of the instruction
+    unsigned int to;                        // of the target
+    unsigned int offset;                    // of the instruction, from the start of PRG-ROM
+    uchar opcode;
+
+} callscan_ref;
+
+
+typedef struct _callscan_graph_t {
+
+    long count;
+    callscan_ref *refs;                     // by target, then by caller
+    long target_count;
+    unsigned int *targets;                  // ascending
+    long *first;                            // target_count + 1 row pointers
+    int banks;                              // PRG banks scanned
+    long bank_size;                         // bytes per bank
+    long cross;                             // references into another known bank
+
+} callscan_graph;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for callscan.cpp
+//
+
+bool callscan_image( const ines_ctx *ctx, callscan_graph *graph );
+void callscan_free( callscan_graph *graph );
+
+// row of a target in targets[] and first[], -1 if nothing refers to it
+long callscan_find( const callscan_graph *graph, unsigned int key );
+
+#endif // _CALLSCAN_H
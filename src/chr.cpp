@@ -0,0 +1,522 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    CHR tiles and tile sheets.
+    See chr.h.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chr.h"
+#include "hash.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #include <immintrin.h>
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define CHR_SSE2
+    #endif
+    #if defined(__GNUC__)
+        #define CHR_AVX2
+        #define CHR_TARGET_AVX2 __attribute__((target("avx2")))
+    #elif defined(_MSC_VER)
+        #include <intrin.h>
+        #define CHR_AVX2
+        #define CHR_TARGET_AVX2
+    #endif
+#endif
+
+
+// tile lines decoded and written at a time
+#define SHEET_CHUNK_LINES                   64
+
+// room for a chunk of PPM rows, PNG rows are smaller. PNG rows are
+// put behind the 5 byte header of a stored deflate block and are
+// followed by the adler32 of the stream in the last block
+#define SHEET_BLOCK_HDR                     5
+#define SHEET_BUFFER_SIZE                   (SHEET_BLOCK_HDR + SHEET_CHUNK_LINES * 8 * CHR_SHEET_WIDTH * 3 + 4)
+
+// NES-ish grey levels for the color indexes
+static const uchar sheet_palette[4][3] =
+{
+    { 0x00, 0x00, 0x00 },
+    { 0x55, 0x55, 0x55 },
+    { 0xAA, 0xAA, 0xAA },
+    { 0xFF, 0xFF, 0xFF }
+};
+
+
+// sheet file being written
+typedef struct _sheet_writer_t {
+
+    FILE *fp;
+    int format;                             // CHR_SHEET_...
+    crc32_t adler;                          // PNG: adler32 of the zlib stream
+    uchar *buffer;                          // SHEET_BUFFER_SIZE bytes
+    bool ok;
+
+} sheet_writer;
+
+
+typedef void (*tile_decoder)( const uchar *src, size_t count, uchar *dst );
+
+#ifndef CHR_SSE2
+static void decode_scalar( const uchar *src, size_t count, uchar *dst );
+#else
+static void decode_sse2( const uchar *src, size_t count, uchar *dst );
+#endif
+#ifdef CHR_AVX2
+CHR_TARGET_AVX2 static void decode_avx2( const uchar *src, size_t count, uchar *dst );
+static bool cpu_has_avx2( void );
+#endif
+static tile_decoder get_decoder( const char **name );
+
+static void put_be32( uchar *p, crc32_t v );
+static crc32_t adler32( crc32_t adler, const uchar *buf, size_t size );
+static void write_bytes( sheet_writer *sw, const void *data, size_t size );
+static void write_png_chunk( sheet_writer *sw, const char *type, const uchar *data, size_t size );
+static void write_stored_block( sheet_writer *sw, size_t size, bool last );
+static void begin_sheet( sheet_writer *sw, long height );
+static void write_sheet_lines( sheet_writer *sw, const uchar *pixels, int lines );
+static void end_sheet( sheet_writer *sw );
+
+
+
+//----------------------------------------------------------------------
+//
+//      decodes tiles with the fastest decoder the CPU supports
+//
+void chr_decode_tiles( const uchar *src, size_t count, uchar *dst )
+{
+    static const tile_decoder decoder = get_decoder( NULL );
+
+    decoder( src, count, dst );
+}
+
+const char *chr_decoder_name( void )
+{
+    const char *name;
+
+    get_decoder( &name );
+    return name;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes the tile sheet of the CHR-ROM to 'path'. tiles cut off
+//      by the end of the file are left out, the last line is padded
+//      with color 0. returns the number of tiles, 0 without CHR-ROM
+//      (no file is written then) or -1 if the file can't be written.
+//      the buffers are allocated per call, sheets can be written
+//      on several threads at once
+//
+long chr_write_sheet( const ines_ctx *ctx, const char *path, int format )
+{
+    uchar *pixels;
+    image_off_t offset = ines_chr_offset( ctx );
+    image_off_t size = ctx->chr_size;
+    const uchar *chr;
+    sheet_writer sw;
+    long tiles, lines;
+
+    if( offset + size > ctx->file_size )
+        size = ctx->file_size > offset ? ctx->file_size - offset : 0;
+    tiles = (long)(size / CHR_TILE_SIZE);
+    if( tiles == 0 )
+        return 0;
+    chr = image_slice( ctx->image, offset, (image_off_t)tiles * CHR_TILE_SIZE );
+    lines = (tiles + CHR_SHEET_TILES - 1) / CHR_SHEET_TILES;
+
+    memset( &sw, 0, sizeof(sw) );
+    pixels = (uchar *)malloc( SHEET_CHUNK_LINES * CHR_SHEET_TILES * CHR_TILE_PIXELS );
+    sw.buffer = (uchar *)malloc( SHEET_BUFFER_SIZE );
+    sw.fp = pixels != NULL && sw.buffer != NULL ? fopen( path, "wb" ) : NULL;
+    if( sw.fp == NULL )
+    {
+        free( pixels );
+        free( sw.buffer );
+        return -1;
+    }
+    sw.format = format;
+    sw.ok = true;
+
+    begin_sheet( &sw, lines * 8 );
+    for( long line=0; line<lines && sw.ok; line+=SHEET_CHUNK_LINES )
+    {
+        int count = (int)(lines - line < SHEET_CHUNK_LINES ? lines - line : SHEET_CHUNK_LINES);
+        long first = line * CHR_SHEET_TILES;
+        long n = tiles - first < count * CHR_SHEET_TILES ? tiles - first : count * CHR_SHEET_TILES;
+
+        chr_decode_tiles( chr + (size_t)first * CHR_TILE_SIZE, n, pixels );
+        memset( pixels + n * CHR_TILE_PIXELS, 0, (count * CHR_SHEET_TILES - n) * CHR_TILE_PIXELS );
+        write_sheet_lines( &sw, pixels, count );
+    }
+    end_sheet( &sw );
+
+    if( fclose( sw.fp ) != 0 )
+        sw.ok = false;
+    free( pixels );
+    free( sw.buffer );
+    return sw.ok ? tiles : -1;
+}
+
+
+
+#ifndef CHR_SSE2
+//----------------------------------------------------------------------
+//
+//      plain C++ decoder: every plane byte is spread to 8 pixel
+//      bytes by table lookup, both planes are combined 8 pixels
+//      at a time
+//
+static void decode_scalar( const uchar *src, size_t count, uchar *dst )
+{
+    static struct spread_table_t
+    {
+        unsigned long long entry[256];
+
+        spread_table_t()
+        {
+            for( int n=0; n<256; n++ )
+            {
+                uchar row[8];
+                for( int x=0; x<8; x++ )
+                    row[x] = (n >> (7 - x)) & 1;
+                memcpy( &entry[n], row, 8 );
+            }
+        }
+    } spread;
+
+    for( size_t i=0; i<count; i++, src+=CHR_TILE_SIZE, dst+=CHR_TILE_PIXELS )
+    {
+        for( int y=0; y<8; y++ )
+        {
+            unsigned long long row = spread.entry[src[y]] | (spread.entry[src[y + 8]] << 1);
+            memcpy( dst + y * 8, &row, 8 );
+        }
+    }
+}
+#else
+//----------------------------------------------------------------------
+//
+//      SSE2 decoder: the plane bytes are repeated 8 times by
+//      unpacking them with themselves, then every lane tests the
+//      bit of its pixel. one vector holds two rows
+//
+static void decode_sse2( const uchar *src, size_t count, uchar *dst )
+{
+    const __m128i bits = _mm_setr_epi8( (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1,
+                                        (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1 );
+    const __m128i one = _mm_set1_epi8( 1 );
+    const __m128i two = _mm_set1_epi8( 2 );
+
+    for( size_t i=0; i<count; i++, src+=CHR_TILE_SIZE, dst+=CHR_TILE_PIXELS )
+    {
+        __m128i tile = _mm_loadu_si128( (const __m128i *)src );
+        __m128i lo = _mm_unpacklo_epi8( tile, tile );           // low plane, every byte twice
+        __m128i hi = _mm_unpackhi_epi8( tile, tile );
+        __m128i lo4[2] = { _mm_unpacklo_epi16( lo, lo ), _mm_unpackhi_epi16( lo, lo ) };
+        __m128i hi4[2] = { _mm_unpacklo_epi16( hi, hi ), _mm_unpackhi_epi16( hi, hi ) };
+
+        for( int k=0; k<4; k++ )
+        {
+            __m128i l = k & 1 ? _mm_unpackhi_epi32( lo4[k >> 1], lo4[k >> 1] ) : _mm_unpacklo_epi32( lo4[k >> 1], lo4[k >> 1] );
+            __m128i h = k & 1 ? _mm_unpackhi_epi32( hi4[k >> 1], hi4[k >> 1] ) : _mm_unpacklo_epi32( hi4[k >> 1], hi4[k >> 1] );
+
+            l = _mm_and_si128( _mm_cmpeq_epi8( _mm_and_si128( l, bits ), bits ), one );
+            h = _mm_and_si128( _mm_cmpeq_epi8( _mm_and_si128( h, bits ), bits ), two );
+            _mm_storeu_si128( (__m128i *)(dst + k * 16), _mm_or_si128( l, h ) );
+        }
+    }
+}
+#endif
+
+
+
+#ifdef CHR_AVX2
+//----------------------------------------------------------------------
+//
+//      AVX2 decoder: the tile is broadcast to both lanes and the
+//      plane bytes are repeated with a byte shuffle. one vector
+//      holds four rows
+//
+CHR_TARGET_AVX2 static void decode_avx2( const uchar *src, size_t count, uchar *dst )
+{
+    const __m256i bits = _mm256_setr_epi8( (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1,
+                                           (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1 );
+    const __m256i rows03 = _mm256_setr_epi8( 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                             2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 );
+    const __m256i four = _mm256_set1_epi8( 4 );
+    const __m256i eight = _mm256_set1_epi8( 8 );
+    const __m256i one = _mm256_set1_epi8( 1 );
+    const __m256i two = _mm256_set1_epi8( 2 );
+
+    for( size_t i=0; i<count; i++, src+=CHR_TILE_SIZE, dst+=CHR_TILE_PIXELS )
+    {
+        __m256i tile = _mm256_broadcastsi128_si256( _mm_loadu_si128( (const __m128i *)src ) );
+
+        for( int k=0; k<2; k++ )
+        {
+            __m256i rows = k ? _mm256_add_epi8( rows03, four ) : rows03;
+            __m256i l = _mm256_shuffle_epi8( tile, rows );
+            __m256i h = _mm256_shuffle_epi8( tile, _mm256_add_epi8( rows, eight ) );
+
+            l = _mm256_and_si256( _mm256_cmpeq_epi8( _mm256_and_si256( l, bits ), bits ), one );
+            h = _mm256_and_si256( _mm256_cmpeq_epi8( _mm256_and_si256( h, bits ), bits ), two );
+            _mm256_storeu_si256( (__m256i *)(dst + k * 32), _mm256_or_si256( l, h ) );
+        }
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      AVX2 needs support by the CPU and the OS (saved YMM state)
+//
+static bool cpu_has_avx2( void )
+{
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+#else
+    int info[4];
+
+    __cpuid( info, 1 );
+    if( (info[2] & (1 << 27)) == 0 || (_xgetbv( 0 ) & 6) != 6 )
+        return false;
+    __cpuidex( info, 7, 0 );
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+#endif
+
+
+
+//----------------------------------------------------------------------
+//
+//      picks the decoder for this CPU
+//
+static tile_decoder get_decoder( const char **name )
+{
+    const char *dummy;
+
+    if( name == NULL )
+        name = &dummy;
+
+#ifdef CHR_AVX2
+    if( cpu_has_avx2() )
+    {
+        *name = "avx2";
+        return decode_avx2;
+    }
+#endif
+#ifdef CHR_SSE2
+    *name = "sse2";
+    return decode_sse2;
+#else
+    *name = "scalar";
+    return decode_scalar;
+#endif
+}
+
+
+
+static void put_be32( uchar *p, crc32_t v )
+{
+    p[0] = (uchar)(v >> 24);
+    p[1] = (uchar)(v >> 16);
+    p[2] = (uchar)(v >> 8);
+    p[3] = (uchar)v;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      adler32 checksum of the zlib stream in a PNG
+//
+static crc32_t adler32( crc32_t adler, const uchar *buf, size_t size )
+{
+    crc32_t a = adler & 0xFFFF, b = adler >> 16;
+
+    while( size > 0 )
+    {
+        // 5552 bytes are the most that can't overflow b
+        size_t n = size < 5552 ? size : 5552;
+
+        size -= n;
+        while( n-- )
+        {
+            a += *buf++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+
+
+static void write_bytes( sheet_writer *sw, const void *data, size_t size )
+{
+    if( sw->ok && fwrite( data, 1, size, sw->fp ) != size )
+        sw->ok = false;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes a PNG chunk: length, type, data and CRC32. chunks
+//      without data (IEND) may pass NULL
+//
+static void write_png_chunk( sheet_writer *sw, const char *type, const uchar *data, size_t size )
+{
+    uchar buf[4];
+    crc32_t crc = hash_crc32( 0, type, 4 );
+
+    put_be32( buf, (crc32_t)size );
+    write_bytes( sw, buf, 4 );
+    write_bytes( sw, type, 4 );
+    if( size > 0 )
+    {
+        crc = hash_crc32( crc, data, size );
+        write_bytes( sw, data, size );
+    }
+    put_be32( buf, crc );
+    write_bytes( sw, buf, 4 );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes the 'size' bytes of rows in the buffer as an IDAT chunk
+//      holding one stored (uncompressed) deflate block. the sheets
+//      would compress well, but they are meant to be written fast
+//
+static void write_stored_block( sheet_writer *sw, size_t size, bool last )
+{
+    uchar *p = sw->buffer;
+
+    p[0] = last ? 1 : 0;
+    p[1] = (uchar)size;
+    p[2] = (uchar)(size >> 8);
+    p[3] = (uchar)~size;
+    p[4] = (uchar)(~size >> 8);
+
+    sw->adler = adler32( sw->adler, p + SHEET_BLOCK_HDR, size );
+    if( last )
+    {
+        put_be32( p + SHEET_BLOCK_HDR + size, sw->adler );
+        size += 4;
+    }
+    write_png_chunk( sw, "IDAT", p, SHEET_BLOCK_HDR + size );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      file header, the first IDAT starts the zlib stream
+//
+static void begin_sheet( sheet_writer *sw, long height )
+{
+    if( sw->format == CHR_SHEET_PPM )
+    {
+        char hdr[64];
+        int size = sprintf( hdr, "P6\n%d %ld\n255\n", CHR_SHEET_WIDTH, height );
+
+        write_bytes( sw, hdr, size );
+        return;
+    }
+
+    static const uchar signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    static const uchar zlib_hdr[2] = { 0x78, 0x01 };
+    uchar ihdr[13];
+
+    write_bytes( sw, signature, sizeof(signature) );
+
+    put_be32( ihdr, CHR_SHEET_WIDTH );
+    put_be32( ihdr + 4, (crc32_t)height );
+    ihdr[8] = 2;                            // bits per pixel
+    ihdr[9] = 3;                            // palette colors
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;     // deflate, no filter, no interlace
+    write_png_chunk( sw, "IHDR", ihdr, sizeof(ihdr) );
+    write_png_chunk( sw, "PLTE", &sheet_palette[0][0], sizeof(sheet_palette) );
+
+    sw->adler = 1;
+    write_png_chunk( sw, "IDAT", zlib_hdr, sizeof(zlib_hdr) );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes 'lines' tile lines of decoded tiles, 8 rows each
+//
+static void write_sheet_lines( sheet_writer *sw, const uchar *pixels, int lines )
+{
+    uchar *rows = sw->buffer + SHEET_BLOCK_HDR;
+    uchar *p = rows;
+
+    for( int line=0; line<lines; line++ )
+    {
+        const uchar *tiles = pixels + line * CHR_SHEET_TILES * CHR_TILE_PIXELS;
+
+        for( int y=0; y<8; y++ )
+        {
+            if( sw->format == CHR_SHEET_PNG )
+                *p++ = 0;                   // filter type: none
+
+            for( int t=0; t<CHR_SHEET_TILES; t++ )
+            {
+                const uchar *px = tiles + t * CHR_TILE_PIXELS + y * 8;
+
+                if( sw->format == CHR_SHEET_PNG )
+                {
+                    *p++ = (uchar)((px[0] << 6) | (px[1] << 4) | (px[2] << 2) | px[3]);
+                    *p++ = (uchar)((px[4] << 6) | (px[5] << 4) | (px[6] << 2) | px[7]);
+                    continue;
+                }
+
+                for( int x=0; x<8; x++ )
+                {
+                    memcpy( p, sheet_palette[px[x]], 3 );
+                    p += 3;
+                }
+            }
+        }
+    }
+
+    if( sw->format == CHR_SHEET_PNG )
+        write_stored_block( sw, p - rows, false );
+    else
+        write_bytes( sw, rows, p - rows );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      PNG: closes the zlib stream with an empty last block
+//
+static void end_sheet( sheet_writer *sw )
+{
+    if( sw->format != CHR_SHEET_PNG )
+        return;
+
+    write_stored_block( sw, 0, true );
+    write_png_chunk( sw, "IEND", NULL, 0 );
+}
@@ -0,0 +1,58 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    CHR tiles and tile sheets.
+
+    A tile is 8x8 pixels in 16 bytes: 8 bytes with bit 0 of every
+    pixel (low plane), then 8 bytes with bit 1 (high plane), the
+    leftmost pixel in bit 7. chr_decode_tiles() turns tiles into
+    64 bytes of color indexes (0-3) each, row by row. It uses AVX2
+    if the CPU has it, SSE2 on other x86 CPUs and plain C++ on
+    anything else.
+
+    A tile sheet shows all CHR-ROM tiles of an image in file order,
+    16 tiles (one pattern table row) per line, so every 4k pattern
+    table is a 128x128 block. Sheets are written as PNG with a
+    4 color palette or as binary PPM, a few tile lines at a time,
+    so the memory needed doesn't depend on the size of the CHR-ROM.
+
+*/
+
+
+#ifndef _CHR_H
+#define _CHR_H
+
+#include "ines.h"
+
+
+#define CHR_TILE_SIZE                       16
+#define CHR_TILE_PIXELS                     64
+#define CHR_SHEET_TILES                     16          // tiles per line
+#define CHR_SHEET_WIDTH                     (CHR_SHEET_TILES * 8)
+
+// sheet file formats
+enum
+{
+    CHR_SHEET_PNG,
+    CHR_SHEET_PPM
+};
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for chr.cpp
+//
+
+// decodes 'count' tiles to CHR_TILE_PIXELS bytes each
+void chr_decode_tiles( const uchar *src, size_t count, uchar *dst );
+const char *chr_decoder_name( void );           // "avx2", "sse2" or "scalar"
+
+// writes the sheet of all CHR-ROM tiles, returns the number of tiles or -1
+long chr_write_sheet( const ines_ctx *ctx, const char *path, int format );
+
+#endif // _CHR_H
@@ -0,0 +1,801 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    far-call trampolines.
+    See farcall.h.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "farcall.h"
+#include "m6502.h"
+
+
+// initial room for calls, grows as needed
+#define CALLS_PER_STUB                      32
+
+// internal RAM, the only memory a trampoline's arguments are kept in
+#define INTERNAL_RAM                        0x800
+
+// values of a trampoline that aren't arguments: the return address
+// pulled from the stack, low and high byte
+#define ARG_RETURN_LOW                      0x10
+#define ARG_RETURN_HIGH                     0x11
+
+// stack entries followed
+#define STACK_DEPTH                         8
+
+
+// PRG banks loaded to the fixed windows
+typedef struct _fixed_view_t {
+
+    const ines_ctx *ctx;
+    ushort start;                           // lowest CPU address of the fixed windows
+    int count;
+    ines_bank banks[INES_MAX_BANKS];
+    const uchar *data[INES_MAX_BANKS];
+    unsigned int offsets[INES_MAX_BANKS];   // from the start of PRG-ROM
+
+} fixed_view;
+
+
+// symbolic state of a trampoline
+typedef struct _stub_state_t {
+
+    farcall_arg a, x, y;
+    bool shifted;                           // A has been shifted
+    farcall_arg stack[STACK_DEPTH];
+    int depth;
+    int pulled;                             // bytes pulled beyond the pushed ones
+    farcall_arg ram[INTERNAL_RAM];
+
+} stub_state;
+
+
+// RAM values of the straight-line code leading up to a call,
+// a value counts only if it was written in the current flow
+typedef struct _ram_values_t {
+
+    short value[INTERNAL_RAM];
+    unsigned int written[INTERNAL_RAM];
+    unsigned int flow;
+
+} ram_values;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for farcall.cpp
+//
+
+static void plan_fixed_view( const ines_ctx *ctx, fixed_view *view );
+static bool fixed_insn( const fixed_view *view, ushort address, uchar *insn, unsigned int *offset );
+static bool fixed_address( const fixed_view *view, unsigned int offset, ushort *address );
+static bool any_candidate( const fixed_view *view, const bankswitch_list *switches );
+static void mark_targets( const ines_ctx *ctx, const fixed_view *view, uchar *targets );
+static bool find_stubs( const ines_ctx *ctx, const fixed_view *view, const uchar *targets, const bankswitch_list *switches, farcall_list *list );
+static bool follow_stub( const ines_ctx *ctx, const fixed_view *view, const bank_switch *switches, long count, farcall_stub *stub );
+static const bank_switch *switch_at( const bank_switch *switches, long count, unsigned int offset );
+static farcall_arg make_arg( uchar kind, ushort where );
+static bool is_argument( const farcall_arg *arg );
+static void push_arg( stub_state *state, farcall_arg arg );
+static farcall_arg pull_arg( stub_state *state );
+static bool indirect_target( const stub_state *state, ushort pointer, farcall_stub *stub );
+
+static bool find_calls( const ines_ctx *ctx, farcall_list *list );
+static bool scan_page( farcall_list *list, ram_values *ram, const uchar *data, long size, unsigned int offset, image_off_t prg_size );
+static void track_ram( ram_values *ram, const m6502_regs *regs, const uchar *insn );
+static short arg_value( const farcall_arg *arg, const m6502_regs *regs, const ram_values *ram, const uchar *data, long size, long pos );
+static bool add_call( farcall_list *list, unsigned int offset, int stub, long bank, long target );
+static const char *arg_name( const farcall_arg *arg, char *buf, size_t size );
+
+
+
+//----------------------------------------------------------------------
+//
+//      finds the trampolines of the fixed windows among the bank
+//      switches of 'switches' and the calls to them in all PRG banks
+//
+bool farcall_scan( const ines_ctx *ctx, const bankswitch_list *switches, farcall_list *list )
+{
+    fixed_view *view;
+    uchar *targets;
+    bool ok;
+
+    memset( list, 0, sizeof(*list) );
+    if( ctx->desc->regs == MAPPER_REGS_NONE || ctx->prg_size == 0 )
+        return true;
+
+    view = (fixed_view *)malloc( sizeof(fixed_view) );
+    targets = (uchar *)calloc( 0x10000, 1 );
+    ok = view != NULL && targets != NULL;
+    if( ok )
+    {
+        plan_fixed_view( ctx, view );
+        if( any_candidate( view, switches ) )
+        {
+            mark_targets( ctx, view, targets );
+            ok = find_stubs( ctx, view, targets, switches, list );
+        }
+    }
+    free( targets );
+    free( view );
+
+    if( ok && list->stub_count > 0 )
+        ok = find_calls( ctx, list );
+    if( !ok )
+        farcall_free( list );
+    return ok;
+}
+
+void farcall_free( farcall_list *list )
+{
+    free( list->calls );
+    memset( list, 0, sizeof(*list) );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      the PRG banks load_rom_banks() maps to the fixed windows: the
+//      top prg_fixed windows, or the bank with the vectors for
+//      mappers switching all of $8000-$FFFF at once
+//
+static void plan_fixed_view( const ines_ctx *ctx, fixed_view *view )
+{
+    long start = 0x10000 - (long)ctx->desc->prg_fixed * ctx->desc->prg_window;
+
+    memset( view, 0, sizeof(*view) );
+    view->ctx = ctx;
+    if( ctx->desc->prg_fixed == 0 || start < ROM_START_ADDRESS )
+        start = 0x10000 - PRG_ROM_BANK_SIZE;
+    view->start = (ushort)start;
+
+    for( int i=0; i<ctx->bank_count; i++ )
+    {
+        const ines_bank *bank = &ctx->banks[i];
+        const uchar *data;
+
+        if( bank->kind == INES_BANK_CHR_8K || bank->address + bank->size <= start )
+            continue;
+        if( (data = ines_bank_data( ctx, bank )) == NULL )
+            continue;
+
+        view->banks[view->count] = *bank;
+        view->data[view->count] = data;
+        view->offsets[view->count] = (unsigned int)(bank->offset - ines_prg_offset( ctx ));
+        view->count++;
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      copies the instruction at a fixed address, false if it isn't
+//      in a fixed window or runs past its end
+//
+static bool fixed_insn( const fixed_view *view, ushort address, uchar *insn, unsigned int *offset )
+{
+    if( address < view->start )
+        return false;
+
+    for( int i=0; i<view->count; i++ )
+    {
+        const ines_bank *bank = &view->banks[i];
+        long pos = address - bank->address;
+
+        if( pos < 0 || pos >= bank->size )
+            continue;
+        if( pos + m6502_op_lengths[view->data[i][pos]] > bank->size )
+            return false;
+
+        memcpy( insn, view->data[i] + pos, m6502_op_lengths[view->data[i][pos]] );
+        *offset = view->offsets[i] + (unsigned int)pos;
+        return true;
+    }
+    return false;
+}
+
+static bool fixed_address( const fixed_view *view, unsigned int offset, ushort *address )
+{
+    for( int i=0; i<view->count; i++ )
+    {
+        const ines_bank *bank = &view->banks[i];
+
+        if( offset >= view->offsets[i] && offset < view->offsets[i] + bank->size
+            && bank->address + (offset - view->offsets[i]) >= view->start )
+        {
+            *address = (ushort)(bank->address + (offset - view->offsets[i]));
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      true if a PRG switch to a bank that isn't constant is made
+//      from a fixed window. otherwise there are no trampolines and
+//      PRG-ROM needn't be read for the JSR/JMP targets
+//
+static bool any_candidate( const fixed_view *view, const bankswitch_list *switches )
+{
+    ushort address;
+
+    for( long i=0; i<switches->count; i++ )
+    {
+        const bank_switch *sw = &switches->switches[i];
+
+        if( sw->kind == BANKSW_PRG && sw->bank == BANKSW_UNKNOWN && fixed_address( view, sw->offset, &address ) )
+            return true;
+    }
+    return false;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      marks the targets of all JSRs and JMPs into the fixed windows
+//
+static void mark_targets( const ines_ctx *ctx, const fixed_view *view, uchar *targets )
+{
+    image_off_t prg_offset = ines_prg_offset( ctx );
+
+    for( int page=0; page<ctx->prg_pages; page++ )
+    {
+        image_off_t start = (image_off_t)page * PRG_PAGE_SIZE;
+        long size = (long)(ctx->prg_size - start < PRG_PAGE_SIZE ? ctx->prg_size - start : PRG_PAGE_SIZE);
+        const uchar *data = image_slice( ctx->image, prg_offset + start, size );
+        long pos, len;
+
+        if( data == NULL )
+            break;
+
+        for( pos=0; pos<size; pos+=len )
+        {
+            len = m6502_op_lengths[data[pos]];
+            if( pos + len > size )
+                break;
+            if( data[pos] != M6502_JSR && data[pos] != M6502_JMP_ABS )
+                continue;
+
+            ushort target = (ushort)(data[pos + 1] | (data[pos + 2] << 8));
+            if( target >= view->start )
+                targets[target] = 1;
+        }
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      a trampoline is entered by a JSR/JMP shortly before a PRG
+//      switch to a bank that isn't constant
+//
+static bool find_stubs( const ines_ctx *ctx, const fixed_view *view, const uchar *targets, const bankswitch_list *switches, farcall_list *list )
+{
+    ushort tried[FARCALL_MAX_STUBS * 4];
+    int tried_count = 0;
+
+    for( long i=0; i<switches->count && list->stub_count<FARCALL_MAX_STUBS; i++ )
+    {
+        const bank_switch *sw = &switches->switches[i];
+        ushort address;
+        long entry;
+        bool seen = false;
+
+        if( sw->kind != BANKSW_PRG || sw->bank != BANKSW_UNKNOWN || !fixed_address( view, sw->offset, &address ) )
+            continue;
+
+        // the nearest entry before the write
+        for( entry=address; entry>=view->start && entry>address - FARCALL_MAX_STUB; entry-- )
+            if( targets[entry] )
+                break;
+        if( entry < view->start || entry <= address - FARCALL_MAX_STUB )
+            continue;
+
+        for( int t=0; t<tried_count; t++ )
+            seen = seen || tried[t] == entry;
+        if( seen || tried_count == (int)(sizeof(tried) / sizeof(tried[0])) )
+            continue;
+        tried[tried_count++] = (ushort)entry;
+
+        farcall_stub *stub = &list->stubs[list->stub_count];
+        memset( stub, 0, sizeof(*stub) );
+        stub->address = (ushort)entry;
+        if( follow_stub( ctx, view, switches->switches, switches->count, stub ) )
+            list->stub_count++;
+    }
+
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      follows the straight-line code of a trampoline with symbolic
+//      registers, RAM and stack, up to the jump to its target
+//
+static bool follow_stub( const ines_ctx *ctx, const fixed_view *view, const bank_switch *switches, long count, farcall_stub *stub )
+{
+    stub_state *state = (stub_state *)malloc( sizeof(stub_state) );
+    ushort pc = stub->address;
+    bool switched = false, done = false;
+
+    if( state == NULL )
+        return false;
+
+    memset( state, 0, sizeof(*state) );
+    state->a = make_arg( FARCALL_ARG_A, 0 );
+    state->x = make_arg( FARCALL_ARG_X, 0 );
+    state->y = make_arg( FARCALL_ARG_Y, 0 );
+    for( int i=0; i<INTERNAL_RAM; i++ )
+        state->ram[i] = make_arg( FARCALL_ARG_RAM, (ushort)i );
+
+    for( int step=0; step<FARCALL_MAX_STEPS && !done; step++ )
+    {
+        uchar insn[3] = { 0, 0, 0 }, op;
+        unsigned int offset;
+        ushort operand;
+        const bank_switch *sw;
+
+        if( !fixed_insn( view, pc, insn, &offset ) )
+            break;
+        if( step == 0 )
+            stub->offset = offset;
+        op = insn[0];
+        operand = (ushort)(insn[1] | (insn[2] << 8));
+        if( m6502_op_lengths[op] == 2 )
+            operand = insn[1];
+
+        // the write completing the switch stores the bank number
+        if( !switched && (sw = switch_at( switches, count, offset )) != NULL )
+        {
+            farcall_arg *value = op == 0x8E || op == 0x86 ? &state->x : op == 0x8C || op == 0x84 ? &state->y : &state->a;
+
+            stub->window = sw->window;
+            stub->size = sw->size;
+            stub->bank = *value;
+            if( value == &state->a && state->shifted && ctx->desc->regs != MAPPER_REGS_SERIAL )
+                stub->bank = make_arg( FARCALL_ARG_UNKNOWN, 0 );
+            switched = true;
+        }
+
+        switch( op )
+        {
+        case 0xA9: state->a = make_arg( FARCALL_ARG_CONST, insn[1] ); state->shifted = false; break;   // LDA #imm
+        case 0xA2: state->x = make_arg( FARCALL_ARG_CONST, insn[1] ); break;                            // LDX #imm
+        case 0xA0: state->y = make_arg( FARCALL_ARG_CONST, insn[1] ); break;                            // LDY #imm
+
+        case 0xA5: case 0xAD:                                                                           // LDA zp/abs
+            state->a = operand < INTERNAL_RAM ? state->ram[operand] : make_arg( FARCALL_ARG_UNKNOWN, 0 );
+            state->shifted = false;
+            break;
+        case 0xA6: case 0xAE:                                                                           // LDX zp/abs
+            state->x = operand < INTERNAL_RAM ? state->ram[operand] : make_arg( FARCALL_ARG_UNKNOWN, 0 );
+            break;
+        case 0xA4: case 0xAC:                                                                           // LDY zp/abs
+            state->y = operand < INTERNAL_RAM ? state->ram[operand] : make_arg( FARCALL_ARG_UNKNOWN, 0 );
+            break;
+
+        case 0xB1:                                                                                      // LDA (zp),Y
+            // through the return address: the bytes behind the JSR
+            state->a = make_arg( FARCALL_ARG_UNKNOWN, 0 );
+            state->shifted = false;
+            if( operand < INTERNAL_RAM - 1 && state->ram[operand].kind == ARG_RETURN_LOW && state->ram[operand + 1].kind == ARG_RETURN_HIGH
+                && state->y.kind == FARCALL_ARG_CONST && state->y.where > 0 )
+            {
+                state->a = make_arg( FARCALL_ARG_INLINE, state->y.where - 1 );
+                if( state->y.where > stub->inline_size )
+                    stub->inline_size = (uchar)state->y.where;
+            }
+            break;
+
+        case 0x85: case 0x8D: if( operand < INTERNAL_RAM ) state->ram[operand] = state->a; break;          // STA zp/abs
+        case 0x86: case 0x8E: if( operand < INTERNAL_RAM ) state->ram[operand] = state->x; break;          // STX zp/abs
+        case 0x84: case 0x8C: if( operand < INTERNAL_RAM ) state->ram[operand] = state->y; break;          // STY zp/abs
+
+        case 0xAA: state->x = state->a; break;                                                          // TAX
+        case 0xA8: state->y = state->a; break;                                                          // TAY
+        case 0x8A: state->a = state->x; state->shifted = false; break;                                  // TXA
+        case 0x98: state->a = state->y; state->shifted = false; break;                                  // TYA
+
+        case 0xE8: case 0xCA:                                                                           // INX, DEX
+            state->x = state->x.kind == FARCALL_ARG_CONST ? make_arg( FARCALL_ARG_CONST, (state->x.where + (op == 0xE8 ? 1 : -1)) & 0xFF )
+                                                          : make_arg( FARCALL_ARG_UNKNOWN, 0 );
+            break;
+        case 0xC8: case 0x88:                                                                           // INY, DEY
+            state->y = state->y.kind == FARCALL_ARG_CONST ? make_arg( FARCALL_ARG_CONST, (state->y.where + (op == 0xC8 ? 1 : -1)) & 0xFF )
+                                                          : make_arg( FARCALL_ARG_UNKNOWN, 0 );
+            break;
+
+        // the serial writes of MMC1 shift the bank number out of A
+        case 0x4A: case 0x0A: state->shifted = true; break;                                             // LSR A, ASL A
+
+        case 0x48: push_arg( state, state->a ); break;                                                  // PHA
+        case 0x68: state->a = pull_arg( state ); state->shifted = false; break;                        // PLA
+
+        case M6502_JMP_ABS:
+            if( operand >= view->start )
+            {
+                pc = operand;
+                continue;
+            }
+            // into the switched window
+            stub->target_low = make_arg( FARCALL_ARG_CONST, operand & 0xFF );
+            stub->target_high = make_arg( FARCALL_ARG_CONST, operand >> 8 );
+            done = true;
+            break;
+
+        case M6502_JMP_IND:
+            done = indirect_target( state, operand, stub );
+            break;
+
+        case M6502_JSR:
+        {
+            uchar callee[3];
+            unsigned int callee_offset;
+
+            // a JSR to a JMP (ind) calls the target and returns
+            if( fixed_insn( view, operand, callee, &callee_offset ) && callee[0] == M6502_JMP_IND )
+            {
+                done = indirect_target( state, (ushort)(callee[1] | (callee[2] << 8)), stub );
+                break;
+            }
+            if( operand < view->start && switched )
+            {
+                stub->target_low = make_arg( FARCALL_ARG_CONST, operand & 0xFF );
+                stub->target_high = make_arg( FARCALL_ARG_CONST, operand >> 8 );
+                done = true;
+                break;
+            }
+            // a helper in the fixed bank, its registers aren't known
+            state->a = state->x = state->y = make_arg( FARCALL_ARG_UNKNOWN, 0 );
+            break;
+        }
+
+        case M6502_RTS:
+            // the target has been pushed, RTS adds one
+            if( state->depth >= 2 )
+            {
+                stub->target_low = state->stack[state->depth - 1];
+                stub->target_high = state->stack[state->depth - 2];
+                stub->target_add = 1;
+            }
+            done = true;
+            break;
+
+        default:
+            if( m6502_ends_flow( op ) )
+                done = true;
+            else if( !m6502_keeps_regs( op ) )
+            {
+                state->a = state->x = state->y = make_arg( FARCALL_ARG_UNKNOWN, 0 );
+                state->shifted = false;
+            }
+            break;
+        }
+        pc = (ushort)(pc + m6502_op_lengths[op]);
+    }
+
+    free( state );
+    return switched && is_argument( &stub->bank ) && is_argument( &stub->target_low ) && is_argument( &stub->target_high );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      the bank switch completed at 'offset', if any
+//
+static const bank_switch *switch_at( const bank_switch *switches, long count, unsigned int offset )
+{
+    long low = 0, high = count;
+
+    // switches are in file order
+    while( low < high )
+    {
+        long mid = low + (high - low) / 2;
+
+        if( switches[mid].offset < offset )
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    for( ; low<count && switches[low].offset == offset; low++ )
+        if( switches[low].kind == BANKSW_PRG )
+            return &switches[low];
+    return NULL;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      symbolic values
+//
+static farcall_arg make_arg( uchar kind, ushort where )
+{
+    farcall_arg arg;
+
+    arg.kind = kind;
+    arg.where = where;
+    return arg;
+}
+
+// something the caller passes or a constant
+static bool is_argument( const farcall_arg *arg )
+{
+    return arg->kind != FARCALL_ARG_UNKNOWN && arg->kind != ARG_RETURN_LOW && arg->kind != ARG_RETURN_HIGH;
+}
+
+static void push_arg( stub_state *state, farcall_arg arg )
+{
+    if( state->depth < STACK_DEPTH )
+        state->stack[state->depth++] = arg;
+}
+
+// pulling more than was pushed yields the return address of the JSR
+static farcall_arg pull_arg( stub_state *state )
+{
+    if( state->depth > 0 )
+        return state->stack[--state->depth];
+
+    switch( state->pulled++ )
+    {
+    case 0: return make_arg( ARG_RETURN_LOW, 0 );
+    case 1: return make_arg( ARG_RETURN_HIGH, 0 );
+    default: return make_arg( FARCALL_ARG_UNKNOWN, 0 );
+    }
+}
+
+static bool indirect_target( const stub_state *state, ushort pointer, farcall_stub *stub )
+{
+    if( pointer < INTERNAL_RAM - 1 )
+    {
+        stub->target_low = state->ram[pointer];
+        stub->target_high = state->ram[pointer + 1];
+    }
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      resolves the arguments of every JSR/JMP to a trampoline
+//
+static bool find_calls( const ines_ctx *ctx, farcall_list *list )
+{
+    image_off_t prg_offset = ines_prg_offset( ctx );
+    ram_values *ram = (ram_values *)calloc( 1, sizeof(ram_values) );
+    bool ok = ram != NULL;
+
+    for( int page=0; page<ctx->prg_pages && ok; page++ )
+    {
+        image_off_t start = (image_off_t)page * PRG_PAGE_SIZE;
+        long size = (long)(ctx->prg_size - start < PRG_PAGE_SIZE ? ctx->prg_size - start : PRG_PAGE_SIZE);
+        const uchar *data = image_slice( ctx->image, prg_offset + start, size );
+
+        // offsets are 32 bit, see ioscan_image()
+        if( data == NULL || start + size > 0xFFFFFFFFLL )
+            break;
+
+        ram->flow++;
+        ok = scan_page( list, ram, data, size, (unsigned int)start, ctx->prg_size );
+    }
+
+    free( ram );
+    return ok;
+}
+
+static bool scan_page( farcall_list *list, ram_values *ram, const uchar *data, long size, unsigned int offset, image_off_t prg_size )
+{
+    m6502_regs regs;
+    long pos, len;
+
+    m6502_forget( &regs );
+    for( pos=0; pos<size; pos+=len )
+    {
+        const uchar *insn = data + pos;
+        int stub = -1;
+
+        len = m6502_op_lengths[*insn];
+        if( pos + len > size )
+            break;
+
+        if( *insn == M6502_JSR || *insn == M6502_JMP_ABS )
+        {
+            ushort target = (ushort)(insn[1] | (insn[2] << 8));
+
+            for( int s=0; s<list->stub_count && stub<0; s++ )
+                if( list->stubs[s].address == target )
+                    stub = s;
+        }
+
+        if( stub >= 0 )
+        {
+            const farcall_stub *st = &list->stubs[stub];
+            short bank = arg_value( &st->bank, &regs, ram, data, size, pos );
+            short low = arg_value( &st->target_low, &regs, ram, data, size, pos );
+            short high = arg_value( &st->target_high, &regs, ram, data, size, pos );
+            long stub_banks = prg_size > st->size ? (long)(prg_size / st->size) : 1;
+
+            if( !add_call( list, offset + (unsigned int)pos, stub,
+                           bank == M6502_UNKNOWN ? FARCALL_UNKNOWN : bank % stub_banks,
+                           low == M6502_UNKNOWN || high == M6502_UNKNOWN ? FARCALL_UNKNOWN : ((low | (high << 8)) + st->target_add) & 0xFFFF ) )
+                return false;
+
+            // the arguments behind the JSR aren't code
+            if( *insn == M6502_JSR )
+                len += st->inline_size;
+        }
+
+        track_ram( ram, &regs, insn );
+        m6502_track( &regs, insn );
+        if( m6502_ends_flow( *insn ) || *insn == M6502_JSR )
+        {
+            m6502_forget( &regs );
+            ram->flow++;
+        }
+    }
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      remembers the registers stored to RAM in the current flow
+//
+static void track_ram( ram_values *ram, const m6502_regs *regs, const uchar *insn )
+{
+    ushort address = m6502_op_lengths[insn[0]] == 2 ? insn[1] : (ushort)(insn[1] | (insn[2] << 8));
+    short value;
+
+    switch( insn[0] )
+    {
+    case 0x85: case 0x8D: value = regs->a; break;          // STA zp/abs
+    case 0x86: case 0x8E: value = regs->x; break;          // STX zp/abs
+    case 0x84: case 0x8C: value = regs->y; break;          // STY zp/abs
+
+    // read-modify-writes of zp/abs
+    case 0x06: case 0x0E: case 0x26: case 0x2E: case 0x46: case 0x4E:
+    case 0x66: case 0x6E: case 0xC6: case 0xCE: case 0xE6: case 0xEE:
+        value = M6502_UNKNOWN;
+        break;
+
+    default:
+        return;
+    }
+
+    if( address < INTERNAL_RAM )
+    {
+        ram->value[address] = value;
+        ram->written[address] = ram->flow;
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      value of an argument at the call at 'pos', M6502_UNKNOWN if
+//      it isn't constant
+//
+static short arg_value( const farcall_arg *arg, const m6502_regs *regs, const ram_values *ram, const uchar *data, long size, long pos )
+{
+    switch( arg->kind )
+    {
+    case FARCALL_ARG_CONST:
+        return (short)arg->where;
+    case FARCALL_ARG_A:
+        return regs->a;
+    case FARCALL_ARG_X:
+        return regs->x;
+    case FARCALL_ARG_Y:
+        return regs->y;
+    case FARCALL_ARG_RAM:
+        return ram->written[arg->where] == ram->flow ? ram->value[arg->where] : M6502_UNKNOWN;
+    case FARCALL_ARG_INLINE:
+        return pos + 3 + arg->where < size ? data[pos + 3 + arg->where] : M6502_UNKNOWN;
+    default:
+        return M6502_UNKNOWN;
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      appends a call to the list
+//
+static bool add_call( farcall_list *list, unsigned int offset, int stub, long bank, long target )
+{
+    if( list->count == list->size )
+    {
+        long size = list->size ? list->size * 2 : CALLS_PER_STUB * list->stub_count;
+        farcall *calls = (farcall *)realloc( list->calls, size * sizeof(farcall) );
+
+        if( calls == NULL )
+            return false;
+        list->calls = calls;
+        list->size = size;
+    }
+
+    farcall *call = &list->calls[list->count++];
+    call->offset = offset;
+    call->stub = stub;
+    call->bank = bank;
+    call->target = target;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      describes a trampoline and a call
+//
+void farcall_describe_stub( const farcall_stub *stub, char *buf, size_t size )
+{
+    char bank[32], low[32], high[32], target[80];
+
+    if( stub->target_low.kind == FARCALL_ARG_INLINE && stub->target_high.kind == FARCALL_ARG_INLINE
+        && stub->target_high.where == stub->target_low.where + 1 )
+        snprintf( target, sizeof(target), "bytes %u-%u behind the JSR", stub->target_low.where, stub->target_high.where );
+    else
+        snprintf( target, sizeof(target), "%s/%s", arg_name( &stub->target_low, low, sizeof(low) ),
+                   arg_name( &stub->target_high, high, sizeof(high) ) );
+
+    snprintf( buf, size, "far call trampoline: %uk PRG bank -> $%04X from %s, target from %s%s",
+               stub->size / 0x400, stub->window, arg_name( &stub->bank, bank, sizeof(bank) ), target,
+               stub->target_add ? ", pushed for RTS" : "" );
+}
+
+void farcall_describe( const farcall_list *list, const farcall *call, char *buf, size_t size )
+{
+    char bank[16], target[16];
+
+    if( call->bank == FARCALL_UNKNOWN )
+        snprintf( bank, sizeof(bank), "?" );
+    else
+        snprintf( bank, sizeof(bank), "%ld", call->bank );
+    if( call->target == FARCALL_UNKNOWN )
+        snprintf( target, sizeof(target), "?" );
+    else
+        snprintf( target, sizeof(target), "$%04lX", call->target );
+
+    snprintf( buf, size, "far call to PRG bank %s:%s via $%04X", bank, target, list->stubs[call->stub].address );
+}
+
+static const char *arg_name( const farcall_arg *arg, char *buf, size_t size )
+{
+    switch( arg->kind )
+    {
+    case FARCALL_ARG_CONST:  snprintf( buf, size, "#$%02X", arg->where ); break;
+    case FARCALL_ARG_A:      snprintf( buf, size, "A" ); break;
+    case FARCALL_ARG_X:      snprintf( buf, size, "X" ); break;
+    case FARCALL_ARG_Y:      snprintf( buf, size, "Y" ); break;
+    case FARCALL_ARG_RAM:    snprintf( buf, size, "$%04X", arg->where ); break;
+    case FARCALL_ARG_INLINE: snprintf( buf, size, "byte %u behind the JSR", arg->where ); break;
+    default:                 snprintf( buf, size, "?" ); break;
+    }
+    return buf;
+}
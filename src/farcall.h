@@ -0,0 +1,133 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    far-call trampolines.
+
+    Games with switched PRG banks call code in other banks through
+    a small routine in the fixed bank: it switches the bank passed
+    by the caller in, then jumps to the target passed by the caller,
+    e.g.
+
+        LDA #5                      JSR far_call
+        LDX #<target                .byte 5
+        LDY #>target                .word target
+        JSR far_call
+
+    farcall_scan() looks for such trampolines in the PRG banks the
+    loader maps to the fixed windows of the mapper (the last 16k for
+    UNROM, $E000 for Rambo-1, ...). A trampoline is a JSR/JMP target
+    there whose code, within FARCALL_MAX_STUB bytes, makes a PRG bank
+    switch with a bank number that isn't constant. The bank switches
+    are taken from the list bankswitch_scan() made (see bankswitch.h),
+    so callers that need both scan PRG-ROM for them only once.
+    Its instructions are then followed symbolically up to an indirect
+    JMP, an RTS to pushed values or a JSR into the switched window, to
+    learn where the bank and the target come from: registers A, X, Y,
+    RAM the caller has written, the bytes behind the JSR (the stub
+    pulls the return address and reads through it) or constants.
+
+    Every JSR/JMP to a trampoline in all PRG banks is then resolved
+    with the constants of the straight-line code leading up to it,
+    tracked like the bank switch values (m6502_track()) plus stores
+    of known values to RAM, or read from the bytes behind the JSR.
+
+*/
+
+
+#ifndef _FARCALL_H
+#define _FARCALL_H
+
+#include "ines.h"
+#include "bankswitch.h"
+
+
+// bytes between the entry of a trampoline and its bank switch,
+// and instructions followed at most
+#define FARCALL_MAX_STUB                    64
+#define FARCALL_MAX_STEPS                   64
+
+// trampolines per image
+#define FARCALL_MAX_STUBS                   16
+
+// bank or target that isn't known
+#define FARCALL_UNKNOWN                     -1
+
+
+// where an argument of a trampoline comes from
+enum
+{
+    FARCALL_ARG_UNKNOWN,
+    FARCALL_ARG_CONST,                      // 'where' is the value
+    FARCALL_ARG_A,
+    FARCALL_ARG_X,
+    FARCALL_ARG_Y,
+    FARCALL_ARG_RAM,                        // 'where' is the address
+    FARCALL_ARG_INLINE                      // 'where' is the offset behind the JSR
+};
+
+typedef struct _farcall_arg_t {
+
+    uchar kind;                             // FARCALL_ARG_...
+    ushort where;
+
+} farcall_arg;
+
+
+typedef struct _farcall_stub_t {
+
+    ushort address;                         // entry, CPU address in a fixed window
+    unsigned int offset;                    // of the entry, from the start of PRG-ROM
+    ushort window;                          // CPU address switched
+    unsigned int size;                      // of the window
+    farcall_arg bank;
+    farcall_arg target_low;
+    farcall_arg target_high;
+    uchar target_add;                       // 1 if the target is pushed for an RTS
+    uchar inline_size;                      // argument bytes behind the JSR
+
+} farcall_stub;
+
+
+// a JSR or JMP to a trampoline
+typedef struct _farcall_t {
+
+    unsigned int offset;                    // of the JSR/JMP, from the start of PRG-ROM
+    int stub;                               // index in farcall_list.stubs
+    long bank;                              // window sized bank or FARCALL_UNKNOWN
+    long target;                            // CPU address or FARCALL_UNKNOWN
+
+} farcall;
+
+
+typedef struct _farcall_list_t {
+
+    int stub_count;
+    farcall_stub stubs[FARCALL_MAX_STUBS];
+
+    long count;
+    long size;
+    farcall *calls;                         // in file order
+
+} farcall_list;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for farcall.cpp
+//
+
+bool farcall_scan( const ines_ctx *ctx, const bankswitch_list *switches, farcall_list *list );
+void farcall_free( farcall_list *list );
+
+// "far call trampoline: bank in A, target in X/Y"
+void farcall_describe_stub( const farcall_stub *stub, char *buf, size_t size );
+
+// "far call to PRG bank 5:$8123 via $C0A0"
+void farcall_describe( const farcall_list *list, const farcall *call, char *buf, size_t size );
+
+#endif // _FARCALL_H
@@ -0,0 +1,200 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    checksums of ROM pages and images.
+    See hash.h.
+
+*/
+
+
+#include <string.h>
+
+#include "hash.h"
+
+
+// slice-by-8 tables for the reflected polynomial 0xEDB88320 (the one
+// used by zip, png and the usual ROM databases). entry[0] is the
+// classic byte table, entry[k] advances a byte by k more positions.
+// the tables are built when the module is loaded, so hash_crc32() can be
+// called from any thread
+static struct crc_table_t
+{
+    crc32_t entry[8][256];
+
+    crc_table_t()
+    {
+        for( crc32_t n=0; n<256; n++ )
+        {
+            crc32_t c = n;
+            for( int k=0; k<8; k++ )
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            entry[0][n] = c;
+        }
+        for( crc32_t n=0; n<256; n++ )
+            for( int k=1; k<8; k++ )
+                entry[k][n] = (entry[k-1][n] >> 8) ^ entry[0][entry[k-1][n] & 0xFF];
+    }
+} crc_table;
+
+
+
+//----------------------------------------------------------------------
+//
+//      CRC32 of a buffer, 8 bytes per step
+//
+crc32_t hash_crc32( crc32_t crc, const void *buf, size_t size )
+{
+    const unsigned char *p = (const unsigned char *)buf;
+    const crc32_t (*t)[256] = crc_table.entry;
+
+    crc = ~crc;
+
+    // align to 4 bytes
+    while( size && ((size_t)p & 3) )
+    {
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        size--;
+    }
+
+    while( size >= 8 )
+    {
+        crc32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((crc32_t)p[3] << 24));
+        crc32_t hi = p[4] | (p[5] << 8) | (p[6] << 16) | ((crc32_t)p[7] << 24);
+
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+
+    while( size-- )
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      SHA-1 (FIPS 180-1)
+//
+
+#define ROL( x, n )                         ( ((x) << (n)) | ((x) >> (32 - (n))) )
+
+static void sha1_block( unsigned int h[5], const unsigned char *p )
+{
+    unsigned int w[80];
+    unsigned int a, b, c, d, e, f, k, tmp;
+    int i;
+
+    for( i=0; i<16; i++ )
+        w[i] = ((unsigned int)p[4*i] << 24) | (p[4*i+1] << 16) | (p[4*i+2] << 8) | p[4*i+3];
+    for( ; i<80; i++ )
+        w[i] = ROL( w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1 );
+
+    a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+    for( i=0; i<80; i++ )
+    {
+        if( i < 20 )
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if( i < 40 )
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if( i < 60 )
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        tmp = ROL( a, 5 ) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL( b, 30 );
+        b = a;
+        a = tmp;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+
+void hash_sha1_init( sha1_ctx *ctx )
+{
+    static const unsigned int h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    memcpy( ctx->h, h, sizeof(h) );
+    ctx->used = 0;
+    ctx->size = 0;
+}
+
+void hash_sha1_update( sha1_ctx *ctx, const void *buf, size_t size )
+{
+    const unsigned char *p = (const unsigned char *)buf;
+
+    ctx->size += size;
+
+    // complete a block started before
+    if( ctx->used > 0 )
+    {
+        size_t n = 64 - ctx->used < size ? 64 - ctx->used : size;
+
+        memcpy( ctx->block + ctx->used, p, n );
+        ctx->used += n;
+        p += n;
+        size -= n;
+        if( ctx->used < 64 )
+            return;
+        sha1_block( ctx->h, ctx->block );
+        ctx->used = 0;
+    }
+
+    for( ; size >= 64; p += 64, size -= 64 )
+        sha1_block( ctx->h, p );
+
+    memcpy( ctx->block, p, size );
+    ctx->used = size;
+}
+
+void hash_sha1_final( sha1_ctx *ctx, unsigned char digest[SHA1_SIZE] )
+{
+    unsigned char last[128];
+    unsigned long long bits = ctx->size * 8;
+    size_t rest = ctx->used, padded;
+    int i;
+
+    // remaining bytes, 0x80, zeros and the length in bits
+    padded = rest < 56 ? 64 : 128;
+    memset( last, 0, sizeof(last) );
+    memcpy( last, ctx->block, rest );
+    last[rest] = 0x80;
+    for( i=0; i<8; i++ )
+        last[padded - 1 - i] = (unsigned char)(bits >> (8 * i));
+
+    sha1_block( ctx->h, last );
+    if( padded == 128 )
+        sha1_block( ctx->h, last + 64 );
+
+    for( i=0; i<SHA1_SIZE; i++ )
+        digest[i] = (unsigned char)(ctx->h[i/4] >> (24 - 8 * (i % 4)));
+}
+
+void hash_sha1( const void *buf, size_t size, unsigned char digest[SHA1_SIZE] )
+{
+    sha1_ctx ctx;
+
+    hash_sha1_init( &ctx );
+    hash_sha1_update( &ctx, buf, size );
+    hash_sha1_final( &ctx, digest );
+}
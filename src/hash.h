@@ -0,0 +1,49 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    checksums of ROM pages and images
+
+*/
+
+
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <stddef.h>
+
+
+typedef unsigned int crc32_t;
+
+#define SHA1_SIZE                           20
+
+
+// SHA-1 of data given in several parts
+typedef struct _sha1_ctx_t {
+
+    unsigned int h[5];
+    unsigned char block[64];                // bytes of an incomplete block
+    size_t used;
+    unsigned long long size;                // bytes hashed so far
+
+} sha1_ctx;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for hash.cpp
+//
+
+// pass the previous result as 'crc' to continue a checksum, 0 to start one
+crc32_t hash_crc32( crc32_t crc, const void *buf, size_t size );
+
+void hash_sha1( const void *buf, size_t size, unsigned char digest[SHA1_SIZE] );
+void hash_sha1_init( sha1_ctx *ctx );
+void hash_sha1_update( sha1_ctx *ctx, const void *buf, size_t size );
+void hash_sha1_final( sha1_ctx *ctx, unsigned char digest[SHA1_SIZE] );
+
+#endif // _HASH_H
@@ -0,0 +1,10 @@
+// stand-in for the SDK's ldr/idaldr.h, see include/pro.h
+#ifndef _IDASTUB_IDALDR_H
+#define _IDASTUB_IDALDR_H
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <loader.hpp>
+#include <kernwin.hpp>
+
+#endif
@@ -0,0 +1,1028 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    In-memory stand-in for the IDA SDK functions used by the
+    loader, see idastub.h and include/pro.h.
+
+    Segments keep their bytes in a buffer that is allocated when
+    bytes are first loaded into them, bytes that were never loaded
+    read as 0xFF. Netnode blobs are stored in one piece per start
+    index instead of MAXSPECSIZE sized supvals.
+
+*/
+
+
+#include <stdarg.h>
+#include <setjmp.h>
+#include <sys/stat.h>
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+
+#include "idastub.h"
+
+
+struct _linput_t {
+
+    FILE *fp;
+    long size;
+    bool remote;                            // qlfile() returns NULL
+    char path[QMAXPATH];
+
+};
+
+
+// a segment and the bytes loaded into it
+typedef struct _stub_segment_t {
+
+    segment_t seg;
+    std::string name;
+    std::string sclass;
+    std::vector<uchar> bytes;               // empty until bytes are loaded
+
+} stub_segment;
+
+
+// a defined item
+typedef struct _stub_item_t {
+
+    flags_t flags;
+    asize_t size;
+
+} stub_item;
+
+
+typedef struct _stub_xref_t {
+
+    ea_t from;
+    ea_t to;
+    dref_t type;
+
+} stub_xref;
+
+
+typedef struct _stub_entry_t {
+
+    uval_t ord;
+    ea_t ea;
+    std::string name;
+
+} stub_entry;
+
+
+// values of a netnode, keyed by tag and index
+typedef struct _stub_node_t {
+
+    std::string name;                       // empty for unnamed nodes
+    bool alive;
+    std::map<unsigned long long, uval_t> alts;
+    std::map<unsigned long long, std::vector<uchar> > sups;
+    std::map<unsigned long long, std::vector<uchar> > blobs;
+
+} stub_node;
+
+
+// a callback hooked to a notification point
+typedef struct _stub_hook_t {
+
+    hook_type_t type;
+    hook_cb_t *cb;
+    void *user_data;
+
+} stub_hook;
+
+
+// RAII marker for the functions of the stand-in
+struct stub_call
+{
+    stub_call()  { idastub_depth++; }
+    ~stub_call() { idastub_depth--; }
+};
+
+
+bool idastub_quiet = false;
+int idastub_answer = -1;
+thread_local int idastub_depth = 0;
+
+idainfo inf;
+processor_t ph;
+insn_t cmd;
+char database_idb[QMAXPATH];
+static char input_path[QMAXPATH];
+
+static std::map<ea_t, stub_segment> segments;   // by start address
+static std::map<ea_t, std::string> names;
+static std::map<std::string, ea_t> name_eas;
+static std::map<ea_t, std::string> comments[2]; // regular, repeatable
+static std::map<ea_t, std::vector<std::string> > lines[2];  // posterior, anterior
+static std::map<ea_t, stub_item> items;
+static std::vector<stub_xref> xrefs;
+static std::vector<stub_entry> entries;
+static std::deque<stub_node> nodes;             // index is the node number
+static std::map<std::string, nodeidx_t> node_names;
+static std::vector<stub_hook> hooks;
+static idastub_stats counters;
+
+static jmp_buf *load_failed;                    // set while idastub_load() runs
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for idastub.cpp
+//
+
+static void trim_segments( ea_t start, ea_t end );
+static stub_segment *find_segment( ea_t ea );
+static uchar *segment_bytes( ea_t ea1, ea_t ea2 );
+static stub_node *get_node( nodeidx_t num );
+static unsigned long long node_key( char tag, nodeidx_t index );
+
+
+
+//----------------------------------------------------------------------
+//
+//      empties the database
+//
+void idastub_reset( void )
+{
+    stub_call call;
+
+    segments.clear();
+    names.clear();
+    name_eas.clear();
+    for( int i=0; i<2; i++ )
+    {
+        comments[i].clear();
+        lines[i].clear();
+    }
+    items.clear();
+    xrefs.clear();
+    entries.clear();
+    nodes.clear();
+    node_names.clear();
+
+    memset( &counters, 0, sizeof(counters) );
+    memset( &inf, 0, sizeof(inf) );
+    inf.minEA = inf.maxEA = inf.startIP = inf.beginEA = BADADDR;
+    ph.id = -1;
+    database_idb[0] = '\0';
+    input_path[0] = '\0';
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      runs a loader like IDA does when a file is opened.
+//      loader_failure() jumps back here
+//
+bool idastub_load( const loader_t *ldr, linput_t *li, const char *idb )
+{
+    char name[MAX_FILE_FORMAT_NAME];
+    jmp_buf failed;
+    int depth = idastub_depth;
+
+    qstrncpy( database_idb, idb, sizeof(database_idb) );
+    qstrncpy( input_path, li->path, sizeof(input_path) );
+
+    if( setjmp( failed ) != 0 )
+    {
+        load_failed = NULL;
+        idastub_depth = depth;
+        return false;
+    }
+    load_failed = &failed;
+
+    name[0] = '\0';
+    qlseek( li, 0 );
+    if( ldr->accept_file( li, name, 0 ) == 0 )
+    {
+        load_failed = NULL;
+        return false;
+    }
+
+    qlseek( li, 0 );
+    ldr->load_file( li, 0, name );
+    load_failed = NULL;
+    return true;
+}
+
+
+
+void idastub_get_stats( idastub_stats *stats )
+{
+    *stats = counters;
+    stats->segments = (long)segments.size();
+    stats->nodes = (long)nodes.size();
+    stats->names = (long)names.size();
+    stats->comments = (long)(comments[0].size() + comments[1].size());
+    for( int i=0; i<2; i++ )
+        for( std::map<ea_t, std::vector<std::string> >::const_iterator it = lines[i].begin(); it != lines[i].end(); ++it )
+            stats->comments += (long)it->second.size();
+    stats->items = (long)items.size();
+    stats->xrefs = (long)xrefs.size();
+    stats->entries = (long)entries.size();
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      memory and strings
+//
+void *qalloc( size_t size )
+{
+    return malloc( size ? size : 1 );
+}
+
+void *qrealloc( void *ptr, size_t size )
+{
+    return realloc( ptr, size ? size : 1 );
+}
+
+void qfree( void *ptr )
+{
+    free( ptr );
+}
+
+char *qstrncpy( char *dst, const char *src, size_t dstsize )
+{
+    size_t len = strlen( src );
+
+    if( dstsize == 0 )
+        return dst;
+    if( len >= dstsize )
+        len = dstsize - 1;
+    memcpy( dst, src, len );
+    dst[len] = '\0';
+    return dst;
+}
+
+int qsnprintf( char *buf, size_t size, const char *format, ... )
+{
+    va_list va;
+    int n;
+
+    va_start( va, format );
+    n = vsnprintf( buf, size, format, va );
+    va_end( va );
+    return n;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      input files
+//
+linput_t *open_linput( const char *file, bool remote )
+{
+    stub_call call;
+    linput_t *li;
+    FILE *fp = fopen( file, "rb" );
+
+    if( fp == NULL )
+        return NULL;
+
+    li = new linput_t;
+    li->fp = fp;
+    li->remote = remote;
+    qstrncpy( li->path, file, sizeof(li->path) );
+    fseek( fp, 0, SEEK_END );
+    li->size = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+    return li;
+}
+
+void close_linput( linput_t *li )
+{
+    stub_call call;
+
+    if( li == NULL )
+        return;
+    fclose( li->fp );
+    delete li;
+}
+
+ssize_t qlread( linput_t *li, void *buf, size_t size )
+{
+    stub_call call;
+    size_t n = fread( buf, 1, size, li->fp );
+
+    counters.bytes_read += n;
+    return (ssize_t)n;
+}
+
+long qlseek( linput_t *li, long pos, int whence )
+{
+    stub_call call;
+
+    if( fseek( li->fp, pos, whence ) != 0 )
+        return -1;
+    return ftell( li->fp );
+}
+
+long qlsize( linput_t *li )
+{
+    return li->size;
+}
+
+FILE *qlfile( linput_t *li )
+{
+    return li->remote ? NULL : li->fp;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      looks for a file in $IDADIR/subdir
+//
+char *getsysfile( char *buf, size_t bufsize, const char *filename, const char *subdir )
+{
+    const char *idadir = getenv( "IDADIR" );
+    struct stat st;
+
+    if( idadir == NULL )
+        return NULL;
+
+    if( subdir != NULL )
+        qsnprintf( buf, bufsize, "%s/%s/%s", idadir, subdir, filename );
+    else
+        qsnprintf( buf, bufsize, "%s/%s", idadir, filename );
+    return stat( buf, &st ) == 0 ? buf : NULL;
+}
+
+
+
+char *get_input_file_path( char *buf, size_t bufsize )
+{
+    qstrncpy( buf, input_path, bufsize );
+    return buf;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      replaces the extension of a file name, 'ext' is given
+//      without the dot
+//
+char *set_file_ext( char *outbuf, size_t bufsize, const char *file, const char *ext )
+{
+    const char *slash = strrchr( file, '/' );
+    const char *dot = strrchr( slash != NULL ? slash : file, '.' );
+    size_t len = dot != NULL ? (size_t)(dot - file) : strlen( file );
+
+    if( len >= bufsize )
+        len = bufsize - 1;
+    memcpy( outbuf, file, len );
+    outbuf[len] = '\0';
+    if( ext != NULL && ext[0] != '\0' )
+        qsnprintf( outbuf + len, bufsize - len, ".%s", ext );
+    return outbuf;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      user interface, output goes to stdout resp. stderr
+//
+int msg( const char *format, ... )
+{
+    va_list va;
+    int n;
+
+    if( idastub_quiet )
+        return 0;
+    va_start( va, format );
+    n = vprintf( format, va );
+    va_end( va );
+    return n;
+}
+
+void warning( const char *format, ... )
+{
+    va_list va;
+
+    if( idastub_quiet )
+        return;
+    va_start( va, format );
+    fprintf( stderr, "warning: " );
+    vfprintf( stderr, format, va );
+    fprintf( stderr, "\n" );
+    va_end( va );
+}
+
+int askyn_c( int deflt, const char *format, ... )
+{
+    int answer = idastub_answer >= 0 ? idastub_answer : deflt;
+    va_list va;
+
+    if( idastub_quiet )
+        return answer;
+    va_start( va, format );
+    fprintf( stderr, "question: " );
+    vfprintf( stderr, format, va );
+    fprintf( stderr, "\nanswer: %s\n", answer == 1 ? "yes" : answer == 0 ? "no" : "cancel" );
+    va_end( va );
+    return answer;
+}
+
+bool asklong( sval_t * /*value*/, const char * /*format*/, ... )
+{
+    return false;
+}
+
+ea_t get_screen_ea( void )
+{
+    return inf.beginEA;
+}
+
+void set_processor_type( const char *procname, int /*level*/ )
+{
+    if( stricmp( procname, "M6502" ) == 0 )
+        ph.id = PLFM_6502;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      notification points. hooks are kept until they are removed,
+//      idastub_reset() doesn't touch them, just like plugins stay
+//      loaded in IDA
+//
+bool hook_to_notification_point( hook_type_t hook_type, hook_cb_t *cb, void *user_data )
+{
+    stub_hook hook = { hook_type, cb, user_data };
+
+    hooks.push_back( hook );
+    return true;
+}
+
+int unhook_from_notification_point( hook_type_t hook_type, hook_cb_t *cb, void *user_data )
+{
+    int count = 0;
+
+    for( size_t i=hooks.size(); i-->0; )
+    {
+        if( hooks[i].type == hook_type && hooks[i].cb == cb && (user_data == NULL || hooks[i].user_data == user_data) )
+        {
+            hooks.erase( hooks.begin() + i );
+            count++;
+        }
+    }
+    return count;
+}
+
+int idastub_notify( hook_type_t hook_type, int notification_code, ... )
+{
+    int code = 0;
+
+    for( size_t i=0; i<hooks.size() && code == 0; i++ )
+    {
+        va_list va;
+
+        if( hooks[i].type != hook_type )
+            continue;
+        va_start( va, notification_code );
+        code = hooks[i].cb( hooks[i].user_data, notification_code, va );
+        va_end( va );
+    }
+    return code;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      segments
+//
+int add_segm( ea_t para, ea_t start, ea_t end, const char *name, const char *sclass )
+{
+    stub_call call;
+
+    if( end <= start )
+        return 0;
+
+    // like IDA, segments in the way are truncated or deleted
+    trim_segments( start, end );
+
+    stub_segment &s = segments[start];
+    s.seg.startEA = start;
+    s.seg.endEA = end;
+    s.seg.sel = para;
+    s.seg.bitness = 0;
+    s.name = name != NULL ? name : "";
+    s.sclass = sclass != NULL ? sclass : "";
+
+    if( inf.minEA == BADADDR || start < inf.minEA )
+        inf.minEA = start;
+    if( inf.maxEA == BADADDR || end > inf.maxEA )
+        inf.maxEA = end;
+    return 1;
+}
+
+segment_t *getseg( ea_t ea )
+{
+    stub_segment *s = find_segment( ea );
+
+    return s != NULL ? &s->seg : NULL;
+}
+
+bool set_segm_addressing( segment_t *s, size_t bitness )
+{
+    if( s == NULL )
+        return false;
+    s->bitness = (uchar)bitness;
+    return true;
+}
+
+//----------------------------------------------------------------------
+//
+//      makes room for a segment from 'start' to 'end'. a segment
+//      that encloses the range is split in two
+//
+static void trim_segments( ea_t start, ea_t end )
+{
+    std::map<ea_t, stub_segment>::iterator it = segments.lower_bound( start );
+
+    if( it != segments.begin() )
+    {
+        std::map<ea_t, stub_segment>::iterator prev = it;
+
+        if( (--prev)->second.seg.endEA > start )
+            it = prev;
+    }
+
+    while( it != segments.end() && it->second.seg.startEA < end )
+    {
+        stub_segment s = it->second;
+        ea_t first = s.seg.startEA;
+
+        it = segments.erase( it );
+
+        // the part in front of the new segment
+        if( first < start )
+        {
+            stub_segment &head = segments[first];
+
+            head = s;
+            head.seg.endEA = start;
+            if( !head.bytes.empty() )
+                head.bytes.resize( start - first );
+        }
+
+        // the part behind it
+        if( s.seg.endEA > end )
+        {
+            stub_segment &tail = segments[end];
+
+            tail = s;
+            tail.seg.startEA = end;
+            if( !tail.bytes.empty() )
+                tail.bytes.erase( tail.bytes.begin(), tail.bytes.begin() + (end - first) );
+            break;
+        }
+    }
+}
+
+static stub_segment *find_segment( ea_t ea )
+{
+    std::map<ea_t, stub_segment>::iterator it = segments.upper_bound( ea );
+
+    if( it == segments.begin() )
+        return NULL;
+    --it;
+    return ea < it->second.seg.endEA ? &it->second : NULL;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      returns the bytes of ea1..ea2, which must lie in one
+//      segment. the segment's buffer is allocated on first use
+//
+static uchar *segment_bytes( ea_t ea1, ea_t ea2 )
+{
+    stub_segment *s = find_segment( ea1 );
+
+    if( s == NULL || ea2 < ea1 || ea2 > s->seg.endEA )
+        return NULL;
+    if( s->bytes.empty() )
+        s->bytes.assign( s->seg.endEA - s->seg.startEA, 0xFF );
+    return &s->bytes[ea1 - s->seg.startEA];
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      bytes, items, names and comments
+//
+int file2base( linput_t *li, long pos, ea_t ea1, ea_t ea2, int /*patchable*/ )
+{
+    stub_call call;
+    uchar *bytes = segment_bytes( ea1, ea2 );
+
+    if( bytes == NULL || qlseek( li, pos ) != pos || qlread( li, bytes, ea2 - ea1 ) != (ssize_t)(ea2 - ea1) )
+        return 0;
+    counters.bytes_loaded += ea2 - ea1;
+    return 1;
+}
+
+int mem2base( const void *memptr, ea_t ea1, ea_t ea2, long /*fpos*/ )
+{
+    stub_call call;
+    uchar *bytes = segment_bytes( ea1, ea2 );
+
+    if( bytes == NULL )
+        return 0;
+    memcpy( bytes, memptr, ea2 - ea1 );
+    counters.bytes_loaded += ea2 - ea1;
+    return 1;
+}
+
+uchar get_byte( ea_t ea )
+{
+    stub_segment *s = find_segment( ea );
+
+    if( s == NULL || s->bytes.empty() )
+        return 0xFF;
+    return s->bytes[ea - s->seg.startEA];
+}
+
+ushort get_word( ea_t ea )
+{
+    return (ushort)(get_byte( ea ) | (get_byte( ea + 1 ) << 8));
+}
+
+bool get_many_bytes( ea_t ea, void *buf, ssize_t size )
+{
+    stub_segment *s = find_segment( ea );
+
+    if( s == NULL || s->bytes.empty() || size < 0 || ea + size > s->seg.endEA )
+        return false;
+    memcpy( buf, &s->bytes[ea - s->seg.startEA], size );
+    return true;
+}
+
+bool do_unknown( ea_t ea, bool /*expand*/ )
+{
+    stub_call call;
+
+    items.erase( ea );
+    return true;
+}
+
+// items overlapping the range are undefined, like in IDA
+void do_unknown_range( ea_t ea, asize_t size, bool /*expand*/ )
+{
+    stub_call call;
+    std::map<ea_t, stub_item>::iterator it = items.lower_bound( ea );
+
+    if( it != items.begin() )
+    {
+        std::map<ea_t, stub_item>::iterator prev = it;
+        if( (--prev)->first + prev->second.size > ea )
+            it = prev;
+    }
+    while( it != items.end() && it->first < ea + size )
+        items.erase( it++ );
+}
+
+bool do_data_ex( ea_t ea, flags_t dataflag, asize_t size, nodeidx_t /*tid*/ )
+{
+    stub_call call;
+
+    if( find_segment( ea ) == NULL )
+        return false;
+    items[ea].flags = dataflag;
+    items[ea].size = size;
+    return true;
+}
+
+int set_offset( ea_t ea, int /*n*/, ea_t /*base*/ )
+{
+    return find_segment( ea ) != NULL;
+}
+
+bool set_name( ea_t ea, const char *name )
+{
+    stub_call call;
+    std::map<std::string, ea_t>::iterator used = name_eas.find( name );
+
+    if( used != name_eas.end() && used->second != ea )
+        return false;
+
+    std::map<ea_t, std::string>::iterator old = names.find( ea );
+    if( old != names.end() )
+        name_eas.erase( old->second );
+    if( name[0] == '\0' )
+    {
+        names.erase( ea );
+        return true;
+    }
+    names[ea] = name;
+    name_eas[name] = ea;
+    return true;
+}
+
+bool set_cmt( ea_t ea, const char *comm, bool rptble )
+{
+    stub_call call;
+
+    if( find_segment( ea ) == NULL )
+        return false;
+    comments[rptble ? 1 : 0][ea] = comm;
+    return true;
+}
+
+void describe( ea_t ea, bool isprev, const char *format, ... )
+{
+    stub_call call;
+    char line[MAXSTR];
+    va_list va;
+
+    va_start( va, format );
+    vsnprintf( line, sizeof(line), format, va );
+    va_end( va );
+    lines[isprev ? 1 : 0][ea].push_back( line );
+}
+
+void create_filename_cmt( void )
+{
+    describe( inf.minEA, true, "; Input file: %s", database_idb );
+}
+
+bool add_entry( uval_t ord, ea_t ea, const char *name, bool /*makecode*/ )
+{
+    stub_call call;
+    stub_entry entry;
+
+    entry.ord = ord;
+    entry.ea = ea;
+    entry.name = name;
+    entries.push_back( entry );
+    set_name( ea, name );
+    return true;
+}
+
+bool add_dref( ea_t from, ea_t to, dref_t type )
+{
+    stub_call call;
+    stub_xref xref;
+
+    if( find_segment( from ) == NULL )
+        return false;
+    xref.from = from;
+    xref.to = to;
+    xref.type = type;
+    xrefs.push_back( xref );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      aborts loading, see idastub_load()
+//
+void vloader_failure( const char *format, ... )
+{
+    va_list va;
+
+    if( format != NULL && !idastub_quiet )
+    {
+        va_start( va, format );
+        fprintf( stderr, "loader failure: " );
+        vfprintf( stderr, format, va );
+        fprintf( stderr, "\n" );
+        va_end( va );
+    }
+    if( load_failed != NULL )
+        longjmp( *load_failed, 1 );
+    exit( 1 );
+}
+
+void loader_failure( const char *format, ... )
+{
+    va_list va;
+
+    if( format != NULL && !idastub_quiet )
+    {
+        va_start( va, format );
+        fprintf( stderr, "loader failure: " );
+        vfprintf( stderr, format, va );
+        fprintf( stderr, "\n" );
+        va_end( va );
+    }
+    if( load_failed != NULL )
+        longjmp( *load_failed, 1 );
+    exit( 1 );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      netnodes
+//
+static stub_node *get_node( nodeidx_t num )
+{
+    if( num == BADNODE || num >= nodes.size() || !nodes[num].alive )
+        return NULL;
+    return &nodes[num];
+}
+
+static unsigned long long node_key( char tag, nodeidx_t index )
+{
+    return ((unsigned long long)(uchar)tag << 32) | index;
+}
+
+netnode::netnode( const char *name, size_t namlen, bool do_create )
+{
+    stub_call call;
+    std::string key( name, namlen != 0 ? namlen : strlen( name ) );
+    std::map<std::string, nodeidx_t>::iterator it = node_names.find( key );
+
+    netnodenumber = BADNODE;
+    if( it != node_names.end() )
+        netnodenumber = it->second;
+    else if( do_create )
+        create( name, namlen );
+}
+
+bool netnode::create( const char *name, size_t namlen )
+{
+    stub_call call;
+    std::string key( name, namlen != 0 ? namlen : strlen( name ) );
+    std::map<std::string, nodeidx_t>::iterator it = node_names.find( key );
+
+    // an existing node is opened, but that counts as failure
+    if( it != node_names.end() )
+    {
+        netnodenumber = it->second;
+        return false;
+    }
+
+    create();
+    nodes[netnodenumber].name = key;
+    node_names[key] = netnodenumber;
+    return true;
+}
+
+bool netnode::create( void )
+{
+    stub_call call;
+
+    netnodenumber = (nodeidx_t)nodes.size();
+    nodes.push_back( stub_node() );
+    nodes.back().alive = true;
+    return true;
+}
+
+void netnode::kill( void )
+{
+    stub_call call;
+    stub_node *node = get_node( netnodenumber );
+
+    if( node == NULL )
+        return;
+    if( !node->name.empty() )
+        node_names.erase( node->name );
+    node->name.clear();
+    node->alts.clear();
+    node->sups.clear();
+    node->blobs.clear();
+    node->alive = false;
+    netnodenumber = BADNODE;
+}
+
+uval_t netnode::altval( sval_t alt, char tag )
+{
+    stub_node *node = get_node( netnodenumber );
+    std::map<unsigned long long, uval_t>::const_iterator it;
+
+    if( node == NULL )
+        return 0;
+    it = node->alts.find( node_key( tag, (nodeidx_t)alt ) );
+    return it != node->alts.end() ? it->second : 0;
+}
+
+bool netnode::altset( sval_t alt, uval_t value, char tag )
+{
+    stub_call call;
+    stub_node *node = get_node( netnodenumber );
+
+    if( node == NULL )
+        return false;
+    node->alts[node_key( tag, (nodeidx_t)alt )] = value;
+    return true;
+}
+
+ssize_t netnode::supval( sval_t alt, void *buf, size_t bufsize, char tag )
+{
+    stub_node *node = get_node( netnodenumber );
+    std::map<unsigned long long, std::vector<uchar> >::const_iterator it;
+
+    if( node == NULL )
+        return -1;
+    it = node->sups.find( node_key( tag, (nodeidx_t)alt ) );
+    if( it == node->sups.end() )
+        return -1;
+    if( buf != NULL )
+        memcpy( buf, it->second.data(), it->second.size() < bufsize ? it->second.size() : bufsize );
+    return (ssize_t)it->second.size();
+}
+
+bool netnode::supset( sval_t alt, const void *value, size_t length, char tag )
+{
+    stub_call call;
+    stub_node *node = get_node( netnodenumber );
+
+    if( node == NULL )
+        return false;
+    if( length == 0 )
+        length = strlen( (const char *)value ) + 1;
+    if( length > MAXSPECSIZE )
+        return false;
+
+    std::vector<uchar> &sup = node->sups[node_key( tag, (nodeidx_t)alt )];
+    sup.assign( (const uchar *)value, (const uchar *)value + length );
+    counters.bytes_stored += length;
+    return true;
+}
+
+size_t netnode::blobsize( nodeidx_t start, char tag )
+{
+    stub_node *node = get_node( netnodenumber );
+    std::map<unsigned long long, std::vector<uchar> >::const_iterator it;
+
+    if( node == NULL )
+        return 0;
+    it = node->blobs.find( node_key( tag, start ) );
+    return it != node->blobs.end() ? it->second.size() : 0;
+}
+
+//
+//      a NULL 'buf' is allocated with qalloc(), otherwise *bufsize
+//      must be large enough for the blob. *bufsize is set to the
+//      size of the blob
+//
+void *netnode::getblob( void *buf, size_t *bufsize, nodeidx_t start, char tag )
+{
+    stub_call call;
+    stub_node *node = get_node( netnodenumber );
+    std::map<unsigned long long, std::vector<uchar> >::const_iterator it;
+
+    if( node == NULL )
+        return NULL;
+    it = node->blobs.find( node_key( tag, start ) );
+    if( it == node->blobs.end() )
+        return NULL;
+
+    if( buf == NULL )
+        buf = qalloc( it->second.size() );
+    else if( *bufsize < it->second.size() )
+        return NULL;
+    if( buf == NULL )
+        return NULL;
+
+    memcpy( buf, it->second.data(), it->second.size() );
+    *bufsize = it->second.size();
+    return buf;
+}
+
+bool netnode::setblob( const void *buf, size_t size, nodeidx_t start, char tag )
+{
+    stub_call call;
+    stub_node *node = get_node( netnodenumber );
+
+    if( node == NULL )
+        return false;
+
+    std::vector<uchar> &blob = node->blobs[node_key( tag, start )];
+    blob.assign( (const uchar *)buf, (const uchar *)buf + size );
+    counters.bytes_stored += size;
+    return true;
+}
+
+int netnode::delblob( nodeidx_t start, char tag )
+{
+    stub_call call;
+    stub_node *node = get_node( netnodenumber );
+
+    if( node == NULL )
+        return 0;
+    return (int)node->blobs.erase( node_key( tag, start ) );
+}
@@ -0,0 +1,77 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    Host side of the in-memory IDA stand-in (idastub.cpp). The
+    loader is compiled against the headers in idastub/include
+    instead of the SDK and linked with idastub.cpp:
+
+        g++ -Isrc/idastub/include ... src/nes.cpp src/idastub/idastub.cpp ...
+
+    (nes.cpp includes "../idaldr.h", which the include path makes
+    resolve to idastub/idaldr.h, like ldr/idaldr.h in the SDK.)
+
+    A host runs the loader with idastub_load() and inspects the
+    database with the SDK functions or idastub_get_stats().
+    idastub_notify() calls the callbacks plugins have hooked to a
+    notification point, like IDA does when the cursor moves.
+
+    The stand-in is meant for one thread, like IDA's database.
+    While one of its functions runs, idastub_depth is above zero
+    on that thread, so hosts counting heap allocations can tell
+    the loader's allocations from the database's.
+
+*/
+
+
+#ifndef _IDASTUB_H
+#define _IDASTUB_H
+
+#include "include/pro.h"
+
+
+// what the loader has put into the database so far
+typedef struct _idastub_stats_t {
+
+    long long bytes_read;                   // by qlread()
+    long long bytes_loaded;                 // into segments by mem2base() and file2base()
+    long long bytes_stored;                 // in netnode blobs and supvals
+    long segments;
+    long nodes;
+    long names;
+    long comments;                          // including anterior lines
+    long items;
+    long xrefs;
+    long entries;
+
+} idastub_stats;
+
+
+extern bool idastub_quiet;                  // msg(), warning() and askyn_c() print nothing
+extern int idastub_answer;                  // askyn_c() answer, -1 for the default
+extern thread_local int idastub_depth;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for idastub.cpp
+//
+
+void idastub_reset( void ); // empties the database
+
+// runs accept_file() and load_file() of a loader on 'li'.
+// 'idb' is the database path seen by the loader (database_idb).
+// returns false if the file isn't accepted or loading failed
+bool idastub_load( const loader_t *ldr, linput_t *li, const char *idb );
+
+void idastub_get_stats( idastub_stats *stats );
+
+// calls the callbacks hooked to a notification point like IDA does,
+// until one returns nonzero. returns that result or 0
+int idastub_notify( hook_type_t hook_type, int notification_code, ... );
+
+#endif // _IDASTUB_H
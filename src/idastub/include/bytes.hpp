@@ -0,0 +1,5 @@
+// stand-in for the SDK's bytes.hpp, everything is declared in pro.h
+#ifndef _IDASTUB_BYTES_HPP
+#define _IDASTUB_BYTES_HPP
+#include "pro.h"
+#endif
@@ -0,0 +1,5 @@
+// stand-in for the SDK's ida.hpp, everything is declared in pro.h
+#ifndef _IDASTUB_IDA_HPP
+#define _IDASTUB_IDA_HPP
+#include "pro.h"
+#endif
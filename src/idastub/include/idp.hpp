@@ -0,0 +1,5 @@
+// stand-in for the SDK's idp.hpp, everything is declared in pro.h
+#ifndef _IDASTUB_IDP_HPP
+#define _IDASTUB_IDP_HPP
+#include "pro.h"
+#endif
@@ -0,0 +1,5 @@
+// stand-in for the SDK's kernwin.hpp, everything is declared in pro.h
+#ifndef _IDASTUB_KERNWIN_HPP
+#define _IDASTUB_KERNWIN_HPP
+#include "pro.h"
+#endif
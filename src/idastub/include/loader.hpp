@@ -0,0 +1,5 @@
+// stand-in for the SDK's loader.hpp, everything is declared in pro.h
+#ifndef _IDASTUB_LOADER_HPP
+#define _IDASTUB_LOADER_HPP
+#include "pro.h"
+#endif
@@ -0,0 +1,5 @@
+// stand-in for the SDK's moves.hpp, everything is declared in pro.h
+#ifndef _IDASTUB_MOVES_HPP
+#define _IDASTUB_MOVES_HPP
+#include "pro.h"
+#endif
@@ -0,0 +1,5 @@
+// stand-in for the SDK's nalt.hpp, everything is declared in pro.h
+#ifndef _IDASTUB_NALT_HPP
+#define _IDASTUB_NALT_HPP
+#include "pro.h"
+#endif
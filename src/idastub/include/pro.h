@@ -0,0 +1,319 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    In-memory stand-in for the parts of the IDA 4.9 SDK the loader
+    and the nesovl plugin use, so that nes.cpp builds and runs on
+    systems without IDA (see idastub.h). All SDK headers of this
+    directory include this file, the declarations follow the SDK
+    but 32 bit types are used for addresses and node values just
+    like the 32 bit IDA the loader is built for.
+
+    The database lives in memory: segments with their bytes,
+    names, comments, items, xrefs, entry points and netnodes with
+    altvals, supvals and blobs. It is emptied by idastub_reset().
+
+*/
+
+
+#ifndef _IDASTUB_PRO_H
+#define _IDASTUB_PRO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+
+//----------------------------------------------------------------------
+//
+//      basic types and limits
+//
+
+typedef unsigned char   uchar;
+typedef unsigned short  ushort;
+typedef uint32_t        uint32;
+
+typedef uint32          ea_t;
+typedef uint32          asize_t;
+typedef uint32          uval_t;
+typedef int32_t         sval_t;
+typedef uint32          nodeidx_t;
+typedef uint32          flags_t;
+typedef uint32          sel_t;
+
+#define BADADDR                             ((ea_t)-1)
+#define BADNODE                             ((nodeidx_t)-1)
+
+#define MAXSTR                              1024
+#define MAXNAMESIZE                         120
+#define MAXSPECSIZE                         1024
+#define QMAXPATH                            260
+#define MAX_FILE_FORMAT_NAME                64
+
+#define IDP_INTERFACE_VERSION               76
+
+#ifndef idaapi
+#define idaapi
+#endif
+
+#define stricmp strcasecmp
+#define qnumber( array )                    ( sizeof(array) / sizeof((array)[0]) )
+
+
+//----------------------------------------------------------------------
+//
+//      memory and strings (pro.h)
+//
+
+void *qalloc( size_t size );
+void *qrealloc( void *ptr, size_t size );
+void qfree( void *ptr );
+char *qstrncpy( char *dst, const char *src, size_t dstsize );
+int qsnprintf( char *buf, size_t size, const char *format, ... );
+
+
+//----------------------------------------------------------------------
+//
+//      input files (diskio.hpp)
+//
+
+typedef struct _linput_t linput_t;
+
+linput_t *open_linput( const char *file, bool remote ); // remote inputs have no FILE *
+void close_linput( linput_t *li );
+ssize_t qlread( linput_t *li, void *buf, size_t size );
+long qlseek( linput_t *li, long pos, int whence = SEEK_SET );
+long qlsize( linput_t *li );
+FILE *qlfile( linput_t *li );
+
+#define LDR_SUBDIR                          "loaders"
+
+char *getsysfile( char *buf, size_t bufsize, const char *filename, const char *subdir );
+char *get_input_file_path( char *buf, size_t bufsize );     // nalt.hpp
+char *set_file_ext( char *outbuf, size_t bufsize, const char *file, const char *ext );
+
+
+//----------------------------------------------------------------------
+//
+//      user interface (kernwin.hpp)
+//
+
+int msg( const char *format, ... );
+void warning( const char *format, ... );
+int askyn_c( int deflt, const char *format, ... );
+bool asklong( sval_t *value, const char *format, ... );
+ea_t get_screen_ea( void );
+
+// HT_VIEW notifications
+enum view_notification_t
+{
+    view_activated,
+    view_deactivated,
+    view_keydown,
+    view_click,
+    view_dblclick,
+    view_curpos                             // the cursor moved
+};
+
+
+//----------------------------------------------------------------------
+//
+//      notification points (loader.hpp)
+//
+
+enum hook_type_t { HT_IDP, HT_UI, HT_DBG, HT_IDB, HT_DEV, HT_VIEW };
+
+typedef int idaapi hook_cb_t( void *user_data, int notification_code, va_list va );
+
+bool hook_to_notification_point( hook_type_t hook_type, hook_cb_t *cb, void *user_data );
+int unhook_from_notification_point( hook_type_t hook_type, hook_cb_t *cb, void *user_data = NULL );
+
+
+//----------------------------------------------------------------------
+//
+//      database (ida.hpp, idp.hpp)
+//
+
+typedef struct _idainfo_t {
+
+    ea_t minEA;
+    ea_t maxEA;
+    ea_t startIP;
+    ea_t beginEA;
+    sel_t start_cs;
+
+} idainfo;
+
+extern idainfo inf;
+extern char database_idb[QMAXPATH];
+
+
+enum { PLFM_6502 = 7 };
+
+#define SETPROC_ALL                         0x0001
+#define SETPROC_FATAL                       0x0080
+
+typedef struct _processor_t {
+
+    int id;                                 // PLFM_...
+
+    // HT_IDP notifications, only the ones used
+    enum idp_notify
+    {
+        custom_ana = 29                     // decode the instruction at cmd.ea
+    };
+
+} processor_t;
+
+extern processor_t ph;
+
+void set_processor_type( const char *procname, int level );
+
+
+// the instruction being decoded (ua.hpp)
+typedef struct _insn_t {
+
+    ea_t ea;
+    ushort size;
+
+} insn_t;
+
+extern insn_t cmd;
+
+
+//----------------------------------------------------------------------
+//
+//      segments (segment.hpp)
+//
+
+#define CLASS_CODE                          "CODE"
+#define CLASS_DATA                          "DATA"
+
+typedef struct _segment_t {
+
+    ea_t startEA;
+    ea_t endEA;
+    sel_t sel;
+    uchar bitness;                          // 0: 16 bit addressing
+
+} segment_t;
+
+int add_segm( ea_t para, ea_t start, ea_t end, const char *name, const char *sclass );
+segment_t *getseg( ea_t ea );
+bool set_segm_addressing( segment_t *s, size_t bitness );
+
+
+//----------------------------------------------------------------------
+//
+//      bytes, items, names and comments (bytes.hpp, name.hpp, ...)
+//
+
+#define FF_BYTE                             0x00000000
+#define FF_WORD                             0x10000000
+
+inline flags_t byteflag( void ) { return FF_BYTE; }
+inline flags_t wordflag( void ) { return FF_WORD; }
+
+uchar get_byte( ea_t ea );
+ushort get_word( ea_t ea );
+bool get_many_bytes( ea_t ea, void *buf, ssize_t size );
+bool do_unknown( ea_t ea, bool expand );
+void do_unknown_range( ea_t ea, asize_t size, bool expand );
+bool do_data_ex( ea_t ea, flags_t dataflag, asize_t size, nodeidx_t tid );
+int set_offset( ea_t ea, int n, ea_t base );
+
+bool set_name( ea_t ea, const char *name );
+bool set_cmt( ea_t ea, const char *comm, bool rptble );
+void describe( ea_t ea, bool isprev, const char *format, ... );
+
+bool add_entry( uval_t ord, ea_t ea, const char *name, bool makecode );
+
+enum dref_t { dr_O = 1, dr_W, dr_R };
+bool add_dref( ea_t from, ea_t to, dref_t type );
+
+
+//----------------------------------------------------------------------
+//
+//      netnodes (netnode.hpp)
+//
+
+class netnode
+{
+    nodeidx_t netnodenumber;
+
+public:
+    netnode( void )                         { netnodenumber = BADNODE; }
+    netnode( nodeidx_t num )                { netnodenumber = num; }
+    netnode( const char *name, size_t namlen = 0, bool do_create = false );
+    operator nodeidx_t() const              { return netnodenumber; }
+
+    bool create( const char *name, size_t namlen = 0 );
+    bool create( void );
+    void kill( void );
+
+    uval_t altval( sval_t alt, char tag = 'A' );
+    bool altset( sval_t alt, uval_t value, char tag = 'A' );
+
+    ssize_t supval( sval_t alt, void *buf, size_t bufsize, char tag = 'S' );
+    bool supset( sval_t alt, const void *value, size_t length = 0, char tag = 'S' );
+
+    size_t blobsize( nodeidx_t start, char tag );
+    void *getblob( void *buf, size_t *bufsize, nodeidx_t start, char tag );
+    bool setblob( const void *buf, size_t size, nodeidx_t start, char tag );
+    int delblob( nodeidx_t start, char tag );
+};
+
+
+//----------------------------------------------------------------------
+//
+//      loaders and plugins (loader.hpp)
+//
+
+#define ACCEPT_FIRST                        0x8000
+#define FILEREG_PATCHABLE                   1
+
+typedef struct _loader_t {
+
+    int version;
+    int flags;
+    int (idaapi *accept_file)( linput_t *li, char fileformatname[MAX_FILE_FORMAT_NAME], int n );
+    void (idaapi *load_file)( linput_t *li, ushort neflag, const char *fileformatname );
+    int (idaapi *save_file)( FILE *fp, const char *fileformatname );
+
+} loader_t;
+
+int file2base( linput_t *li, long pos, ea_t ea1, ea_t ea2, int patchable );
+int mem2base( const void *memptr, ea_t ea1, ea_t ea2, long fpos );
+void create_filename_cmt( void );
+
+// abort loading, never return
+void vloader_failure( const char *format, ... );
+void loader_failure( const char *format = NULL, ... );
+
+
+#define PLUGIN_SKIP                         0
+#define PLUGIN_OK                           1
+#define PLUGIN_KEEP                         2
+
+typedef struct _plugin_t {
+
+    int version;
+    int flags;
+    int (idaapi *init)( void );
+    void (idaapi *term)( void );
+    void (idaapi *run)( int arg );
+    char *comment;
+    char *help;
+    char *wanted_name;
+    char *wanted_hotkey;
+
+} plugin_t;
+
+#endif // _IDASTUB_PRO_H
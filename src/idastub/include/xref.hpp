@@ -0,0 +1,5 @@
+// stand-in for the SDK's xref.hpp, everything is declared in pro.h
+#ifndef _IDASTUB_XREF_HPP
+#define _IDASTUB_XREF_HPP
+#include "pro.h"
+#endif
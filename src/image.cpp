@@ -0,0 +1,126 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    read-only view of a whole ROM image file.
+    See image.h.
+
+*/
+
+
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <io.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "image.h"
+
+
+
+//----------------------------------------------------------------------
+//
+//      maps the whole file into memory
+//      returns false if the file can't be mapped, the caller
+//      should read it into a buffer then
+//
+bool image_map_file( image_t *img, FILE *fp )
+{
+    memset( img, 0, sizeof(*img) );
+
+#ifdef _WIN32
+    HANDLE file = (HANDLE)_get_osfhandle( _fileno( fp ) );
+    LARGE_INTEGER size;
+
+    if( file == INVALID_HANDLE_VALUE || !GetFileSizeEx( file, &size ) || size.QuadPart == 0 )
+        return false;
+
+    HANDLE mapping = CreateFileMapping( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    if( mapping == NULL )
+        return false;
+
+    void *data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    if( data == NULL )
+    {
+        CloseHandle( mapping );
+        return false;
+    }
+
+    img->mapping = mapping;
+    img->size = size.QuadPart;
+#else
+    struct stat st;
+
+    if( fstat( fileno( fp ), &st ) != 0 || !S_ISREG( st.st_mode ) || st.st_size == 0 )
+        return false;
+
+    // too large for the address space of a 32 bit process
+    if( (off_t)(size_t)st.st_size != st.st_size )
+        return false;
+
+    void *data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno( fp ), 0 );
+    if( data == MAP_FAILED )
+        return false;
+
+    img->size = st.st_size;
+#endif
+
+    img->data = (const unsigned char *)data;
+    img->mapped = true;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      uses a buffer holding the whole file as view,
+//      the buffer is still owned by the caller
+//
+void image_from_buffer( image_t *img, const void *buf, image_off_t size )
+{
+    memset( img, 0, sizeof(*img) );
+    img->data = (const unsigned char *)buf;
+    img->size = size;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      unmaps the file, if it was mapped
+//
+void image_release( image_t *img )
+{
+    if( img->mapped )
+    {
+#ifdef _WIN32
+        UnmapViewOfFile( img->data );
+        CloseHandle( (HANDLE)img->mapping );
+#else
+        munmap( (void *)img->data, (size_t)img->size );
+#endif
+    }
+    memset( img, 0, sizeof(*img) );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      returns a pointer to 'size' bytes at 'offset' or NULL,
+//      if the range isn't completely inside the image
+//
+const unsigned char *image_slice( const image_t *img, image_off_t offset, image_off_t size )
+{
+    if( offset < 0 || size < 0 || offset > img->size || size > img->size - offset )
+        return NULL;
+    return img->data + offset;
+}
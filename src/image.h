@@ -0,0 +1,54 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    read-only view of a whole ROM image file.
+
+    The file is mapped into memory if possible, otherwise the
+    caller reads it into a buffer once and attaches it. All
+    consumers get pointers into the view, nothing is copied.
+
+    A view is always contiguous, there is no chunked reader: files
+    that can't be mapped (remote inputs), extracted archive members
+    and put together UNIF images cost one buffer of their size.
+
+*/
+
+
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include <stdio.h>
+
+
+// file offsets and sizes, 64 bit even where long is 32 bit
+typedef long long image_off_t;
+
+
+typedef struct _image_t {
+
+    const unsigned char *data;
+    image_off_t size;
+
+    bool mapped;                            // data must be unmapped by image_release()
+    void *mapping;                          // mapping handle (Windows only)
+
+} image_t;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for image.cpp
+//
+
+bool image_map_file( image_t *img, FILE *fp );
+void image_from_buffer( image_t *img, const void *buf, image_off_t size );
+void image_release( image_t *img );
+
+const unsigned char *image_slice( const image_t *img, image_off_t offset, image_off_t size );
+
+#endif // _IMAGE_H
@@ -0,0 +1,782 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    iNES core: header checks and bank layout of ROM images.
+    See ines.h.
+
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ines.h"
+#include "m6502.h"
+
+
+// instructions decoded at the target of a vector
+#define VECTOR_DECODE_COUNT                 16
+
+// NMI, RESET and IRQ vectors at the end of a bank
+#define VECTORS_SIZE                        6
+
+
+static long long nes20_rom_size( uchar lsb, uchar msb, long unit );
+static long ram_size( uchar shift );
+static void add_segment( ines_ctx *ctx, const char *name, const char *sclass, unsigned long start, unsigned long size );
+static void add_ppu_segment( ines_ctx *ctx, const char *name, ushort address, unsigned long size );
+static void init_bank( const ines_ctx *ctx, ines_bank *bank, uchar kind, unsigned int banknr, ushort address );
+static void add_bank( ines_ctx *ctx, uchar kind, unsigned int banknr, ushort address );
+template<int layout> static void plan_prg_banks( ines_ctx *ctx );
+template<long window> static void init_overlay( const ines_ctx *ctx, int index, ines_bank *bank );
+static void plan_segments( ines_ctx *ctx );
+static void plan_ppu_segments( ines_ctx *ctx );
+static void plan_banks( ines_ctx *ctx );
+static void plan_vector_banks( ines_ctx *ctx );
+static int check_targets( const uchar *data, long size, ushort address, const ushort *vectors );
+static bool plausible_code( const uchar *data, long size, long pos );
+
+
+
+
+//----------------------------------------------------------------------
+//
+//      check for the iNES signature "NES\x1A"
+//
+bool ines_is_ines_image( const void *buf, size_t size )
+{
+    const ines_hdr *hdr = (const ines_hdr *)buf;
+
+    // quit if buffer is smaller than size of iNes header
+    if( size < INES_HDR_SIZE )
+        return false;
+
+    return memcmp("NES", &hdr->id, sizeof(hdr->id)) == 0 && hdr->term == 0x1A;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      initialize a loader context from the image view,
+//      the view must stay valid as long as the context is used
+//
+bool ines_init( ines_ctx *ctx, const image_t *image )
+{
+    memset( ctx, 0, sizeof(*ctx) );
+
+    if( !ines_is_ines_image( image->data, image->size ) )
+        return false;
+
+    memcpy( &ctx->hdr, image->data, INES_HDR_SIZE );
+    ctx->image = image;
+    ctx->file_size = image->size;
+    ines_parse_hdr( ctx );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      check for a NES 2.0 header. the marker alone isn't enough,
+//      garbage in byte 7 may look like it, so the ROM sizes must
+//      fit into the file as well
+//
+bool ines_is_nes20_hdr( const ines_hdr *hdr, image_off_t file_size )
+{
+    long long size = INES_HDR_SIZE + (INES_MASK_TRAINER(hdr->rom_control_byte_0) ? TRAINER_SIZE : 0);
+
+    if( !INES_MASK_NES20( hdr->rom_control_byte_1 ) )
+        return false;
+
+    size += nes20_rom_size( hdr->prg_page_count_16k, NES20_PRG_SIZE_HIGH( hdr ), PRG_PAGE_SIZE );
+    size += nes20_rom_size( hdr->chr_page_count_8k, NES20_CHR_SIZE_HIGH( hdr ), CHR_PAGE_SIZE );
+    return size <= file_size;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      check if ROM image header is corrupt,
+//      NES 2.0 headers use all bytes and are never corrupt
+//
+bool ines_is_corrupt_hdr( const ines_hdr *hdr, image_off_t file_size )
+{
+    char empty[sizeof(hdr->reserved)];
+
+    if( ines_is_nes20_hdr( hdr, file_size ) )
+        return false;
+
+    memset( &empty, 0, sizeof(empty) );
+    return ( memcmp(&empty, &hdr->reserved, sizeof(empty)) != 0 );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      fix iNES header
+//
+void ines_fix_hdr( ines_hdr *hdr )
+{
+    const char *diskdude = "DiskDude";
+
+    if(memcmp(&hdr->rom_control_byte_1, diskdude, strlen(diskdude)) == 0)
+    {
+        memset(&hdr->rom_control_byte_1, 0, 9);
+    }
+    memset( &hdr->reserved, 0, sizeof(hdr->reserved));
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      decodes mapper, ROM and RAM sizes from the header,
+//      has to be called again whenever ctx->hdr is changed
+//
+void ines_parse_hdr( ines_ctx *ctx )
+{
+    const ines_hdr *hdr = &ctx->hdr;
+    long long prg_size, chr_size;
+
+    ctx->nes20 = ines_is_nes20_hdr( hdr, ctx->file_size );
+    ctx->mapper = INES_MASK_MAPPER_VERSION( hdr->rom_control_byte_0, hdr->rom_control_byte_1 );
+
+    if( ctx->nes20 )
+    {
+        ctx->mapper |= NES20_MAPPER_HIGH( hdr ) << 8;
+        ctx->submapper = NES20_SUBMAPPER( hdr );
+
+        prg_size = nes20_rom_size( hdr->prg_page_count_16k, NES20_PRG_SIZE_HIGH( hdr ), PRG_PAGE_SIZE );
+        chr_size = nes20_rom_size( hdr->chr_page_count_8k, NES20_CHR_SIZE_HIGH( hdr ), CHR_PAGE_SIZE );
+
+        ctx->prg_ram_size = ram_size( NES20_PRG_RAM_SHIFT( hdr ) );
+        ctx->prg_nvram_size = ram_size( NES20_PRG_NVRAM_SHIFT( hdr ) );
+        ctx->chr_ram_size = ram_size( NES20_CHR_RAM_SHIFT( hdr ) );
+        ctx->chr_nvram_size = ram_size( NES20_CHR_NVRAM_SHIFT( hdr ) );
+    }
+    else
+    {
+        ctx->submapper = 0;
+
+        prg_size = (long long)hdr->prg_page_count_16k * PRG_PAGE_SIZE;
+        chr_size = (long long)hdr->chr_page_count_8k * CHR_PAGE_SIZE;
+
+        // iNES only knows battery backed RAM, boards without CHR-ROM have 8k CHR-RAM
+        ctx->prg_ram_size = INES_MASK_SRAM( hdr->rom_control_byte_0 ) ? 0 : SRAM_SIZE;
+        ctx->prg_nvram_size = INES_MASK_SRAM( hdr->rom_control_byte_0 ) ? SRAM_SIZE : 0;
+        ctx->chr_ram_size = chr_size == 0 ? CHR_PAGE_SIZE : 0;
+        ctx->chr_nvram_size = 0;
+    }
+
+    // NES 2.0 sizes have been checked against the file size,
+    // iNES sizes are 255 pages at most
+    ctx->prg_size = prg_size;
+    ctx->chr_size = chr_size;
+    ctx->prg_pages = (int)((prg_size + PRG_PAGE_SIZE - 1) / PRG_PAGE_SIZE);
+    ctx->chr_pages = (int)((chr_size + CHR_PAGE_SIZE - 1) / CHR_PAGE_SIZE);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      file offsets of the trainer, the first PRG and the first CHR page.
+//      chunked images have no trainer and one PRG and CHR chunk each,
+//      -1 is returned for missing trainers
+//
+image_off_t ines_trainer_offset( const ines_ctx *ctx )
+{
+    if( ctx->chunked || !INES_MASK_TRAINER( ctx->hdr.rom_control_byte_0 ) )
+        return -1;
+    return INES_HDR_SIZE;
+}
+
+image_off_t ines_prg_offset( const ines_ctx *ctx )
+{
+    if( ctx->chunked )
+        return ctx->chunk_prg_offset;
+    return INES_HDR_SIZE + (INES_MASK_TRAINER(ctx->hdr.rom_control_byte_0) ? TRAINER_SIZE : 0);
+}
+
+image_off_t ines_chr_offset( const ines_ctx *ctx )
+{
+    if( ctx->chunked )
+        return ctx->chunk_chr_offset;
+    return ines_prg_offset( ctx ) + ctx->prg_size;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      trainer, PRG and CHR pages (counted from 0) inside the image view.
+//      NULL is returned for missing trainers and for pages that
+//      are cut off by the end of the file
+//
+const uchar *ines_trainer( const ines_ctx *ctx )
+{
+    image_off_t offset = ines_trainer_offset( ctx );
+
+    if( offset < 0 )
+        return NULL;
+    return image_slice( ctx->image, offset, TRAINER_SIZE );
+}
+
+const uchar *ines_prg_page( const ines_ctx *ctx, int page )
+{
+    if( page < 0 || page >= ctx->prg_pages )
+        return NULL;
+    return image_slice( ctx->image, ines_prg_offset( ctx ) + (image_off_t)page * PRG_PAGE_SIZE, PRG_PAGE_SIZE );
+}
+
+const uchar *ines_chr_page( const ines_ctx *ctx, int page )
+{
+    if( page < 0 || page >= ctx->chr_pages )
+        return NULL;
+    return image_slice( ctx->image, ines_chr_offset( ctx ) + (image_off_t)page * CHR_PAGE_SIZE, CHR_PAGE_SIZE );
+}
+
+const uchar *ines_bank_data( const ines_ctx *ctx, const ines_bank *bank )
+{
+    return image_slice( ctx->image, bank->offset, bank->size );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      computes the segments to create and the banks to load,
+//      depending on the header and the mapper in use
+//
+void ines_plan( ines_ctx *ctx )
+{
+    ines_parse_hdr( ctx );
+    ctx->desc = get_mapper_desc( ctx->mapper );
+    ctx->mapper_supported = ctx->desc->name != NULL;
+    ctx->segment_count = 0;
+    ctx->bank_count = 0;
+
+    // guess the fixed bank of unknown mappers from the vectors
+    memset( &ctx->vectors, 0, sizeof(ctx->vectors) );
+    ctx->vectors.bank = -1;
+    if( !ctx->mapper_supported )
+        ines_scan_vectors( ctx, &ctx->vectors );
+
+    plan_segments( ctx );
+    plan_banks( ctx );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      plans every PRG bank as overlay at the CPU address it is
+//      used at. the bank size is the mapper's PRG window, 32k
+//      windows are planned as two 16k halves. only the number
+//      of overlays is stored, see ines_get_overlay()
+//
+void ines_plan_overlays( ines_ctx *ctx )
+{
+    long long count = ctx->prg_pages;
+
+    if( ctx->desc->prg_window == PRG_ROM_8K_BANK_SIZE )
+        count *= PRG_ROM_BANK_SIZE / PRG_ROM_8K_BANK_SIZE;
+
+    ctx->overlay_count = (int)(count > INES_MAX_OVERLAYS ? INES_MAX_OVERLAYS : count);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      computes overlay 'index' (counted from 0). banks that are
+//      fixed by the mapper get their fixed address, all others are
+//      placed at the start of the ROM area
+//
+bool ines_get_overlay( const ines_ctx *ctx, int index, ines_bank *bank )
+{
+    if( index < 0 || index >= ctx->overlay_count )
+        return false;
+
+    switch( ctx->desc->prg_window )
+    {
+    case PRG_ROM_8K_BANK_SIZE:
+        init_overlay<PRG_ROM_8K_BANK_SIZE>( ctx, index, bank );
+        break;
+
+    case 2 * PRG_ROM_BANK_SIZE:
+        init_overlay<2 * PRG_ROM_BANK_SIZE>( ctx, index, bank );
+        break;
+
+    default:
+        init_overlay<PRG_ROM_BANK_SIZE>( ctx, index, bank );
+        break;
+    }
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      returns name of mapper
+//
+const char *ines_get_mapper_name( ushort mapper )
+{
+    const mapper_desc *desc = get_mapper_desc( mapper );
+
+    return desc->name != NULL ? desc->name : MAPPER_NOT_SUPPORTED;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      ROM size in NES 2.0 notation: 12 bit number of units, or
+//      2^E * (2*M + 1) bytes with E and M taken from the LSB if
+//      the high nibble is 0xF
+//
+static long long nes20_rom_size( uchar lsb, uchar msb, long unit )
+{
+    int exponent = lsb >> 2;
+
+    if( msb != 0x0F )
+        return (long long)((msb << 8) | lsb) * unit;
+
+    // anything beyond 2^40 can't be a real image
+    if( exponent > 40 )
+        return 1LL << 48;
+    return (1LL << exponent) * ((lsb & 3) * 2 + 1);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      RAM size in NES 2.0 notation, 64 << shift bytes
+//
+static long ram_size( uchar shift )
+{
+    return shift == 0 ? 0 : 64L << shift;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      appends a segment to the plan
+//
+static void add_segment( ines_ctx *ctx, const char *name, const char *sclass, unsigned long start, unsigned long size )
+{
+    ines_segment *seg = &ctx->segments[ctx->segment_count++];
+
+    seg->name = name;
+    seg->sclass = sclass;
+    seg->base = 0;
+    seg->start = start;
+    seg->end = start + size;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      appends a segment of the PPU address space to the plan
+//
+static void add_ppu_segment( ines_ctx *ctx, const char *name, ushort address, unsigned long size )
+{
+    add_segment( ctx, name, NULL, PPU_EA( address ), size );
+    ctx->segments[ctx->segment_count - 1].base = PPU_BASE;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      fills in size and file offset of a bank
+//
+static void init_bank( const ines_ctx *ctx, ines_bank *bank, uchar kind, unsigned int banknr, ushort address )
+{
+    bank->kind = kind;
+    bank->banknr = banknr;
+    bank->address = address;
+
+    switch( kind )
+    {
+    case INES_BANK_PRG_16K:
+        bank->size = PRG_ROM_BANK_SIZE;
+        bank->offset = ines_prg_offset( ctx ) + (banknr - 1) * bank->size;
+        break;
+
+    case INES_BANK_PRG_8K:
+        bank->size = PRG_ROM_8K_BANK_SIZE;
+        bank->offset = ines_prg_offset( ctx ) + (banknr - 1) * bank->size;
+        break;
+
+    case INES_BANK_CHR_8K:
+        bank->size = CHR_ROM_BANK_SIZE;
+        bank->offset = ines_chr_offset( ctx ) + (banknr - 1) * bank->size;
+        break;
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      appends a bank to the plan, banks that aren't present are skipped
+//
+static void add_bank( ines_ctx *ctx, uchar kind, unsigned int banknr, ushort address )
+{
+    if( banknr == 0 )
+        return;
+    if( kind == INES_BANK_CHR_8K ? ctx->chr_pages == 0 : ctx->prg_pages == 0 )
+        return;
+
+    init_bank( ctx, &ctx->banks[ctx->bank_count++], kind, banknr, address );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      RAM, I/O registers, SRAM, expansion ROM, trainer and PRG ROM
+//
+static void plan_segments( ines_ctx *ctx )
+{
+    add_segment( ctx, "RAM", NULL, RAM_START_ADDRESS, RAM_SIZE );
+
+    // NES uses memory mapped I/O
+    add_segment( ctx, "IO_REGS", NULL, IOREGS_START_ADDRESS, IOREGS_SIZE );
+
+    // SRAM is always created for iNES images, games use it even if
+    // the header doesn't say so. NES 2.0 headers give the exact
+    // size, larger RAM is banked through the 8k window
+    long sram_size = SRAM_SIZE;
+    if( ctx->nes20 )
+    {
+        sram_size = ctx->prg_ram_size + ctx->prg_nvram_size;
+        if( sram_size > SRAM_SIZE )
+            sram_size = SRAM_SIZE;
+    }
+    if( sram_size != 0 )
+        add_segment( ctx, "SRAM", NULL, SRAM_START_ADDRESS, sram_size );
+
+    add_segment( ctx, "EXP_ROM", NULL, EXPROM_START_ADDRESS, EXPROM_SIZE );
+
+    // if both SRAM and a trainer are present, the trainer
+    // is mapped to a part of the SRAM segment
+    bool sram = ctx->nes20 ? SRAM_START_ADDRESS + sram_size >= TRAINER_START_ADDRESS + TRAINER_SIZE :
+                             INES_MASK_SRAM(ctx->hdr.rom_control_byte_0) != 0;
+    if( INES_MASK_TRAINER(ctx->hdr.rom_control_byte_0) && !sram )
+        add_segment( ctx, "TRAINER", "CODE", TRAINER_START_ADDRESS, TRAINER_SIZE );
+
+    add_segment( ctx, "ROM", "CODE", ROM_START_ADDRESS, ROM_SIZE );
+
+    plan_ppu_segments( ctx );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      pattern tables, name tables and palettes of the PPU. the
+//      pattern tables show CHR-ROM banks (or CHR-RAM), the mirrors
+//      at 3000-3EFF and 3F20-3FFF are left out
+//
+static void plan_ppu_segments( ines_ctx *ctx )
+{
+    add_ppu_segment( ctx, "PPU_PT0", PATTERN_TABLE_0_ADDRESS, PATTERN_TABLE_SIZE );
+    add_ppu_segment( ctx, "PPU_PT1", PATTERN_TABLE_1_ADDRESS, PATTERN_TABLE_SIZE );
+    add_ppu_segment( ctx, "PPU_NT", NAME_TABLE_0_ADDRESS, MIRRORS_0_ADDRESS - NAME_TABLE_0_ADDRESS );
+    add_ppu_segment( ctx, "PPU_PAL", IMAGE_PALETTE_ADDRESS, MIRRORS_1_ADDRESS - IMAGE_PALETTE_ADDRESS );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      PRG banks loaded into the ROM segment, one function per
+//      layout of the mapper table
+//
+template<int layout> static void plan_prg_banks( ines_ctx *ctx )
+{
+    unsigned int last = (unsigned int)ctx->prg_pages;
+
+    if constexpr( layout == MAPPER_LAYOUT_FIRST_LAST )
+    {
+        add_bank( ctx, INES_BANK_PRG_16K, 1, PRG_ROM_BANK_LOW_ADDRESS );
+        add_bank( ctx, INES_BANK_PRG_16K, last, PRG_ROM_BANK_HIGH_ADDRESS );
+    }
+    else if constexpr( layout == MAPPER_LAYOUT_LAST_LAST )
+    {
+        add_bank( ctx, INES_BANK_PRG_16K, last, PRG_ROM_BANK_LOW_ADDRESS );
+        add_bank( ctx, INES_BANK_PRG_16K, last, PRG_ROM_BANK_HIGH_ADDRESS );
+    }
+    else if constexpr( layout == MAPPER_LAYOUT_FIRST_SECOND )
+    {
+        add_bank( ctx, INES_BANK_PRG_16K, 1, PRG_ROM_BANK_LOW_ADDRESS );
+        add_bank( ctx, INES_BANK_PRG_16K, 2, PRG_ROM_BANK_HIGH_ADDRESS );
+    }
+    else if constexpr( layout == MAPPER_LAYOUT_8K_FIRST_LAST_THREE )
+    {
+        add_bank( ctx, INES_BANK_PRG_8K, 1, PRG_ROM_BANK_LOW_ADDRESS );
+        add_bank( ctx, INES_BANK_PRG_8K, last*2 - 2, PRG_ROM_BANK_A000 );
+        add_bank( ctx, INES_BANK_PRG_16K, last, PRG_ROM_BANK_HIGH_ADDRESS );
+    }
+    else if constexpr( layout == MAPPER_LAYOUT_8K_LAST )
+    {
+        add_bank( ctx, INES_BANK_PRG_8K, last*2, PRG_ROM_BANK_8000 );
+        add_bank( ctx, INES_BANK_PRG_8K, last*2, PRG_ROM_BANK_A000 );
+        add_bank( ctx, INES_BANK_PRG_8K, last*2, PRG_ROM_BANK_C000 );
+        add_bank( ctx, INES_BANK_PRG_8K, last*2, PRG_ROM_BANK_E000 );
+    }
+}
+
+
+static void (* const prg_bank_planners[MAPPER_LAYOUT_COUNT])( ines_ctx *ctx ) =
+{
+    plan_prg_banks<MAPPER_LAYOUT_FIRST_LAST>,
+    plan_prg_banks<MAPPER_LAYOUT_LAST_LAST>,
+    plan_prg_banks<MAPPER_LAYOUT_FIRST_SECOND>,
+    plan_prg_banks<MAPPER_LAYOUT_8K_FIRST_LAST_THREE>,
+    plan_prg_banks<MAPPER_LAYOUT_8K_LAST>
+};
+
+
+
+//----------------------------------------------------------------------
+//
+//      selects the ROM banks to be loaded depending on the mapper,
+//      unknown mappers get the 1st PRG bank and the bank with the
+//      vectors, or the last one if no bank has plausible vectors
+//
+static void plan_banks( ines_ctx *ctx )
+{
+    if( !ctx->mapper_supported && ctx->vectors.bank >= 0 )
+        plan_vector_banks( ctx );
+    else
+        prg_bank_planners[ctx->desc->layout]( ctx );
+    add_bank( ctx, INES_BANK_CHR_8K, 1, CHR_ROM_BANK_ADDRESS );
+}
+
+static void plan_vector_banks( ines_ctx *ctx )
+{
+    unsigned int bank = (unsigned int)ctx->vectors.bank + 1;
+
+    add_bank( ctx, INES_BANK_PRG_16K, 1, PRG_ROM_BANK_LOW_ADDRESS );
+    if( ctx->vectors.window == PRG_ROM_BANK_SIZE )
+        add_bank( ctx, INES_BANK_PRG_16K, bank / 2, PRG_ROM_BANK_HIGH_ADDRESS );
+    else
+    {
+        // the 8k bank in front of it fills $C000-$DFFF
+        add_bank( ctx, INES_BANK_PRG_8K, bank > 1 ? bank - 1 : bank, PRG_ROM_BANK_C000 );
+        add_bank( ctx, INES_BANK_PRG_8K, bank, PRG_ROM_BANK_E000 );
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      looks for the bank a mapper fixes at the top of the CPU
+//      space: every 8k bank, and every 16k bank, is checked for
+//      vectors pointing into the bank itself, at code made of
+//      documented opcodes. The bank with the most plausible vectors
+//      wins, the last one on a tie, where most mappers start up.
+//      All vectors are gathered first and range checked in one
+//      branch-free pass, only the few banks passing it are decoded
+//
+bool ines_scan_vectors( const ines_ctx *ctx, ines_vector_scan *scan )
+{
+    long count = (long)(ctx->prg_size / PRG_ROM_8K_BANK_SIZE);
+    image_off_t prg_offset = ines_prg_offset( ctx );
+    ushort *nmi, *reset, *irq;
+    uchar *in_range;
+
+    memset( scan, 0, sizeof(*scan) );
+    scan->bank = -1;
+    if( count == 0 )
+        return true;
+
+    nmi = (ushort *)malloc( count * INES_VECTOR_COUNT * sizeof(ushort) );
+    in_range = (uchar *)malloc( count );
+    if( nmi == NULL || in_range == NULL )
+    {
+        free( nmi );
+        free( in_range );
+        return false;
+    }
+    reset = nmi + count;
+    irq = reset + count;
+
+    for( long i=0; i<count; i++ )
+    {
+        const uchar *v = image_slice( ctx->image, prg_offset + (image_off_t)(i + 1) * PRG_ROM_8K_BANK_SIZE - VECTORS_SIZE, VECTORS_SIZE );
+
+        nmi[i] = v != NULL ? (ushort)(v[0] | (v[1] << 8)) : 0;
+        reset[i] = v != NULL ? (ushort)(v[2] | (v[3] << 8)) : 0;
+        irq[i] = v != NULL ? (ushort)(v[4] | (v[5] << 8)) : 0;
+    }
+
+    // bit INES_VECTOR_... if a vector points into the last 8k,
+    // that bit + INES_VECTOR_COUNT if it points into the last 16k
+    for( long i=0; i<count; i++ )
+        in_range[i] = (uchar)((nmi[i] >= 0xE000) << INES_VECTOR_NMI | (reset[i] >= 0xE000) << INES_VECTOR_RESET |
+                              (irq[i] >= 0xE000) << INES_VECTOR_IRQ | (nmi[i] >= 0xC000) << (INES_VECTOR_NMI + INES_VECTOR_COUNT) |
+                              (reset[i] >= 0xC000) << (INES_VECTOR_RESET + INES_VECTOR_COUNT) |
+                              (irq[i] >= 0xC000) << (INES_VECTOR_IRQ + INES_VECTOR_COUNT));
+
+    for( long i=0; i<count; i++ )
+    {
+        // vectors of a 16k bank are at the end of its upper half
+        bool wide = (i & 1) && (in_range[i] & (1 << (INES_VECTOR_RESET + INES_VECTOR_COUNT)));
+        long size = wide ? PRG_ROM_BANK_SIZE : PRG_ROM_8K_BANK_SIZE;
+        ushort vectors[INES_VECTOR_COUNT] = { nmi[i], reset[i], irq[i] };
+        const uchar *data;
+        int mask, plausible = 0;
+
+        if( !wide && !(in_range[i] & (1 << INES_VECTOR_RESET)) )
+            continue;
+        data = image_slice( ctx->image, prg_offset + (image_off_t)(i + 1) * PRG_ROM_8K_BANK_SIZE - size, size );
+        if( data == NULL )
+            continue;
+
+        mask = check_targets( data, size, (ushort)(0x10000 - size), vectors );
+        if( !(mask & (1 << INES_VECTOR_RESET)) )
+            continue;
+        for( int v=0; v<INES_VECTOR_COUNT; v++ )
+            plausible += (mask >> v) & 1;
+
+        scan->candidates++;
+        if( plausible >= scan->plausible )
+        {
+            scan->bank = i;
+            scan->window = size;
+            scan->plausible = plausible;
+        }
+    }
+
+    free( nmi );
+    free( in_range );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      checks the vectors of the planned banks: bit INES_VECTOR_...
+//      is set if a vector points to plausible code in a planned PRG
+//      bank or the trainer. 'vectors' receives the vectors, it may
+//      be NULL
+//
+int ines_check_vectors( const ines_ctx *ctx, ushort *vectors )
+{
+    ushort v[INES_VECTOR_COUNT] = { 0, 0, 0 };
+    bool found = false;
+    int mask = 0;
+
+    for( int i=0; i<ctx->bank_count && !found; i++ )
+    {
+        const ines_bank *bank = &ctx->banks[i];
+        const uchar *data;
+
+        if( bank->kind == INES_BANK_CHR_8K || NMI_VECTOR_START_ADDRESS < bank->address
+            || NMI_VECTOR_START_ADDRESS + VECTORS_SIZE > bank->address + bank->size )
+            continue;
+        if( (data = ines_bank_data( ctx, bank )) == NULL )
+            break;
+
+        data += NMI_VECTOR_START_ADDRESS - bank->address;
+        for( int n=0; n<INES_VECTOR_COUNT; n++ )
+            v[n] = (ushort)(data[2 * n] | (data[2 * n + 1] << 8));
+        found = true;
+    }
+
+    if( vectors != NULL )
+        memcpy( vectors, v, sizeof(v) );
+    if( !found )
+        return 0;
+
+    for( int i=0; i<ctx->bank_count; i++ )
+    {
+        const ines_bank *bank = &ctx->banks[i];
+        const uchar *data;
+
+        if( bank->kind != INES_BANK_CHR_8K && (data = ines_bank_data( ctx, bank )) != NULL )
+            mask |= check_targets( data, (long)bank->size, bank->address, v );
+    }
+    if( ines_trainer( ctx ) != NULL )
+        mask |= check_targets( ines_trainer( ctx ), TRAINER_SIZE, TRAINER_START_ADDRESS, v );
+    return mask;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      bit INES_VECTOR_... for the vectors pointing to plausible
+//      code in 'size' bytes at CPU address 'address'
+//
+static int check_targets( const uchar *data, long size, ushort address, const ushort *vectors )
+{
+    int mask = 0;
+
+    for( int v=0; v<INES_VECTOR_COUNT; v++ )
+        if( vectors[v] >= address && vectors[v] < address + size && plausible_code( data, size, vectors[v] - address ) )
+            mask |= 1 << v;
+    return mask;
+}
+
+// documented opcodes up to the end of the flow or for a while,
+// a routine doesn't start with BRK
+static bool plausible_code( const uchar *data, long size, long pos )
+{
+    if( data[pos] == M6502_BRK )
+        return false;
+
+    for( int i=0; i<VECTOR_DECODE_COUNT; i++ )
+    {
+        uchar op = data[pos];
+
+        if( !m6502_documented[op] || pos + m6502_op_lengths[op] > size )
+            return false;
+        if( m6502_ends_flow( op ) )
+            return true;
+        pos += m6502_op_lengths[op];
+        if( pos >= size )
+            return false;
+    }
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      overlay for a PRG window size. 32k windows are split into
+//      two 16k halves, the mapper's fixed windows go to the top
+//      of the address space
+//
+template<long window> static void init_overlay( const ines_ctx *ctx, int index, ines_bank *bank )
+{
+    constexpr long size = window > PRG_ROM_BANK_SIZE ? PRG_ROM_BANK_SIZE : window;
+    constexpr uchar kind = size == PRG_ROM_8K_BANK_SIZE ? INES_BANK_PRG_8K : INES_BANK_PRG_16K;
+    constexpr int parts = window / size;
+
+    // not ctx->overlay_count, that may be capped
+    long long count = (long long)ctx->prg_pages * (PRG_ROM_BANK_SIZE / size);
+    int fixed = ctx->desc->prg_fixed * parts;
+    long address = index >= count - fixed ? 0x10000 - (long)(count - index) * size : ROM_START_ADDRESS + (index % parts) * size;
+
+    init_bank( ctx, bank, kind, index + 1, (ushort)address );
+}
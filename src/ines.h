@@ -0,0 +1,183 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    iNES core: header checks and bank layout of ROM images.
+
+    This part of the loader does not depend on IDA. Everything
+    it knows about an image is kept in an ines_ctx, so any number
+    of images can be handled at the same time, one context each.
+
+    The context refers to a read-only view of the whole file
+    (see image.h), trainer and ROM pages are returned as pointers
+    into that view.
+
+*/
+
+
+#ifndef _INES_H
+#define _INES_H
+
+#include <stddef.h>
+
+// usually provided by IDA's pro.h
+typedef unsigned char   uchar;
+typedef unsigned short  ushort;
+
+#include "nes.h"
+#include "image.h"
+#include "mappers.h"
+
+
+
+// maximum number of segments and banks in a plan
+#define INES_MAX_SEGMENTS                   12
+#define INES_MAX_BANKS                      8
+
+// maximum number of PRG overlays, each one takes a 64k block
+// of the 32 bit address space (see INES_OVERLAY_EA)
+#define INES_MAX_OVERLAYS                   0xFFFD
+
+
+// kinds of banks in a bank plan
+enum
+{
+    INES_BANK_PRG_16K,
+    INES_BANK_PRG_8K,
+    INES_BANK_CHR_8K
+};
+
+
+// segment to be created in the database
+typedef struct _ines_segment_t {
+
+    const char *name;
+    const char *sclass;                     // segment class, NULL for data
+    unsigned long base;                     // in paragraphs, PPU_BASE for PPU segments
+    unsigned long start;                    // linear addresses, see PPU_EA()
+    unsigned long end;
+
+} ines_segment;
+
+
+// ROM bank to be mapped into the database
+typedef struct _ines_bank_t {
+
+    uchar kind;                             // INES_BANK_...
+    unsigned int banknr;                    // 1-based page number
+    ushort address;                         // cpu address of the bank
+    image_off_t offset;                     // file offset of the bank
+    image_off_t size;
+
+} ines_bank;
+
+
+// board names of chunked images, NUL included
+#define INES_BOARD_SIZE                     64
+
+
+// NMI, RESET and IRQ vectors, bit numbers of ines_check_vectors()
+enum
+{
+    INES_VECTOR_NMI,
+    INES_VECTOR_RESET,
+    INES_VECTOR_IRQ,
+
+    INES_VECTOR_COUNT
+};
+
+
+// the PRG bank holding the most plausible vectors, for mappers
+// that aren't known, see ines_scan_vectors()
+typedef struct _ines_vector_scan_t {
+
+    long bank;                              // 0-based 8k bank, -1 if none was found
+    long window;                            // 8k or 16k, fixed at the top of the CPU space
+    int plausible;                          // vectors pointing to code in the window
+    long candidates;                        // banks with a plausible RESET vector
+
+} ines_vector_scan;
+
+
+// loader context, one per image
+typedef struct _ines_ctx_t {
+
+    ines_hdr hdr;
+    const image_t *image;
+    image_off_t file_size;
+
+    // chunked images (UNIF, see unif.h) keep PRG and CHR-ROM in
+    // chunks instead of behind the header, 'hdr' is made up from
+    // the chunks
+    bool chunked;
+    image_off_t chunk_prg_offset;
+    image_off_t chunk_chr_offset;
+    char board[INES_BOARD_SIZE];            // board name, "" for iNES images
+
+    // decoded header, see ines_parse_hdr()
+    bool nes20;                             // NES 2.0 header
+    ushort mapper;                          // 12 bits with NES 2.0
+    uchar submapper;
+    image_off_t prg_size;                   // PRG-ROM bytes
+    image_off_t chr_size;                   // CHR-ROM bytes
+    int prg_pages;                          // 16k PRG-ROM pages, the last may be partial
+    int chr_pages;                          // 8k CHR-ROM pages
+    long prg_ram_size;                      // volatile PRG-RAM bytes
+    long prg_nvram_size;                    // battery backed PRG-RAM bytes
+    long chr_ram_size;
+    long chr_nvram_size;
+
+    const mapper_desc *desc;                // never NULL after ines_plan()
+    bool mapper_supported;
+    ines_vector_scan vectors;               // unknown mappers only, see ines_plan()
+
+    int segment_count;
+    ines_segment segments[INES_MAX_SEGMENTS];
+
+    int bank_count;
+    ines_bank banks[INES_MAX_BANKS];
+
+    // every PRG bank at its own CPU address, see ines_plan_overlays().
+    // overlays are computed by ines_get_overlay(), there can be
+    // thousands of them for large multicarts
+    int overlay_count;
+
+} ines_ctx;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for ines.cpp
+//
+
+bool ines_is_ines_image( const void *buf, size_t size );
+bool ines_init( ines_ctx *ctx, const image_t *image );
+
+bool ines_is_nes20_hdr( const ines_hdr *hdr, image_off_t file_size );
+bool ines_is_corrupt_hdr( const ines_hdr *hdr, image_off_t file_size );
+void ines_fix_hdr( ines_hdr *hdr );
+void ines_parse_hdr( ines_ctx *ctx ); // after changing ctx->hdr
+
+image_off_t ines_trainer_offset( const ines_ctx *ctx ); // -1 if there is none
+image_off_t ines_prg_offset( const ines_ctx *ctx );
+image_off_t ines_chr_offset( const ines_ctx *ctx );
+
+const uchar *ines_trainer( const ines_ctx *ctx );
+const uchar *ines_prg_page( const ines_ctx *ctx, int page );
+const uchar *ines_chr_page( const ines_ctx *ctx, int page );
+const uchar *ines_bank_data( const ines_ctx *ctx, const ines_bank *bank );
+
+void ines_plan( ines_ctx *ctx ); // fills mapper, segments and banks
+void ines_plan_overlays( ines_ctx *ctx ); // counts overlays, call ines_plan() first
+bool ines_get_overlay( const ines_ctx *ctx, int index, ines_bank *bank );
+
+bool ines_scan_vectors( const ines_ctx *ctx, ines_vector_scan *scan );
+int ines_check_vectors( const ines_ctx *ctx, ushort *vectors ); // bit INES_VECTOR_... for plausible vectors
+
+const char *ines_get_mapper_name( ushort mapper );
+
+#endif // _INES_H
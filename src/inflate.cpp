@@ -0,0 +1,457 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    deflate decoder.
+    See inflate.h.
+
+*/
+
+
+#include <string.h>
+
+#include "inflate.h"
+
+
+typedef unsigned char uchar;
+
+
+// results of the block decoders
+#define BLOCK_OK                            0
+#define BLOCK_ERROR                         -1
+#define BLOCK_FULL                          1   // 'size' bytes written, more would follow
+
+#define LENGTH_CODES                        29
+#define DISTANCE_CODES                      30
+#define CODE_LENGTH_CODES                   19
+#define END_OF_BLOCK                        256
+
+
+static const unsigned short length_base[LENGTH_CODES] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uchar length_extra[LENGTH_CODES] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short distance_base[DISTANCE_CODES] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uchar distance_extra[DISTANCE_CODES] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// order of the code length code lengths in a dynamic block header
+static const uchar code_length_order[CODE_LENGTH_CODES] =
+{
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+
+typedef struct _inflate_state_t {
+
+    const uchar *in;
+    const uchar *in_end;
+    unsigned long long bits;                // LSB first
+    int count;                              // bits in 'bits'
+    size_t zeros;                           // bytes fed past the end of the input
+
+    uchar *out;
+    size_t pos;
+    size_t size;
+    bool partial;
+
+    inflate_huffman litlen;
+    inflate_huffman distance;
+
+} inflate_state;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for inflate.cpp
+//
+
+static unsigned int reverse_bits( unsigned int code, int length );
+static bool build_huffman( inflate_huffman *h, const uchar *lengths, int count );
+static void refill( inflate_state *s );
+static unsigned int get_bits( inflate_state *s, int n );
+static int decode( inflate_state *s, const inflate_huffman *h );
+static int decode_slow( inflate_state *s, const inflate_huffman *h );
+static int stored_block( inflate_state *s );
+static int fixed_tables( inflate_state *s );
+static int dynamic_tables( inflate_state *s );
+static int codes_block( inflate_state *s );
+
+
+
+//----------------------------------------------------------------------
+//
+//      decompresses the blocks of a stream up to the last one
+//
+bool inflate_stream( const unsigned char *src, size_t packed, unsigned char *dst, size_t size, bool partial, size_t *written )
+{
+    inflate_state s;
+    int result = BLOCK_OK;
+    unsigned int last;
+
+    s.in = src;
+    s.in_end = src + packed;
+    s.bits = 0;
+    s.count = 0;
+    s.zeros = 0;
+    s.out = dst;
+    s.pos = 0;
+    s.size = size;
+    s.partial = partial;
+
+    do
+    {
+        last = get_bits( &s, 1 );
+        switch( get_bits( &s, 2 ) )
+        {
+        case 0:
+            result = stored_block( &s );
+            break;
+        case 1:
+            result = fixed_tables( &s );
+            if( result == BLOCK_OK )
+                result = codes_block( &s );
+            break;
+        case 2:
+            result = dynamic_tables( &s );
+            if( result == BLOCK_OK )
+                result = codes_block( &s );
+            break;
+        default:
+            result = BLOCK_ERROR;
+            break;
+        }
+    } while( result == BLOCK_OK && !last );
+
+    *written = s.pos;
+
+    // bits taken from past the end of the input: truncated
+    if( s.zeros * 8 > (size_t)s.count )
+        return false;
+    return result != BLOCK_ERROR;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      builds the tables of a canonical Huffman code from its code
+//      lengths. incomplete codes are fine (a single distance code),
+//      oversubscribed ones are not
+//
+static bool build_huffman( inflate_huffman *h, const uchar *lengths, int count )
+{
+    int counts[16], next[16];
+    unsigned int code = 0;
+    int k = 0;
+
+    memset( counts, 0, sizeof(counts) );
+    memset( h->fast, 0, sizeof(h->fast) );
+    for( int i=0; i<count; i++ )
+        counts[lengths[i]]++;
+    counts[0] = 0;
+
+    for( int n=1; n<16; n++ )
+    {
+        next[n] = code;
+        h->first_code[n] = (unsigned short)code;
+        h->first_symbol[n] = (unsigned short)k;
+        code += counts[n];
+        if( counts[n] != 0 && code - 1 >= (1u << n) )
+            return false;
+        h->max_code[n] = code << (16 - n);
+        code <<= 1;
+        k += counts[n];
+    }
+    h->max_code[16] = 0x10000;
+
+    for( int i=0; i<count; i++ )
+    {
+        int n = lengths[i];
+        int c;
+
+        if( n == 0 )
+            continue;
+
+        c = next[n] - h->first_code[n] + h->first_symbol[n];
+        h->length[c] = (uchar)n;
+        h->symbol[c] = (unsigned short)i;
+
+        // every index whose low bits are the (reversed) code
+        if( n <= INFLATE_FAST_BITS )
+            for( unsigned int j=reverse_bits( next[n], n ); j<(1u << INFLATE_FAST_BITS); j+=1u << n )
+                h->fast[j] = (unsigned short)((n << 9) | i);
+        next[n]++;
+    }
+    return true;
+}
+
+static unsigned int reverse_bits( unsigned int code, int length )
+{
+    code = ((code & 0xAAAA) >> 1) | ((code & 0x5555) << 1);
+    code = ((code & 0xCCCC) >> 2) | ((code & 0x3333) << 2);
+    code = ((code & 0xF0F0) >> 4) | ((code & 0x0F0F) << 4);
+    code = ((code & 0xFF00) >> 8) | ((code & 0x00FF) << 8);
+    return code >> (16 - length);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      bit input. past the end of the input zeros are fed, the
+//      caller checks s->zeros once the stream is done
+//
+static void refill( inflate_state *s )
+{
+    while( s->count <= 56 )
+    {
+        if( s->in < s->in_end )
+            s->bits |= (unsigned long long)*s->in++ << s->count;
+        else
+            s->zeros++;
+        s->count += 8;
+    }
+}
+
+// up to 16 bits
+static unsigned int get_bits( inflate_state *s, int n )
+{
+    unsigned int value;
+
+    if( s->count < n )
+        refill( s );
+    value = (unsigned int)(s->bits & ((1u << n) - 1));
+    s->bits >>= n;
+    s->count -= n;
+    return value;
+}
+
+static int decode( inflate_state *s, const inflate_huffman *h )
+{
+    unsigned int entry;
+
+    if( s->count < 16 )
+        refill( s );
+
+    entry = h->fast[s->bits & ((1 << INFLATE_FAST_BITS) - 1)];
+    if( entry == 0 )
+        return decode_slow( s, h );
+
+    s->bits >>= entry >> 9;
+    s->count -= entry >> 9;
+    return entry & 511;
+}
+
+// codes longer than INFLATE_FAST_BITS, or none at all
+static int decode_slow( inflate_state *s, const inflate_huffman *h )
+{
+    unsigned int k = reverse_bits( (unsigned int)(s->bits & 0xFFFF), 16 );
+    int n, c;
+
+    for( n=INFLATE_FAST_BITS+1; k>=h->max_code[n]; n++ )
+        ;
+    if( n >= 16 )
+        return -1;
+
+    c = (k >> (16 - n)) - h->first_code[n] + h->first_symbol[n];
+    if( c >= INFLATE_MAX_SYMBOLS || h->length[c] != n )
+        return -1;
+
+    s->bits >>= n;
+    s->count -= n;
+    return h->symbol[c];
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      block types
+//
+static int stored_block( inflate_state *s )
+{
+    unsigned int length, nlength;
+    size_t available;
+
+    get_bits( s, s->count & 7 );
+    length = get_bits( s, 16 );
+    nlength = get_bits( s, 16 );
+    if( (length ^ 0xFFFF) != nlength )
+        return BLOCK_ERROR;
+
+    // the bytes already in the bit buffer, then straight from the input
+    while( length > 0 && s->count >= 8 )
+    {
+        if( s->pos == s->size )
+            return s->partial ? BLOCK_FULL : BLOCK_ERROR;
+        s->out[s->pos++] = (uchar)s->bits;
+        s->bits >>= 8;
+        s->count -= 8;
+        length--;
+    }
+
+    if( length > (size_t)(s->in_end - s->in) )
+        return BLOCK_ERROR;
+    available = s->size - s->pos;
+    if( length > available )
+    {
+        if( !s->partial )
+            return BLOCK_ERROR;
+        memcpy( s->out + s->pos, s->in, available );
+        s->pos += available;
+        return BLOCK_FULL;
+    }
+
+    memcpy( s->out + s->pos, s->in, length );
+    s->in += length;
+    s->pos += length;
+    return BLOCK_OK;
+}
+
+static int fixed_tables( inflate_state *s )
+{
+    uchar lengths[INFLATE_MAX_SYMBOLS];
+
+    memset( lengths, 8, 144 );
+    memset( lengths + 144, 9, 256 - 144 );
+    memset( lengths + 256, 7, 280 - 256 );
+    memset( lengths + 280, 8, INFLATE_MAX_SYMBOLS - 280 );
+    build_huffman( &s->litlen, lengths, INFLATE_MAX_SYMBOLS );
+
+    memset( lengths, 5, DISTANCE_CODES );
+    build_huffman( &s->distance, lengths, DISTANCE_CODES );
+    return BLOCK_OK;
+}
+
+static int dynamic_tables( inflate_state *s )
+{
+    uchar lengths[INFLATE_MAX_SYMBOLS + DISTANCE_CODES];
+    uchar code_lengths[CODE_LENGTH_CODES];
+    int litlen_count, distance_count, code_count, n;
+
+    litlen_count = get_bits( s, 5 ) + 257;
+    distance_count = get_bits( s, 5 ) + 1;
+    code_count = get_bits( s, 4 ) + 4;
+    if( litlen_count > END_OF_BLOCK + 1 + LENGTH_CODES || distance_count > DISTANCE_CODES )
+        return BLOCK_ERROR;
+
+    // the code length code goes to 'litlen' until the lengths are read
+    memset( code_lengths, 0, sizeof(code_lengths) );
+    for( int i=0; i<code_count; i++ )
+        code_lengths[code_length_order[i]] = (uchar)get_bits( s, 3 );
+    if( !build_huffman( &s->litlen, code_lengths, CODE_LENGTH_CODES ) )
+        return BLOCK_ERROR;
+
+    for( n=0; n<litlen_count + distance_count; )
+    {
+        int symbol = decode( s, &s->litlen );
+        int repeat, value = 0;
+
+        if( symbol < 0 )
+            return BLOCK_ERROR;
+        if( symbol < 16 )
+        {
+            lengths[n++] = (uchar)symbol;
+            continue;
+        }
+
+        if( symbol == 16 )
+        {
+            if( n == 0 )
+                return BLOCK_ERROR;
+            value = lengths[n - 1];
+            repeat = 3 + get_bits( s, 2 );
+        }
+        else if( symbol == 17 )
+            repeat = 3 + get_bits( s, 3 );
+        else
+            repeat = 11 + get_bits( s, 7 );
+
+        if( n + repeat > litlen_count + distance_count )
+            return BLOCK_ERROR;
+        memset( lengths + n, value, repeat );
+        n += repeat;
+    }
+
+    if( lengths[END_OF_BLOCK] == 0
+        || !build_huffman( &s->litlen, lengths, litlen_count )
+        || !build_huffman( &s->distance, lengths + litlen_count, distance_count ) )
+        return BLOCK_ERROR;
+    return BLOCK_OK;
+}
+
+// literals and matches up to the end of the block
+static int codes_block( inflate_state *s )
+{
+    for( ;; )
+    {
+        int symbol = decode( s, &s->litlen );
+        unsigned int length, distance;
+
+        if( symbol < END_OF_BLOCK )
+        {
+            if( symbol < 0 )
+                return BLOCK_ERROR;
+            if( s->pos == s->size )
+                return s->partial ? BLOCK_FULL : BLOCK_ERROR;
+            s->out[s->pos++] = (uchar)symbol;
+            continue;
+        }
+        if( symbol == END_OF_BLOCK )
+            return BLOCK_OK;
+
+        symbol -= END_OF_BLOCK + 1;
+        if( symbol >= LENGTH_CODES )
+            return BLOCK_ERROR;
+        length = length_base[symbol] + get_bits( s, length_extra[symbol] );
+
+        symbol = decode( s, &s->distance );
+        if( symbol < 0 || symbol >= DISTANCE_CODES )
+            return BLOCK_ERROR;
+        distance = distance_base[symbol] + get_bits( s, distance_extra[symbol] );
+        if( distance > s->pos )
+            return BLOCK_ERROR;
+
+        bool full = length > s->size - s->pos;
+        if( full )
+        {
+            if( !s->partial )
+                return BLOCK_ERROR;
+            length = (unsigned int)(s->size - s->pos);
+        }
+
+        // overlapping matches repeat the last 'distance' bytes
+        uchar *out = s->out + s->pos;
+        const uchar *from = out - distance;
+        if( distance >= length )
+            memcpy( out, from, length );
+        else
+            for( unsigned int i=0; i<length; i++ )
+                out[i] = from[i];
+        s->pos += length;
+
+        if( full )
+            return BLOCK_FULL;
+    }
+}
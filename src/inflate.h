@@ -0,0 +1,56 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    deflate decoder (RFC 1951) for zip and gzip archives.
+
+    The whole output is in memory, so it is its own window: matches
+    are copied from the output buffer, there is no 32k ring buffer
+    and no intermediate buffer between the compressed input and the
+    image. Huffman codes up to INFLATE_FAST_BITS bits long are
+    decoded with one table lookup, longer ones canonically.
+
+*/
+
+
+#ifndef _INFLATE_H
+#define _INFLATE_H
+
+#include <stddef.h>
+
+
+// code bits decoded with a single lookup
+#define INFLATE_FAST_BITS                   10
+
+// literal/length and distance symbols
+#define INFLATE_MAX_SYMBOLS                 288
+
+
+typedef struct _inflate_huffman_t {
+
+    unsigned short fast[1 << INFLATE_FAST_BITS]; // (length << 9) | symbol, 0 if longer
+    unsigned short first_code[16];
+    unsigned short first_symbol[16];
+    unsigned int max_code[17];              // left aligned to 16 bits
+    unsigned char length[INFLATE_MAX_SYMBOLS]; // by canonical order
+    unsigned short symbol[INFLATE_MAX_SYMBOLS];
+
+} inflate_huffman;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for inflate.cpp
+//
+
+// decompresses a raw deflate stream to 'dst' and stops at the end of
+// the stream or after 'size' bytes. '*written' is the number of bytes
+// written. returns false if the stream is damaged, truncated or if
+// it is longer than 'size' bytes and 'partial' isn't set
+bool inflate_stream( const unsigned char *src, size_t packed, unsigned char *dst, size_t size, bool partial, size_t *written );
+
+#endif // _INFLATE_H
@@ -274,4 +274,63 @@
                                              "   D0: Expansion Port Method\n"
 
 
+// all of the above, see name_ioregs() and ioscan.cpp
+typedef struct _ioreg_desc_t {
+
+    unsigned short address;
+    unsigned char size;                     // IOREG_8 or IOREG_16
+    const char *name;                       // short description
+    const char *comment;
+
+} ioreg_desc;
+
+#define IOREG_DESC( reg )                   { reg##_ADDRESS, reg##_SIZE, reg##_SHORT_DESCRIPTION, reg##_COMMENT }
+
+inline constexpr ioreg_desc ioreg_descs[] =
+{
+    IOREG_DESC( PPU_CR_1 ),
+    IOREG_DESC( PPU_CR_2 ),
+    IOREG_DESC( PPU_SR ),
+    IOREG_DESC( SPR_RAM_AR ),
+    IOREG_DESC( SPR_RAM_IOR ),
+    IOREG_DESC( VRAM_AR_1 ),
+    IOREG_DESC( VRAM_AR_2 ),
+    IOREG_DESC( VRAM_IOR ),
+
+    IOREG_DESC( PAPU_PULSE_1_CR ),
+    IOREG_DESC( PAPU_PULSE_1_RCR ),
+    IOREG_DESC( PAPU_PULSE_1_FTR ),
+    IOREG_DESC( PAPU_PULSE_1_CTR ),
+
+    IOREG_DESC( PAPU_PULSE_2_CR ),
+    IOREG_DESC( PAPU_PULSE_2_RCR ),
+    IOREG_DESC( PAPU_PULSE_2_FTR ),
+    IOREG_DESC( PAPU_PULSE_2_CTR ),
+
+    IOREG_DESC( PAPU_TRIANGLE_CR_1 ),
+    IOREG_DESC( PAPU_TRIANGLE_CR_2 ),
+    IOREG_DESC( PAPU_TRIANGLE_FR_1 ),
+    IOREG_DESC( PAPU_TRIANGLE_FR_2 ),
+
+    IOREG_DESC( PAPU_NOISE_CR_1 ),
+    IOREG_DESC( PAPU_NOISE_CR_2 ),
+    IOREG_DESC( PAPU_NOISE_FR_1 ),
+    IOREG_DESC( PAPU_NOISE_FR_2 ),
+
+    IOREG_DESC( PAPU_DM_CR ),
+    IOREG_DESC( PAPU_DM_DAR ),
+    IOREG_DESC( PAPU_DM_AR ),
+    IOREG_DESC( PAPU_DM_DLR ),
+
+    IOREG_DESC( PAPU_SV_CSR ),
+
+    IOREG_DESC( SPRITE_DMAR ),
+
+    IOREG_DESC( JOYPAD_1 ),
+    IOREG_DESC( JOYPAD_2 )
+};
+
+#define IOREG_DESC_COUNT                    (sizeof(ioreg_descs) / sizeof(ioreg_descs[0]))
+
+
 #endif // _IOREGS_H
\ No newline at end of file
@@ -0,0 +1,485 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    I/O register access index.
+    See ioscan.h.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "ioscan.h"
+#include "ioregs.h"
+#include "m6502.h"
+
+
+// bit fields taken from a register comment
+#define MAX_REG_FIELDS                      8
+#define MAX_FIELD_NAME                      48
+
+// initial room for accesses, grows as needed
+#define ACCESSES_PER_PAGE                   64
+
+
+// what an instruction with an absolute operand does to a register,
+// only documented opcodes are listed
+typedef struct _op_info_t {
+
+    uchar opcode;
+    uchar kind;
+
+} op_info;
+
+static constexpr op_info op_infos[] =
+{
+    { 0x0D, IOSCAN_READ },      // ORA abs
+    { 0x0E, IOSCAN_MODIFY },    // ASL abs
+    { 0x2C, IOSCAN_READ },      // BIT abs
+    { 0x2D, IOSCAN_READ },      // AND abs
+    { 0x2E, IOSCAN_MODIFY },    // ROL abs
+    { 0x4D, IOSCAN_READ },      // EOR abs
+    { 0x4E, IOSCAN_MODIFY },    // LSR abs
+    { 0x6D, IOSCAN_READ },      // ADC abs
+    { 0x6E, IOSCAN_MODIFY },    // ROR abs
+    { 0x8C, IOSCAN_WRITE },     // STY abs
+    { 0x8D, IOSCAN_WRITE },     // STA abs
+    { 0x8E, IOSCAN_WRITE },     // STX abs
+    { 0xAC, IOSCAN_READ },      // LDY abs
+    { 0xAD, IOSCAN_READ },      // LDA abs
+    { 0xAE, IOSCAN_READ },      // LDX abs
+    { 0xCC, IOSCAN_READ },      // CPY abs
+    { 0xCD, IOSCAN_READ },      // CMP abs
+    { 0xCE, IOSCAN_MODIFY },    // DEC abs
+    { 0xEC, IOSCAN_READ },      // CPX abs
+    { 0xED, IOSCAN_READ },      // SBC abs
+    { 0xEE, IOSCAN_MODIFY }     // INC abs
+};
+
+typedef struct _op_table_t {
+
+    uchar kind[256];
+
+} op_table;
+
+constexpr op_table build_op_table( void )
+{
+    op_table table = {};
+
+    for( const op_info &info : op_infos )
+        table.kind[info.opcode] = info.kind;
+    return table;
+}
+
+// IOSCAN_... by opcode, 0 for all opcodes not in op_infos[]
+static constexpr op_table op_kinds = build_op_table();
+
+
+// a bit field of a register, D<shift+width-1>-D<shift>
+typedef struct _reg_field_t {
+
+    uchar shift;
+    uchar width;
+    char name[MAX_FIELD_NAME];
+
+} reg_field;
+
+typedef struct _reg_fields_t {
+
+    int count;
+    reg_field fields[MAX_REG_FIELDS];
+
+} reg_fields;
+
+
+// accesses found so far, in file order
+typedef struct _access_list_t {
+
+    long count;
+    long size;
+    ioscan_access *accesses;
+
+} access_list;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for ioscan.cpp
+//
+
+static bool add_access( access_list *list, unsigned int offset, ushort address, uchar opcode, uchar kind, short value );
+static bool scan_page( access_list *list, const uchar *data, long size, unsigned int offset );
+static bool sort_accesses( const access_list *list, ioscan_index *index );
+
+static const ioreg_desc *find_ioreg_desc( ushort address );
+static const reg_fields *get_reg_fields( ushort address );
+static void parse_reg_fields( const char *comment, reg_fields *fields );
+static bool is_write_section( const char *start, const char *end );
+static bool contains( const char *start, const char *end, const char *text );
+static bool parse_field_line( const char *line, const char *end, reg_field *field );
+
+
+
+//----------------------------------------------------------------------
+//
+//      register numbers
+//
+int ioscan_reg_index( unsigned address )
+{
+    if( address >= IOREGS_START_ADDRESS && address < IOSCAN_APU_REGS_ADDRESS )
+        return (int)(address & (IOSCAN_PPU_REGS - 1));
+    if( address >= IOSCAN_APU_REGS_ADDRESS && address < EXPROM_START_ADDRESS )
+        return (int)(IOSCAN_PPU_REGS + address - IOSCAN_APU_REGS_ADDRESS);
+    return -1;
+}
+
+ushort ioscan_reg_address( int reg )
+{
+    if( reg < IOSCAN_PPU_REGS )
+        return (ushort)(IOREGS_START_ADDRESS + reg);
+    return (ushort)(IOSCAN_APU_REGS_ADDRESS + reg - IOSCAN_PPU_REGS);
+}
+
+const char *ioscan_reg_name( ushort address )
+{
+    const ioreg_desc *desc = find_ioreg_desc( address );
+
+    return desc != NULL ? desc->name : NULL;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      builds the access index of all PRG pages
+//
+bool ioscan_image( const ines_ctx *ctx, ioscan_index *index )
+{
+    access_list list;
+    image_off_t prg_offset = ines_prg_offset( ctx );
+    bool ok = true;
+
+    memset( index, 0, sizeof(*index) );
+    memset( &list, 0, sizeof(list) );
+
+    for( int page=0; page<ctx->prg_pages && ok; page++ )
+    {
+        image_off_t start = (image_off_t)page * PRG_PAGE_SIZE;
+        long size = (long)(ctx->prg_size - start < PRG_PAGE_SIZE ? ctx->prg_size - start : PRG_PAGE_SIZE);
+        const uchar *data = image_slice( ctx->image, prg_offset + start, size );
+
+        // offsets are 32 bit, which is plenty for PRG-ROM
+        if( data == NULL || start + size > 0xFFFFFFFFLL )
+            break;
+
+        ok = scan_page( &list, data, size, (unsigned int)start );
+        index->pages++;
+    }
+
+    ok = ok && sort_accesses( &list, index );
+    free( list.accesses );
+    if( !ok )
+        ioscan_free( index );
+    return ok;
+}
+
+void ioscan_free( ioscan_index *index )
+{
+    free( index->accesses );
+    memset( index, 0, sizeof(*index) );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      appends an access to the list
+//
+static bool add_access( access_list *list, unsigned int offset, ushort address, uchar opcode, uchar kind, short value )
+{
+    if( list->count == list->size )
+    {
+        long size = list->size ? list->size * 2 : ACCESSES_PER_PAGE;
+        ioscan_access *accesses = (ioscan_access *)realloc( list->accesses, size * sizeof(ioscan_access) );
+
+        if( accesses == NULL )
+            return false;
+        list->accesses = accesses;
+        list->size = size;
+    }
+
+    ioscan_access *access = &list->accesses[list->count++];
+    access->offset = offset;
+    access->address = address;
+    access->opcode = opcode;
+    access->kind = kind;
+    access->value = value;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      decodes a page one instruction after the other, the values
+//      stored are tracked by m6502_track()
+//
+static bool scan_page( access_list *list, const uchar *data, long size, unsigned int offset )
+{
+    m6502_regs regs;
+    long pos, len;
+
+    m6502_forget( &regs );
+    for( pos=0; pos<size; pos+=len )
+    {
+        uchar opcode = data[pos];
+        uchar kind = op_kinds.kind[opcode];
+
+        len = m6502_op_lengths[opcode];
+        if( pos + len > size )
+            break;
+
+        if( kind != 0 )
+        {
+            ushort address = (ushort)(data[pos + 1] | (data[pos + 2] << 8));
+            int reg = ioscan_reg_index( address );
+
+            if( reg >= 0 )
+            {
+                short value = kind == IOSCAN_WRITE ? m6502_stored( &regs, opcode ) : IOSCAN_NO_VALUE;
+
+                if( !add_access( list, offset + (unsigned int)pos, ioscan_reg_address( reg ), opcode, kind, value ) )
+                    return false;
+            }
+        }
+
+        m6502_track( &regs, data + pos );
+    }
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      counting sort by register, keeps the file order of the
+//      accesses of every register
+//
+static bool sort_accesses( const access_list *list, ioscan_index *index )
+{
+    long next[IOSCAN_REG_COUNT];
+
+    index->count = list->count;
+    index->accesses = (ioscan_access *)malloc( (list->count ? list->count : 1) * sizeof(ioscan_access) );
+    if( index->accesses == NULL )
+        return false;
+
+    memset( index->first, 0, sizeof(index->first) );
+    for( long i=0; i<list->count; i++ )
+        index->first[ioscan_reg_index( list->accesses[i].address ) + 1]++;
+    for( int r=0; r<IOSCAN_REG_COUNT; r++ )
+    {
+        index->first[r + 1] += index->first[r];
+        next[r] = index->first[r];
+    }
+    for( long i=0; i<list->count; i++ )
+        index->accesses[next[ioscan_reg_index( list->accesses[i].address )]++] = list->accesses[i];
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes "NAME = $xx: FLAG | FLAG | FIELD=n", only set flags
+//      are listed, fields of several bits always
+//
+bool ioscan_describe_value( ushort address, uchar value, char *buf, size_t size )
+{
+    const reg_fields *fields = get_reg_fields( address );
+    const char *name = ioscan_reg_name( address );
+    size_t len;
+
+    if( fields == NULL || fields->count == 0 || size == 0 )
+        return false;
+
+    snprintf( buf, size, "%s = $%02X", name, value );
+    len = strlen( buf );
+
+    const char *separator = ": ";
+    for( int i=0; i<fields->count && len<size; i++ )
+    {
+        const reg_field *field = &fields->fields[i];
+        unsigned bits = (value >> field->shift) & ((1u << field->width) - 1);
+
+        if( field->width == 1 && bits == 0 )
+            continue;
+        if( field->width == 1 )
+            snprintf( buf + len, size - len, "%s%s", separator, field->name );
+        else
+            snprintf( buf + len, size - len, "%s%s=%u", separator, field->name, bits );
+        len += strlen( buf + len );
+        separator = " | ";
+    }
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      register descriptions of ioregs.h, the bit fields are
+//      parsed from the comments the first time they're needed
+//
+static const ioreg_desc *find_ioreg_desc( ushort address )
+{
+    for( size_t i=0; i<IOREG_DESC_COUNT; i++ )
+        if( ioreg_descs[i].address == address )
+            return &ioreg_descs[i];
+    return NULL;
+}
+
+static const reg_fields *get_reg_fields( ushort address )
+{
+    // C++11 makes the initialization of local statics thread-safe
+    static const struct all_fields_t {
+
+        reg_fields regs[IOREG_DESC_COUNT];
+
+        all_fields_t()
+        {
+            for( size_t i=0; i<IOREG_DESC_COUNT; i++ )
+                parse_reg_fields( ioreg_descs[i].comment, &regs[i] );
+        }
+
+    } all_fields;
+
+    const ioreg_desc *desc = find_ioreg_desc( address );
+    return desc != NULL ? &all_fields.regs[desc - ioreg_descs] : NULL;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      takes the "Dn: Text" and "Dm-Dn: Text" lines of the first
+//      section of a comment that describes writing the register.
+//      sections are separated by lines of dashes. fields covering
+//      the whole byte and fields overlapping earlier ones (bits
+//      whose meaning depends on other bits) are left out
+//
+static void parse_reg_fields( const char *comment, reg_fields *fields )
+{
+    const char *section = comment;
+
+    fields->count = 0;
+    while( *section != '\0' && fields->count == 0 )
+    {
+        const char *end = section;
+        unsigned used = 0;
+
+        // a section ends before the next line starting with dashes
+        while( *end != '\0' && !(end[0] == '\n' && end[1] == '-') )
+            end++;
+
+        if( is_write_section( section, end ) )
+        {
+            for( const char *line=section; line<end; )
+            {
+                const char *eol = (const char *)memchr( line, '\n', end - line );
+                reg_field field;
+
+                if( eol == NULL )
+                    eol = end;
+                if( parse_field_line( line, eol, &field ) && field.width < 8 && fields->count < MAX_REG_FIELDS )
+                {
+                    unsigned bits = ((1u << field.width) - 1) << field.shift;
+
+                    if( (used & bits) == 0 )
+                    {
+                        fields->fields[fields->count++] = field;
+                        used |= bits;
+                    }
+                }
+                line = eol + 1;
+            }
+        }
+
+        // skip the dashes
+        section = end;
+        if( *section != '\0' )
+            section++;
+        while( *section != '\0' && *section != '\n' )
+            section++;
+        if( *section != '\0' )
+            section++;
+    }
+}
+
+static bool is_write_section( const char *start, const char *end )
+{
+    const char *eol = (const char *)memchr( start, '\n', end - start );
+
+    if( eol == NULL )
+        eol = end;
+    return !contains( start, end, "READING:" ) && !contains( start, eol, "(R)" );
+}
+
+static bool contains( const char *start, const char *end, const char *text )
+{
+    size_t len = strlen( text );
+
+    for( ; end - start >= (long)len; start++ )
+        if( memcmp( start, text, len ) == 0 )
+            return true;
+    return false;
+}
+
+// "   D7: Execute NMI on VBlank" -> 7, 1, "EXECUTE_NMI_ON_VBLANK"
+static bool parse_field_line( const char *line, const char *end, reg_field *field )
+{
+    int high, low;
+    size_t len = 0;
+
+    while( line < end && *line == ' ' )
+        line++;
+    if( end - line < 4 || line[0] != 'D' || !isdigit( (uchar)line[1] ) )
+        return false;
+
+    high = low = line[1] - '0';
+    line += 2;
+    if( end - line >= 3 && line[0] == '-' && line[1] == 'D' && isdigit( (uchar)line[2] ) )
+    {
+        low = line[2] - '0';
+        line += 3;
+    }
+    if( line >= end || *line != ':' || high > 7 || low > high )
+        return false;
+
+    // the name ends at a parenthesized remark
+    for( line++; line < end && *line != '('; line++ )
+    {
+        if( isalnum( (uchar)*line ) )
+        {
+            if( len + 1 < sizeof(field->name) )
+                field->name[len++] = (char)toupper( (uchar)*line );
+        }
+        else if( len > 0 && field->name[len - 1] != '_' && len + 1 < sizeof(field->name) )
+            field->name[len++] = '_';
+    }
+    while( len > 0 && field->name[len - 1] == '_' )
+        len--;
+    field->name[len] = '\0';
+
+    field->shift = (uchar)low;
+    field->width = (uchar)(high - low + 1);
+    return len > 0;
+}
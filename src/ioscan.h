@@ -0,0 +1,94 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    I/O register access index.
+
+    ioscan_image() makes a single linear pass over every PRG page
+    of an image, not only over the banks loaded into the database,
+    decoding one instruction after the other (see m6502.h).
+    Every absolute load, store or read-modify-write of a register
+    in $2000-$401F is recorded, PPU register mirrors are folded to
+    $2000-$2007. Data inside the pages is decoded as well, so the
+    index may contain a few accesses that are never executed.
+
+    The index is compact: accesses are sorted by register and
+    ioscan_index.first[] says where the accesses of a register
+    start, like a CSR matrix row pointer.
+
+    A store of a value m6502_track() knows, typically right after
+    LDA/LDX/LDY #imm, records the value written, which
+    ioscan_describe_value() turns into the flag names from the bit
+    descriptions of the register's comment in ioregs.h, e.g.
+    "PPU_CR_1 = $90: EXECUTE_NMI_ON_VBLANK | BACKGROUND_PATTERN_TABLE_ADDRESS | NAME_TABLE_ADDRESS=0".
+
+*/
+
+
+#ifndef _IOSCAN_H
+#define _IOSCAN_H
+
+#include "ines.h"
+
+
+// registers in the index: $2000-$2007 (mirrored up to $3FFF)
+// and $4000-$401F
+#define IOSCAN_PPU_REGS                     8
+#define IOSCAN_APU_REGS_ADDRESS             0x4000
+#define IOSCAN_REG_COUNT                    (IOSCAN_PPU_REGS + EXPROM_START_ADDRESS - IOSCAN_APU_REGS_ADDRESS)
+
+// kinds of accesses
+enum
+{
+    IOSCAN_READ = 1,
+    IOSCAN_WRITE,
+    IOSCAN_MODIFY                           // INC, ASL, ... read and write
+};
+
+// value of an access if it isn't known
+#define IOSCAN_NO_VALUE                     -1
+
+
+// one instruction accessing a register
+typedef struct _ioscan_access_t {
+
+    unsigned int offset;                    // of the instruction, from the start of PRG-ROM
+    ushort address;                         // of the register, mirrors folded
+    uchar opcode;
+    uchar kind;                             // IOSCAN_...
+    short value;                            // byte stored or IOSCAN_NO_VALUE
+
+} ioscan_access;
+
+
+typedef struct _ioscan_index_t {
+
+    long count;
+    ioscan_access *accesses;                // by register, then by offset
+    long first[IOSCAN_REG_COUNT + 1];       // accesses of register r are first[r]..first[r+1]-1
+    int pages;                              // PRG pages scanned
+
+} ioscan_index;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for ioscan.cpp
+//
+
+int ioscan_reg_index( unsigned address );       // -1 if not a register
+ushort ioscan_reg_address( int reg );
+const char *ioscan_reg_name( ushort address );  // NULL if unnamed
+
+bool ioscan_image( const ines_ctx *ctx, ioscan_index *index );
+void ioscan_free( ioscan_index *index );
+
+// writes the flag names of 'value' written to a register, returns false
+// if the register has no bit descriptions
+bool ioscan_describe_value( ushort address, uchar value, char *buf, size_t size );
+
+#endif // _IOSCAN_H
@@ -0,0 +1,181 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    fast LZ77 codec for page blobs.
+    See lz.h.
+
+*/
+
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "lz.h"
+
+
+#define HASH_BITS                           12
+#define MIN_MATCH                           4
+#define MAX_OFFSET                          0xFFFF
+
+// the format wants the last 5 bytes to be literals and no match
+// to start within the last 12 bytes
+#define LAST_LITERALS                       5
+#define MATCH_LIMIT                         12
+
+
+
+static inline unsigned read32( const unsigned char *p )
+{
+    unsigned v;
+    memcpy( &v, p, sizeof(v) );
+    return v;
+}
+
+static inline unsigned hash32( unsigned v )
+{
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes a length that doesn't fit into a token nibble
+//
+static unsigned char *put_length( unsigned char *op, size_t len )
+{
+    while( len >= 255 )
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes a sequence of literals and an optional match,
+//      returns NULL if 'cap' would be exceeded
+//
+static unsigned char *put_sequence( unsigned char *op, unsigned char *oend,
+                                    const unsigned char *lit, size_t litlen,
+                                    size_t offset, size_t matchlen )
+{
+    unsigned char *token = op++;
+
+    // token, extra length bytes, literals, offset, extra length bytes
+    if( (size_t)(oend - op) < litlen + litlen / 255 + 1 + 2 + matchlen / 255 + 1 )
+        return NULL;
+
+    *token = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+    if( litlen >= 15 )
+        op = put_length( op, litlen - 15 );
+    memcpy( op, lit, litlen );
+    op += litlen;
+
+    if( matchlen == 0 )
+        return op;
+
+    *op++ = (unsigned char)(offset & 0xFF);
+    *op++ = (unsigned char)(offset >> 8);
+
+    matchlen -= MIN_MATCH;
+    *token |= (unsigned char)(matchlen >= 15 ? 15 : matchlen);
+    if( matchlen >= 15 )
+        op = put_length( op, matchlen - 15 );
+
+    return op;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      compresses 'size' bytes, the hash table lives on the stack
+//      so this can run on any number of threads at once
+//
+size_t lz_compress( const unsigned char *src, size_t size, unsigned char *dst, size_t cap )
+{
+    int table[1 << HASH_BITS];
+    const unsigned char *anchor = src;
+    unsigned char *op = dst, *oend = dst + cap;
+    size_t ip = 0;
+
+    memset( table, -1, sizeof(table) );
+
+    if( size > MATCH_LIMIT )
+    {
+        size_t limit = size - MATCH_LIMIT;
+
+        while( ip < limit )
+        {
+            unsigned h = hash32( read32( src + ip ) );
+            int ref = table[h];
+            table[h] = (int)ip;
+
+            if( ref < 0 || ip - ref > MAX_OFFSET || read32( src + ref ) != read32( src + ip ) )
+            {
+                ip++;
+                continue;
+            }
+
+            size_t len = MIN_MATCH;
+            while( ip + len < size - LAST_LITERALS && src[ref + len] == src[ip + len] )
+                len++;
+
+            op = put_sequence( op, oend, anchor, src + ip - anchor, ip - ref, len );
+            if( op == NULL )
+                return 0;
+
+            ip += len;
+            anchor = src + ip;
+        }
+    }
+
+    op = put_sequence( op, oend, anchor, src + size - anchor, 0, 0 );
+    if( op == NULL )
+        return 0;
+    return op - dst;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      compresses all jobs on worker threads, every thread takes
+//      the next unfinished job until none are left
+//
+void lz_compress_jobs( lz_job *jobs, int count, int threads )
+{
+    std::atomic<int> next( 0 );
+    std::vector<std::thread> workers;
+
+    auto worker = [&]()
+    {
+        int i;
+        while( (i = next++) < count )
+            jobs[i].packed = lz_compress( jobs[i].src, jobs[i].size, jobs[i].dst, lz_bound( jobs[i].size ) );
+    };
+
+    if( threads <= 0 )
+        threads = std::thread::hardware_concurrency();
+    if( threads > count )
+        threads = count;
+
+    for( int t=1; t<threads; t++ )
+        workers.push_back( std::thread( worker ) );
+
+    // the calling thread helps as well
+    worker();
+
+    for( size_t t=0; t<workers.size(); t++ )
+        workers[t].join();
+}
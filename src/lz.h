@@ -0,0 +1,128 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    fast LZ77 codec for page blobs.
+
+    The stream uses the LZ4 block format: a sequence is a token
+    (literal length in the upper, match length - 4 in the lower
+    nibble, 15 meaning "more length bytes follow"), the literals,
+    a 16-bit little endian match offset and the remaining match
+    length bytes. The last sequence only holds literals.
+
+    The decoder is inline so that pagestore.h can be used without
+    linking lz.cpp, plugins only ever decompress.
+
+*/
+
+
+#ifndef _LZ_H
+#define _LZ_H
+
+#include <stddef.h>
+#include <string.h>
+
+
+// job for lz_compress_jobs()
+typedef struct _lz_job_t {
+
+    const unsigned char *src;
+    size_t size;
+    unsigned char *dst;                     // at least lz_bound( size ) bytes
+    size_t packed;                          // result of lz_compress()
+
+} lz_job;
+
+
+// worst case size of compressed data
+#define lz_bound( size )                    ( (size) + (size) / 255 + 16 )
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for lz.cpp
+//
+
+// returns the compressed size or 0, if the data doesn't fit into 'cap' bytes
+size_t lz_compress( const unsigned char *src, size_t size, unsigned char *dst, size_t cap );
+
+// compresses all jobs, using up to 'threads' worker threads (0: one per core)
+void lz_compress_jobs( lz_job *jobs, int count, int threads );
+
+
+
+//----------------------------------------------------------------------
+//
+//      decompresses exactly 'size' bytes to 'dst'.
+//      returns false if the stream is damaged
+//
+inline bool lz_decompress( const unsigned char *src, size_t packed, unsigned char *dst, size_t size )
+{
+    const unsigned char *ip = src, *iend = src + packed;
+    unsigned char *op = dst, *oend = dst + size;
+
+    while( ip < iend )
+    {
+        unsigned token = *ip++;
+        size_t len = token >> 4;
+
+        // literals
+        if( len == 15 )
+        {
+            unsigned char b;
+            do
+            {
+                if( ip >= iend )
+                    return false;
+                b = *ip++;
+                len += b;
+            } while( b == 255 );
+        }
+        if( len > (size_t)(iend - ip) || len > (size_t)(oend - op) )
+            return false;
+        memcpy( op, ip, len );
+        op += len;
+        ip += len;
+
+        // the last sequence has no match
+        if( ip >= iend )
+            break;
+
+        // match
+        if( iend - ip < 2 )
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if( offset == 0 || offset > (size_t)(op - dst) )
+            return false;
+
+        len = token & 15;
+        if( len == 15 )
+        {
+            unsigned char b;
+            do
+            {
+                if( ip >= iend )
+                    return false;
+                b = *ip++;
+                len += b;
+            } while( b == 255 );
+        }
+        len += 4;
+        if( len > (size_t)(oend - op) )
+            return false;
+
+        // byte by byte, matches may overlap the output
+        const unsigned char *ref = op - offset;
+        while( len-- )
+            *op++ = *ref++;
+    }
+
+    return op == oend;
+}
+
+#endif // _LZ_H
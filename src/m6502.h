@@ -0,0 +1,207 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    6502 instruction lengths and register tracking for the linear
+    scans over PRG-ROM (ioscan.cpp, bankswitch.cpp).
+
+    m6502_track() follows the values of A, X and Y through the
+    instructions a scan steps over: immediate loads, transfers,
+    INX/DEX, shifts of A and AND/ORA/EOR #imm. Instructions that
+    don't change the registers (stores, compares, branches, flag
+    instructions, ...) keep them, everything else forgets them.
+    Branch targets aren't known in a linear scan, so the values
+    are what the straight-line code leading up to an instruction
+    computes.
+
+*/
+
+
+#ifndef _M6502_H
+#define _M6502_H
+
+
+// value of a register that isn't known
+#define M6502_UNKNOWN                       -1
+
+
+// length of every opcode, undocumented ones included, so that
+// a linear sweep stays in step with the code as long as possible
+inline constexpr unsigned char m6502_op_lengths[256] =
+{
+//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,     // 0
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,     // 1
+    3, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,     // 2
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,     // 3
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,     // 4
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,     // 5
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,     // 6
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,     // 7
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,     // 8
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,     // 9
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,     // A
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,     // B
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,     // C
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,     // D
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,     // E
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3      // F
+};
+
+
+// documented opcodes, code jumping into anything else is unlikely
+inline constexpr unsigned char m6502_documented[256] =
+{
+//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 0, 0, 1, 1, 0,     // 0
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,     // 1
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,     // 2
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,     // 3
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,     // 4
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,     // 5
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,     // 6
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,     // 7
+    0, 1, 0, 0, 1, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 0,     // 8
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 0, 0,     // 9
+    1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,     // A
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,     // B
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,     // C
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0,     // D
+    1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,     // E
+    1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0, 0, 1, 1, 0      // F
+};
+
+// opcodes the scans look at
+#define M6502_STY_ABS                       0x8C
+#define M6502_STA_ABS                       0x8D
+#define M6502_STX_ABS                       0x8E
+#define M6502_JSR                           0x20
+#define M6502_JMP_ABS                       0x4C
+#define M6502_JMP_IND                       0x6C
+#define M6502_RTS                           0x60
+#define M6502_RTI                           0x40
+#define M6502_BRK                           0x00
+
+
+// known values of A, X and Y
+typedef struct _m6502_regs_t {
+
+    short a;
+    short x;
+    short y;
+
+} m6502_regs;
+
+
+
+//----------------------------------------------------------------------
+//
+//      forgets all register values
+//
+inline void m6502_forget( m6502_regs *regs )
+{
+    regs->a = regs->x = regs->y = M6502_UNKNOWN;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      true if execution doesn't continue with the next instruction
+//
+inline bool m6502_ends_flow( unsigned char opcode )
+{
+    return opcode == M6502_JMP_ABS || opcode == M6502_JMP_IND || opcode == M6502_RTS ||
+           opcode == M6502_RTI || opcode == M6502_BRK;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      value of the register an absolute store writes, opcode
+//      must be M6502_STA_ABS, M6502_STX_ABS or M6502_STY_ABS
+//
+inline short m6502_stored( const m6502_regs *regs, unsigned char opcode )
+{
+    return opcode == M6502_STA_ABS ? regs->a : opcode == M6502_STX_ABS ? regs->x : regs->y;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      true if an instruction leaves A, X and Y alone
+//
+inline bool m6502_keeps_regs( unsigned char opcode )
+{
+    switch( opcode )
+    {
+    // stores
+    case 0x81: case 0x84: case 0x85: case 0x86: case 0x8C: case 0x8D: case 0x8E:
+    case 0x91: case 0x94: case 0x95: case 0x96: case 0x99: case 0x9D:
+    // compares and BIT
+    case 0xC0: case 0xC1: case 0xC4: case 0xC5: case 0xC9: case 0xCC: case 0xCD:
+    case 0xD1: case 0xD5: case 0xD9: case 0xDD: case 0xE0: case 0xE4: case 0xEC:
+    case 0x24: case 0x2C:
+    // memory read-modify-writes
+    case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x36: case 0x3E:
+    case 0x46: case 0x4E: case 0x56: case 0x5E: case 0x66: case 0x6E: case 0x76: case 0x7E:
+    case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+    // branches, flags, pushes, NOP
+    case 0x10: case 0x30: case 0x50: case 0x70: case 0x90: case 0xB0: case 0xD0: case 0xF0:
+    case 0x18: case 0x38: case 0x58: case 0x78: case 0xB8: case 0xD8: case 0xF8:
+    case 0x08: case 0x48: case 0xEA:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      updates the register values for the instruction at 'insn',
+//      which must be m6502_op_lengths[*insn] bytes long
+//
+inline void m6502_track( m6502_regs *regs, const unsigned char *insn )
+{
+    #define M6502_KNOWN( r, expr )          ( (r) == M6502_UNKNOWN ? M6502_UNKNOWN : (short)((expr) & 0xFF) )
+
+    switch( insn[0] )
+    {
+    case 0xA9: regs->a = insn[1]; break;                            // LDA #imm
+    case 0xA2: regs->x = insn[1]; break;                            // LDX #imm
+    case 0xA0: regs->y = insn[1]; break;                            // LDY #imm
+
+    case 0xAA: regs->x = regs->a; break;                            // TAX
+    case 0xA8: regs->y = regs->a; break;                            // TAY
+    case 0x8A: regs->a = regs->x; break;                            // TXA
+    case 0x98: regs->a = regs->y; break;                            // TYA
+
+    case 0xE8: regs->x = M6502_KNOWN( regs->x, regs->x + 1 ); break;    // INX
+    case 0xC8: regs->y = M6502_KNOWN( regs->y, regs->y + 1 ); break;    // INY
+    case 0xCA: regs->x = M6502_KNOWN( regs->x, regs->x - 1 ); break;    // DEX
+    case 0x88: regs->y = M6502_KNOWN( regs->y, regs->y - 1 ); break;    // DEY
+
+    case 0x4A: regs->a = M6502_KNOWN( regs->a, regs->a >> 1 ); break;   // LSR A
+    case 0x0A: regs->a = M6502_KNOWN( regs->a, regs->a << 1 ); break;   // ASL A
+    case 0x29: regs->a = M6502_KNOWN( regs->a, regs->a & insn[1] ); break;  // AND #imm
+    case 0x09: regs->a = M6502_KNOWN( regs->a, regs->a | insn[1] ); break;  // ORA #imm
+    case 0x49: regs->a = M6502_KNOWN( regs->a, regs->a ^ insn[1] ); break;  // EOR #imm
+
+    default:
+        if( !m6502_keeps_regs( insn[0] ) )
+            m6502_forget( regs );
+        break;
+    }
+
+    #undef M6502_KNOWN
+}
+
+#endif // _M6502_H
@@ -4,6 +4,20 @@
 	------------------------------------------------------
 	Copyright 2006, Dennis Elser (dennis@backtrace.de)
 
+
+    mapper descriptor table.
+
+    Everything the loader knows about a mapper is in one line of
+    mapper_descs[] below: its name, which banks are loaded into
+    the ROM segment, the size of the PRG and CHR windows it
+    switches, how many PRG banks are fixed at the top of the
+    address space and how and where its bank registers are
+    written. Mappers that aren't listed use mapper_unknown.
+
+    mapper_index maps all 4096 NES 2.0 mapper numbers to their
+    descriptor and is built by the compiler, so get_mapper_desc()
+    is a single table lookup. To add a mapper, append a line.
+
 */
 
 
@@ -11,152 +25,152 @@
 #define _MAPPERS_H
 
 
+#define MAPPER_NOT_SUPPORTED                "mapper unknown/not supported"
 
+// number of mapper numbers (12 bits in NES 2.0 headers)
+#define MAPPER_COUNT                        4096
+
+
+// banks loaded into the ROM segment, see plan_prg_banks()
+enum
+{
+    MAPPER_LAYOUT_FIRST_LAST,               // 1st prg, last prg
+    MAPPER_LAYOUT_LAST_LAST,                // last prg, last prg
+    MAPPER_LAYOUT_FIRST_SECOND,             // 1st prg, 2nd prg
+    MAPPER_LAYOUT_8K_FIRST_LAST_THREE,      // 1st 8k prg, last three 8k prgs
+    MAPPER_LAYOUT_8K_LAST,                  // last 8k prg four times
 
-#define MAPPER_NOT_SUPPORTED "mapper unknown/not supported"
-
-char *mapper_names[] = {
-    "no mapper used",
-    "MMC 1",
-    "UNROM",
-    "CNROM",
-    "MMC 3",
-    "MMC 5",
-    "FFE F4xxx",
-    "AOROM",
-    "FFE F3xxx",
-    "MMC 2",
-    "MMC 4",
-    "Color Dreams",
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    "100 in 1",
-    "Bandai",
-    "FFE F8xxx",
-    "Jaleco SS8806",
-    "Namcot 106",
-    MAPPER_NOT_SUPPORTED,
-    "Konami VRC4",
-    "Konami VRC2 Type A",
-    "Konami VRC2 Type B",
-    "Konami VRC6",
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    "Irem G 101",
-    "Taito TC0190",
-    "Nina 1",
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    "Tengen Rambo 1",
-    "Irem H 3001",
-    "GNROM",
-    MAPPER_NOT_SUPPORTED,
-    "Sunsoft Mapper 4",
-    "Sunsoft FME7",
-    MAPPER_NOT_SUPPORTED,
-    "Camerica",
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    "Irem 74HC161 32",
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    MAPPER_NOT_SUPPORTED,
-    "HK SF3"
+    MAPPER_LAYOUT_COUNT
 };
 
 
+// how bank registers are written
 enum
 {
-    MAPPER_NONE                     = 0,
-    MAPPER_MMC1,
-    MAPPER_UNROM,
-    MAPPER_CNROM,
-    MAPPER_MMC3,
-    MAPPER_MMC5,
-    MAPPER_FFE_F4XXX,
-    MAPPER_AOROM,
-    MAPPER_FFE_F3XXX,
-    MAPPER_MMC2,
-    MAPPER_MMC4,
-    MAPPER_COLOR_DREAMS,
-
-    MAPPER_100_IN_1                 = 15,
-    MAPPER_BANDAI,
-    MAPPER_FFE_F8XXX,
-    MAPPER_JALECO_SS8806,
-    MAPPER_NAMCOT_106,
-
-    MAPPER_KONAMI_VRC4              = 21,
-    MAPPER_KONAMI_VRC2_TYPE_A,
-    MAPPER_KONAMI_VRC2_TYPE_B,
-    MAPPER_KONAMI_VRC6,
-
-    MAPPER_IREM_G_101               = 32,
-    MAPPER_TAITO_TC0190,
-    MAPPER_NINA_1,
-    
-    MAPPER_TENGEN_RAMBO_1           = 64,
-    MAPPER_IREM_H_3001,
-    MAPPER_GNROM,
-
-    MAPPER_SUNSOFT_MAPPER_4         = 68,
-    MAPPER_SUNSOFT_FME7,
-
-    MAPPER_CAMERICA                 = 71,
-
-    MAPPER_IREM_74HC161_32          = 78,
-
-    MAPPER_HK_SF3                   = 91,
+    MAPPER_REGS_NONE,                       // no bank switching
+    MAPPER_REGS_LATCH,                      // bank number written anywhere in the range
+    MAPPER_REGS_SERIAL,                     // 5 single bit writes (MMC1)
+    MAPPER_REGS_SELECT_DATA,                // register select, then data (MMC3)
+    MAPPER_REGS_DIRECT                      // one address per register (VRC, ...)
+};
+
+
+// what a latch switches
+#define MAPPER_SWITCH_PRG                   0x01
+#define MAPPER_SWITCH_CHR                   0x02
+
+
+typedef struct _mapper_desc_t {
+
+    unsigned short number;
+    const char *name;                       // NULL for unknown mappers
+    unsigned char layout;                   // MAPPER_LAYOUT_...
+    unsigned short prg_window;              // bytes switched at once
+    unsigned short chr_window;
+    unsigned char prg_fixed;                // PRG windows fixed at the top
+    unsigned char regs;                     // MAPPER_REGS_...
+    unsigned char switches;                 // MAPPER_SWITCH_...
+    unsigned short reg_start;               // bank register range
+    unsigned short reg_end;
+
+} mapper_desc;
+
 
+// sizes in kilobytes, "16 K" reads better than 0x4000 in a table
+#define K *0x400
 
+inline constexpr mapper_desc mapper_descs[] =
+{
+    //  #   name                    layout                              PRG    CHR   fix  registers                switch                                 range
+    {   0, "no mapper used",        MAPPER_LAYOUT_FIRST_LAST,           16 K,  8 K,  1,   MAPPER_REGS_NONE,        0,                                     0x0000, 0x0000 },
+    {   1, "MMC 1",                 MAPPER_LAYOUT_FIRST_LAST,           16 K,  4 K,  1,   MAPPER_REGS_SERIAL,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xFFFF },
+    {   2, "UNROM",                 MAPPER_LAYOUT_FIRST_LAST,           16 K,  8 K,  1,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_PRG,                     0x8000, 0xFFFF },
+    {   3, "CNROM",                 MAPPER_LAYOUT_FIRST_LAST,           16 K,  8 K,  1,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_CHR,                     0x8000, 0xFFFF },
+    {   4, "MMC 3",                 MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  2,   MAPPER_REGS_SELECT_DATA, MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0x8001 },
+    {   5, "MMC 5",                 MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x5100, 0x5130 },
+    {   6, "FFE F4xxx",             MAPPER_LAYOUT_FIRST_LAST,           16 K,  8 K,  1,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xFFFF },
+    {   7, "AOROM",                 MAPPER_LAYOUT_FIRST_SECOND,         32 K,  8 K,  0,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_PRG,                     0x8000, 0xFFFF },
+    {   8, "FFE F3xxx",             MAPPER_LAYOUT_FIRST_SECOND,         16 K,  8 K,  1,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xFFFF },
+    {   9, "MMC 2",                 MAPPER_LAYOUT_8K_FIRST_LAST_THREE,   8 K,  4 K,  3,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0xA000, 0xFFFF },
+    {  10, "MMC 4",                 MAPPER_LAYOUT_FIRST_LAST,           16 K,  4 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0xA000, 0xFFFF },
+    {  11, "Color Dreams",          MAPPER_LAYOUT_FIRST_SECOND,         32 K,  8 K,  0,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xFFFF },
+    {  15, "100 in 1",              MAPPER_LAYOUT_FIRST_SECOND,         16 K,  8 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG,                     0x8000, 0x8003 },
+    {  16, "Bandai",                MAPPER_LAYOUT_FIRST_LAST,           16 K,  1 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x6000, 0x800D },
+    {  17, "FFE F8xxx",             MAPPER_LAYOUT_FIRST_LAST,           16 K,  1 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x42FE, 0x4517 },
+    {  18, "Jaleco SS8806",         MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xF003 },
+    {  19, "Namcot 106",            MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xF7FF },
+    {  21, "Konami VRC4",           MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  2,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xF0C0 },
+    {  22, "Konami VRC2 Type A",    MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  2,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xE003 },
+    {  23, "Konami VRC2 Type B",    MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  2,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xF00C },
+    {  24, "Konami VRC6",           MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xF003 },
+    {  32, "Irem G 101",            MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  2,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xBFFF },
+    {  33, "Taito TC0190",          MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  2,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xA003 },
+    {  34, "Nina 1",                MAPPER_LAYOUT_FIRST_SECOND,         32 K,  4 K,  0,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x7FFD, 0x7FFF },
+    {  64, "Tengen Rambo 1",        MAPPER_LAYOUT_8K_LAST,               8 K,  1 K,  1,   MAPPER_REGS_SELECT_DATA, MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0x8001 },
+    {  65, "Irem H 3001",           MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xC000 },
+    {  66, "GNROM",                 MAPPER_LAYOUT_FIRST_LAST,           32 K,  8 K,  0,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xFFFF },
+    {  68, "Sunsoft Mapper 4",      MAPPER_LAYOUT_FIRST_LAST,           16 K,  2 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xF000 },
+    {  69, "Sunsoft FME7",          MAPPER_LAYOUT_FIRST_LAST,            8 K,  1 K,  1,   MAPPER_REGS_SELECT_DATA, MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xBFFF }, // not sure about this mapper
+    {  71, "Camerica",              MAPPER_LAYOUT_FIRST_LAST,           16 K,  8 K,  1,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_PRG,                     0xC000, 0xFFFF },
+    {  78, "Irem 74HC161 32",       MAPPER_LAYOUT_FIRST_LAST,           16 K,  8 K,  1,   MAPPER_REGS_LATCH,       MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x8000, 0xFFFF },
+    {  91, "HK SF3",                MAPPER_LAYOUT_LAST_LAST,            16 K,  2 K,  1,   MAPPER_REGS_DIRECT,      MAPPER_SWITCH_PRG | MAPPER_SWITCH_CHR, 0x6000, 0x7FFF },
 };
 
-#define MAPPER_LAST                 91
+// 1st prg, last prg, 1st chr for everything else
+inline constexpr mapper_desc mapper_unknown =
+    {   0, NULL,                    MAPPER_LAYOUT_FIRST_LAST,           16 K,  8 K,  1,   MAPPER_REGS_NONE,        0,                                     0x0000, 0x0000 };
+
+#undef K
+
+
+#define MAPPER_DESC_COUNT                   ( sizeof(mapper_descs) / sizeof(mapper_descs[0]) )
+
+
+// mapper number -> index into mapper_descs[] + 1, 0 for unknown mappers
+typedef struct _mapper_index_t {
+
+    unsigned char entry[MAPPER_COUNT];
+
+} mapper_index_t;
+
+constexpr mapper_index_t build_mapper_index( void )
+{
+    mapper_index_t index = {};
+
+    for( unsigned i=0; i<MAPPER_DESC_COUNT; i++ )
+        index.entry[mapper_descs[i].number] = (unsigned char)(i + 1);
+    return index;
+}
+
+inline constexpr mapper_index_t mapper_index = build_mapper_index();
+
+// every mapper number must be valid and listed once
+constexpr bool mapper_descs_valid( void )
+{
+    for( unsigned i=0; i<MAPPER_DESC_COUNT; i++ )
+    {
+        if( mapper_descs[i].number >= MAPPER_COUNT || mapper_descs[i].layout >= MAPPER_LAYOUT_COUNT )
+            return false;
+        for( unsigned j=0; j<i; j++ )
+            if( mapper_descs[j].number == mapper_descs[i].number )
+                return false;
+    }
+    return true;
+}
+
+static_assert( MAPPER_DESC_COUNT < 255, "mapper_index entries are bytes" );
+static_assert( mapper_descs_valid(), "bad or duplicate entry in mapper_descs[]" );
+
+
+
+//----------------------------------------------------------------------
+//
+//      descriptor of a mapper, never NULL
+//
+constexpr const mapper_desc *get_mapper_desc( unsigned number )
+{
+    return number < MAPPER_COUNT && mapper_index.entry[number] != 0 ?
+           &mapper_descs[mapper_index.entry[number] - 1] : &mapper_unknown;
+}
 
-#endif // _MAPPERS_H
\ No newline at end of file
+#endif // _MAPPERS_H
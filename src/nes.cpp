@@ -6,14 +6,12 @@
 
 
 	IDA Pro loader module for Nintendo Enternainment System
-    (NES) ROM images in iNES file format.
+    (NES) ROM images in iNES and UNIF file format, also straight
+    from zip and gzip archives.
 
 
 	todo list:
 	----------
-    - detect write access to PRG ROM and EXP ROM area and
-      autocomment it as bank swapping mechanism ?
-
     - implement a bank-switching-plugin?
 
     - further division of several memory segments into
@@ -38,19 +36,162 @@
 
 
 #include "../idaldr.h"
-#include "nes.h"
+#include "ines.h"
+#include "unif.h"
+#include "archive.h"
+#include "hash.h"
+#include "romdb.h"
+#include "pagestore.h"
+#include "overlay.h"
+#include "ppu.h"
+#include "bankswap.h"
 #include "ioregs.h"
-#include "mappers.h"
+#include "chr.h"
+#include "ioscan.h"
+#include "bankswitch.h"
+#include "callscan.h"
+#include "farcall.h"
 
 #include <moves.hpp>
 #include <bytes.hpp>
+#include <xref.hpp>
+#include <nalt.hpp>
+
+#include <chrono>
 
 
 #define YES_NO( condition ) ( condition ? "yes" : "no" )
 
 
-static ines_hdr hdr;
+// loader options, taken from the NESLDR environment variable
+// (a comma separated list, e.g. NESLDR=compress)
+typedef struct _loader_options_t {
+
+    bool compress;                          // store pages LZ compressed
+    bool reference;                         // store only the path of the ROM file
+    bool overlays;                          // every PRG bank as its own segment
+    bool chr_sheet;                         // write a CHR tile sheet
+    int chr_sheet_format;                   // CHR_SHEET_...
+
+} loader_options;
+
+
+// pages to be saved to INES_PAGES_NODE
+typedef struct _page_writer_t {
+
+    int count;                              // pages added so far
+    int unique;                             // pages with their own blob
+    long bytes_saved;                       // bytes not stored thanks to duplicates
+    long blob_bytes;                        // bytes written to blobs
+
+    ines_page_info *pages;                  // index entries
+    const uchar **data;                     // per page, NULL for duplicates
+
+    // unique pages by CRC32: chains of page indexes, -1 terminated
+    int *buckets;                           // bucket_mask + 1 chain heads
+    int *chain;                             // next unique page in the bucket, per page
+    crc32_t bucket_mask;
+
+} page_writer;
+
+
+// number of unique pages compressed and written at a time
+#define PAGE_WRITE_CHUNK                    64
+
 
+// counters of a load phase
+typedef struct _load_counters_t {
+
+    double ms;
+    long long bytes_read;
+    long seeks;
+    long nodes;                             // netnodes created
+    long long blob_bytes;
+    long long peak_buffers;                 // largest sum of the live buffers
+
+} load_counters;
+
+
+// profile of the running load, see profile_phase()
+typedef struct _load_profile_t {
+
+    int phase;                              // INES_PHASE_...
+    double started;                         // time the phase started
+    load_counters total;                    // running totals
+    load_counters mark;                     // totals when the phase started
+    load_counters phases[INES_PHASE_COUNT];
+    long long buffers;                      // bytes in the loader's buffers now
+
+} load_profile;
+
+static load_profile profile;
+
+static const char *const phase_names[INES_PHASE_COUNT] =
+{
+    "open", "plan", "segments", "blobs", "CHR sheet", "banks", "overlays",
+    "I/O registers", "bank switches", "calls", "far calls", "entry points",
+    "describe"
+};
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for nes.cpp
+//
+
+static void load_ines_file( linput_t *li ); // convenience function for all below
+static void get_loader_options( loader_options *opt );
+
+static double now_ms( void );
+static void profile_phase( int phase );
+static void profile_buffer( long long size );
+static void save_profile( void );
+static ssize_t read_input( linput_t *li, void *buf, size_t size );
+static long seek_input( linput_t *li, long pos );
+static bool create_node( netnode *node, const char *name );
+
+static bool open_image( linput_t *li, image_t *img, void **buffer );
+static bool peek_archive( linput_t *li, void *hdr, size_t size );
+static bool use_known_hdr( ines_ctx *ctx, const rom_fingerprint *fp );
+
+static void create_segments( const ines_ctx *ctx ); // convenience function for the following few
+static void create_segment( const ines_segment *seg );
+static void name_ioregs( void );
+static void name_ppu_tables( void );
+
+static void load_trainer( const ines_ctx *ctx );
+static void load_chr_rom_bank( const ines_ctx *ctx, const ines_bank *bank );
+static void load_prg_rom_bank( const ines_ctx *ctx, const ines_bank *bank );
+static void load_8k_prg_rom_bank( const ines_ctx *ctx, const ines_bank *bank );
+static bool map_bank( const ines_ctx *ctx, const ines_bank *bank );
+static void record_resident_bank( const ines_bank *bank );
+static void load_rom_banks( const ines_ctx *ctx );
+static void create_overlays( ines_ctx *ctx );
+static void export_chr_sheet( const ines_ctx *ctx, int format );
+static void index_ioregs( const ines_ctx *ctx );
+static bool find_bank_switches( const ines_ctx *ctx, bankswitch_list *list );
+static void index_calls( const ines_ctx *ctx );
+static void find_far_calls( const ines_ctx *ctx, const bankswitch_list *switches );
+static int find_prg_eas( const ines_ctx *ctx, image_off_t offset, ea_t *eas, int max );
+
+static void save_image_as_blobs( const ines_ctx *ctx, const loader_options *opt ); // convenience function for the following few
+static bool save_ines_hdr_as_blob( const ines_ctx *ctx );
+static bool reference_source( const ines_ctx *ctx );
+static int find_saved_page( const page_writer *pw, crc32_t hash, const uchar *data, long size );
+static void add_page( page_writer *pw, uchar kind, int number, const uchar *data, image_off_t offset, long size );
+static bool write_pages( page_writer *pw, bool compress, bool embed );
+static bool save_trainer_as_blob( const ines_ctx *ctx, page_writer *pw );
+static bool save_prg_rom_pages_as_blobs( const ines_ctx *ctx, page_writer *pw, int count );
+static bool save_chr_rom_pages_as_blobs( const ines_ctx *ctx, page_writer *pw, int count );
+
+
+static void define_item( ushort address, asize_t size, const char *shortdesc, const char *comment );
+static ea_t get_vector( ea_t vec );
+static void name_vector( ushort address, const char *name );
+static bool add_entry_points( linput_t *li, const ines_ctx *ctx );
+static void set_ida_export_data( const ines_ctx *ctx );
+static void describe_rom_image( const ines_ctx *ctx, const rom_fingerprint *fp, bool known );
 
 
 
@@ -64,6 +205,10 @@ static ines_hdr hdr;
 //
 int accept_file(linput_t *li, char fileformatname[MAX_FILE_FORMAT_NAME], int n)
 {
+    ines_hdr hdr;
+    int archive;
+    bool unif;
+
 	if( n!= 0 )
 		return 0;
 
@@ -78,13 +223,22 @@ int accept_file(linput_t *li, char fileformatname[MAX_FILE_FORMAT_NAME], int n)
 	if(qlread(li, &hdr, INES_HDR_SIZE) != INES_HDR_SIZE)
 		return 0;
 
-	// is it a valid ROM image in iNes format?
-	if( memcmp("NES", &hdr.id, sizeof(hdr.id)) != 0 || hdr.term != 0x1A )
+	// zip and gzip archives are checked by the header of the ROM image inside
+	archive = archive_kind( &hdr, INES_HDR_SIZE );
+	if( archive != ARCHIVE_NONE && !peek_archive( li, &hdr, INES_HDR_SIZE ) )
+		return 0;
+
+	// is it a valid ROM image in iNes or UNIF format?
+	unif = unif_is_unif_image( &hdr, INES_HDR_SIZE );
+	if( !unif && !ines_is_ines_image( &hdr, INES_HDR_SIZE ) )
 		return 0;
 
 	// this is the name of the file format which will be
 	// displayed in IDA's dialog
-	qstrncpy(fileformatname, "Nintendo Entertainment System ROM", MAX_FILE_FORMAT_NAME);
+	if( archive != ARCHIVE_NONE )
+		qsnprintf(fileformatname, MAX_FILE_FORMAT_NAME, "Nintendo Entertainment System ROM (%s%s)", unif ? "UNIF, " : "", archive_kind_name( archive ));
+	else
+		qstrncpy(fileformatname, unif ? "Nintendo Entertainment System ROM (UNIF)" : "Nintendo Entertainment System ROM", MAX_FILE_FORMAT_NAME);
 
 	// set processor to 6502
 	if ( ph.id != PLFM_6502 )
@@ -167,16 +321,60 @@ loader_t LDSC =
 //
 static void load_ines_file( linput_t *li )
 {
-    // go to file offset 0 - just to be sure
-	qlseek(li, 0, SEEK_SET);
-
-	// read the whole header
-	if( qlread(li, &hdr, sizeof(ines_hdr)) != sizeof(ines_hdr) )
+    loader_options opt;
+    rom_fingerprint fp;
+    ines_ctx ctx;
+    image_t img;
+    void *buffer, *rom;
+    long long read_size;
+    const char *error;
+    int archive;
+    bool known;
+    bankswitch_list switches;
+    bool switched;
+
+    memset( &profile, 0, sizeof(profile) );
+    profile.phase = INES_PHASE_OPEN;
+    profile.started = now_ms();
+
+    get_loader_options( &opt );
+
+    // map or read the whole file, once
+	if( !open_image( li, &img, &buffer ) )
         vloader_failure("File read error!",0);
 
+    // ROM images in archives are decompressed into memory, UNIF
+    // images with split PRG or CHR-ROM put together there
+    archive = archive_kind( img.data, (size_t)img.size );
+    read_size = buffer != NULL ? img.size : 0;
+    error = rom_open( &img, &ctx, &rom );
+    if( error != NULL )
+        loader_failure("Can't load the ROM image: %s!", error);
+    if( rom != NULL )
+    {
+        // the file read into 'buffer' has been replaced
+        profile_buffer( img.size - read_size );
+        qfree( buffer );
+        buffer = NULL;
+    }
+
+    if( archive != ARCHIVE_NONE )
+        msg("extracted the ROM image (%lld bytes) from the %s archive\n", (long long)img.size, archive_kind_name( archive ));
+    if( ctx.chunked || ctx.board[0] != '\0' )
+    {
+        msg("UNIF image, board '%s'%s\n", ctx.board, ctx.chunked ? "" : ", PRG or CHR-ROM put together from chunks");
+        if( unif_board_mapper( ctx.board ) == UNIF_MAPPER_UNKNOWN )
+            msg("The board of the UNIF image isn't known, loading it as mapper %d\n", UNIF_MAPPER_UNKNOWN);
+    }
+
+    // look the PRG and CHR data up in the local ROM database,
+    // a known-good header replaces the one of the file
+    romdb_fingerprint( &ctx, &fp );
+    known = use_known_hdr( &ctx, &fp );
+
     // check if header is corrupt
     // show a warning msg, but load the rom nonetheless
-    if( is_corrupt_ines_hdr() )
+    if( !known && ines_is_corrupt_hdr( &ctx.hdr, ctx.file_size ) )
     {
         //warning("The iNES header seems to be corrupt.\nLoader might give inaccurate results!");
         int code = askyn_c(1, "The iNES header seems to be corrupt.\n"
@@ -184,264 +382,454 @@ static void load_ines_file( linput_t *li )
                               "Do you want to internally fix the header ?\n\n"
                               "(this will not affect the input file)");
         if( code == 1 )
-            fix_ines_hdr();
+            ines_fix_hdr( &ctx.hdr );
     }
 
+    // decide which segments to create and which banks to load
+    profile_phase( INES_PHASE_PLAN );
+    ines_plan( &ctx );
+
     // create NES segments
-    create_segments( li );
+    profile_phase( INES_PHASE_SEGMENTS );
+    create_segments( &ctx );
 
     // save NES file to blobs
-    save_image_as_blobs( li );
+    profile_phase( INES_PHASE_BLOBS );
+    save_image_as_blobs( &ctx, &opt );
+
+    // render the CHR-ROM tiles to an image file next to the database
+    profile_phase( INES_PHASE_CHR_SHEET );
+    if( opt.chr_sheet )
+        export_chr_sheet( &ctx, opt.chr_sheet_format );
     
     // load relevant ROM banks into database
-    load_rom_banks( li );
+    profile_phase( INES_PHASE_BANKS );
+    load_rom_banks( &ctx );
+
+    // add the other PRG banks as overlays, their bytes are
+    // loaded from the page store later on
+    profile_phase( INES_PHASE_OVERLAYS );
+    if( opt.overlays )
+        create_overlays( &ctx );
+
+    // find the I/O register accesses of all PRG banks
+    profile_phase( INES_PHASE_IOREGS );
+    index_ioregs( &ctx );
+
+    // explain the writes to the mapper's bank registers, the
+    // list is kept for the far calls
+    profile_phase( INES_PHASE_BANK_SWITCHES );
+    switched = find_bank_switches( &ctx, &switches );
+
+    // JSRs and JMPs of all PRG banks, by target
+    profile_phase( INES_PHASE_CALLS );
+    index_calls( &ctx );
+
+    // far-call trampolines among the bank switches, calls to them
+    profile_phase( INES_PHASE_FAR_CALLS );
+    if( switched )
+    {
+        find_far_calls( &ctx, &switches );
+        profile_buffer( -(long long)(switches.size * sizeof(bank_switch)) );
+        bankswitch_free( &switches );
+    }
     
     // make vectors public
-    add_entry_points( li );
+    profile_phase( INES_PHASE_ENTRY_POINTS );
+    add_entry_points( li, &ctx );
 
     // fill inf structure
-    set_ida_export_data();    
+    profile_phase( INES_PHASE_DESCRIBE );
+    set_ida_export_data( &ctx );
 
     // add information about the ROM image
-	describe_rom_image();
+	describe_rom_image( &ctx, &fp, known );
   
     // let IDA add some information about the loaded file
     create_filename_cmt();
+
+    if( buffer != NULL || rom != NULL )
+        profile_buffer( -img.size );
+    image_release( &img );
+    qfree( buffer );
+    free( rom );
+
+    // report and keep the time and counters of every phase
+    profile_phase( INES_PHASE_COUNT );
+    save_profile();
+}
+
+
+
+static double now_ms( void )
+{
+    return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch() ).count();
 }
 
 
 
 //----------------------------------------------------------------------
 //
-//      check if ROM image header is corrupt
+//      ends the running load phase and starts the next one,
+//      INES_PHASE_COUNT ends the last phase
 //
-static bool is_corrupt_ines_hdr(void)
+static void profile_phase( int phase )
 {
-    char empty[sizeof(hdr.reserved)];
+    double now = now_ms();
+    load_counters *done = &profile.phases[profile.phase];
+
+    done->ms += now - profile.started;
+    done->bytes_read += profile.total.bytes_read - profile.mark.bytes_read;
+    done->seeks += profile.total.seeks - profile.mark.seeks;
+    done->nodes += profile.total.nodes - profile.mark.nodes;
+    done->blob_bytes += profile.total.blob_bytes - profile.mark.blob_bytes;
+    profile.total.ms += now - profile.started;
+
+    if( phase == INES_PHASE_COUNT )
+        return;
 
-    memset( &empty, 0, sizeof(empty) );
-    return ( memcmp(&empty, &hdr.reserved, sizeof(empty)) != 0 );    
+    profile.phase = phase;
+    profile.started = now;
+    profile.mark = profile.total;
+    if( profile.phases[phase].peak_buffers < profile.buffers )
+        profile.phases[phase].peak_buffers = profile.buffers;
 }
 
 
 
 //----------------------------------------------------------------------
 //
-//      fix iNES header internally
+//      accounts for a buffer of the loader being allocated
+//      (size > 0) or freed (size < 0)
 //
-static void fix_ines_hdr(void)
+static void profile_buffer( long long size )
 {
-    char *diskdude = "DiskDude";
+    load_counters *phase = &profile.phases[profile.phase];
 
-    if(memcmp(&hdr.rom_control_byte_1, diskdude, strlen(diskdude)) == 0)
-    {
-        memset(&hdr.rom_control_byte_1, 0, 9);
-    }
-    memset( &hdr.reserved, 0, sizeof(hdr.reserved));
-    return;
+    profile.buffers += size;
+    if( phase->peak_buffers < profile.buffers )
+        phase->peak_buffers = profile.buffers;
+    if( profile.total.peak_buffers < profile.buffers )
+        profile.total.peak_buffers = profile.buffers;
 }
 
 
 
-
 //----------------------------------------------------------------------
 //
-//      creates all necessary segments and initializes them, if possible
+//      prints the load profile and saves it to INES_PROFILE_NODE,
+//      times are stored in microseconds
 //
-static void create_segments( linput_t *li )
+static void save_profile( void )
 {
-    // create RAM segment
-    create_ram_segment();
+    netnode node;
 
-    // create segment for I/O registers
-    // NES uses memory mapped I/O
-    create_ioreg_segment();
+    msg("load profile:\n");
+    msg("  %-14s %10s %12s %6s %6s %12s %12s\n", "phase", "ms", "bytes read", "seeks", "nodes", "blob bytes", "peak buffers");
 
-    // create SRAM segment if supported by cartridge
-    //if( INES_MASK_SRAM( hdr.rom_control_byte_0 ) )
-        create_sram_segment();
-
-    // create segment for expansion ROM
-    create_exprom_segment();
-
-    // load trainer, if one is present
-    if( INES_MASK_TRAINER(hdr.rom_control_byte_0) )
+    node.create( INES_PROFILE_NODE );
+    for( int i=0; i<=INES_PHASE_COUNT; i++ )
     {
-        warning("This ROM image seems to have a trainer.\n"
-                "By default, this loader assumes the trainer to be mapped to $7000.\n");
-        load_trainer( li );  
+        const load_counters *c = i < INES_PHASE_COUNT ? &profile.phases[i] : &profile.total;
+        const char *name = i < INES_PHASE_COUNT ? phase_names[i] : "total";
+        double us = c->ms * 1000.0;
+
+        msg("  %-14s %10.3f %12lld %6ld %6ld %12lld %12lld\n", name, c->ms, c->bytes_read, c->seeks, c->nodes, c->blob_bytes, c->peak_buffers);
+
+        node.altset( i, us < 0xFFFFFFFFu ? (uval_t)us : 0xFFFFFFFFu, INES_PROFILE_TAG_TIME );
+        node.altset( i, (uval_t)c->bytes_read, INES_PROFILE_TAG_READ );
+        node.altset( i, (uval_t)c->seeks, INES_PROFILE_TAG_SEEKS );
+        node.altset( i, (uval_t)c->nodes, INES_PROFILE_TAG_NODES );
+        node.altset( i, (uval_t)c->blob_bytes, INES_PROFILE_TAG_BLOBS );
+        node.altset( i, (uval_t)c->peak_buffers, INES_PROFILE_TAG_PEAK );
+        node.supset( i, name, 0, INES_PROFILE_TAG_NAME );
     }
+}
 
-    // create segment for PRG ROMs
-    create_rom_segment();
 
+
+//----------------------------------------------------------------------
+//
+//      qlread(), qlseek() and netnode::create() counted in the
+//      load profile
+//
+static ssize_t read_input( linput_t *li, void *buf, size_t size )
+{
+    ssize_t n = qlread( li, buf, size );
+
+    if( n > 0 )
+        profile.total.bytes_read += n;
+    return n;
 }
 
+static long seek_input( linput_t *li, long pos )
+{
+    profile.total.seeks++;
+    return qlseek( li, pos, SEEK_SET );
+}
+
+static bool create_node( netnode *node, const char *name )
+{
+    if( !node->create( name ) )
+        return false;
+    profile.total.nodes++;
+    return true;
+}
+
+
 
 //----------------------------------------------------------------------
 //
-//      creates an SRAM segment, if available on cartridge
+//      parses the NESLDR environment variable, a comma separated
+//      list of options:
+//
+//      compress        - store ROM pages LZ compressed
+//      reference       - don't store ROM pages, read them from the
+//                        ROM file when needed (see pagestore.h)
+//      overlays        - create a segment for every PRG bank
+//      chrsheet        - write the CHR-ROM tiles to <database>.chr.png
+//      chrsheet=ppm    - the same as binary PPM file
 //
-static void create_sram_segment( void )
+static void get_loader_options( loader_options *opt )
 {
-    bool success = add_segm( 0, SRAM_START_ADDRESS, SRAM_START_ADDRESS + SRAM_SIZE, "SRAM", NULL ) == 1;
-    msg("creating SRAM segment..%s", success ? "ok!\n" : "failure!\n");
-    if(!success)
+    char buf[MAXSTR];
+    const char *env = getenv( "NESLDR" );
+
+    memset( opt, 0, sizeof(*opt) );
+    if( env == NULL )
         return;
-    set_segm_addressing( getseg( SRAM_START_ADDRESS ), 0 );
+
+    qstrncpy( buf, env, sizeof(buf) );
+    for( char *tok = strtok( buf, ", " ); tok != NULL; tok = strtok( NULL, ", " ) )
+    {
+        if( stricmp( tok, "compress" ) == 0 )
+            opt->compress = true;
+        else if( stricmp( tok, "reference" ) == 0 )
+            opt->reference = true;
+        else if( stricmp( tok, "overlays" ) == 0 )
+            opt->overlays = true;
+        else if( stricmp( tok, "chrsheet" ) == 0 || stricmp( tok, "chrsheet=png" ) == 0 )
+            opt->chr_sheet = true;
+        else if( stricmp( tok, "chrsheet=ppm" ) == 0 )
+        {
+            opt->chr_sheet = true;
+            opt->chr_sheet_format = CHR_SHEET_PPM;
+        }
+        else
+            msg("NESLDR: unknown option '%s' ignored\n", tok);
+    }
 }
 
 
 
 //----------------------------------------------------------------------
 //
-//      creates a RAM segment
+//      makes the whole input file available as image view.
+//      local files are mapped into memory, anything else is read
+//      into '*buffer' with a single qlread(). the caller has to
+//      image_release() the view and qfree() the buffer
 //
-static void create_ram_segment( void )
+static bool open_image( linput_t *li, image_t *img, void **buffer )
 {
-    bool success = add_segm( 0, RAM_START_ADDRESS, RAM_START_ADDRESS + RAM_SIZE, "RAM", NULL ) == 1;
-    msg("creating RAM segment..%s", success ? "ok!\n" : "failure!\n");
-    if(!success)
-        return;
-    set_segm_addressing( getseg( RAM_START_ADDRESS ), 0 );
-    
-    // how do I properly initialize a segment ?
-    //for( unsigned int ea = SRAM_START_ADDRESS; ea<= SRAM_START_ADDRESS + SRAM_SIZE; ea++ )
-    //    put_byte( ea, 0 );
+    FILE *fp = qlfile( li );
+    long size = qlsize( li );
+
+    *buffer = NULL;
+    if( fp != NULL && image_map_file( img, fp ) )
+        return true;
+
+    *buffer = qalloc( size );
+    if( *buffer == NULL )
+        return false;
+    profile_buffer( size );
+
+    seek_input( li, 0 );
+    if( read_input( li, *buffer, size ) != size )
+    {
+        qfree( *buffer );
+        *buffer = NULL;
+        profile_buffer( -size );
+        return false;
+    }
+
+    image_from_buffer( img, *buffer, size );
+    return true;
 }
 
 
 
 //----------------------------------------------------------------------
 //
-//      creates an I/O registers segment and names all io registers
+//      reads the first 'size' bytes of the ROM image in an archive
 //
-static void create_ioreg_segment( void )
+static bool peek_archive( linput_t *li, void *hdr, size_t size )
 {
-    bool success = add_segm( 0, IOREGS_START_ADDRESS, IOREGS_START_ADDRESS + IOREGS_SIZE, "IO_REGS", NULL ) == 1;
-    msg("creating IO_REGS segment..%s", success ? "ok!\n" : "failure!\n");
-    if(!success)
-        return;
-    set_segm_addressing( getseg( IOREGS_START_ADDRESS ), 0 );
+    archive_member member;
+    image_t img;
+    void *buffer;
+    bool ok;
+
+    if( !open_image( li, &img, &buffer ) )
+        return false;
+    ok = archive_find_member( &img, &member ) && member.size >= (image_off_t)size
+         && archive_extract( &img, &member, hdr, size );
+
+    if( buffer != NULL )
+        profile_buffer( -img.size );
+    image_release( &img );
+    qfree( buffer );
+    return ok;
+}
 
-    define_item( PPU_CR_1_ADDRESS, PPU_CR_1_SIZE, PPU_CR_1_SHORT_DESCRIPTION, PPU_CR_1_COMMENT );
-    define_item( PPU_CR_2_ADDRESS, PPU_CR_2_SIZE, PPU_CR_2_SHORT_DESCRIPTION, PPU_CR_2_COMMENT );
-    define_item( PPU_SR_ADDRESS, PPU_SR_SIZE, PPU_SR_SHORT_DESCRIPTION, PPU_SR_COMMENT );
 
-    define_item( SPR_RAM_AR_ADDRESS, SPR_RAM_AR_SIZE, SPR_RAM_AR_SHORT_DESCRIPTION, SPR_RAM_AR_COMMENT );
-    define_item( SPR_RAM_IOR_ADDRESS, SPR_RAM_IOR_SIZE, SPR_RAM_IOR_SHORT_DESCRIPTION, SPR_RAM_IOR_COMMENT );
 
-    define_item( VRAM_AR_1_ADDRESS, VRAM_AR_1_SIZE, VRAM_AR_1_SHORT_DESCRIPTION, VRAM_AR_1_COMMENT );
-    define_item( VRAM_AR_2_ADDRESS, VRAM_AR_2_SIZE, VRAM_AR_2_SHORT_DESCRIPTION, VRAM_AR_2_COMMENT );
-    define_item( VRAM_IOR_ADDRESS, VRAM_IOR_SIZE, VRAM_IOR_SHORT_DESCRIPTION, VRAM_IOR_COMMENT );
+//----------------------------------------------------------------------
+//
+//      replaces the header by the one stored in the ROM database
+//      (loaders/nesdb.bin) for this fingerprint.
+//      returns false if there's no database or the ROM isn't listed
+//
+static bool use_known_hdr( ines_ctx *ctx, const rom_fingerprint *fp )
+{
+    char path[QMAXPATH];
+    const ines_hdr *hdr;
+    romdb db;
 
-    define_item( PAPU_PULSE_1_CR_ADDRESS, PAPU_PULSE_1_CR_SIZE, PAPU_PULSE_1_CR_SHORT_DESCRIPTION, PAPU_PULSE_1_CR_COMMENT );
-    define_item( PAPU_PULSE_1_RCR_ADDRESS, PAPU_PULSE_1_RCR_SIZE, PAPU_PULSE_1_RCR_SHORT_DESCRIPTION, PAPU_PULSE_1_RCR_COMMENT );
-    define_item( PAPU_PULSE_1_FTR_ADDRESS, PAPU_PULSE_1_FTR_SIZE, PAPU_PULSE_1_FTR_SHORT_DESCRIPTION, PAPU_PULSE_1_FTR_COMMENT );
-    define_item( PAPU_PULSE_1_CTR_ADDRESS, PAPU_PULSE_1_CTR_SIZE, PAPU_PULSE_1_CTR_SHORT_DESCRIPTION, PAPU_PULSE_1_CTR_COMMENT );
+    if( getsysfile( path, sizeof(path), ROMDB_FILE_NAME, LDR_SUBDIR ) == NULL || !romdb_open( &db, path ) )
+        return false;
 
-    define_item( PAPU_PULSE_2_CR_ADDRESS, PAPU_PULSE_2_CR_SIZE, PAPU_PULSE_2_CR_SHORT_DESCRIPTION, PAPU_PULSE_2_CR_COMMENT );
-    define_item( PAPU_PULSE_2_RCR_ADDRESS, PAPU_PULSE_2_RCR_SIZE, PAPU_PULSE_2_RCR_SHORT_DESCRIPTION, PAPU_PULSE_2_RCR_COMMENT );
-    define_item( PAPU_PULSE_2_FTR_ADDRESS, PAPU_PULSE_2_FTR_SIZE, PAPU_PULSE_2_FTR_SHORT_DESCRIPTION, PAPU_PULSE_2_FTR_COMMENT );
-    define_item( PAPU_PULSE_2_CTR_ADDRESS, PAPU_PULSE_2_CTR_SIZE, PAPU_PULSE_2_CTR_SHORT_DESCRIPTION, PAPU_PULSE_2_CTR_COMMENT );
+    hdr = romdb_lookup( &db, fp );
+    if( hdr != NULL )
+    {
+        if( memcmp( hdr, &ctx->hdr, INES_HDR_SIZE ) != 0 )
+            msg("ROM found in %s, using the known-good iNES header\n", ROMDB_FILE_NAME);
+        ctx->hdr = *hdr;
+    }
 
-    define_item( PAPU_TRIANGLE_CR_1_ADDRESS, PAPU_TRIANGLE_CR_1_SIZE, PAPU_TRIANGLE_CR_1_SHORT_DESCRIPTION, PAPU_TRIANGLE_CR_1_COMMENT );
-    define_item( PAPU_TRIANGLE_CR_2_ADDRESS, PAPU_TRIANGLE_CR_2_SIZE, PAPU_TRIANGLE_CR_2_SHORT_DESCRIPTION, PAPU_TRIANGLE_CR_2_COMMENT );
-    define_item( PAPU_TRIANGLE_FR_1_ADDRESS, PAPU_TRIANGLE_FR_1_SIZE, PAPU_TRIANGLE_FR_1_SHORT_DESCRIPTION, PAPU_TRIANGLE_FR_1_COMMENT );
-    define_item( PAPU_TRIANGLE_FR_2_ADDRESS, PAPU_TRIANGLE_FR_2_SIZE, PAPU_TRIANGLE_FR_2_SHORT_DESCRIPTION, PAPU_TRIANGLE_FR_2_COMMENT );
-    
-    define_item( PAPU_NOISE_CR_1_ADDRESS, PAPU_NOISE_CR_1_SIZE, PAPU_NOISE_CR_1_SHORT_DESCRIPTION, PAPU_NOISE_CR_1_COMMENT );
-    define_item( PAPU_NOISE_CR_2_ADDRESS, PAPU_NOISE_CR_2_SIZE, PAPU_NOISE_CR_2_SHORT_DESCRIPTION, PAPU_NOISE_CR_2_COMMENT );
-    define_item( PAPU_NOISE_FR_1_ADDRESS, PAPU_NOISE_FR_1_SIZE, PAPU_NOISE_FR_1_SHORT_DESCRIPTION, PAPU_NOISE_FR_1_COMMENT );
-    define_item( PAPU_NOISE_FR_2_ADDRESS, PAPU_NOISE_FR_2_SIZE, PAPU_NOISE_FR_2_SHORT_DESCRIPTION, PAPU_NOISE_FR_2_COMMENT );
+    romdb_close( &db );
+    return hdr != NULL;
+}
 
-    
-    define_item( PAPU_DM_CR_ADDRESS, PAPU_DM_CR_SIZE, PAPU_DM_CR_SHORT_DESCRIPTION, PAPU_DM_CR_COMMENT );
-    define_item( PAPU_DM_DAR_ADDRESS, PAPU_DM_DAR_SIZE, PAPU_DM_DAR_SHORT_DESCRIPTION, PAPU_DM_DAR_COMMENT );
-    define_item( PAPU_DM_AR_ADDRESS, PAPU_DM_AR_SIZE, PAPU_DM_AR_SHORT_DESCRIPTION, PAPU_DM_AR_COMMENT );
-    define_item( PAPU_DM_DLR_ADDRESS, PAPU_DM_DLR_SIZE, PAPU_DM_DLR_SHORT_DESCRIPTION, PAPU_DM_DLR_COMMENT );
 
-    define_item( PAPU_SV_CSR_ADDRESS, PAPU_SV_CSR_SIZE, PAPU_SV_CSR_SHORT_DESCRIPTION, PAPU_SV_CSR_COMMENT );    
-    
-    define_item( SPRITE_DMAR_ADDRESS, SPRITE_DMAR_SIZE, SPRITE_DMAR_SHORT_DESCRIPTION, SPRITE_DMAR_COMMENT );
 
-    define_item( JOYPAD_1_ADDRESS, JOYPAD_1_SIZE, JOYPAD_1_SHORT_DESCRIPTION, JOYPAD_1_COMMENT );
-    define_item( JOYPAD_2_ADDRESS, JOYPAD_2_SIZE, JOYPAD_2_SHORT_DESCRIPTION, JOYPAD_2_COMMENT );
+//----------------------------------------------------------------------
+//
+//      creates all necessary segments and initializes them, if possible
+//
+static void create_segments( const ines_ctx *ctx )
+{
+    for( int i=0; i<ctx->segment_count; i++ )
+    {
+        create_segment( &ctx->segments[i] );
+
+        // NES uses memory mapped I/O
+        if( ctx->segments[i].start == IOREGS_START_ADDRESS )
+            name_ioregs();
+        else if( ctx->segments[i].start == PPU_EA( NAME_TABLE_0_ADDRESS ) )
+            name_ppu_tables();
+    }
+
+    // load trainer, if one is present
+    if( INES_MASK_TRAINER(ctx->hdr.rom_control_byte_0) )
+    {
+        warning("This ROM image seems to have a trainer.\n"
+                "By default, this loader assumes the trainer to be mapped to $7000.\n");
+        load_trainer( ctx );  
+    }
 }
 
 
 //----------------------------------------------------------------------
 //
-//      creates a ROM segment where all the code is being loaded to
+//      creates a segment of the plan built by ines_plan()
 //
-static void create_rom_segment( void )
+static void create_segment( const ines_segment *seg )
 {
-    bool success = add_segm( 0, ROM_START_ADDRESS, ROM_START_ADDRESS + ROM_SIZE, "ROM", CLASS_CODE ) == 1;
-    msg("creating ROM segment..%s", success ? "ok!\n" : "failure!\n");
+    bool success = add_segm( seg->base, seg->start, seg->end, seg->name, seg->sclass ) == 1;
+    msg("creating %s segment..%s", seg->name, success ? "ok!\n" : "failure!\n");
     if(!success)
         return;
-    set_segm_addressing( getseg( ROM_START_ADDRESS ), 0 );
+    set_segm_addressing( getseg( seg->start ), 0 );
 }
 
 
+
 //----------------------------------------------------------------------
 //
-//      creates an EXPANSION ROM segment, I don't know when it is used
+//      names all io registers
 //
-static void create_exprom_segment( void )
+static void name_ioregs( void )
 {
-    bool success = add_segm( 0, EXPROM_START_ADDRESS, EXPROM_START_ADDRESS + EXPROM_SIZE, "EXP_ROM", NULL ) == 1;
-    msg("creating EXP_ROM segment..%s", success ? "ok!\n" : "failure!\n");
-    if(!success)
-        return;
-    set_segm_addressing( getseg( EXPROM_START_ADDRESS ), 0 );
+    for( size_t i=0; i<IOREG_DESC_COUNT; i++ )
+        define_item( ioreg_descs[i].address, ioreg_descs[i].size, ioreg_descs[i].name, ioreg_descs[i].comment );
 }
 
 
-
 //----------------------------------------------------------------------
 //
-//      loads a 512 byte trainer (located at file offset INES_HDR_SIZE)
-//      to TRAINER_START_ADDRESS
+//      names the name, attribute and palette tables of the PPU
 //
-static void load_trainer( linput_t *li )
+static void name_ppu_tables( void )
 {
-    if( !INES_MASK_SRAM( hdr.rom_control_byte_0 ) )
+    static const struct { ushort address; const char *name; const char *comment; } tables[] =
     {
-        bool success = add_segm( 0, TRAINER_START_ADDRESS, TRAINER_START_ADDRESS + TRAINER_SIZE, "TRAINER", CLASS_CODE ) == 1;
-        msg("creating TRAINER segment..%s", success ? "ok!\n" : "failure!\n");
-        set_segm_addressing( getseg( TRAINER_START_ADDRESS ), 0 );
+        { PATTERN_TABLE_0_ADDRESS,   "PATTERN_TABLE_0",   "Pattern Table #0 (256 tiles)" },
+        { PATTERN_TABLE_1_ADDRESS,   "PATTERN_TABLE_1",   "Pattern Table #1 (256 tiles)" },
+        { NAME_TABLE_0_ADDRESS,      "NAME_TABLE_0",      "Name Table #0 (32x30 tiles)" },
+        { ATTRIBUTE_TABLE_0_ADDRESS, "ATTRIBUTE_TABLE_0", "Attribute Table #0" },
+        { NAME_TABLE_1_ADDRESS,      "NAME_TABLE_1",      "Name Table #1 (32x30 tiles)" },
+        { ATTRIBUTE_TABLE_1_ADDRESS, "ATTRIBUTE_TABLE_1", "Attribute Table #1" },
+        { NAME_TABLE_2_ADDRESS,      "NAME_TABLE_2",      "Name Table #2 (32x30 tiles)" },
+        { ATTRIBUTE_TABLE_2_ADDRESS, "ATTRIBUTE_TABLE_2", "Attribute Table #2" },
+        { NAME_TABLE_3_ADDRESS,      "NAME_TABLE_3",      "Name Table #3 (32x30 tiles)" },
+        { ATTRIBUTE_TABLE_3_ADDRESS, "ATTRIBUTE_TABLE_3", "Attribute Table #3" },
+        { IMAGE_PALETTE_ADDRESS,     "IMAGE_PALETTE",     "Image Palette (16 colors)" },
+        { SPRITE_PALETTE_ADDRESS,    "SPRITE_PALETTE",    "Sprite Palette (16 colors)" }
+    };
+
+    for( size_t i=0; i<sizeof(tables)/sizeof(tables[0]); i++ )
+    {
+        set_name( PPU_EA( tables[i].address ), tables[i].name );
+        set_cmt( PPU_EA( tables[i].address ), tables[i].comment, true );
     }
-    file2base(li, INES_HDR_SIZE, TRAINER_START_ADDRESS, TRAINER_START_ADDRESS + TRAINER_SIZE, FILEREG_PATCHABLE);
 }
 
 
+
 //----------------------------------------------------------------------
 //
-//      load 8k chr rom bank into database
+//      loads a 512 byte trainer (located at file offset INES_HDR_SIZE)
+//      to TRAINER_START_ADDRESS,
+//      the TRAINER segment itself is part of the segment plan
 //
-static void load_chr_rom_bank( linput_t *li, uchar banknr, ea_t address )
+static void load_trainer( const ines_ctx *ctx )
 {
-    // todo: add support for PPU
-    // this function currently is disabled, since no
-    // segment for the PPU is created
-    msg("The loader was trying to load a CHR bank but the PPU is not supported yet.\n");
-    return;
+    const uchar *trainer = ines_trainer( ctx );
 
-    if( (banknr == 0) || (hdr.chr_page_count_8k == 0) )
-        return;
-    
-    // this is the file offset to begin reading pages from
-    long offset = INES_HDR_SIZE +
-        (INES_MASK_TRAINER(hdr.rom_control_byte_0) ? TRAINER_SIZE : 0) +
-        PRG_PAGE_SIZE * hdr.prg_page_count_16k + (banknr - 1) * CHR_ROM_BANK_SIZE;
-    
-    // load page from ROM file into segment
-    msg("mapping CHR-ROM page %02d to %08x-%08x (file offset %08x) ..", banknr, address, address + CHR_PAGE_SIZE, offset);
-    if( file2base(li, offset, address, address + CHR_ROM_BANK_SIZE, FILEREG_PATCHABLE) == 1)
-        msg("ok\n");
-    else
-        msg("failure (corrupt ROM image?)\n");
+    if( trainer == NULL || mem2base(trainer, TRAINER_START_ADDRESS, TRAINER_START_ADDRESS + TRAINER_SIZE, (long)ines_trainer_offset( ctx )) != 1 )
+        msg("Could not load trainer (corrupt ROM image?)\n");
+}
+
+
+//----------------------------------------------------------------------
+//
+//      selects an 8k chr rom bank for the PPU pattern tables. the
+//      bytes are copied from the page store when a pattern table
+//      is visited, see ppu.h
+//
+static void load_chr_rom_bank( const ines_ctx *ctx, const ines_bank *bank )
+{
+    uval_t first = (uval_t)((bank->offset - ines_chr_offset( ctx )) / CHR_4K_BANK_SIZE);
+    bool created = netnode( INES_PPU_NODE ) == BADNODE;
+    bool ok = true;
+
+    msg("mapping CHR-ROM page %02u to PPU %04x-%04x on demand ..", bank->banknr, bank->address, (ea_t)(bank->address + bank->size));
+    for( int i=0; i<INES_PATTERN_TABLES; i++ )
+        ok = ines_select_chr_bank( i, first + i ) && ok;
+    msg(ok ? "ok\n" : "failure (corrupt ROM image?)\n");
+
+    if( created && netnode( INES_PPU_NODE ) != BADNODE )
+        profile.total.nodes++;
 }
 
 
@@ -451,21 +839,15 @@ static void load_chr_rom_bank( linput_t *li, uchar banknr, ea_t address )
 //
 //      load 16k prg rom bank into database
 //
-static void load_prg_rom_bank( linput_t *li, uchar banknr, ea_t address )
+static void load_prg_rom_bank( const ines_ctx *ctx, const ines_bank *bank )
 {
-
-    if( (banknr == 0) || (hdr.prg_page_count_16k == 0) )
-        return;
-
-    // this is the file offset to begin reading pages from
-    long offset = INES_HDR_SIZE +
-        (INES_MASK_TRAINER(hdr.rom_control_byte_0) ? TRAINER_SIZE : 0) +
-        (banknr - 1) * PRG_ROM_BANK_SIZE;
-    
     // load page from ROM file into segment
-    msg("mapping PRG-ROM page %02d to %08x-%08x (file offset %08x) ..", 1, address, address + PRG_ROM_BANK_SIZE, offset);
-    if( file2base(li, offset, address, address + PRG_ROM_BANK_SIZE, FILEREG_PATCHABLE) == 1)
+    msg("mapping PRG-ROM page %02u to %08x-%08x (file offset %08lx) ..", bank->banknr, bank->address, (ea_t)(bank->address + bank->size), (unsigned long)bank->offset);
+    if( map_bank( ctx, bank ) )
+    {
+        record_resident_bank( bank );
         msg("ok\n");
+    }
     else
         msg("failure (corrupt ROM image?)\n");                  
 }
@@ -476,127 +858,488 @@ static void load_prg_rom_bank( linput_t *li, uchar banknr, ea_t address )
 //
 //      load 8k prg rom bank into database
 //
-static void load_8k_prg_rom_bank( linput_t *li, uchar banknr, ea_t address )
+static void load_8k_prg_rom_bank( const ines_ctx *ctx, const ines_bank *bank )
 {
-
-    if( (banknr == 0) || (hdr.prg_page_count_16k == 0) )
-        return;
-
-    // this is the file offset to begin reading pages from
-    long offset = INES_HDR_SIZE +
-        (INES_MASK_TRAINER(hdr.rom_control_byte_0) ? TRAINER_SIZE : 0) +
-        (banknr - 1) * PRG_ROM_8K_BANK_SIZE;
-    
     // load page from ROM file into segment
-    msg("mapping 8k PRG-ROM page %02d to %08x-%08x (file offset %08x) ..", 1, address, address + PRG_ROM_8K_BANK_SIZE, offset);
-    if( file2base(li, offset, address, address + PRG_ROM_8K_BANK_SIZE, FILEREG_PATCHABLE) == 1)
+    msg("mapping 8k PRG-ROM page %02u to %08x-%08x (file offset %08lx) ..", bank->banknr, bank->address, (ea_t)(bank->address + bank->size), (unsigned long)bank->offset);
+    if( map_bank( ctx, bank ) )
+    {
+        record_resident_bank( bank );
         msg("ok\n");
+    }
     else
         msg("failure (corrupt ROM image?)\n");                  
 }
 
 
+
 //----------------------------------------------------------------------
 //
-//      this function loads the image into the ida database
-//      depending on the mapper in use
+//      copies a bank from the image view into the database,
+//      the file offset is kept so the bytes stay patchable
 //
-static void load_rom_banks( linput_t *li )
+static bool map_bank( const ines_ctx *ctx, const ines_bank *bank )
 {
-    uchar mapper = INES_MASK_MAPPER_VERSION(hdr.rom_control_byte_0, hdr.rom_control_byte_1);
-    switch( mapper )
-    {
-    default: // 1st prg, last prg, 1st chr
+    const uchar *data = ines_bank_data( ctx, bank );
+
+    if( data == NULL )
+        return false;
+    return mem2base(data, bank->address, (ea_t)(bank->address + bank->size), (long)bank->offset) == 1;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      remembers the PRG bank shown in a CPU window, so that other
+//      banks can be swapped in later on (see bankswap.h)
+//
+static void record_resident_bank( const ines_bank *bank )
+{
+    netnode node;
+
+    create_node( &node, ines_bank_num_node( bank->address ) );
+    ines_set_resident_bank( bank->address, (uval_t)bank->size, bank->banknr - 1 );
+}
+
+
+//----------------------------------------------------------------------
+//
+//      this function loads the banks selected by ines_plan()
+//      into the ida database
+//
+static void load_rom_banks( const ines_ctx *ctx )
+{
+    if( !ctx->mapper_supported && ctx->vectors.bank >= 0 )
+        warning("Mapper %d is not supported by this loader!\n"
+                "This could be a corrupt ROM image!\n"
+                "Loading the first PRG-ROM bank and, at $%04lX, the %ldk bank\n"
+                "with the most plausible vectors (%ld candidates).", ctx->mapper, 0x10000 - ctx->vectors.window,
+                ctx->vectors.window / 1024, ctx->vectors.candidates);
+    else if( !ctx->mapper_supported )
         warning("Mapper %d is not supported by this loader!\n"
                 "This could be a corrupt ROM image!\n"
-                "Loading first and last PRG-ROM banks by default.", mapper);
-    case MAPPER_NONE:
-    case MAPPER_MMC1:
-    case MAPPER_UNROM:
-    case MAPPER_CNROM:
-    case MAPPER_MMC3:
-    case MAPPER_MMC5:
-    case MAPPER_FFE_F4XXX:
-    case MAPPER_MMC4:
-    case MAPPER_BANDAI:
-    case MAPPER_FFE_F8XXX:
-    case MAPPER_JALECO_SS8806:
-    case MAPPER_KONAMI_VRC4:
-    case MAPPER_KONAMI_VRC2_TYPE_A:
-    case MAPPER_KONAMI_VRC2_TYPE_B:
-    case MAPPER_KONAMI_VRC6:
-    case MAPPER_NAMCOT_106:
-    case MAPPER_IREM_G_101:
-    case MAPPER_TAITO_TC0190:
-    case MAPPER_IREM_H_3001:
-    case MAPPER_SUNSOFT_MAPPER_4:
-    case MAPPER_SUNSOFT_FME7: // not sure about this mapper
-    case MAPPER_CAMERICA:
-    case MAPPER_IREM_74HC161_32:
-    case MAPPER_GNROM:
+                "Loading first and last PRG-ROM banks by default.", ctx->mapper);
+
+    for( int i=0; i<ctx->bank_count; i++ )
+    {
+        const ines_bank *bank = &ctx->banks[i];
+
+        switch( bank->kind )
         {
-            load_prg_rom_bank( li, 1, PRG_ROM_BANK_LOW_ADDRESS );
-            load_prg_rom_bank( li, hdr.prg_page_count_16k, PRG_ROM_BANK_HIGH_ADDRESS );
-            load_chr_rom_bank( li, 1, CHR_ROM_BANK_ADDRESS );
+        case INES_BANK_PRG_16K:
+            load_prg_rom_bank( ctx, bank );
+            break;
+        case INES_BANK_PRG_8K:
+            load_8k_prg_rom_bank( ctx, bank );
+            break;
+        case INES_BANK_CHR_8K:
+            load_chr_rom_bank( ctx, bank );
+            break;
         }
-        break;
-        
-    case MAPPER_HK_SF3: // last prg, last prg, 1st chr
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      creates an empty segment for every PRG bank planned by
+//      ines_plan_overlays() and describes it in INES_OVERLAYS_NODE.
+//      the pages must have been saved already, see overlay.h
+//
+static void create_overlays( ines_ctx *ctx )
+{
+    netnode node;
+    int created = 0;
+
+    ines_plan_overlays( ctx );
+    if( ctx->overlay_count == INES_MAX_OVERLAYS )
+        msg("The image has too many PRG banks, only the first %d get an overlay\n", INES_MAX_OVERLAYS);
+
+    create_node( &node, INES_OVERLAYS_NODE );
+    for( int i=0; i<ctx->overlay_count; i++ )
+    {
+        ines_bank bank;
+        image_off_t prg_offset;
+        ines_overlay_info info;
+        char name[MAXNAMESIZE];
+
+        if( !ines_get_overlay( ctx, i, &bank ) || ines_bank_data( ctx, &bank ) == NULL )
+            break;
+        prg_offset = bank.offset - ines_prg_offset( ctx );
+
+        info.start = INES_OVERLAY_EA( i, bank.address );
+        info.address = bank.address;
+        info.size = (uval_t)bank.size;
+        info.page = ines_find_page( INES_PAGE_PRG, (int)(prg_offset / PRG_PAGE_SIZE) );
+        info.page_offset = (uval_t)(prg_offset % PRG_PAGE_SIZE);
+        info.offset = (uval_t)bank.offset;
+        info.loaded = false;
+
+        qsnprintf( name, sizeof(name), "BANK%03d", i );
+        if( add_segm( INES_OVERLAY_BASE( i ), info.start, info.start + info.size, name, CLASS_CODE ) != 1 )
+            break;
+        set_segm_addressing( getseg( info.start ), 0 );
+
+        ines_set_overlay( node, i, &info );
+        created++;
+    }
+
+    msg("created %d of %d %dk PRG overlays, use the nesovl plugin to load them\n",
+        created, ctx->overlay_count, ctx->desc->prg_window == PRG_ROM_8K_BANK_SIZE ? 8 : 16);
+    ctx->overlay_count = created;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      indexes the I/O register accesses of all PRG pages (see
+//      ioscan.h) and saves the index to INES_IOREGS_NODE.
+//      accesses in loaded banks and overlays get a data xref to
+//      their register, stores of known values a comment with the
+//      flags written
+//
+static void index_ioregs( const ines_ctx *ctx )
+{
+    ioscan_index index;
+    netnode node;
+    long annotated = 0;
+
+    if( !ioscan_image( ctx, &index ) )
+    {
+        msg("Could not index I/O register accesses (out of memory)\n");
+        return;
+    }
+
+    profile_buffer( index.count * sizeof(ioscan_access) );
+
+    create_node( &node, INES_IOREGS_NODE );
+    for( int r=0; r<=IOSCAN_REG_COUNT; r++ )
+        node.altset( r, index.first[r], INES_IOREGS_TAG_FIRST );
+    if( index.count > 0 && node.setblob( index.accesses, index.count * sizeof(ioscan_access), 0, INES_IOREGS_TAG_ACCESSES ) )
+        profile.total.blob_bytes += index.count * sizeof(ioscan_access);
+
+    for( long i=0; i<index.count; i++ )
+    {
+        const ioscan_access *access = &index.accesses[i];
+        image_off_t offset = ines_prg_offset( ctx ) + access->offset;
+        char flags[MAXSTR];
+        bool described;
+        ea_t eas[INES_MAX_BANKS + 1];
+        int count;
+
+        count = find_prg_eas( ctx, offset, eas, INES_MAX_BANKS + 1 );
+        if( count == 0 )
+            continue;
+
+        described = access->value != IOSCAN_NO_VALUE &&
+                    ioscan_describe_value( access->address, (uchar)access->value, flags, sizeof(flags) );
+
+        for( int j=0; j<count; j++ )
         {
-            load_prg_rom_bank( li, hdr.prg_page_count_16k, PRG_ROM_BANK_LOW_ADDRESS );
-            load_prg_rom_bank( li, hdr.prg_page_count_16k, PRG_ROM_BANK_HIGH_ADDRESS );
-            load_chr_rom_bank( li, 1, CHR_ROM_BANK_ADDRESS );
+            add_dref( eas[j], access->address, access->kind == IOSCAN_READ ? dr_R : dr_W );
+            if( described )
+                set_cmt( eas[j], flags, false );
         }
-        break;
+        if( described )
+            annotated++;
+    }
+
+    msg("indexed %ld I/O register accesses in %d PRG pages, %ld stores annotated\n",
+        index.count, index.pages, annotated);
+    profile_buffer( -(long long)(index.count * sizeof(ioscan_access)) );
+    ioscan_free( &index );
+}
+
+
 
-    case MAPPER_AOROM: // 1st prg, 2nd prg, 1st chr
-    case MAPPER_FFE_F3XXX:
-    case MAPPER_COLOR_DREAMS:
-    case MAPPER_100_IN_1:
-    case MAPPER_NINA_1:
+//----------------------------------------------------------------------
+//
+//      comments the writes to bank registers (see bankswitch.h)
+//      in loaded banks and overlays and records the banks switched
+//      in the BANK_NUM_ nodes. the caller frees 'list' if true is
+//      returned
+//
+static bool find_bank_switches( const ines_ctx *ctx, bankswitch_list *list )
+{
+    netnode prg_8000, prg_c000, chr;
+    long resolved = 0;
+
+    if( !bankswitch_scan( ctx, list ) )
+    {
+        msg("Could not find bank switches (out of memory)\n");
+        return false;
+    }
+    profile_buffer( list->size * sizeof(bank_switch) );
+    if( list->count == 0 )
+        return true;
+
+    create_node( &prg_8000, BANK_NUM_8000 );
+    create_node( &prg_c000, BANK_NUM_C000 );
+    create_node( &chr, BANK_NUM_CHR );
+
+    for( long i=0; i<list->count; i++ )
+    {
+        const bank_switch *sw = &list->switches[i];
+        netnode *node = NULL;
+        char text[MAXSTR];
+        ea_t eas[INES_MAX_BANKS + 1];
+        int count;
+
+        if( sw->kind == BANKSW_PRG )
+            node = sw->window < 0xC000 ? &prg_8000 : &prg_c000;
+        else if( sw->kind == BANKSW_CHR )
+            node = &chr;
+        if( node != NULL && sw->bank != BANKSW_UNKNOWN )
+            resolved++;
+
+        count = find_prg_eas( ctx, ines_prg_offset( ctx ) + sw->offset, eas, INES_MAX_BANKS + 1 );
+        if( count == 0 )
+            continue;
+
+        bankswitch_describe( ctx, sw, text, sizeof(text) );
+        for( int j=0; j<count; j++ )
         {
-            load_prg_rom_bank( li, 1, PRG_ROM_BANK_LOW_ADDRESS );
-            load_prg_rom_bank( li, 2, PRG_ROM_BANK_HIGH_ADDRESS );
-            load_chr_rom_bank( li, 1, CHR_ROM_BANK_ADDRESS );
+            set_cmt( eas[j], text, false );
+            if( node == NULL )
+                continue;
+            node->altset( eas[j], sw->bank == BANKSW_UNKNOWN ? 0 : sw->bank + 1, BANK_NUM_TAG_BANK );
+            node->altset( eas[j], sw->window, BANK_NUM_TAG_WINDOW );
+            node->altset( eas[j], sw->size, BANK_NUM_TAG_SIZE );
         }
-        break;
-    case MAPPER_MMC2: // 1st 8k prg, last three 8k prgs, 1st chr
+    }
+
+    msg("found %ld bank register writes, %ld switch a constant bank\n", list->count, resolved);
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      builds the call graph of all PRG banks (see callscan.h) and
+//      saves it to INES_CALLS_NODE, see callgraph.h
+//
+static void index_calls( const ines_ctx *ctx )
+{
+    callscan_graph graph;
+    netnode node;
+
+    if( !callscan_image( ctx, &graph ) )
+    {
+        msg("Could not build the call graph (out of memory)\n");
+        return;
+    }
+    profile_buffer( graph.count * sizeof(callscan_ref) + graph.target_count * (sizeof(unsigned int) + sizeof(long)) );
+
+    create_node( &node, INES_CALLS_NODE );
+    node.altset( 0, graph.count, INES_CALLS_TAG_COUNT );
+    node.altset( 1, graph.target_count, INES_CALLS_TAG_COUNT );
+    node.altset( 2, graph.bank_size, INES_CALLS_TAG_COUNT );
+
+    for( long t=0; t<graph.target_count; t++ )
+    {
+        unsigned int key = graph.targets[t];
+
+        node.altset( t, key, INES_CALLS_TAG_TARGET );
+        node.altset( key, graph.first[t] + 1, INES_CALLS_TAG_FIRST );
+        node.altset( key, graph.first[t + 1] - graph.first[t], INES_CALLS_TAG_DEGREE );
+    }
+    for( long i=0; i<graph.count; i++ )
+    {
+        node.altset( i, graph.refs[i].from, INES_CALLS_TAG_FROM );
+        node.altset( i, graph.refs[i].opcode, INES_CALLS_TAG_OPCODE );
+    }
+
+    msg("indexed %ld calls and jumps to %ld targets in %d PRG banks, %ld into other banks\n",
+        graph.count, graph.target_count, graph.banks, graph.cross);
+    profile_buffer( -(long long)(graph.count * sizeof(callscan_ref) + graph.target_count * (sizeof(unsigned int) + sizeof(long))) );
+    callscan_free( &graph );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      comments the far-call trampolines of the fixed banks and the
+//      calls to them with the bank and target they reach (see
+//      farcall.h). the trampolines are looked for among the bank
+//      switches find_bank_switches() found. calls to a known bank
+//      get a data xref to the target in its overlay
+//
+static void find_far_calls( const ines_ctx *ctx, const bankswitch_list *switches )
+{
+    farcall_list list;
+    image_off_t prg_offset = ines_prg_offset( ctx );
+    long resolved = 0;
+
+    if( !farcall_scan( ctx, switches, &list ) )
+    {
+        msg("Could not find far calls (out of memory)\n");
+        return;
+    }
+    if( list.stub_count == 0 )
+        return;
+    profile_buffer( list.size * sizeof(farcall) );
+
+    for( int s=0; s<list.stub_count; s++ )
+    {
+        char text[MAXSTR];
+        ea_t eas[INES_MAX_BANKS + 1];
+        int count = find_prg_eas( ctx, prg_offset + list.stubs[s].offset, eas, INES_MAX_BANKS + 1 );
+
+        farcall_describe_stub( &list.stubs[s], text, sizeof(text) );
+        for( int j=0; j<count; j++ )
+            set_cmt( eas[j], text, true );
+    }
+
+    for( long i=0; i<list.count; i++ )
+    {
+        const farcall *call = &list.calls[i];
+        const farcall_stub *stub = &list.stubs[call->stub];
+        char text[MAXSTR];
+        ea_t eas[INES_MAX_BANKS + 1], target = BADADDR;
+        int count;
+
+        if( call->bank != FARCALL_UNKNOWN && call->target != FARCALL_UNKNOWN )
         {
-            load_8k_prg_rom_bank( li, 1, PRG_ROM_BANK_LOW_ADDRESS );
-            load_8k_prg_rom_bank( li, hdr.prg_page_count_16k*2 - 2, PRG_ROM_BANK_A000 );
-            load_prg_rom_bank( li, hdr.prg_page_count_16k, PRG_ROM_BANK_HIGH_ADDRESS );
-            load_chr_rom_bank( li, 1, CHR_ROM_BANK_ADDRESS );
+            resolved++;
+
+            // the overlay of the target, overlays may be smaller than the window
+            if( ctx->overlay_count > 0 && call->target >= stub->window && call->target < stub->window + (long)stub->size )
+            {
+                long size = ctx->desc->prg_window == PRG_ROM_8K_BANK_SIZE ? PRG_ROM_8K_BANK_SIZE : PRG_ROM_BANK_SIZE;
+                long overlay = (long)((call->bank * (long long)stub->size + (call->target - stub->window)) / size);
+                ines_bank bank;
+
+                if( overlay < ctx->overlay_count && ines_get_overlay( ctx, (int)overlay, &bank )
+                    && call->target >= bank.address && call->target < bank.address + bank.size )
+                    target = INES_OVERLAY_EA( overlay, call->target );
+            }
         }
-        break;
-              
-    case MAPPER_TENGEN_RAMBO_1: // last 8k prg, last 8k prg, last 8k prg, last 8k prg, 1st chr
+
+        count = find_prg_eas( ctx, prg_offset + call->offset, eas, INES_MAX_BANKS + 1 );
+        farcall_describe( &list, call, text, sizeof(text) );
+        for( int j=0; j<count; j++ )
         {
-            load_8k_prg_rom_bank( li, hdr.prg_page_count_16k*2 , PRG_ROM_BANK_8000 );
-            load_8k_prg_rom_bank( li, hdr.prg_page_count_16k*2 , PRG_ROM_BANK_A000 );
-            load_8k_prg_rom_bank( li, hdr.prg_page_count_16k*2 , PRG_ROM_BANK_C000 );
-            load_8k_prg_rom_bank( li, hdr.prg_page_count_16k*2 , PRG_ROM_BANK_E000 );
-            load_chr_rom_bank( li, 1, CHR_ROM_BANK_ADDRESS );           
+            set_cmt( eas[j], text, false );
+            if( target != BADADDR )
+                add_dref( eas[j], target, dr_O );
         }
-        break;
     }
+
+    msg("found %d far call trampolines, %ld of %ld far calls resolved\n", list.stub_count, resolved, list.count);
+    profile_buffer( -(long long)(list.size * sizeof(farcall)) );
+    farcall_free( &list );
 }
 
 
 
 //----------------------------------------------------------------------
 //
-//      saves prg and chr ROM pages/banks to a binary large object (blob)
+//      finds the addresses a PRG-ROM byte is mapped to: the loaded
+//      banks and its overlay, if overlays have been created
 //
-static void save_image_as_blobs( linput_t *li )
+static int find_prg_eas( const ines_ctx *ctx, image_off_t offset, ea_t *eas, int max )
 {
+    int count = 0;
+    ines_bank bank;
+
+    for( int i=0; i<ctx->bank_count && count<max; i++ )
+    {
+        const ines_bank *loaded = &ctx->banks[i];
+
+        if( loaded->kind != INES_BANK_CHR_8K && offset >= loaded->offset && offset < loaded->offset + loaded->size )
+            eas[count++] = loaded->address + (ea_t)(offset - loaded->offset);
+    }
+
+    if( ctx->overlay_count > 0 && count < max )
+    {
+        // overlays are 8k or 16k, see ines_get_overlay()
+        long size = ctx->desc->prg_window == PRG_ROM_8K_BANK_SIZE ? PRG_ROM_8K_BANK_SIZE : PRG_ROM_BANK_SIZE;
+        int overlay = (int)((offset - ines_prg_offset( ctx )) / size);
+
+        if( ines_get_overlay( ctx, overlay, &bank ) && offset >= bank.offset && offset < bank.offset + bank.size )
+            eas[count++] = INES_OVERLAY_EA( overlay, bank.address ) + (ea_t)(offset - bank.offset);
+    }
+    return count;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes the tile sheet of the CHR-ROM next to the database,
+//      see chr.h
+//
+static void export_chr_sheet( const ines_ctx *ctx, int format )
+{
+    char path[QMAXPATH];
+    long tiles;
+
+    set_file_ext( path, sizeof(path), database_idb, format == CHR_SHEET_PPM ? "chr.ppm" : "chr.png" );
+    tiles = chr_write_sheet( ctx, path, format );
+    if( tiles < 0 )
+        msg("Could not write CHR tile sheet %s\n", path);
+    else if( tiles > 0 )
+        msg("wrote %ld CHR tiles to %s (%s decoder)\n", tiles, path, chr_decoder_name());
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      saves prg and chr ROM pages/banks to binary large objects (blobs)
+//      all pages go to INES_PAGES_NODE, see pagestore.h. if the
+//      ROM file is to be referenced, only the page index is saved
+//
+static void save_image_as_blobs( const ines_ctx *ctx, const loader_options *opt )
+{
+    page_writer pw;
+    int max_pages = 1 + ctx->prg_pages + ctx->chr_pages;
+    int buckets = 1;
+    bool embed = !opt->reference || !reference_source( ctx );
+    long long buffers;
+
     // store ines header in a blob
-	save_ines_hdr_as_blob();
- 
-    save_trainer_as_blob( li );
+	save_ines_hdr_as_blob( ctx );
+
+    // at least one bucket per page
+    while( buckets < max_pages )
+        buckets <<= 1;
+    buffers = max_pages * (sizeof(ines_page_info) + sizeof(const uchar *) + sizeof(int)) + buckets * sizeof(int);
 
-    // store rom image in blobs
-    save_prg_rom_pages_as_blobs( li, hdr.prg_page_count_16k );
-    save_chr_rom_pages_as_blobs( li, hdr.chr_page_count_8k );
+    memset( &pw, 0, sizeof(pw) );
+    pw.pages = (ines_page_info *)qalloc( max_pages * sizeof(ines_page_info) );
+    pw.data = (const uchar **)qalloc( max_pages * sizeof(const uchar *) );
+    pw.chain = (int *)qalloc( max_pages * sizeof(int) );
+    pw.buckets = (int *)qalloc( buckets * sizeof(int) );
+    pw.bucket_mask = buckets - 1;
+
+    if( pw.pages != NULL && pw.data != NULL && pw.chain != NULL && pw.buckets != NULL )
+    {
+        profile_buffer( buffers );
+        memset( pw.buckets, 0xFF, buckets * sizeof(int) );
+        save_trainer_as_blob( ctx, &pw );
+
+        // store rom image in blobs
+        save_prg_rom_pages_as_blobs( ctx, &pw, ctx->prg_pages );
+        save_chr_rom_pages_as_blobs( ctx, &pw, ctx->chr_pages );
+
+        if( write_pages( &pw, opt->compress, embed ) && embed )
+            msg("stored %d ROM pages, %d unique (%ld bytes saved by deduplication), %ld bytes in blobs\n",
+                pw.count, pw.unique, pw.bytes_saved, pw.blob_bytes);
+        else if( !embed )
+            msg("indexed %d ROM pages, they are read from the ROM file\n", pw.count);
+        profile_buffer( -buffers );
+    }
+
+    qfree( pw.pages );
+    qfree( (void *)pw.data );
+    qfree( pw.chain );
+    qfree( pw.buckets );
 }
 
 
@@ -607,115 +1350,261 @@ static void save_image_as_blobs( linput_t *li )
 //
 //      store header to netnode
 //
-static bool save_ines_hdr_as_blob( void )
+static bool save_ines_hdr_as_blob( const ines_ctx *ctx )
 {
 	netnode hdr_node;
     
-	if( !hdr_node.create( INES_HDR_NODE ) )
+	if( !create_node( &hdr_node, INES_HDR_NODE ) )
 		return false;
-	return hdr_node.setblob(&hdr, INES_HDR_SIZE, 0, 'I');
+	if( !hdr_node.setblob(&ctx->hdr, INES_HDR_SIZE, 0, 'I') )
+        return false;
+    profile.total.blob_bytes += INES_HDR_SIZE;
+    return true;
 }
 
 
 
 //----------------------------------------------------------------------
 //
-//      store trainer to netnode
+//      describes the input file in INES_SOURCE_NODE if the pages
+//      can be read from there later on: it must be a local file
+//      with exactly the bytes being loaded. its size, CRC32 and
+//      SHA-1 are kept for ines_check_source(). returns false if the
+//      pages have to be embedded after all
 //
-static bool save_trainer_as_blob( linput_t *li )
+static bool reference_source( const ines_ctx *ctx )
 {
-	netnode node;
+    char path[QMAXPATH];
+    uchar sha1[SHA1_SIZE];
+    crc32_t crc = 0;
+    netnode node;
+    image_t file;
+    bool same;
+
+    FILE *f = get_input_file_path( path, sizeof(path) ) != NULL && path[0] != '\0' ? fopen( path, "rb" ) : NULL;
+    if( f == NULL || !image_map_file( &file, f ) )
+    {
+        if( f != NULL )
+            fclose( f );
+        msg("The ROM file can't be referenced, storing its pages in the database\n");
+        return false;
+    }
+    fclose( f );
 
-    uchar *buffer;
+    same = file.size == ctx->file_size && memcmp( file.data, ctx->image->data, (size_t)file.size ) == 0;
+    if( same )
+    {
+        crc = hash_crc32( 0, file.data, (size_t)file.size );
+        hash_sha1( file.data, (size_t)file.size, sha1 );
+    }
+    image_release( &file );
+    if( !same || strlen( path ) >= MAXSPECSIZE )
+    {
+        msg("%s differs from the loaded image, storing its pages in the database\n", path);
+        return false;
+    }
 
-    if( !INES_MASK_TRAINER( hdr.rom_control_byte_0 ) )
+    if( !create_node( &node, INES_SOURCE_NODE ) )
         return false;
+    node.supset( 0, path, 0, INES_SOURCE_TAG_PATH );
+    node.altset( 0, (uval_t)ctx->file_size, INES_SOURCE_TAG_SIZE );
+    node.altset( 0, crc, INES_SOURCE_TAG_CRC );
+    node.supset( 0, sha1, SHA1_SIZE, INES_SOURCE_TAG_SHA1 );
+    ines_set_source_state( INES_SOURCE_SAME );
+
+    msg("referencing %s, ROM pages are read from there\n", path);
+    return true;
+}
 
-    buffer = (uchar *)qalloc( TRAINER_SIZE );
 
-    if( buffer == 0 )
-        return false;
 
-    qlseek( li, INES_HDR_SIZE );
-    qlread( li, buffer, TRAINER_SIZE );
-  	if( !node.create( "$ Trainer" ) )
+//----------------------------------------------------------------------
+//
+//      returns the index of a page saved before with the same
+//      contents, or -1. only pages with the same CRC32 are compared
+//
+static int find_saved_page( const page_writer *pw, crc32_t hash, const uchar *data, long size )
+{
+    for( int i=pw->buckets[hash & pw->bucket_mask]; i>=0; i=pw->chain[i] )
     {
-        qfree( buffer );
-	  	return false;
+        if( pw->pages[i].hash == hash && pw->pages[i].size == (uval_t)size &&
+            memcmp( pw->data[i], data, size ) == 0 )
+            return i;
     }
-    if( !node.setblob( buffer, TRAINER_SIZE, 0, 'I' ) )
-        msg("Could not store trainer to netnode!\n");
-    
-    qfree( buffer );    
-	return true;
+    return -1;
 }
 
 
+
 //----------------------------------------------------------------------
 //
-//      store PRG ROM pages to netnode
+//      adds a page with its index entry as the next page,
+//      duplicates of pages added before only get an index entry
 //
-static bool save_prg_rom_pages_as_blobs( linput_t *li, uchar count )
+static void add_page( page_writer *pw, uchar kind, int number, const uchar *data, image_off_t offset, long size )
 {
-	netnode node;
+    int index = pw->count;
+    ines_page_info *info = &pw->pages[index];
+    int ref;
+
+    info->kind = kind;
+    info->number = number;
+    info->offset = (uval_t)offset;
+    info->size = size;
+    info->hash = hash_crc32( 0, data, size );
+    info->packed = 0;
+
+    ref = find_saved_page( pw, info->hash, data, size );
+    if( ref < 0 )
+    {
+        ref = index;
+        pw->data[index] = data;
+        pw->chain[index] = pw->buckets[info->hash & pw->bucket_mask];
+        pw->buckets[info->hash & pw->bucket_mask] = index;
+        pw->unique++;
+    }
+    else
+    {
+        pw->data[index] = NULL;
+        pw->bytes_saved += size;
+    }
+    info->ref = ref;
+
+    pw->count++;
+}
 
-    char prg_node_name[MAXNAMESIZE];
-    uchar *buffer = (uchar *)qalloc( PRG_PAGE_SIZE );
 
-    if( buffer == 0 )
+
+//----------------------------------------------------------------------
+//
+//      writes all added pages to INES_PAGES_NODE.
+//      if requested, the unique pages are compressed on worker
+//      threads first, the database is only touched from this thread.
+//      pages are compressed and written PAGE_WRITE_CHUNK at a time,
+//      so the memory needed doesn't grow with the size of the image.
+//      without 'embed' only the index entries are written
+//
+static bool write_pages( page_writer *pw, bool compress, bool embed )
+{
+    netnode node;
+    lz_job *jobs = NULL;
+    uchar *packed = NULL;
+    int first, last, i, j;
+
+    if( !create_node( &node, INES_PAGES_NODE ) )
+    {
+        msg("Could not create netnode for ROM pages!\n");
         return false;
+    }
 
-    qlseek( li, INES_HDR_SIZE + (INES_MASK_TRAINER(hdr.rom_control_byte_0) ? TRAINER_SIZE : 0) );
+    if( compress && embed && pw->unique > 0 )
+    {
+        jobs = (lz_job *)qalloc( PAGE_WRITE_CHUNK * sizeof(lz_job) );
+        packed = (uchar *)qalloc( PAGE_WRITE_CHUNK * lz_bound( PRG_PAGE_SIZE ) );
+        if( jobs == NULL || packed == NULL )
+        {
+            msg("Not enough memory to compress ROM pages, storing them uncompressed\n");
+            qfree( jobs );
+            qfree( packed );
+            jobs = NULL;
+            packed = NULL;
+        }
+        else
+            profile_buffer( PAGE_WRITE_CHUNK * (sizeof(lz_job) + lz_bound( PRG_PAGE_SIZE )) );
+    }
 
-    for(int i=0; i<count; i++)
+    for( first=0; first<pw->count; first=last )
     {
-        qlread( li, buffer, PRG_PAGE_SIZE );
-        qsnprintf( prg_node_name, sizeof(prg_node_name), "$ PRG-ROM page %d", i );
-    	if( !node.create( prg_node_name ) )
+        // next chunk: up to PAGE_WRITE_CHUNK unique pages
+        // and the duplicates between them
+        for( last=first, j=0; last<pw->count; last++ )
+        {
+            if( pw->data[last] == NULL )
+                continue;
+            if( j == PAGE_WRITE_CHUNK )
+                break;
+            if( jobs != NULL )
+            {
+                jobs[j].src = pw->data[last];
+                jobs[j].size = pw->pages[last].size;
+                jobs[j].dst = packed + j * lz_bound( PRG_PAGE_SIZE );
+            }
+            j++;
+        }
+        if( jobs != NULL )
+            lz_compress_jobs( jobs, j, 0 );
+
+        for( i=first, j=0; i<last; i++ )
         {
-            qfree( buffer );
-	    	return false;
+            ines_page_info *info = &pw->pages[i];
+            const uchar *data = embed ? pw->data[i] : NULL;
+
+            if( data != NULL && jobs != NULL )
+            {
+                // keep pages that don't shrink uncompressed
+                if( jobs[j].packed != 0 && jobs[j].packed < (size_t)info->size )
+                {
+                    info->packed = jobs[j].packed;
+                    data = jobs[j].dst;
+                }
+                j++;
+            }
+
+            if( !ines_set_page( node, i, info, data ) )
+                msg("Could not store %s page %d to netnode!\n",
+                    info->kind == INES_PAGE_TRAINER ? "trainer" : info->kind == INES_PAGE_PRG ? "PRG-ROM" : "CHR-ROM", info->number);
+            else if( data != NULL )
+            {
+                pw->blob_bytes += info->packed ? info->packed : info->size;
+                profile.total.blob_bytes += info->packed ? info->packed : info->size;
+            }
         }
-        if( !node.setblob( buffer, PRG_PAGE_SIZE, 0, 'I' ) )
-            msg("Could not store PRG-ROM pages to netnode!\n");
     }
-    
-    qfree( buffer );    
-	return true;
+
+    if( jobs != NULL )
+        profile_buffer( -(long long)(PAGE_WRITE_CHUNK * (sizeof(lz_job) + lz_bound( PRG_PAGE_SIZE ))) );
+    qfree( jobs );
+    qfree( packed );
+    return true;
 }
 
 
 
 //----------------------------------------------------------------------
 //
-//      store CHR ROM pages to netnode
+//      store trainer to netnode
 //
-static bool save_chr_rom_pages_as_blobs( linput_t *li, uchar count )
+static bool save_trainer_as_blob( const ines_ctx *ctx, page_writer *pw )
 {
-	netnode node;
+    const uchar *trainer = ines_trainer( ctx );
 
-    char chr_node_name[MAXSTR];
-    uchar *buffer = (uchar *)qalloc( CHR_PAGE_SIZE );
-
-    if( buffer == 0 )
+    if( trainer == NULL )
         return false;
 
-    qlseek( li, INES_HDR_SIZE + (INES_MASK_TRAINER(hdr.rom_control_byte_0) ? TRAINER_SIZE : 0) + PRG_PAGE_SIZE * hdr.prg_page_count_16k );
+    add_page( pw, INES_PAGE_TRAINER, 0, trainer, ines_trainer_offset( ctx ), TRAINER_SIZE );
+
+    return true;
+}
+
 
+//----------------------------------------------------------------------
+//
+//      store PRG ROM pages to netnode
+//
+static bool save_prg_rom_pages_as_blobs( const ines_ctx *ctx, page_writer *pw, int count )
+{
     for(int i=0; i<count; i++)
     {
-        qlread( li, buffer, CHR_PAGE_SIZE );
-        qsnprintf( chr_node_name, sizeof(chr_node_name), "$ CHR-ROM page %d", i );
-    	if( !node.create( chr_node_name ) )
+        const uchar *page = ines_prg_page( ctx, i );
+        if( page == NULL )
         {
-            qfree( buffer );
-	    	return false;
+            msg("PRG-ROM page %d is missing (corrupt ROM image?)\n", i);
+            return false;
         }
-        if( !node.setblob( buffer, CHR_PAGE_SIZE, 0, 'I' ) )
-            msg("Could not store CHR-ROM pages to netnode!\n");
+
+        add_page( pw, INES_PAGE_PRG, i, page, ines_prg_offset( ctx ) + (image_off_t)i * PRG_PAGE_SIZE, PRG_PAGE_SIZE );
     }
     
-    qfree( buffer );    
 	return true;
 }
 
@@ -723,15 +1612,24 @@ static bool save_chr_rom_pages_as_blobs( linput_t *li, uchar count )
 
 //----------------------------------------------------------------------
 //
-//      returns name of mapper
+//      store CHR ROM pages to netnode
 //
-static char *get_mapper_name( uchar mapper )
+static bool save_chr_rom_pages_as_blobs( const ines_ctx *ctx, page_writer *pw, int count )
 {
-    if(mapper > MAPPER_LAST)
-        return MAPPER_NOT_SUPPORTED;
-    return mapper_names[mapper];
-}
+    for(int i=0; i<count; i++)
+    {
+        const uchar *page = ines_chr_page( ctx, i );
+        if( page == NULL )
+        {
+            msg("CHR-ROM page %d is missing (corrupt ROM image?)\n", i);
+            return false;
+        }
 
+        add_page( pw, INES_PAGE_CHR, i, page, ines_chr_offset( ctx ) + (image_off_t)i * CHR_PAGE_SIZE, CHR_PAGE_SIZE );
+    }
+    
+	return true;
+}
 
 
 
@@ -739,20 +1637,38 @@ static char *get_mapper_name( uchar mapper )
 //
 //      add information about the ROM image to disassembly
 //
-static void describe_rom_image(void)
+static void describe_rom_image( const ines_ctx *ctx, const rom_fingerprint *fp, bool known )
 {
-    uchar mapper = INES_MASK_MAPPER_VERSION( hdr.rom_control_byte_0, hdr.rom_control_byte_1 );
+    const ines_hdr &hdr = ctx->hdr;
+    char sha1[2 * SHA1_SIZE + 1];
+
+    for( int i=0; i<SHA1_SIZE; i++ )
+        qsnprintf( &sha1[2 * i], 3, "%02x", fp->sha1[i] );
 
     describe(inf.minEA, true, "\n;   ROM information\n"
 		                      ";   ---------------\n;");
-    describe(inf.minEA, true, ";   Valid image header      : %s", YES_NO( !is_corrupt_ines_hdr() ) );
-	describe(inf.minEA, true, ";   16K PRG-ROM page count  : %d", hdr.prg_page_count_16k);
-	describe(inf.minEA, true, ";   8K CHR-ROM page count   : %d", hdr.chr_page_count_8k);
+    describe(inf.minEA, true, ";   Valid image header      : %s", YES_NO( !ines_is_corrupt_hdr( &hdr, ctx->file_size ) ) );
+    describe(inf.minEA, true, ";   Header format           : %s", ctx->board[0] != '\0' ? "UNIF" : ctx->nes20 ? "NES 2.0" : "iNES");
+    if( ctx->board[0] != '\0' )
+    {
+        describe(inf.minEA, true, ";   Board                   : %s", ctx->board);
+    }
+	describe(inf.minEA, true, ";   16K PRG-ROM page count  : %d", ctx->prg_pages);
+	describe(inf.minEA, true, ";   8K CHR-ROM page count   : %d", ctx->chr_pages);
     describe(inf.minEA, true, ";   Mirroring               : %s", INES_MASK_H_MIRRORING(hdr.rom_control_byte_0) ? "horizontal" : "vertical");
 	describe(inf.minEA, true, ";   SRAM enabled            : %s", YES_NO( INES_MASK_SRAM(hdr.rom_control_byte_0) ) );
 	describe(inf.minEA, true, ";   512-byte trainer        : %s", YES_NO( INES_MASK_TRAINER(hdr.rom_control_byte_0) ) );
     describe(inf.minEA, true, ";   Four screen VRAM layout : %s", YES_NO( INES_MASK_VRAM_LAYOUT(hdr.rom_control_byte_0) ) );
-	describe(inf.minEA, true, ";   Mapper                  : %s (Mapper #%d)", get_mapper_name( mapper ), mapper);
+	describe(inf.minEA, true, ";   Mapper                  : %s (Mapper #%d)", ines_get_mapper_name( ctx->mapper ), ctx->mapper);
+    if( ctx->nes20 )
+    {
+        describe(inf.minEA, true, ";   Submapper               : %d", ctx->submapper);
+        describe(inf.minEA, true, ";   PRG-RAM/NVRAM size      : %ld/%ld bytes", ctx->prg_ram_size, ctx->prg_nvram_size);
+        describe(inf.minEA, true, ";   CHR-RAM/NVRAM size      : %ld/%ld bytes", ctx->chr_ram_size, ctx->chr_nvram_size);
+    }
+    describe(inf.minEA, true, ";   PRG/CHR CRC32           : %08X", fp->crc);
+    describe(inf.minEA, true, ";   PRG/CHR SHA-1           : %s", sha1);
+    describe(inf.minEA, true, ";   Header from ROM database: %s", YES_NO( known ) );
 }
 
 
@@ -761,7 +1677,7 @@ static void describe_rom_image(void)
 //
 //      defines, names and comments an item
 //
-static void define_item( ushort address, asize_t size, char *shortdesc, char *comment )
+static void define_item( ushort address, asize_t size, const char *shortdesc, const char *comment )
 {
     do_unknown( address, true );
     do_data_ex( address, (size == IOREG_16 ? wordflag() : byteflag() ), size, BADNODE );
@@ -804,8 +1720,11 @@ static void name_vector( ushort address, const char *name )
 //
 //      add entrypoints to the database and name vectors
 //
-static bool add_entry_points( linput_t *li )
+static bool add_entry_points( linput_t *li, const ines_ctx *ctx )
 {
+    static const char *const names[INES_VECTOR_COUNT] = { "NMI", "RESET", "IRQ" };
+    ushort vectors[INES_VECTOR_COUNT];
+    int plausible;
     ea_t ea;
 
     ea = get_vector( NMI_VECTOR_START_ADDRESS );
@@ -820,6 +1739,12 @@ static bool add_entry_points( linput_t *li )
     add_entry( ea, ea, "IRQ_routine", true );
     name_vector( IRQ_VECTOR_START_ADDRESS, "IRQ_vector" );
 
+    // vectors pointing elsewhere hint at a patched or broken image
+    plausible = ines_check_vectors( ctx, vectors );
+    for( int v=0; v<INES_VECTOR_COUNT; v++ )
+        if( !(plausible & (1 << v)) )
+            msg("%s vector $%04X doesn't point to code in the loaded PRG banks\n", names[v], vectors[v]);
+
     return true;
 }
 
@@ -829,7 +1754,7 @@ static bool add_entry_points( linput_t *li )
 //
 //      set entrypoint, minEA, maxEA, start_cs and filetype
 //
-static void set_ida_export_data( void )
+static void set_ida_export_data( const ines_ctx *ctx )
 {
     // set entrypoint
     inf.startIP = inf.beginEA = get_vector( RESET_VECTOR_START_ADDRESS );
@@ -837,7 +1762,16 @@ static void set_ida_export_data( void )
     // set minEA, maxEA, etc.
     inf.start_cs = 0;
     inf.minEA = RAM_START_ADDRESS;
-    inf.maxEA = ROM_START_ADDRESS + ROM_SIZE;
+    inf.maxEA = PPU_EA( MIRRORS_1_ADDRESS );    // the PPU palettes end the PPU address space
+
+    // overlays lie above the CPU address space
+    if( ctx->overlay_count != 0 )
+    {
+        ines_bank last;
+
+        ines_get_overlay( ctx, ctx->overlay_count - 1, &last );
+        inf.maxEA = INES_OVERLAY_EA( ctx->overlay_count - 1, last.address ) + (ea_t)last.size;
+    }
 }
 
 
@@ -53,7 +53,7 @@
 
 
 #define CHR_ROM_BANK_SIZE                   CHR_PAGE_SIZE
-#define CHR_ROM_BANK_ADDRESS                RAM_START_ADDRESS
+#define CHR_ROM_BANK_ADDRESS                PATTERN_TABLE_0_ADDRESS     // PPU address
 
 
 
@@ -92,7 +92,7 @@
 #define ATTRIBUTE_TABLE_2_ADDRESS           0x2BC0
 
 #define NAME_TABLE_3_ADDRESS                0x2C00
-#define ATTRIBUTE_TABLE_3_ADDRESS           0x2CF0
+#define ATTRIBUTE_TABLE_3_ADDRESS           0x2FC0
 
 #define MIRRORS_0_ADDRESS                   0x3000
 
@@ -105,6 +105,13 @@
 #define MIRRORS_2_ADDRESS                   0x4000
 
 
+// the PPU address space is put into the 64k block above the CPU's.
+// PPU segments have a base, so offsets show the PPU address
+#define PPU_BASE_EA                         0x10000
+#define PPU_EA( address )                   ( PPU_BASE_EA + (address) )
+#define PPU_BASE                            ( PPU_BASE_EA >> 4 ) // in paragraphs
+
+
 
 //----------------------------------------------------------------------
 //
@@ -120,8 +127,8 @@ typedef struct _ines_hdr_t {
 	uchar chr_page_count_8k;                // number of CHR-ROM pages
 	uchar rom_control_byte_0;               // flags describing ROM image
 	uchar rom_control_byte_1;               // flags describing ROM image
-	uchar ram_bank_count_8k;                // not used by this loader currently
-	uchar reserved[7];                      // should all be zero (not checked by loader)
+	uchar ram_bank_count_8k;                // iNES: PRG-RAM banks, NES 2.0: mapper bits 8-11 and submapper
+	uchar reserved[7];                      // iNES: should all be zero, NES 2.0: see NES20_... macros
 
 } ines_hdr;
 
@@ -133,8 +140,103 @@ typedef struct _ines_hdr_t {
 // node name for iNES header
 #define INES_HDR_NODE                       "$ iNES ROM header"
 
+// node name for trainer, PRG-ROM and CHR-ROM pages (see pagestore.h)
+#define INES_PAGES_NODE                     "$ iNES ROM pages"
+
+// ROM file the pages are read from if they aren't stored in
+// the database (NESLDR=reference, see pagestore.h)
+#define INES_SOURCE_NODE                    "$ iNES source file"
+
+// kinds of pages stored in INES_PAGES_NODE
+#define INES_PAGE_TRAINER                   1
+#define INES_PAGE_PRG                       2
+#define INES_PAGE_CHR                       3
+
+// PRG overlays (NESLDR=overlays), see overlay.h
+#define INES_OVERLAYS_NODE                  "$ iNES PRG overlays"
+
+// linear address of an overlay: the overlay index selects a
+// 64k block above the CPU and PPU address spaces, the bank keeps
+// its CPU address as offset within that block
+#define INES_OVERLAY_EA( index, address )   ( (((unsigned long)(index) + 2) << 16) | (address) )
+#define INES_OVERLAY_BASE( index )          ( ((unsigned long)(index) + 2) << 12 ) // in paragraphs
+#define INES_OVERLAY_INDEX( ea )            ( (int)((ea) >> 16) - 2 )
+
+// CHR banks shown in the PPU pattern tables, see ppu.h
+#define INES_PPU_NODE                       "$ iNES PPU"
+
+// I/O register access index (see ioscan.h): altval r is
+// ioscan_index.first[r], blob 0 holds the ioscan_access entries
+#define INES_IOREGS_NODE                    "$ iNES I/O register accesses"
+#define INES_IOREGS_TAG_FIRST               'F'
+#define INES_IOREGS_TAG_ACCESSES            'A'
+
+
+// bank switches found in PRG-ROM (see bankswitch.h), indexed by
+// the address of the write completing a switch. PRG banks switched
+// below $C000 go to BANK_NUM_8000, the others to BANK_NUM_C000,
+// CHR banks to BANK_NUM_CHR
 #define BANK_NUM_8000                       "$ Bank 8000"
 #define BANK_NUM_C000                       "$ Bank C000"
+#define BANK_NUM_CHR                        "$ Bank CHR"
+#define BANK_NUM_TAG_BANK                   'B'         // bank number + 1, 0 if it isn't constant
+#define BANK_NUM_TAG_WINDOW                 'W'         // CPU or PPU address switched
+#define BANK_NUM_TAG_SIZE                   'S'         // of the window
+
+// the PRG bank shown in a window of the CPU address space, indexed
+// by the address of the window (see bankswap.h)
+#define BANK_NUM_TAG_RESIDENT               'R'         // bank number + 1
+#define BANK_NUM_TAG_RESIDENT_SIZE          'Z'         // of the window
+
+
+// cross-bank call graph (see callscan.h and callgraph.h). JSRs and
+// JMPs are keyed by PRG bank, counted like the overlays, and CPU
+// address. the references to a target are a contiguous range of
+// reference numbers, so a target's callers are read in O(callers)
+#define INES_CALLS_NODE                     "$ iNES calls"
+#define INES_CALLS_TAG_COUNT                'C'         // altval 0: references, 1: targets, 2: bank size
+#define INES_CALLS_TAG_TARGET               'T'         // by target number: key of the target
+#define INES_CALLS_TAG_FIRST                'F'         // by target key: 1 + number of its first reference
+#define INES_CALLS_TAG_DEGREE               'N'         // by target key: number of references
+#define INES_CALLS_TAG_FROM                 'E'         // by reference number: key of the JSR/JMP
+#define INES_CALLS_TAG_OPCODE               'O'         // by reference number
+
+#define INES_CALLS_ANY_BANK                 0xFFFF      // bank isn't known
+#define INES_CALLS_KEY( bank, address )     ( ((unsigned int)(bank) << 16) | (unsigned int)(address) )
+#define INES_CALLS_KEY_BANK( key )          ( (unsigned int)(key) >> 16 )
+#define INES_CALLS_KEY_ADDRESS( key )       ( (unsigned int)(key) & 0xFFFF )
+
+
+// load profile: altval p holds the counters of load phase p,
+// altval INES_PHASE_COUNT those of the whole load, supval p the
+// name of the phase
+#define INES_PROFILE_NODE                   "$ iNES load profile"
+#define INES_PROFILE_TAG_TIME               'T'         // microseconds
+#define INES_PROFILE_TAG_READ               'R'         // bytes read from the input file
+#define INES_PROFILE_TAG_SEEKS              'K'         // seeks in the input file
+#define INES_PROFILE_TAG_NODES              'N'         // netnodes created
+#define INES_PROFILE_TAG_BLOBS              'B'         // bytes written to blobs
+#define INES_PROFILE_TAG_PEAK               'M'         // peak memory of the loader's buffers
+#define INES_PROFILE_TAG_NAME               'S'
+
+// phases of a load
+enum
+{
+    INES_PHASE_OPEN,                        // reading the file, fingerprint, header checks
+    INES_PHASE_PLAN,
+    INES_PHASE_SEGMENTS,
+    INES_PHASE_BLOBS,
+    INES_PHASE_CHR_SHEET,
+    INES_PHASE_BANKS,
+    INES_PHASE_OVERLAYS,
+    INES_PHASE_IOREGS,
+    INES_PHASE_BANK_SWITCHES,
+    INES_PHASE_CALLS,
+    INES_PHASE_FAR_CALLS,
+    INES_PHASE_ENTRY_POINTS,
+    INES_PHASE_DESCRIBE,                    // export data and ROM information
+    INES_PHASE_COUNT
+};
 
 // macros for masking control byte (cb) flags of the header
 #define INES_MASK_V_MIRRORING( cb )         ( cb & 0x1 )
@@ -148,44 +250,20 @@ typedef struct _ines_hdr_t {
 #define INES_MASK_MAPPER_VERSION(cb0, cb1)  ( ((cb0 & 0xF0) >> 4) |  (cb1 & 0xF0) )
 
 
+// NES 2.0 headers are marked by bits 2-3 of control byte 1 being 10b.
+// bytes 8-15 of the header are used as follows:
+#define INES_MASK_NES20( cb1 )              ( (cb1 & 0x0C) == 0x08 )
 
+#define NES20_MAPPER_HIGH( hdr )            ( (hdr)->ram_bank_count_8k & 0x0F )         // mapper bits 8-11
+#define NES20_SUBMAPPER( hdr )              ( (hdr)->ram_bank_count_8k >> 4 )
+#define NES20_PRG_SIZE_HIGH( hdr )          ( (hdr)->reserved[0] & 0x0F )               // size bits 8-11, 0xF: exponent
+#define NES20_CHR_SIZE_HIGH( hdr )          ( (hdr)->reserved[0] >> 4 )
+#define NES20_PRG_RAM_SHIFT( hdr )          ( (hdr)->reserved[1] & 0x0F )               // size is 64 << shift, 0: none
+#define NES20_PRG_NVRAM_SHIFT( hdr )        ( (hdr)->reserved[1] >> 4 )
+#define NES20_CHR_RAM_SHIFT( hdr )          ( (hdr)->reserved[2] & 0x0F )
+#define NES20_CHR_NVRAM_SHIFT( hdr )        ( (hdr)->reserved[2] >> 4 )
 
-//----------------------------------------------------------------------
-//
-//      function prototypes for nes.cpp
-//
-
-static void load_ines_file( linput_t *li ); // convenience function for all below
-
-static bool is_corrupt_ines_hdr( void );
-static void fix_ines_hdr( void );
-
-static void create_segments( linput_t *li ); // convenience function for the following few
-static void create_sram_segment( void );
-static void create_ram_segment( void );
-static void create_ioreg_segment( void );
-static void create_rom_segment( void );
-static void create_exprom_segment( void );
-
-static void load_trainer( linput_t *li );
-static void load_chr_rom_bank( linput_t *li, uchar banknr, ea_t address );
-static void load_prg_rom_bank( linput_t *li, uchar banknr, ea_t address );
-static void load_8k_prg_rom_bank( linput_t *li, uchar banknr, ea_t address );
-static void load_rom_banks( linput_t *li );
-
-static void save_image_as_blobs( linput_t *li ); // convenience function for the following few
-static bool save_ines_hdr_as_blob( void );
-static bool save_trainer_as_blob( linput_t *li );
-static bool save_prg_rom_pages_as_blobs( linput_t *li, uchar count );
-static bool save_chr_rom_pages_as_blobs( linput_t *li, uchar count );
 
 
-static char *get_mapper_name( uchar mapper );
-static void define_item( ushort address, asize_t size, char *shortdesc, char *comment );
-static ea_t get_vector( ea_t vec );
-static void name_vector( ushort address, const char *name );
-static bool add_entry_points( linput_t *li );
-static void set_ida_export_data( void );
-static void describe_rom_image( void );
 
-#endif // _NES_H
\ No newline at end of file
+#endif // _NES_H
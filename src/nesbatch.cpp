@@ -0,0 +1,525 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    nesbatch - runs the loader's header checks and bank planning
+    over whole ROM collections, without IDA, and writes one JSON
+    record per ROM image (JSON Lines).
+
+    usage: nesbatch [-t threads] [-f] [-d nesdb.bin] [-o out.jsonl] dir|file.nes [...]
+
+        -t  number of worker threads, all cores by default
+        -f  fix corrupt headers before planning
+        -d  use the known-good header from a ROM database
+        -o  write the records to a file instead of stdout
+
+    Directories are searched recursively for *.nes, *.unf and
+    *.unif files (UNIF images, see unif.h), and for *.zip and *.gz
+    archives holding one of them (see archive.h). Every
+    worker thread has its own queue of images, handed out in
+    contiguous runs at the start. A worker takes images from the
+    back of its own queue and, once that is empty, steals from the
+    front of the other queues, so a few large multicarts don't
+    leave the other threads idle. The records are written in the
+    order the images were found, the time taken goes to stderr.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <algorithm>
+
+#include "ines.h"
+#include "archive.h"
+#include "romdb.h"
+
+
+// a worker's share of the images, indexes into the path list
+typedef struct _work_queue_t {
+
+    std::mutex lock;
+    std::deque<long> items;
+
+} work_queue;
+
+
+// what every worker needs
+typedef struct _batch_t {
+
+    const std::vector<std::string> *paths;
+    std::vector<std::string> records;       // JSON record per path
+    work_queue *queues;
+    int threads;
+    bool fix;
+    const romdb *db;
+
+} batch;
+
+
+// JSON record being built
+typedef struct _json_buf_t {
+
+    std::string text;
+    const char *separator;                  // before the next member
+
+} json_buf;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for nesbatch.cpp
+//
+
+static void find_images( const char *path, std::vector<std::string> *paths );
+static void run_batch( batch *b );
+static void worker( batch *b, int self );
+static bool take_image( batch *b, int self, long *index );
+
+static void describe_image( const batch *b, const char *path, std::string *record );
+static bool get_vector( const ines_ctx *ctx, ushort address, ushort *vector );
+
+static void json_begin( json_buf *json, char open );
+static void json_end( json_buf *json, char close );
+static void json_key( json_buf *json, const char *key );
+static void json_string( json_buf *json, const char *key, const char *value );
+static void json_int( json_buf *json, const char *key, long long value );
+static void json_bool( json_buf *json, const char *key, bool value );
+static void json_printf( json_buf *json, const char *key, const char *format, ... );
+
+
+
+static double now_ms( void )
+{
+    return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      collects the ROM images below a directory, in sorted
+//      order, or takes the path itself if it is a file
+//
+static void find_images( const char *path, std::vector<std::string> *paths )
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::vector<std::string> found;
+
+    if( !fs::is_directory( path, ec ) )
+    {
+        paths->push_back( path );
+        return;
+    }
+
+    for( fs::recursive_directory_iterator it( path, fs::directory_options::skip_permission_denied, ec ), end;
+         !ec && it != end; it.increment( ec ) )
+    {
+        std::string ext = it->path().extension().string();
+
+        std::transform( ext.begin(), ext.end(), ext.begin(), []( unsigned char c ) { return (char)tolower( c ); } );
+        if( (ext == ".nes" || ext == ".unf" || ext == ".unif" || ext == ".zip" || ext == ".gz") && it->is_regular_file( ec ) )
+            found.push_back( it->path().string() );
+    }
+    if( ec )
+        fprintf( stderr, "%s: %s\n", path, ec.message().c_str() );
+
+    std::sort( found.begin(), found.end() );
+    paths->insert( paths->end(), found.begin(), found.end() );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      hands the images out in contiguous runs and runs the
+//      workers, the calling thread is one of them
+//
+static void run_batch( batch *b )
+{
+    long count = (long)b->paths->size();
+    std::vector<std::thread> workers;
+
+    b->records.resize( count );
+    b->queues = new work_queue[b->threads];
+    for( int t=0; t<b->threads; t++ )
+    {
+        long first = count * t / b->threads;
+        long last = count * (t + 1) / b->threads;
+
+        for( long i=first; i<last; i++ )
+            b->queues[t].items.push_back( i );
+    }
+
+    for( int t=1; t<b->threads; t++ )
+        workers.push_back( std::thread( worker, b, t ) );
+    worker( b, 0 );
+
+    for( size_t t=0; t<workers.size(); t++ )
+        workers[t].join();
+    delete[] b->queues;
+    b->queues = NULL;
+}
+
+static void worker( batch *b, int self )
+{
+    long index;
+
+    while( take_image( b, self, &index ) )
+        describe_image( b, (*b->paths)[index].c_str(), &b->records[index] );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      takes the next image from the back of the own queue or
+//      steals one from the front of another queue. returns false
+//      if all queues are empty. no images are added once the
+//      workers run, so empty queues stay empty
+//
+static bool take_image( batch *b, int self, long *index )
+{
+    {
+        work_queue *own = &b->queues[self];
+        std::lock_guard<std::mutex> guard( own->lock );
+
+        if( !own->items.empty() )
+        {
+            *index = own->items.back();
+            own->items.pop_back();
+            return true;
+        }
+    }
+
+    for( int i=1; i<b->threads; i++ )
+    {
+        work_queue *victim = &b->queues[(self + i) % b->threads];
+        std::lock_guard<std::mutex> guard( victim->lock );
+
+        if( !victim->items.empty() )
+        {
+            *index = victim->items.front();
+            victim->items.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      checks and plans a single image and builds its record
+//
+static void describe_image( const batch *b, const char *path, std::string *record )
+{
+    static const struct { ushort address; const char *name; } vectors[] =
+    {
+        { NMI_VECTOR_START_ADDRESS,   "nmi" },
+        { RESET_VECTOR_START_ADDRESS, "reset" },
+        { IRQ_VECTOR_START_ADDRESS,   "irq" }
+    };
+
+    rom_fingerprint fp;
+    const ines_hdr *known = NULL;
+    json_buf json;
+    ines_ctx ctx;
+    image_t img;
+    void *buffer;
+    bool corrupt, missing = false;
+    char sha1[2 * SHA1_SIZE + 1];
+
+    json_begin( &json, '{' );
+    json_string( &json, "path", path );
+
+    FILE *fp_in = fopen( path, "rb" );
+    if( fp_in == NULL || !image_map_file( &img, fp_in ) )
+    {
+        if( fp_in != NULL )
+            fclose( fp_in );
+        json_bool( &json, "ok", false );
+        json_string( &json, "error", "can't open file" );
+        json_end( &json, '}' );
+        *record = json.text;
+        return;
+    }
+    fclose( fp_in );
+
+    int archive = archive_kind( img.data, (size_t)img.size );
+    const char *error = rom_open( &img, &ctx, &buffer );
+    if( error != NULL )
+    {
+        image_release( &img );
+        free( buffer );
+        json_bool( &json, "ok", false );
+        json_string( &json, "error", error );
+        json_end( &json, '}' );
+        *record = json.text;
+        return;
+    }
+
+    romdb_fingerprint( &ctx, &fp );
+    if( b->db != NULL )
+        known = romdb_lookup( b->db, &fp );
+
+    corrupt = ines_is_corrupt_hdr( &ctx.hdr, ctx.file_size );
+    if( known != NULL )
+        ctx.hdr = *known;
+    else if( corrupt && b->fix )
+        ines_fix_hdr( &ctx.hdr );
+    ines_plan( &ctx );
+
+    for( int i=0; i<SHA1_SIZE; i++ )
+        snprintf( sha1 + 2 * i, 3, "%02x", fp.sha1[i] );
+    for( int i=0; i<ctx.bank_count; i++ )
+        if( ines_bank_data( &ctx, &ctx.banks[i] ) == NULL )
+            missing = true;
+
+    json_bool( &json, "ok", true );
+    json_string( &json, "format", ctx.board[0] != '\0' ? "UNIF" : ctx.nes20 ? "NES 2.0" : "iNES" );
+    if( ctx.board[0] != '\0' )
+        json_string( &json, "board", ctx.board );
+    if( archive != ARCHIVE_NONE )
+        json_string( &json, "archive", archive_kind_name( archive ) );
+    json_int( &json, "mapper", ctx.mapper );
+    json_string( &json, "mapper_name", ines_get_mapper_name( ctx.mapper ) );
+    json_bool( &json, "mapper_supported", ctx.mapper_supported );
+    json_int( &json, "submapper", ctx.submapper );
+    json_int( &json, "file_size", ctx.file_size );
+    json_int( &json, "prg_size", ctx.prg_size );
+    json_int( &json, "chr_size", ctx.chr_size );
+    json_int( &json, "prg_pages", ctx.prg_pages );
+    json_int( &json, "chr_pages", ctx.chr_pages );
+    json_int( &json, "prg_ram_size", ctx.prg_ram_size );
+    json_int( &json, "prg_nvram_size", ctx.prg_nvram_size );
+    json_int( &json, "chr_ram_size", ctx.chr_ram_size );
+    json_int( &json, "chr_nvram_size", ctx.chr_nvram_size );
+    json_bool( &json, "trainer", INES_MASK_TRAINER( ctx.hdr.rom_control_byte_0 ) != 0 );
+    json_bool( &json, "corrupt", corrupt );
+    json_bool( &json, "fixed", corrupt && b->fix && known == NULL );
+    if( b->db != NULL )
+        json_bool( &json, "known", known != NULL );
+    json_bool( &json, "banks_missing", missing );
+    json_printf( &json, "crc32", "\"%08x\"", fp.crc );
+    json_string( &json, "sha1", sha1 );
+
+    json_key( &json, "vectors" );
+    json_begin( &json, '{' );
+    for( size_t i=0; i<sizeof(vectors)/sizeof(vectors[0]); i++ )
+    {
+        ushort vector;
+
+        if( get_vector( &ctx, vectors[i].address, &vector ) )
+            json_int( &json, vectors[i].name, vector );
+        else
+            json_printf( &json, vectors[i].name, "null" );
+    }
+    json_end( &json, '}' );
+
+    // vectors pointing to code in the planned banks
+    int plausible = ines_check_vectors( &ctx, NULL );
+    json_key( &json, "plausible_vectors" );
+    json_begin( &json, '{' );
+    for( size_t i=0; i<sizeof(vectors)/sizeof(vectors[0]); i++ )
+        json_bool( &json, vectors[i].name, (plausible & (1 << i)) != 0 );
+    json_end( &json, '}' );
+
+    json_end( &json, '}' );
+    *record = json.text;
+    image_release( &img );
+    free( buffer );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      reads a vector from the bank planned at its address
+//
+static bool get_vector( const ines_ctx *ctx, ushort address, ushort *vector )
+{
+    for( int i=0; i<ctx->bank_count; i++ )
+    {
+        const ines_bank *bank = &ctx->banks[i];
+        const uchar *data;
+
+        if( bank->kind == INES_BANK_CHR_8K || address < bank->address || address + 2 > bank->address + bank->size )
+            continue;
+
+        data = ines_bank_data( ctx, bank );
+        if( data == NULL )
+            return false;
+        *vector = (ushort)(data[address - bank->address] | (data[address - bank->address + 1] << 8));
+        return true;
+    }
+    return false;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      JSON output, just what the records need
+//
+static void json_begin( json_buf *json, char open )
+{
+    json->text += open;
+    json->separator = "";
+}
+
+static void json_end( json_buf *json, char close )
+{
+    json->text += close;
+    json->separator = ",";
+}
+
+static void json_key( json_buf *json, const char *key )
+{
+    json->text += json->separator;
+    json->text += '"';
+    json->text += key;
+    json->text += "\":";
+    json->separator = ",";
+}
+
+static void json_string( json_buf *json, const char *key, const char *value )
+{
+    json_key( json, key );
+    json->text += '"';
+    for( const uchar *p=(const uchar *)value; *p != '\0'; p++ )
+    {
+        char escape[8];
+
+        if( *p == '"' || *p == '\\' )
+        {
+            json->text += '\\';
+            json->text += (char)*p;
+        }
+        else if( *p < 0x20 )
+        {
+            snprintf( escape, sizeof(escape), "\\u%04x", *p );
+            json->text += escape;
+        }
+        else
+            json->text += (char)*p;
+    }
+    json->text += '"';
+}
+
+static void json_int( json_buf *json, const char *key, long long value )
+{
+    json_printf( json, key, "%lld", value );
+}
+
+static void json_bool( json_buf *json, const char *key, bool value )
+{
+    json_printf( json, key, value ? "true" : "false" );
+}
+
+static void json_printf( json_buf *json, const char *key, const char *format, ... )
+{
+    char value[64];
+    va_list va;
+
+    va_start( va, format );
+    vsnprintf( value, sizeof(value), format, va );
+    va_end( va );
+
+    json_key( json, key );
+    json->text += value;
+}
+
+
+
+int main( int argc, char **argv )
+{
+    std::vector<std::string> paths;
+    const char *dbpath = NULL;
+    const char *outpath = NULL;
+    romdb db;
+    batch b;
+    FILE *out = stdout;
+    double t;
+    int i = 1;
+
+    // hardware_concurrency() is 0 if the number of cores isn't known
+    b.threads = std::thread::hardware_concurrency();
+    if( b.threads < 1 )
+        b.threads = 1;
+    b.fix = false;
+    b.db = NULL;
+    b.queues = NULL;
+
+    for( ; i<argc && argv[i][0] == '-'; i++ )
+    {
+        if( strcmp( argv[i], "-t" ) == 0 && i + 1 < argc )
+            b.threads = atoi( argv[++i] );
+        else if( strcmp( argv[i], "-f" ) == 0 )
+            b.fix = true;
+        else if( strcmp( argv[i], "-d" ) == 0 && i + 1 < argc )
+            dbpath = argv[++i];
+        else if( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc )
+            outpath = argv[++i];
+        else
+            break;
+    }
+
+    if( i >= argc || argv[i][0] == '-' || b.threads < 1 )
+    {
+        fprintf( stderr, "usage: %s [-t threads] [-f] [-d nesdb.bin] [-o out.jsonl] dir|file.nes [...]\n", argv[0] );
+        return 2;
+    }
+
+    if( dbpath != NULL )
+    {
+        if( !romdb_open( &db, dbpath ) )
+        {
+            fprintf( stderr, "%s: not a ROM database\n", dbpath );
+            return 1;
+        }
+        b.db = &db;
+    }
+
+    if( outpath != NULL && (out = fopen( outpath, "w" )) == NULL )
+    {
+        fprintf( stderr, "%s: can't write file\n", outpath );
+        return 1;
+    }
+
+    for( ; i<argc; i++ )
+        find_images( argv[i], &paths );
+    b.paths = &paths;
+
+    t = now_ms();
+    run_batch( &b );
+    t = now_ms() - t;
+
+    for( size_t n=0; n<b.records.size(); n++ )
+        fprintf( out, "%s\n", b.records[n].c_str() );
+    if( out != stdout )
+        fclose( out );
+
+    fprintf( stderr, "%ld images in %.1f ms with %d threads (%.0f images/s)\n",
+             (long)paths.size(), t, b.threads, t > 0 ? paths.size() * 1000.0 / t : 0.0 );
+
+    if( b.db != NULL )
+        romdb_close( &db );
+    return 0;
+}
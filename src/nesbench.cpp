@@ -0,0 +1,274 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    nesbench - compares the raw and the compressed page blob
+    layout for iNES ROM images, without IDA.
+
+    usage: nesbench [-t threads] [-n runs] file.nes [file.nes ...]
+
+    For every image the unique pages are collected like the loader
+    does it, then copied (raw layout) resp. compressed with lz.cpp
+    (compressed layout) the given number of times. The best time
+    of all runs and the number of bytes that end up in blobs are
+    printed, followed by the totals over all images.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "ines.h"
+#include "hash.h"
+#include "lz.h"
+
+
+// unique pages of an image
+typedef struct _page_set_t {
+
+    int count;
+    const uchar **data;                     // room for trainer, PRG and CHR pages
+    long *size;
+    crc32_t *hash;
+
+} page_set;
+
+
+// results of one image
+typedef struct _bench_result_t {
+
+    long raw_bytes;
+    long packed_bytes;
+    double copy_ms;                         // raw layout
+    double pack_ms;                         // single thread
+    double pack_mt_ms;                      // worker threads
+    double unpack_ms;
+
+} bench_result;
+
+
+
+static double now_ms( void )
+{
+    return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      adds a page unless a page with the same contents is present
+//
+static void add_unique_page( page_set *set, const uchar *data, long size )
+{
+    crc32_t hash;
+
+    if( data == NULL )
+        return;
+
+    hash = hash_crc32( 0, data, size );
+    for( int i=0; i<set->count; i++ )
+        if( set->hash[i] == hash && set->size[i] == size && memcmp( set->data[i], data, size ) == 0 )
+            return;
+
+    set->data[set->count] = data;
+    set->size[set->count] = size;
+    set->hash[set->count] = hash;
+    set->count++;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      runs the benchmark on the unique pages of one image
+//
+static void bench_pages( const page_set *set, int threads, int runs, bench_result *res )
+{
+    lz_job *jobs = (lz_job *)malloc( (set->count + 1) * sizeof(lz_job) );
+    size_t bound = 0;
+    int i, r;
+
+    memset( res, 0, sizeof(*res) );
+    for( i=0; i<set->count; i++ )
+    {
+        res->raw_bytes += set->size[i];
+        bound += lz_bound( set->size[i] );
+    }
+
+    uchar *raw = (uchar *)malloc( res->raw_bytes + 1 );
+    uchar *packed = (uchar *)malloc( bound + 1 );
+    uchar *unpacked = (uchar *)malloc( PRG_PAGE_SIZE );
+
+    res->copy_ms = res->pack_ms = res->pack_mt_ms = res->unpack_ms = 1e30;
+    for( r=0; r<runs; r++ )
+    {
+        double t;
+        uchar *dst;
+
+        // raw layout: every unique page is copied into the blob once
+        t = now_ms();
+        dst = raw;
+        for( i=0; i<set->count; i++ )
+        {
+            memcpy( dst, set->data[i], set->size[i] );
+            dst += set->size[i];
+        }
+        t = now_ms() - t;
+        if( t < res->copy_ms )
+            res->copy_ms = t;
+
+        dst = packed;
+        for( i=0; i<set->count; i++ )
+        {
+            jobs[i].src = set->data[i];
+            jobs[i].size = set->size[i];
+            jobs[i].dst = dst;
+            dst += lz_bound( set->size[i] );
+        }
+
+        t = now_ms();
+        lz_compress_jobs( jobs, set->count, 1 );
+        t = now_ms() - t;
+        if( t < res->pack_ms )
+            res->pack_ms = t;
+
+        t = now_ms();
+        lz_compress_jobs( jobs, set->count, threads );
+        t = now_ms() - t;
+        if( t < res->pack_mt_ms )
+            res->pack_mt_ms = t;
+
+        t = now_ms();
+        for( i=0; i<set->count; i++ )
+        {
+            if( jobs[i].packed != 0 && jobs[i].packed < (size_t)set->size[i] &&
+                !lz_decompress( jobs[i].dst, jobs[i].packed, unpacked, set->size[i] ) )
+            {
+                fprintf( stderr, "page %d doesn't decompress!\n", i );
+                exit( 1 );
+            }
+        }
+        t = now_ms() - t;
+        if( t < res->unpack_ms )
+            res->unpack_ms = t;
+    }
+
+    // pages that don't shrink are stored raw by the loader
+    for( i=0; i<set->count; i++ )
+        res->packed_bytes += jobs[i].packed != 0 && jobs[i].packed < (size_t)set->size[i] ? jobs[i].packed : set->size[i];
+
+    free( jobs );
+    free( raw );
+    free( packed );
+    free( unpacked );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      benchmarks a single ROM image
+//
+static bool bench_image( const char *path, int threads, int runs, bench_result *res )
+{
+    page_set set;
+    ines_ctx ctx;
+    image_t img;
+    int i, max_pages;
+
+    FILE *fp = fopen( path, "rb" );
+    if( fp == NULL || !image_map_file( &img, fp ) )
+    {
+        fprintf( stderr, "%s: can't open file\n", path );
+        if( fp != NULL )
+            fclose( fp );
+        return false;
+    }
+    fclose( fp );
+
+    if( !ines_init( &ctx, &img ) )
+    {
+        fprintf( stderr, "%s: not an iNES ROM image\n", path );
+        image_release( &img );
+        return false;
+    }
+
+    max_pages = 1 + ctx.prg_pages + ctx.chr_pages;
+    set.count = 0;
+    set.data = (const uchar **)malloc( max_pages * sizeof(const uchar *) );
+    set.size = (long *)malloc( max_pages * sizeof(long) );
+    set.hash = (crc32_t *)malloc( max_pages * sizeof(crc32_t) );
+
+    add_unique_page( &set, ines_trainer( &ctx ), TRAINER_SIZE );
+    for( i=0; i<ctx.prg_pages; i++ )
+        add_unique_page( &set, ines_prg_page( &ctx, i ), PRG_PAGE_SIZE );
+    for( i=0; i<ctx.chr_pages; i++ )
+        add_unique_page( &set, ines_chr_page( &ctx, i ), CHR_PAGE_SIZE );
+
+    bench_pages( &set, threads, runs, res );
+
+    printf( "%-40s %9ld %9ld %5.1f%% %8.3f %8.3f %8.3f %8.3f\n", path,
+            res->raw_bytes, res->packed_bytes, res->raw_bytes ? 100.0 * res->packed_bytes / res->raw_bytes : 0.0,
+            res->copy_ms, res->pack_ms, res->pack_mt_ms, res->unpack_ms );
+
+    free( (void *)set.data );
+    free( set.size );
+    free( set.hash );
+    image_release( &img );
+    return true;
+}
+
+
+
+int main( int argc, char **argv )
+{
+    bench_result total, res;
+    int threads = std::thread::hardware_concurrency();
+    int runs = 5;
+    int i = 1;
+
+    for( ; i + 1 < argc && argv[i][0] == '-'; i += 2 )
+    {
+        if( strcmp( argv[i], "-t" ) == 0 )
+            threads = atoi( argv[i+1] );
+        else if( strcmp( argv[i], "-n" ) == 0 )
+            runs = atoi( argv[i+1] );
+        else
+            break;
+    }
+
+    if( i >= argc || threads < 1 || runs < 1 )
+    {
+        fprintf( stderr, "usage: %s [-t threads] [-n runs] file.nes [file.nes ...]\n", argv[0] );
+        return 2;
+    }
+
+    printf( "%-40s %9s %9s %6s %8s %8s %8s %8s\n", "image", "raw", "packed", "ratio", "copy ms", "lz ms", "lz*N ms", "unlz ms" );
+
+    memset( &total, 0, sizeof(total) );
+    for( ; i<argc; i++ )
+    {
+        if( !bench_image( argv[i], threads, runs, &res ) )
+            continue;
+        total.raw_bytes += res.raw_bytes;
+        total.packed_bytes += res.packed_bytes;
+        total.copy_ms += res.copy_ms;
+        total.pack_ms += res.pack_ms;
+        total.pack_mt_ms += res.pack_mt_ms;
+        total.unpack_ms += res.unpack_ms;
+    }
+
+    printf( "%-40s %9ld %9ld %5.1f%% %8.3f %8.3f %8.3f %8.3f\n", "total",
+            total.raw_bytes, total.packed_bytes, total.raw_bytes ? 100.0 * total.packed_bytes / total.raw_bytes : 0.0,
+            total.copy_ms, total.pack_ms, total.pack_mt_ms, total.unpack_ms );
+    printf( "(N = %d threads, best of %d runs)\n", threads, runs );
+    return 0;
+}
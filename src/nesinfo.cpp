@@ -0,0 +1,526 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    nesinfo - prints the segment and bank plan the loader
+    would use for iNES ROM images, without IDA.
+
+    usage: nesinfo [-f] [-o] [-i] [-b] [-g] [-t] [-c png|ppm] [-d nesdb.bin] file.nes [file.nes ...]
+           nesinfo -w nesdb.bin file.nes [file.nes ...]
+
+        -f  fix corrupt headers before planning, just like
+            answering "yes" in the loader's dialog
+        -o  print the PRG overlays (NESLDR=overlays) as well
+        -i  print the I/O register access index (see ioscan.h)
+        -b  print the bank switches (see bankswitch.h)
+        -g  print the cross-bank call graph, the callers of
+            every JSR/JMP target (see callscan.h)
+        -t  print the far-call trampolines and the banks and
+            targets of their calls (see farcall.h)
+        -c  write the CHR-ROM tile sheet of every image to
+            file.nes.chr.png resp. file.nes.chr.ppm (see chr.h)
+        -d  use the known-good header from a ROM database
+            if the image is listed there
+        -w  write a ROM database holding the headers of the
+            given (known-good) images
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ines.h"
+#include "archive.h"
+#include "romdb.h"
+#include "chr.h"
+#include "ioscan.h"
+#include "bankswitch.h"
+#include "callscan.h"
+#include "farcall.h"
+
+
+#define YES_NO( condition ) ( condition ? "yes" : "no" )
+
+
+static const char *bank_kind_names[] = { "PRG-ROM 16k", "PRG-ROM 8k", "CHR-ROM 8k" };
+static const char *access_kind_names[] = { "", "read", "write", "r/w" };
+
+
+
+//----------------------------------------------------------------------
+//
+//      maps an image and initializes its context, '*buffer' has to
+//      be free()d after image_release() (see rom_open())
+//
+static bool open_rom( const char *path, ines_ctx *ctx, image_t *img, void **buffer )
+{
+    FILE *fp = fopen( path, "rb" );
+    const char *error;
+
+    *buffer = NULL;
+    if( fp == NULL || !image_map_file( img, fp ) )
+    {
+        fprintf( stderr, "%s: can't open file\n", path );
+        if( fp != NULL )
+            fclose( fp );
+        return false;
+    }
+    fclose( fp );
+
+    error = rom_open( img, ctx, buffer );
+    if( error != NULL )
+    {
+        fprintf( stderr, "%s: %s\n", path, error );
+        image_release( img );
+        free( *buffer );
+        *buffer = NULL;
+        return false;
+    }
+    return true;
+}
+
+
+
+static void print_sha1( const uchar *sha1 )
+{
+    for( int i=0; i<SHA1_SIZE; i++ )
+        printf( "%02x", sha1[i] );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      prints the accesses of every register, with the flags
+//      written where they are known
+//
+static void print_ioregs( const ines_ctx *ctx )
+{
+    ioscan_index index;
+    clock_t start = clock();
+    double ms;
+
+    if( !ioscan_image( ctx, &index ) )
+    {
+        printf( "  I/O register accesses   : out of memory\n" );
+        return;
+    }
+    ms = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    printf( "  I/O register accesses   : %ld in %d PRG pages (%.3f ms, %.3f ms per page)\n",
+            index.count, index.pages, ms, index.pages ? ms / index.pages : 0.0 );
+    for( int r=0; r<IOSCAN_REG_COUNT; r++ )
+    {
+        ushort address = ioscan_reg_address( r );
+        const char *name = ioscan_reg_name( address );
+
+        if( index.first[r] == index.first[r + 1] )
+            continue;
+        printf( "    %04x %-12s %ld\n", address, name != NULL ? name : "", index.first[r + 1] - index.first[r] );
+
+        for( long i=index.first[r]; i<index.first[r + 1]; i++ )
+        {
+            const ioscan_access *access = &index.accesses[i];
+            char flags[256];
+
+            if( access->value != IOSCAN_NO_VALUE && ioscan_describe_value( address, (uchar)access->value, flags, sizeof(flags) ) )
+                printf( "      %08x %-5s %s\n", access->offset, access_kind_names[access->kind], flags );
+            else if( access->value != IOSCAN_NO_VALUE )
+                printf( "      %08x %-5s $%02X\n", access->offset, access_kind_names[access->kind], access->value );
+            else
+                printf( "      %08x %s\n", access->offset, access_kind_names[access->kind] );
+        }
+    }
+    ioscan_free( &index );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      prints the bank switches found in PRG-ROM
+//
+static void print_switches( const ines_ctx *ctx )
+{
+    bankswitch_list list;
+    clock_t start = clock();
+    double ms;
+
+    if( !bankswitch_scan( ctx, &list ) )
+    {
+        printf( "  bank switches           : out of memory\n" );
+        return;
+    }
+    ms = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    printf( "  bank switches           : %ld (%.3f ms)\n", list.count, ms );
+    for( long i=0; i<list.count; i++ )
+    {
+        char text[256];
+
+        bankswitch_describe( ctx, &list.switches[i], text, sizeof(text) );
+        printf( "    %08x %s\n", list.switches[i].offset, text );
+    }
+    bankswitch_free( &list );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      prints the JSR/JMP targets of all PRG banks and their
+//      callers as bank:address, '*' for a bank that isn't known
+//
+static void print_bank_address( unsigned int key )
+{
+    if( INES_CALLS_KEY_BANK( key ) == INES_CALLS_ANY_BANK )
+        printf( "*:%04x", INES_CALLS_KEY_ADDRESS( key ) );
+    else
+        printf( "%u:%04x", INES_CALLS_KEY_BANK( key ), INES_CALLS_KEY_ADDRESS( key ) );
+}
+
+static void print_calls( const ines_ctx *ctx )
+{
+    callscan_graph graph;
+    clock_t start = clock();
+    double ms;
+
+    if( !callscan_image( ctx, &graph ) )
+    {
+        printf( "  call graph              : out of memory\n" );
+        return;
+    }
+    ms = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    printf( "  call graph              : %ld JSR/JMP to %ld targets in %d %ldk banks, %ld into other banks (%.3f ms)\n",
+            graph.count, graph.target_count, graph.banks, graph.bank_size / 1024, graph.cross, ms );
+    for( long t=0; t<graph.target_count; t++ )
+    {
+        printf( "    " );
+        print_bank_address( graph.targets[t] );
+        printf( " %ld:", graph.first[t + 1] - graph.first[t] );
+        for( long i=graph.first[t]; i<graph.first[t + 1]; i++ )
+        {
+            printf( " " );
+            print_bank_address( graph.refs[i].from );
+        }
+        printf( "\n" );
+    }
+    callscan_free( &graph );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      prints the far-call trampolines and their calls
+//
+static void print_farcalls( const ines_ctx *ctx )
+{
+    bankswitch_list switches;
+    farcall_list list;
+    clock_t start;
+    double ms;
+    bool ok;
+
+    if( !bankswitch_scan( ctx, &switches ) )
+    {
+        printf( "  far calls               : out of memory\n" );
+        return;
+    }
+    start = clock();
+    ok = farcall_scan( ctx, &switches, &list );
+    ms = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+    bankswitch_free( &switches );
+    if( !ok )
+    {
+        printf( "  far calls               : out of memory\n" );
+        return;
+    }
+
+    printf( "  far calls               : %d trampolines, %ld calls (%.3f ms)\n", list.stub_count, list.count, ms );
+    for( int s=0; s<list.stub_count; s++ )
+    {
+        char text[256];
+
+        farcall_describe_stub( &list.stubs[s], text, sizeof(text) );
+        printf( "    %08x %04x %s\n", list.stubs[s].offset, list.stubs[s].address, text );
+    }
+    for( long i=0; i<list.count; i++ )
+    {
+        char text[256];
+
+        farcall_describe( &list, &list.calls[i], text, sizeof(text) );
+        printf( "    %08x %s\n", list.calls[i].offset, text );
+    }
+    farcall_free( &list );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      prints the plan of a single ROM image, 'sheet' is the
+//      CHR_SHEET_... format of the tile sheet to write or -1
+//
+static bool print_plan( const char *path, bool fix, bool overlays, bool ioregs, bool switches, bool calls, bool farcalls, int sheet, const romdb *db )
+{
+    rom_fingerprint fp;
+    const ines_hdr *known = NULL;
+    ines_ctx ctx;
+    image_t img;
+    void *buffer;
+    bool corrupt;
+    int i;
+
+    if( !open_rom( path, &ctx, &img, &buffer ) )
+        return false;
+
+    romdb_fingerprint( &ctx, &fp );
+    if( db != NULL )
+        known = romdb_lookup( db, &fp );
+
+    corrupt = ines_is_corrupt_hdr( &ctx.hdr, ctx.file_size );
+    if( known != NULL )
+        ctx.hdr = *known;
+    else if( corrupt && fix )
+        ines_fix_hdr( &ctx.hdr );
+
+    ines_plan( &ctx );
+
+    printf( "%s\n", path );
+    printf( "  file size               : %lld\n", ctx.file_size );
+    printf( "  corrupt header          : %s%s\n", YES_NO( corrupt ), corrupt && fix && known == NULL ? " (fixed)" : "" );
+    printf( "  CRC32                   : %08x\n", fp.crc );
+    printf( "  SHA-1                   : " );
+    print_sha1( fp.sha1 );
+    printf( "\n" );
+    if( db != NULL )
+        printf( "  ROM database            : %s\n", known != NULL ? "known, header taken from database" : "unknown" );
+    printf( "  header format           : %s\n", ctx.board[0] != '\0' ? "UNIF" : ctx.nes20 ? "NES 2.0" : "iNES" );
+    if( ctx.board[0] != '\0' )
+        printf( "  board                   : %s\n", ctx.board );
+    printf( "  16K PRG-ROM page count  : %d\n", ctx.prg_pages );
+    printf( "  8K CHR-ROM page count   : %d\n", ctx.chr_pages );
+    printf( "  512-byte trainer        : %s\n", YES_NO( INES_MASK_TRAINER(ctx.hdr.rom_control_byte_0) ) );
+    printf( "  mapper                  : %s (Mapper #%d)%s\n", ines_get_mapper_name( ctx.mapper ), ctx.mapper,
+            ctx.mapper_supported ? "" : ", not supported" );
+    if( ctx.nes20 )
+    {
+        printf( "  submapper               : %d\n", ctx.submapper );
+        printf( "  PRG-RAM/NVRAM size      : %ld/%ld bytes\n", ctx.prg_ram_size, ctx.prg_nvram_size );
+        printf( "  CHR-RAM/NVRAM size      : %ld/%ld bytes\n", ctx.chr_ram_size, ctx.chr_nvram_size );
+    }
+
+    printf( "  segments:\n" );
+    for( i=0; i<ctx.segment_count; i++ )
+    {
+        const ines_segment *seg = &ctx.segments[i];
+        unsigned long base = seg->base << 4;
+
+        printf( "    %-8s %04lx-%04lx %s\n", seg->name, seg->start - base, seg->end - base,
+                seg->base ? "PPU" : seg->sclass ? seg->sclass : "" );
+    }
+
+    printf( "  banks:\n" );
+    for( i=0; i<ctx.bank_count; i++ )
+    {
+        const ines_bank *bank = &ctx.banks[i];
+        printf( "    %-11s page %02u to %04x-%04llx (file offset %08llx)%s\n",
+                bank_kind_names[bank->kind], bank->banknr, bank->address, bank->address + bank->size, bank->offset,
+                ines_bank_data( &ctx, bank ) == NULL ? " beyond end of file!" : "" );
+    }
+
+    ushort vectors[INES_VECTOR_COUNT];
+    int plausible = ines_check_vectors( &ctx, vectors );
+    printf( "  vectors                 : NMI %04x%s, RESET %04x%s, IRQ %04x%s\n",
+            vectors[INES_VECTOR_NMI], plausible & (1 << INES_VECTOR_NMI) ? "" : " (no code)",
+            vectors[INES_VECTOR_RESET], plausible & (1 << INES_VECTOR_RESET) ? "" : " (no code)",
+            vectors[INES_VECTOR_IRQ], plausible & (1 << INES_VECTOR_IRQ) ? "" : " (no code)" );
+    if( !ctx.mapper_supported )
+    {
+        if( ctx.vectors.bank >= 0 )
+            printf( "  vector scan             : 8k bank %ld, fixed %ldk window, %d plausible vectors, %ld candidates\n",
+                    ctx.vectors.bank, ctx.vectors.window / 1024, ctx.vectors.plausible, ctx.vectors.candidates );
+        else
+            printf( "  vector scan             : no bank with plausible vectors\n" );
+    }
+
+    if( overlays )
+    {
+        ines_plan_overlays( &ctx );
+        printf( "  overlays:\n" );
+        for( i=0; i<ctx.overlay_count; i++ )
+        {
+            ines_bank bank;
+
+            ines_get_overlay( &ctx, i, &bank );
+            printf( "    BANK%03d     page %02u to %08lx-%08lx (file offset %08llx)%s\n",
+                    i, bank.banknr, INES_OVERLAY_EA( i, bank.address ), INES_OVERLAY_EA( i, bank.address ) + (unsigned long)bank.size,
+                    bank.offset, ines_bank_data( &ctx, &bank ) == NULL ? " beyond end of file!" : "" );
+        }
+    }
+
+    if( ioregs )
+        print_ioregs( &ctx );
+    if( switches )
+        print_switches( &ctx );
+    if( calls )
+        print_calls( &ctx );
+    if( farcalls )
+        print_farcalls( &ctx );
+
+    if( sheet >= 0 )
+    {
+        char sheet_path[1024];
+        long tiles;
+
+        snprintf( sheet_path, sizeof(sheet_path), "%s.chr.%s", path, sheet == CHR_SHEET_PPM ? "ppm" : "png" );
+        tiles = chr_write_sheet( &ctx, sheet_path, sheet );
+        if( tiles < 0 )
+            printf( "  CHR tile sheet          : can't write %s\n", sheet_path );
+        else if( tiles == 0 )
+            printf( "  CHR tile sheet          : no CHR-ROM\n" );
+        else
+            printf( "  CHR tile sheet          : %s (%ld tiles, %s)\n", sheet_path, tiles, chr_decoder_name() );
+    }
+
+    image_release( &img );
+    free( buffer );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes a ROM database from the headers of the given images
+//
+static bool write_db( const char *dbpath, char **paths, int count )
+{
+    rom_fingerprint *fps = (rom_fingerprint *)malloc( (count + 1) * sizeof(rom_fingerprint) );
+    ines_hdr *hdrs = (ines_hdr *)malloc( (count + 1) * sizeof(ines_hdr) );
+    long n = 0;
+    bool ok;
+
+    if( fps == NULL || hdrs == NULL )
+    {
+        free( fps );
+        free( hdrs );
+        return false;
+    }
+
+    for( int i=0; i<count; i++ )
+    {
+        ines_ctx ctx;
+        image_t img;
+        void *buffer;
+
+        if( !open_rom( paths[i], &ctx, &img, &buffer ) )
+            continue;
+
+        romdb_fingerprint( &ctx, &fps[n] );
+        hdrs[n] = ctx.hdr;
+        printf( "%08x ", fps[n].crc );
+        print_sha1( fps[n].sha1 );
+        printf( " %s%s\n", paths[i], ines_is_corrupt_hdr( &ctx.hdr, ctx.file_size ) ? " (corrupt header, stored anyway)" : "" );
+        n++;
+
+        image_release( &img );
+        free( buffer );
+    }
+
+    ok = romdb_write( dbpath, fps, hdrs, n );
+    if( !ok )
+        fprintf( stderr, "%s: can't write database\n", dbpath );
+
+    free( fps );
+    free( hdrs );
+    return ok;
+}
+
+
+
+int main( int argc, char **argv )
+{
+    const char *dbpath = NULL;
+    const char *outpath = NULL;
+    romdb db, *pdb = NULL;
+    bool fix = false;
+    bool overlays = false;
+    bool ioregs = false;
+    bool switches = false;
+    bool calls = false;
+    bool farcalls = false;
+    int sheet = -1;
+    int failed = 0;
+    int i = 1;
+
+    for( ; i<argc && argv[i][0] == '-'; i++ )
+    {
+        if( strcmp( argv[i], "-f" ) == 0 )
+            fix = true;
+        else if( strcmp( argv[i], "-o" ) == 0 )
+            overlays = true;
+        else if( strcmp( argv[i], "-i" ) == 0 )
+            ioregs = true;
+        else if( strcmp( argv[i], "-b" ) == 0 )
+            switches = true;
+        else if( strcmp( argv[i], "-g" ) == 0 )
+            calls = true;
+        else if( strcmp( argv[i], "-t" ) == 0 )
+            farcalls = true;
+        else if( strcmp( argv[i], "-c" ) == 0 && i + 1 < argc && strcmp( argv[i+1], "png" ) == 0 )
+        {
+            sheet = CHR_SHEET_PNG;
+            i++;
+        }
+        else if( strcmp( argv[i], "-c" ) == 0 && i + 1 < argc && strcmp( argv[i+1], "ppm" ) == 0 )
+        {
+            sheet = CHR_SHEET_PPM;
+            i++;
+        }
+        else if( strcmp( argv[i], "-d" ) == 0 && i + 1 < argc )
+            dbpath = argv[++i];
+        else if( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc )
+            outpath = argv[++i];
+        else
+            break;
+    }
+
+    if( i >= argc || (i < argc && argv[i][0] == '-') )
+    {
+        fprintf( stderr, "usage: %s [-f] [-o] [-i] [-b] [-g] [-t] [-c png|ppm] [-d nesdb.bin] file.nes [file.nes ...]\n"
+                         "       %s -w nesdb.bin file.nes [file.nes ...]\n", argv[0], argv[0] );
+        return 2;
+    }
+
+    if( outpath != NULL )
+        return write_db( outpath, argv + i, argc - i ) ? 0 : 1;
+
+    if( dbpath != NULL )
+    {
+        if( !romdb_open( &db, dbpath ) )
+        {
+            fprintf( stderr, "%s: not a ROM database\n", dbpath );
+            return 1;
+        }
+        pdb = &db;
+    }
+
+    for( ; i<argc; i++ )
+    {
+        if( !print_plan( argv[i], fix, overlays, ioregs, switches, calls, farcalls, sheet, pdb ) )
+            failed++;
+    }
+
+    if( pdb != NULL )
+        romdb_close( pdb );
+    return failed ? 1 : 0;
+}
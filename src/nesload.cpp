@@ -0,0 +1,279 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    nesload - runs the loader (nes.cpp) on iNES ROM images against
+    the in-memory IDA stand-in (idastub/) and measures the loads.
+
+    usage: nesload [-n runs] [-r] [-s] [-v] file.nes [file.nes ...]
+
+        -n  number of loads per image, the best time is printed
+        -r  open the images as remote inputs, i.e. without a FILE
+            the loader could map, so it has to qlread() them
+        -s  after loading, swap every PRG bank into the window at
+            $8000 (bankswap.h) and print the time and the bytes
+            rewritten per swap
+        -v  print the loader's messages of the first load
+
+    The loader options are taken from NESLDR as in IDA, the ROM
+    database from $IDADIR/loaders/nesdb.bin. For every image the
+    load time, the bytes copied (read from the input, loaded into
+    segments and stored in netnodes) and the heap allocations made
+    by the loader are printed, the latter two from the last load.
+    Allocations made inside the stand-in are counted separately
+    ("db allocs"). Heap allocations can only be counted with glibc,
+    whose malloc() is wrapped here.
+
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <atomic>
+
+#include "idastub/idastub.h"
+#include "bankswap.h"
+
+
+extern loader_t LDSC;
+
+
+// results of one image
+typedef struct _load_result_t {
+
+    double load_ms;                         // best of all runs
+    long long copied;
+    long allocs;                            // by the loader
+    long long alloc_bytes;
+    long db_allocs;                         // by the stand-in
+
+} load_result;
+
+
+// heap allocations while a load runs
+static std::atomic<bool> counting( false );
+static std::atomic<long> loader_allocs( 0 );
+static std::atomic<long long> loader_alloc_bytes( 0 );
+static std::atomic<long> db_allocs( 0 );
+
+
+
+static double now_ms( void )
+{
+    return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      counts heap allocations by wrapping glibc's malloc().
+//      operator new ends up here as well
+//
+static inline void count_alloc( size_t size )
+{
+    if( !counting.load( std::memory_order_relaxed ) )
+        return;
+    if( idastub_depth > 0 )
+        db_allocs++;
+    else
+    {
+        loader_allocs++;
+        loader_alloc_bytes += size;
+    }
+}
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc( size_t size );
+extern "C" void *__libc_calloc( size_t count, size_t size );
+extern "C" void *__libc_realloc( void *ptr, size_t size );
+extern "C" void __libc_free( void *ptr );
+
+extern "C" void *malloc( size_t size )
+{
+    count_alloc( size );
+    return __libc_malloc( size );
+}
+
+extern "C" void *calloc( size_t count, size_t size )
+{
+    count_alloc( count * size );
+    return __libc_calloc( count, size );
+}
+
+extern "C" void *realloc( void *ptr, size_t size )
+{
+    count_alloc( size );
+    return __libc_realloc( ptr, size );
+}
+
+extern "C" void free( void *ptr )
+{
+    __libc_free( ptr );
+}
+#endif
+
+
+
+//----------------------------------------------------------------------
+//
+//      swaps all PRG banks through the window at $8000 of the
+//      loaded image, ending with the bank loaded first
+//
+static void swap_banks( void )
+{
+    ines_swap_result res;
+    uval_t size, first, banks;
+    long long bytes = 0;
+    ea_t window;
+    double t;
+
+    if( !ines_get_resident_bank( ROM_START_ADDRESS, &window, &size, &first ) )
+    {
+        printf( "  no PRG bank window at $8000\n" );
+        return;
+    }
+
+    banks = 0;
+    while( ines_find_page( INES_PAGE_PRG, banks ) >= 0 )
+        banks++;
+    banks *= PRG_PAGE_SIZE / size;
+
+    t = now_ms();
+    for( uval_t b=0; b<=banks; b++ )
+    {
+        if( !ines_swap_prg_bank( window, b < banks ? b : first, &res ) )
+        {
+            printf( "  swapping %uk PRG bank %u failed\n", size / 1024, b );
+            return;
+        }
+        bytes += res.bytes;
+    }
+    t = now_ms() - t;
+
+    printf( "  %u swaps of %uk PRG banks into $%04X: %.3f ms, %lld of %u bytes rewritten per swap\n",
+            banks + 1, size / 1024, window, t / (banks + 1), bytes / (banks + 1), size );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      loads an image 'runs' times into an empty database
+//
+static bool load_image( const char *path, int runs, bool remote, bool swap, bool verbose, load_result *res )
+{
+    idastub_stats stats;
+    char idb[QMAXPATH];
+
+    memset( res, 0, sizeof(*res) );
+    res->load_ms = 1e30;
+    set_file_ext( idb, sizeof(idb), path, "idb" );
+
+    for( int r=0; r<runs; r++ )
+    {
+        linput_t *li;
+        bool ok;
+        double t;
+
+        idastub_reset();
+        li = open_linput( path, remote );
+        if( li == NULL )
+        {
+            fprintf( stderr, "%s: can't open file\n", path );
+            return false;
+        }
+
+        idastub_quiet = !(verbose && r == 0);
+        loader_allocs = 0;
+        loader_alloc_bytes = 0;
+        db_allocs = 0;
+
+        counting = true;
+        t = now_ms();
+        ok = idastub_load( &LDSC, li, idb );
+        t = now_ms() - t;
+        counting = false;
+
+        close_linput( li );
+        if( !ok )
+        {
+            fprintf( stderr, "%s: not loaded\n", path );
+            idastub_reset();
+            return false;
+        }
+        if( t < res->load_ms )
+            res->load_ms = t;
+    }
+
+    idastub_get_stats( &stats );
+    res->copied = stats.bytes_read + stats.bytes_loaded + stats.bytes_stored;
+    res->allocs = loader_allocs;
+    res->alloc_bytes = loader_alloc_bytes;
+    res->db_allocs = db_allocs;
+
+    printf( "%-40s %9.3f %11lld %8ld %11lld %9ld\n", path,
+            res->load_ms, res->copied, res->allocs, res->alloc_bytes, res->db_allocs );
+    if( swap )
+        swap_banks();
+
+    idastub_reset();
+    return true;
+}
+
+
+
+int main( int argc, char **argv )
+{
+    load_result total, res;
+    bool remote = false, swap = false, verbose = false;
+    int runs = 5;
+    int i = 1;
+
+    for( ; i<argc && argv[i][0] == '-'; i++ )
+    {
+        if( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc )
+            runs = atoi( argv[++i] );
+        else if( strcmp( argv[i], "-r" ) == 0 )
+            remote = true;
+        else if( strcmp( argv[i], "-s" ) == 0 )
+            swap = true;
+        else if( strcmp( argv[i], "-v" ) == 0 )
+            verbose = true;
+        else
+            break;
+    }
+
+    if( i >= argc || argv[i][0] == '-' || runs < 1 )
+    {
+        fprintf( stderr, "usage: %s [-n runs] [-r] [-s] [-v] file.nes [file.nes ...]\n", argv[0] );
+        return 2;
+    }
+
+    // the loader asks whether to fix corrupt headers
+    idastub_answer = 1;
+
+    printf( "%-40s %9s %11s %8s %11s %9s\n", "image", "load ms", "copied", "allocs", "alloc bytes", "db allocs" );
+
+    memset( &total, 0, sizeof(total) );
+    for( ; i<argc; i++ )
+    {
+        if( !load_image( argv[i], runs, remote, swap, verbose, &res ) )
+            continue;
+        total.load_ms += res.load_ms;
+        total.copied += res.copied;
+        total.allocs += res.allocs;
+        total.alloc_bytes += res.alloc_bytes;
+        total.db_allocs += res.db_allocs;
+    }
+
+    printf( "%-40s %9.3f %11lld %8ld %11lld %9ld\n", "total",
+            total.load_ms, total.copied, total.allocs, total.alloc_bytes, total.db_allocs );
+    printf( "(best of %d loads%s)\n", runs, remote ? ", remote input" : "" );
+    return 0;
+}
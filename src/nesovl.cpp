@@ -0,0 +1,384 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    nesovl - IDA plugin that loads PRG overlays and CHR banks
+    on demand.
+
+    Databases created with NESLDR=overlays contain an empty segment
+    for every PRG bank (see overlay.h), the PPU pattern tables are
+    always created empty (see ppu.h). The plugin stays loaded and
+    fills them from the page store the first time they are
+    touched: when the cursor moves into one (HT_VIEW) or when the
+    analysis decodes an instruction in an overlay (HT_IDP
+    custom_ana), so code and cross-references never point at
+    undefined bytes. Running the plugin loads the overlay or
+    pattern table under the cursor. With argument 1 (plugins.cfg) all of them are
+    loaded at once, with argument 2
+    another CHR bank can be selected for the pattern table under
+    the cursor. Argument 3 swaps another PRG bank into the window
+    at $8000-$FFFF under the cursor, only the bytes that differ
+    are rewritten (see bankswap.h). Argument 4 lists the JSRs and
+    JMPs of all banks that refer to the location under the cursor
+    (see callgraph.h).
+
+    Copy compiled plugin to idadir%/plugins/nesovl.plw
+
+*/
+
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <loader.hpp>
+#include <kernwin.hpp>
+#include <bytes.hpp>
+
+#include "overlay.h"
+#include "ppu.h"
+#include "callgraph.h"
+#include "m6502.h"
+
+
+// the cursor and analysis callbacks are hooked (see init())
+static bool hooked = false;
+
+
+
+//----------------------------------------------------------------------
+//
+//      loads a single overlay and tells the user about it
+//
+static bool load_overlay( int index )
+{
+    ines_overlay_info info;
+
+    if( !ines_get_overlay_info( index, &info ) )
+        return false;
+    if( info.loaded )
+        return true;
+
+    if( !ines_load_overlay( index ) )
+    {
+        if( ines_source_state( false ) != INES_SOURCE_STORED && ines_source_state( false ) != INES_SOURCE_SAME )
+            msg("nesovl: could not load overlay %d (file offset %08x), the ROM file is missing or has changed\n", index, info.offset);
+        else
+            msg("nesovl: could not load overlay %d (file offset %08x)\n", index, info.offset);
+        return false;
+    }
+
+    msg("nesovl: loaded overlay %d to %08x-%08x (CPU address %04x)\n", index, info.start, info.start + info.size, info.address);
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      loads the CHR bank selected for a pattern table
+//
+static bool load_pattern_table( int table )
+{
+    uval_t bank;
+    bool loaded;
+
+    if( !ines_get_chr_bank( table, &bank, &loaded ) )
+        return false;
+    if( loaded )
+        return true;
+
+    if( !ines_load_pattern_table( table ) )
+    {
+        msg("nesovl: could not load 4k CHR bank %d into pattern table %d\n", bank, table);
+        return false;
+    }
+
+    msg("nesovl: loaded 4k CHR bank %d into pattern table %d\n", bank, table);
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      asks for the 4k CHR bank to show in a pattern table
+//
+static void select_chr_bank( int table )
+{
+    uval_t bank = 0;
+    bool loaded;
+    sval_t value;
+
+    ines_get_chr_bank( table, &bank, &loaded );
+    value = bank;
+    if( !asklong( &value, "Number of the 4k CHR bank for pattern table %d", table ) )
+        return;
+
+    if( value < 0 || !ines_select_chr_bank( table, value ) )
+    {
+        warning("There is no 4k CHR bank %d.", value);
+        return;
+    }
+    load_pattern_table( table );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      asks for the PRG bank to show in the window containing 'ea'
+//
+static void swap_prg_bank( ea_t ea )
+{
+    ines_swap_result res;
+    uval_t size, bank;
+    ea_t window;
+    sval_t value;
+
+    if( !ines_get_resident_bank( ea, &window, &size, &bank ) )
+    {
+        warning("The cursor is not inside a PRG bank window.");
+        return;
+    }
+
+    value = bank;
+    if( !asklong( &value, "Number of the %uk PRG bank for $%04X", size / 1024, window ) )
+        return;
+
+    if( value < 0 || !ines_swap_prg_bank( window, value, &res ) )
+    {
+        warning("There is no %uk PRG bank %d.", size / 1024, value);
+        return;
+    }
+    msg("nesovl: swapped %uk PRG bank %d into $%04X, %u bytes in %d ranges rewritten\n", size / 1024, value, window, res.bytes, res.ranges);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      lists the JSRs and JMPs of all PRG banks referring to 'ea'
+//
+static void list_callers( ea_t ea )
+{
+    ines_call_ref refs[256];
+    uval_t bank;
+    ea_t address;
+    int count, shown, any;
+
+    if( !ines_find_call_location( ea, &bank, &address ) )
+    {
+        warning("The cursor is not inside a PRG bank.");
+        return;
+    }
+
+    count = ines_get_callers( bank, address, refs, qnumber(refs) );
+    msg("nesovl: %d references to bank %u:%04X\n", count, bank, address);
+    shown = count < (int)qnumber(refs) ? count : (int)qnumber(refs);
+    for( int i=0; i<shown; i++ )
+        msg("  %s from bank %u:%04X\n", refs[i].opcode == M6502_JSR ? "JSR" : "JMP", refs[i].bank, refs[i].address);
+
+    // callers that can't tell which bank they reach
+    any = ines_get_callers( INES_CALLS_ANY_BANK, address, refs, qnumber(refs) );
+    if( any != 0 )
+        msg("nesovl: %d more references to %04X in a switched bank\n", any, address);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      loads the overlay containing 'ea' when it is first touched,
+//      addresses below the overlays are let through at once
+//
+static void touch_overlay( ea_t ea )
+{
+    int index;
+
+    if( ea == BADADDR || INES_OVERLAY_INDEX( ea ) < 0 )
+        return;
+    index = ines_find_overlay( ea );
+    if( index >= 0 )
+        load_overlay( index );
+}
+
+// the cursor moved in a disassembly view, into an overlay or
+// a pattern table maybe
+static int idaapi view_callback( void * /*user_data*/, int notification_code, va_list /*va*/ )
+{
+    if( notification_code == view_curpos )
+    {
+        ea_t ea = get_screen_ea();
+        int table = ines_find_pattern_table( ea );
+
+        if( table >= 0 )
+            load_pattern_table( table );
+        else
+            touch_overlay( ea );
+    }
+    return 0;
+}
+
+// the analysis is about to decode the instruction at cmd.ea, the
+// processor module still does the decoding
+static int idaapi idp_callback( void * /*user_data*/, int notification_code, va_list /*va*/ )
+{
+    if( notification_code == processor_t::custom_ana )
+        touch_overlay( cmd.ea );
+    return 0;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      tells the user if the ROM file the pages are read from
+//      (NESLDR=reference) is gone or isn't the one loaded
+//
+static void check_source( void )
+{
+    netnode source( INES_SOURCE_NODE );
+    char path[MAXSPECSIZE];
+    int state = ines_source_state( true );
+
+    if( state == INES_SOURCE_STORED || state == INES_SOURCE_SAME )
+        return;
+    if( source.supval( 0, path, sizeof(path), INES_SOURCE_TAG_PATH ) <= 0 )
+        qstrncpy( path, "?", sizeof(path) );
+    path[sizeof(path) - 1] = '\0';
+    if( state == INES_SOURCE_MISSING )
+        warning("The ROM file %s can't be read, overlays and banks\n"
+                "can't be loaded from it.", path);
+    else
+        warning("The ROM file %s has changed since it was loaded\n"
+                "(size, CRC32 or SHA-1 differ), overlays and banks\n"
+                "won't be loaded from it.", path);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      only databases with overlays or CHR banks are of interest.
+//      the plugin stays loaded to fill them when they are touched
+//
+int idaapi init( void )
+{
+    uval_t bank;
+    bool loaded;
+
+    uval_t size;
+    ea_t window;
+
+    check_source();
+    if( ines_overlay_count() == 0 && !ines_get_chr_bank( 0, &bank, &loaded ) )
+    {
+        if( !ines_get_resident_bank( IRQ_VECTOR_START_ADDRESS, &window, &size, &bank ) )
+            return PLUGIN_SKIP;
+        return PLUGIN_OK;
+    }
+
+    hooked = hook_to_notification_point( HT_VIEW, view_callback, NULL ) &&
+             hook_to_notification_point( HT_IDP, idp_callback, NULL );
+    if( hooked )
+        return PLUGIN_KEEP;
+    unhook_from_notification_point( HT_VIEW, view_callback, NULL );
+    msg("nesovl: could not hook the cursor and the analysis, use Alt-B to load overlays and pattern tables\n");
+    return PLUGIN_OK;
+}
+
+
+
+void idaapi term( void )
+{
+    if( hooked )
+    {
+        unhook_from_notification_point( HT_VIEW, view_callback, NULL );
+        unhook_from_notification_point( HT_IDP, idp_callback, NULL );
+        hooked = false;
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      arg 0: load the overlay or pattern table under the cursor
+//      arg 1: load all overlays and pattern tables
+//      arg 2: select the CHR bank of the pattern table under the cursor
+//      arg 3: swap another PRG bank into the window under the cursor
+//      arg 4: list the callers of the location under the cursor
+//
+void idaapi run( int arg )
+{
+    ea_t ea = get_screen_ea();
+
+    if( arg == 1 )
+    {
+        int count = ines_overlay_count();
+        int loaded = 0;
+
+        for( int i=0; i<count; i++ )
+            if( load_overlay( i ) )
+                loaded++;
+        for( int i=0; i<INES_PATTERN_TABLES; i++ )
+            load_pattern_table( i );
+        msg("nesovl: %d of %d overlays loaded\n", loaded, count);
+        return;
+    }
+
+    if( arg == 3 )
+    {
+        swap_prg_bank( ea );
+        return;
+    }
+    if( arg == 4 )
+    {
+        list_callers( ea );
+        return;
+    }
+
+    int table = ines_find_pattern_table( ea );
+    if( table >= 0 )
+    {
+        if( arg == 2 )
+            select_chr_bank( table );
+        else
+            load_pattern_table( table );
+        return;
+    }
+
+    int index = ines_find_overlay( ea );
+    if( index < 0 )
+    {
+        warning("The cursor is not inside a PRG overlay or a pattern table.");
+        return;
+    }
+    load_overlay( index );
+}
+
+
+
+char comment[] = "Loads PRG overlays and CHR banks of NES ROM images";
+char help[] = "Loads PRG overlays when the cursor or the analysis first reaches them,\n"
+              "the PRG bank under the cursor into its overlay segment\n"
+              "or the selected CHR bank into the pattern table under the cursor";
+char wanted_name[] = "Load NES PRG overlay";
+char wanted_hotkey[] = "Alt-B";
+
+
+
+plugin_t PLUGIN =
+{
+    IDP_INTERFACE_VERSION,
+    0,                      // plugin flags
+    init,                   // initialize
+    term,                   // terminate. this pointer may be NULL.
+    run,                    // invoke plugin
+    comment,                // long comment about the plugin
+    help,                   // multiline help about the plugin
+    wanted_name,            // the preferred short name of the plugin
+    wanted_hotkey           // the preferred hotkey to run the plugin
+};
@@ -0,0 +1,167 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    PRG banks as overlay segments.
+
+    With NESLDR=overlays the loader creates a segment for every
+    PRG bank of the mapper's window size (see ines_plan_overlays()).
+    Overlay n lives at INES_OVERLAY_EA( n, cpu address ), its segment
+    base is chosen so that offsets show the CPU address the bank
+    is used at, e.g. BANK005:8000.
+
+    The segments are created empty, start-up doesn't depend on
+    the size of the ROM. The bytes of an overlay are copied from
+    the page store (pagestore.h) when it is materialized, which
+    the nesovl plugin does the first time the cursor or the
+    analysis reaches the segment.
+
+    INES_OVERLAYS_NODE holds the number of overlays in altval 0
+    with tag 'C' and for every overlay:
+
+        'S'  linear start address
+        'A'  CPU address
+        'L'  length in bytes
+        'I'  index of the PRG page in the page store
+        'D'  offset of the bank within that page
+        'O'  file offset
+        'M'  1 once the bytes have been loaded
+
+*/
+
+
+#ifndef _OVERLAY_H
+#define _OVERLAY_H
+
+#include "pagestore.h"
+
+
+#define INES_OVERLAYS_TAG_COUNT             'C'
+#define INES_OVERLAYS_TAG_START             'S'
+#define INES_OVERLAYS_TAG_ADDRESS           'A'
+#define INES_OVERLAYS_TAG_SIZE              'L'
+#define INES_OVERLAYS_TAG_PAGE              'I'
+#define INES_OVERLAYS_TAG_PAGE_OFFSET       'D'
+#define INES_OVERLAYS_TAG_OFFSET            'O'
+#define INES_OVERLAYS_TAG_LOADED            'M'
+
+
+// an overlay
+typedef struct _ines_overlay_info_t {
+
+    ea_t start;
+    uval_t address;
+    uval_t size;
+    uval_t page;                            // page store index
+    uval_t page_offset;
+    uval_t offset;                          // file offset
+    bool loaded;
+
+} ines_overlay_info;
+
+
+
+//----------------------------------------------------------------------
+//
+//      number of overlays in the database
+//
+inline int ines_overlay_count( void )
+{
+    netnode node( INES_OVERLAYS_NODE );
+
+    if( node == BADNODE )
+        return 0;
+    return (int)node.altval( 0, INES_OVERLAYS_TAG_COUNT );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      reads the description of an overlay
+//
+inline bool ines_get_overlay_info( int index, ines_overlay_info *info )
+{
+    netnode node( INES_OVERLAYS_NODE );
+
+    if( node == BADNODE || index < 0 || index >= (int)node.altval( 0, INES_OVERLAYS_TAG_COUNT ) )
+        return false;
+
+    info->start       = node.altval( index, INES_OVERLAYS_TAG_START );
+    info->address     = node.altval( index, INES_OVERLAYS_TAG_ADDRESS );
+    info->size        = node.altval( index, INES_OVERLAYS_TAG_SIZE );
+    info->page        = node.altval( index, INES_OVERLAYS_TAG_PAGE );
+    info->page_offset = node.altval( index, INES_OVERLAYS_TAG_PAGE_OFFSET );
+    info->offset      = node.altval( index, INES_OVERLAYS_TAG_OFFSET );
+    info->loaded      = node.altval( index, INES_OVERLAYS_TAG_LOADED ) != 0;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      returns the overlay containing 'ea' or -1, the overlay
+//      index is taken from the 64k block of the address
+//
+inline int ines_find_overlay( ea_t ea )
+{
+    ines_overlay_info info;
+    int index = INES_OVERLAY_INDEX( ea );
+
+    if( !ines_get_overlay_info( index, &info ) || ea < info.start || ea >= info.start + info.size )
+        return -1;
+    return index;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      copies the bytes of an overlay into its segment.
+//      does nothing if that has been done before
+//
+inline bool ines_load_overlay( int index )
+{
+    netnode node( INES_OVERLAYS_NODE );
+    ines_overlay_info info;
+    uchar page[PRG_PAGE_SIZE];
+
+    if( !ines_get_overlay_info( index, &info ) )
+        return false;
+    if( info.loaded )
+        return true;
+
+    if( info.page_offset + info.size > sizeof(page) ||
+        !ines_get_page( (int)info.page, page, sizeof(page) ) ||
+        mem2base( page + info.page_offset, info.start, info.start + info.size, info.offset ) != 1 )
+        return false;
+
+    node.altset( index, 1, INES_OVERLAYS_TAG_LOADED );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      stores the description of an overlay (used by the loader)
+//
+inline void ines_set_overlay( netnode node, int index, const ines_overlay_info *info )
+{
+    node.altset( index, info->start, INES_OVERLAYS_TAG_START );
+    node.altset( index, info->address, INES_OVERLAYS_TAG_ADDRESS );
+    node.altset( index, info->size, INES_OVERLAYS_TAG_SIZE );
+    node.altset( index, info->page, INES_OVERLAYS_TAG_PAGE );
+    node.altset( index, info->page_offset, INES_OVERLAYS_TAG_PAGE_OFFSET );
+    node.altset( index, info->offset, INES_OVERLAYS_TAG_OFFSET );
+    node.altset( index, info->loaded, INES_OVERLAYS_TAG_LOADED );
+
+    if( (int)node.altval( 0, INES_OVERLAYS_TAG_COUNT ) <= index )
+        node.altset( 0, index + 1, INES_OVERLAYS_TAG_COUNT );
+}
+
+#endif // _OVERLAY_H
@@ -0,0 +1,374 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    access to the ROM pages stored in the database.
+
+    The loader stores the trainer and all PRG-ROM and CHR-ROM pages
+    in a single netnode (INES_PAGES_NODE). Every page has an index,
+    starting at 0 in file order, and the following altvals:
+
+        'K'  kind of page (INES_PAGE_...)
+        'N'  number of the page within its kind, counted from 0
+        'O'  file offset
+        'L'  length in bytes
+        'H'  CRC32 of the page
+        'R'  index of the page whose blob holds the data
+        'Z'  size of the blob if it is compressed (see lz.h), 0 if not
+
+    altval 0 with tag 'C' holds the number of pages, altval <kind>
+    with tag 'F' holds the index of the first page of that kind.
+    The page data is stored as blob with tag 'P' starting at
+    supval index << INES_PAGES_BLOB_SHIFT.
+
+    Identical pages (mirrored banks, padding, repeated CHR sets)
+    are stored only once: their 'R' altval refers to the first
+    page with the same contents, which is the only one that has
+    a blob.
+
+    If the loader was told to compress pages (NESLDR=compress),
+    blobs hold LZ compressed data. ines_get_page() decompresses
+    them transparently.
+
+    With NESLDR=reference the pages get their index entries but
+    no blobs. INES_SOURCE_NODE names the ROM file instead, and
+    ines_get_page() reads the pages from there: supval 0 with tag
+    'S' holds its path, altval 0 with tag 'L' its size, altval 0
+    with tag 'H' and supval 0 with tag 'D' the CRC32 and SHA-1 of
+    the whole file. Before the first page is read, the file is
+    compared with them by ines_check_source(); the result is kept
+    for the session (plugins check again when a database is
+    opened, see ines_source_state()). A page is only returned if
+    the file is the same and the page still has its CRC32, so ROMs
+    that moved or changed are noticed. Plugins using
+    ines_get_page() need hash.cpp for this.
+
+    Plugins include this header after the IDA headers and fetch
+    pages by index, e.g. the 3rd PRG-ROM page:
+
+        uchar page[PRG_PAGE_SIZE];
+        int index = ines_find_page( INES_PAGE_PRG, 2 );
+
+        if( index >= 0 && ines_get_page( index, page, sizeof(page) ) )
+            ...
+
+*/
+
+
+#ifndef _PAGESTORE_H
+#define _PAGESTORE_H
+
+#include "nes.h"
+#include "lz.h"
+#include "hash.h"
+
+
+#define INES_PAGES_TAG_COUNT                'C'
+#define INES_PAGES_TAG_FIRST                'F'
+#define INES_PAGES_TAG_KIND                 'K'
+#define INES_PAGES_TAG_NUMBER               'N'
+#define INES_PAGES_TAG_OFFSET               'O'
+#define INES_PAGES_TAG_SIZE                 'L'
+#define INES_PAGES_TAG_HASH                 'H'
+#define INES_PAGES_TAG_REF                  'R'
+#define INES_PAGES_TAG_PACKED               'Z'
+#define INES_PAGES_TAG_DATA                 'P'
+
+// room for 256 supvals (256k) per page
+#define INES_PAGES_BLOB_SHIFT               8
+
+#define INES_SOURCE_TAG_PATH                'S'
+#define INES_SOURCE_TAG_SIZE                'L'
+#define INES_SOURCE_TAG_CRC                 'H'
+#define INES_SOURCE_TAG_SHA1                'D'
+
+// results of ines_check_source()
+#define INES_SOURCE_UNCHECKED               -1
+#define INES_SOURCE_STORED                  0       // no ROM file referenced, the pages are in the database
+#define INES_SOURCE_SAME                    1
+#define INES_SOURCE_MISSING                 2       // the ROM file can't be read
+#define INES_SOURCE_CHANGED                 3       // another size, CRC32 or SHA-1
+
+// bytes read at a time by ines_check_source()
+#define INES_SOURCE_CHUNK                   0x10000
+
+
+// index entry of a page
+typedef struct _ines_page_info_t {
+
+    uchar kind;                             // INES_PAGE_...
+    uval_t number;
+    uval_t offset;
+    uval_t size;
+    uval_t hash;
+    uval_t ref;                             // index of the page holding the data
+    uval_t packed;                          // compressed size of the blob, 0 if raw
+
+} ines_page_info;
+
+
+
+//----------------------------------------------------------------------
+//
+//      number of pages in the database
+//
+inline int ines_page_count( void )
+{
+    netnode node( INES_PAGES_NODE );
+
+    if( node == BADNODE )
+        return 0;
+    return (int)node.altval( 0, INES_PAGES_TAG_COUNT );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      returns the index of a page or -1 if there is no such page
+//
+inline int ines_find_page( uchar kind, uval_t number )
+{
+    netnode node( INES_PAGES_NODE );
+    int index;
+
+    if( node == BADNODE )
+        return -1;
+
+    index = (int)(node.altval( kind, INES_PAGES_TAG_FIRST ) + number);
+    if( index >= (int)node.altval( 0, INES_PAGES_TAG_COUNT ) ||
+        node.altval( index, INES_PAGES_TAG_KIND ) != kind ||
+        node.altval( index, INES_PAGES_TAG_NUMBER ) != number )
+        return -1;
+    return index;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      reads the index entry of a page
+//
+inline bool ines_get_page_info( int index, ines_page_info *info )
+{
+    netnode node( INES_PAGES_NODE );
+
+    if( node == BADNODE || index < 0 || index >= (int)node.altval( 0, INES_PAGES_TAG_COUNT ) )
+        return false;
+
+    info->kind   = (uchar)node.altval( index, INES_PAGES_TAG_KIND );
+    info->number = node.altval( index, INES_PAGES_TAG_NUMBER );
+    info->offset = node.altval( index, INES_PAGES_TAG_OFFSET );
+    info->size   = node.altval( index, INES_PAGES_TAG_SIZE );
+    info->hash   = node.altval( index, INES_PAGES_TAG_HASH );
+    info->ref    = node.altval( index, INES_PAGES_TAG_REF );
+    info->packed = node.altval( info->ref, INES_PAGES_TAG_PACKED );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      compares the ROM file named by INES_SOURCE_NODE with the size,
+//      CRC32 and SHA-1 the loader stored. the whole file is read
+//
+inline int ines_check_source( void )
+{
+    netnode source( INES_SOURCE_NODE );
+    char path[MAXSPECSIZE];
+    uchar stored[SHA1_SIZE], sha1[SHA1_SIZE];
+    unsigned long long size = 0;
+    crc32_t crc = 0;
+    sha1_ctx sha;
+    uchar *buf;
+    size_t n;
+    FILE *fp;
+    bool ok;
+
+    if( source == BADNODE )
+        return INES_SOURCE_STORED;
+    if( source.supval( 0, path, sizeof(path), INES_SOURCE_TAG_PATH ) <= 0 ||
+        source.supval( 0, stored, sizeof(stored), INES_SOURCE_TAG_SHA1 ) != SHA1_SIZE )
+        return INES_SOURCE_MISSING;
+    path[sizeof(path) - 1] = '\0';
+
+    fp = fopen( path, "rb" );
+    if( fp == NULL )
+        return INES_SOURCE_MISSING;
+    buf = (uchar *)qalloc( INES_SOURCE_CHUNK );
+    if( buf == NULL )
+    {
+        fclose( fp );
+        return INES_SOURCE_MISSING;
+    }
+
+    hash_sha1_init( &sha );
+    while( (n = fread( buf, 1, INES_SOURCE_CHUNK, fp )) > 0 )
+    {
+        crc = hash_crc32( crc, buf, n );
+        hash_sha1_update( &sha, buf, n );
+        size += n;
+    }
+    ok = !ferror( fp );
+    fclose( fp );
+    qfree( buf );
+    if( !ok )
+        return INES_SOURCE_MISSING;
+
+    hash_sha1_final( &sha, sha1 );
+    if( size != source.altval( 0, INES_SOURCE_TAG_SIZE ) ||
+        crc != source.altval( 0, INES_SOURCE_TAG_CRC ) ||
+        memcmp( sha1, stored, SHA1_SIZE ) != 0 )
+        return INES_SOURCE_CHANGED;
+    return INES_SOURCE_SAME;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      the result of the last ines_check_source()
+//
+inline int *ines_source_cache( void )
+{
+    static int state = INES_SOURCE_UNCHECKED;
+    return &state;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      result of ines_check_source(), which is called only once
+//      unless 'recheck' is set
+//
+inline int ines_source_state( bool recheck )
+{
+    int *state = ines_source_cache();
+
+    if( *state == INES_SOURCE_UNCHECKED || recheck )
+        *state = ines_check_source();
+    return *state;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      sets the result for a source the caller has just checked
+//      itself, the loader does when it references the ROM file
+//
+inline void ines_set_source_state( int state )
+{
+    *ines_source_cache() = state;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      reads a page from the ROM file named by INES_SOURCE_NODE.
+//      fails if the file is gone or isn't the one loaded (see
+//      ines_check_source()), or if the page has another CRC32
+//
+inline bool ines_read_source_page( netnode source, netnode node, int index, void *buf, size_t size )
+{
+    char path[MAXSPECSIZE];
+    uval_t offset = node.altval( index, INES_PAGES_TAG_OFFSET );
+    FILE *fp;
+    bool ok;
+
+    if( ines_source_state( false ) != INES_SOURCE_SAME ||
+        source.supval( 0, path, sizeof(path), INES_SOURCE_TAG_PATH ) <= 0 )
+        return false;
+    path[sizeof(path) - 1] = '\0';
+
+    fp = fopen( path, "rb" );
+    if( fp == NULL )
+        return false;
+
+    ok = fseek( fp, 0, SEEK_END ) == 0 &&
+         (uval_t)ftell( fp ) == source.altval( 0, INES_SOURCE_TAG_SIZE ) &&
+         fseek( fp, (long)offset, SEEK_SET ) == 0 &&
+         fread( buf, 1, size, fp ) == size &&
+         hash_crc32( 0, buf, size ) == node.altval( index, INES_PAGES_TAG_HASH );
+    fclose( fp );
+    return ok;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      reads the data of a page into 'buf', which must be large
+//      enough to hold the whole page
+//
+inline bool ines_get_page( int index, void *buf, size_t bufsize )
+{
+    netnode node( INES_PAGES_NODE );
+    netnode source( INES_SOURCE_NODE );
+    size_t size = bufsize;
+    uval_t ref, packed;
+    bool ok;
+
+    if( node == BADNODE || index < 0 || index >= (int)node.altval( 0, INES_PAGES_TAG_COUNT ) )
+        return false;
+    size = node.altval( index, INES_PAGES_TAG_SIZE );
+    if( size > bufsize )
+        return false;
+
+    // the pages weren't stored, see NESLDR=reference
+    if( source != BADNODE )
+        return ines_read_source_page( source, node, index, buf, size );
+
+    ref = node.altval( index, INES_PAGES_TAG_REF );
+    packed = node.altval( ref, INES_PAGES_TAG_PACKED );
+    if( packed == 0 )
+        return node.getblob( buf, &size, (nodeidx_t)ref << INES_PAGES_BLOB_SHIFT, INES_PAGES_TAG_DATA ) != NULL;
+
+    uchar *tmp = (uchar *)qalloc( packed );
+    size_t tmpsize = packed;
+    if( tmp == NULL )
+        return false;
+    ok = node.getblob( tmp, &tmpsize, (nodeidx_t)ref << INES_PAGES_BLOB_SHIFT, INES_PAGES_TAG_DATA ) != NULL &&
+         lz_decompress( tmp, tmpsize, (uchar *)buf, size );
+    qfree( tmp );
+    return ok;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      stores a page and its index entry (used by the loader).
+//      the blob is only written if the page refers to itself
+//      and 'data' isn't NULL, pages of referenced ROM files have
+//      no blobs. 'data' holds info->packed bytes of compressed
+//      data if info->packed isn't 0
+//
+inline bool ines_set_page( netnode node, int index, const ines_page_info *info, const void *data )
+{
+    if( info->number == 0 )
+        node.altset( info->kind, index, INES_PAGES_TAG_FIRST );
+
+    node.altset( index, info->kind, INES_PAGES_TAG_KIND );
+    node.altset( index, info->number, INES_PAGES_TAG_NUMBER );
+    node.altset( index, info->offset, INES_PAGES_TAG_OFFSET );
+    node.altset( index, info->size, INES_PAGES_TAG_SIZE );
+    node.altset( index, info->hash, INES_PAGES_TAG_HASH );
+    node.altset( index, info->ref, INES_PAGES_TAG_REF );
+    node.altset( index, info->ref == (uval_t)index ? info->packed : 0, INES_PAGES_TAG_PACKED );
+
+    if( (int)node.altval( 0, INES_PAGES_TAG_COUNT ) <= index )
+        node.altset( 0, index + 1, INES_PAGES_TAG_COUNT );
+
+    if( info->ref != (uval_t)index || data == NULL )
+        return true;
+    return node.setblob( data, info->packed ? info->packed : info->size, (nodeidx_t)index << INES_PAGES_BLOB_SHIFT, INES_PAGES_TAG_DATA );
+}
+
+#endif // _PAGESTORE_H
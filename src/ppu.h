@@ -0,0 +1,133 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    CHR banks in the PPU pattern tables.
+
+    The loader creates the PPU address space above the CPU's (see
+    PPU_EA()): two pattern tables, the name tables and the palettes.
+    The pattern tables are created empty. The loader only selects
+    the 4k CHR banks they show, the bytes are copied from the page
+    store (pagestore.h) when a pattern table is materialized, which
+    the nesovl plugin does for the table under the cursor. Any other
+    CHR bank can be selected later on.
+
+    INES_PPU_NODE holds for every pattern table (0 and 1):
+
+        'B'  1 + number of the selected 4k CHR bank, 0 if none
+             is selected (CHR-RAM)
+        'M'  1 once the bytes of the selected bank have been loaded
+
+*/
+
+
+#ifndef _PPU_H
+#define _PPU_H
+
+#include "pagestore.h"
+
+
+#define INES_PPU_TAG_BANK                   'B'
+#define INES_PPU_TAG_LOADED                 'M'
+
+#define INES_PATTERN_TABLES                 2
+#define CHR_4K_BANK_SIZE                    PATTERN_TABLE_SIZE
+
+
+
+//----------------------------------------------------------------------
+//
+//      returns the pattern table containing 'ea' or -1
+//
+inline int ines_find_pattern_table( ea_t ea )
+{
+    if( ea < PPU_EA( PATTERN_TABLE_0_ADDRESS ) || ea >= PPU_EA( PATTERN_TABLE_0_ADDRESS + INES_PATTERN_TABLES * PATTERN_TABLE_SIZE ) )
+        return -1;
+    return (int)((ea - PPU_EA( PATTERN_TABLE_0_ADDRESS )) / PATTERN_TABLE_SIZE);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      reads the 4k CHR bank selected for a pattern table.
+//      returns false if there is none
+//
+inline bool ines_get_chr_bank( int table, uval_t *bank, bool *loaded )
+{
+    netnode node( INES_PPU_NODE );
+    uval_t selected;
+
+    if( node == BADNODE || table < 0 || table >= INES_PATTERN_TABLES )
+        return false;
+
+    selected = node.altval( table, INES_PPU_TAG_BANK );
+    if( selected == 0 )
+        return false;
+
+    *bank = selected - 1;
+    *loaded = node.altval( table, INES_PPU_TAG_LOADED ) != 0;
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      selects the 4k CHR bank shown by a pattern table, the bytes
+//      are loaded by ines_load_pattern_table()
+//
+inline bool ines_select_chr_bank( int table, uval_t bank )
+{
+    netnode node;
+
+    if( table < 0 || table >= INES_PATTERN_TABLES ||
+        ines_find_page( INES_PAGE_CHR, bank / 2 ) < 0 )
+        return false;
+
+    node.create( INES_PPU_NODE );
+    node.altset( table, bank + 1, INES_PPU_TAG_BANK );
+    node.altset( table, 0, INES_PPU_TAG_LOADED );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      copies the selected CHR bank into its pattern table.
+//      does nothing if that has been done before
+//
+inline bool ines_load_pattern_table( int table )
+{
+    netnode node( INES_PPU_NODE );
+    ines_page_info info;
+    uchar page[CHR_PAGE_SIZE];
+    uval_t bank, offset;
+    bool loaded;
+    int index;
+    ea_t start;
+
+    if( !ines_get_chr_bank( table, &bank, &loaded ) )
+        return false;
+    if( loaded )
+        return true;
+
+    // two 4k banks per 8k page
+    index = ines_find_page( INES_PAGE_CHR, bank / 2 );
+    offset = (bank % 2) * CHR_4K_BANK_SIZE;
+    start = PPU_EA( PATTERN_TABLE_0_ADDRESS + table * PATTERN_TABLE_SIZE );
+
+    if( index < 0 || !ines_get_page_info( index, &info ) || info.size < offset + CHR_4K_BANK_SIZE ||
+        !ines_get_page( index, page, sizeof(page) ) ||
+        mem2base( page + offset, start, start + CHR_4K_BANK_SIZE, info.offset + offset ) != 1 )
+        return false;
+
+    node.altset( table, 1, INES_PPU_TAG_LOADED );
+    return true;
+}
+
+#endif // _PPU_H
@@ -0,0 +1,235 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    ROM fingerprints and the database of known-good headers.
+    See romdb.h.
+
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "romdb.h"
+
+
+static crc32_t get_le32( const uchar *p )
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((crc32_t)p[3] << 24);
+}
+
+static void put_le32( uchar *p, crc32_t v )
+{
+    p[0] = (uchar)v;
+    p[1] = (uchar)(v >> 8);
+    p[2] = (uchar)(v >> 16);
+    p[3] = (uchar)(v >> 24);
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      orders records by CRC32, then SHA-1
+//
+static int compare_key( const uchar *rec, crc32_t crc, const uchar *sha1 )
+{
+    crc32_t c = get_le32( rec );
+
+    if( c != crc )
+        return c < crc ? -1 : 1;
+    return memcmp( rec + 4, sha1, SHA1_SIZE );
+}
+
+static int compare_records( const void *a, const void *b )
+{
+    const uchar *rb = (const uchar *)b;
+    return compare_key( (const uchar *)a, get_le32( rb ), rb + 4 );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      hashes everything behind header and trainer, the PRG and
+//      CHR chunk of chunked images
+//
+void romdb_fingerprint( const ines_ctx *ctx, rom_fingerprint *fp )
+{
+    if( ctx->chunked )
+    {
+        const uchar *prg = ctx->image->data + ines_prg_offset( ctx );
+        const uchar *chr = ctx->image->data + ines_chr_offset( ctx );
+        sha1_ctx sha1;
+
+        fp->size = ctx->prg_size + ctx->chr_size;
+        fp->crc = hash_crc32( 0, prg, (size_t)ctx->prg_size );
+        fp->crc = hash_crc32( fp->crc, chr, (size_t)ctx->chr_size );
+        hash_sha1_init( &sha1 );
+        hash_sha1_update( &sha1, prg, (size_t)ctx->prg_size );
+        hash_sha1_update( &sha1, chr, (size_t)ctx->chr_size );
+        hash_sha1_final( &sha1, fp->sha1 );
+        return;
+    }
+
+    image_off_t offset = ines_prg_offset( ctx );
+    image_off_t size = ctx->file_size > offset ? ctx->file_size - offset : 0;
+    const uchar *data = ctx->image->data + offset;
+
+    // the whole image is in the address space, so size fits size_t
+    fp->size = size;
+    fp->crc = hash_crc32( 0, data, (size_t)size );
+    hash_sha1( data, (size_t)size, fp->sha1 );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      maps a database file and checks its header
+//
+bool romdb_open( romdb *db, const char *path )
+{
+    const uchar *hdr;
+    FILE *fp;
+
+    memset( db, 0, sizeof(*db) );
+
+    fp = fopen( path, "rb" );
+    if( fp == NULL )
+        return false;
+
+    if( !image_map_file( &db->view, fp ) )
+    {
+        // read it once, databases are small
+        long size;
+
+        fseek( fp, 0, SEEK_END );
+        size = ftell( fp );
+        fseek( fp, 0, SEEK_SET );
+        db->buffer = size > 0 ? malloc( size ) : NULL;
+        if( db->buffer == NULL || fread( db->buffer, 1, size, fp ) != (size_t)size )
+        {
+            fclose( fp );
+            romdb_close( db );
+            return false;
+        }
+        image_from_buffer( &db->view, db->buffer, size );
+    }
+    fclose( fp );
+
+    hdr = image_slice( &db->view, 0, ROMDB_HDR_SIZE );
+    if( hdr == NULL || memcmp( hdr, ROMDB_MAGIC, 8 ) != 0 || get_le32( hdr + 12 ) != ROMDB_RECORD_SIZE )
+    {
+        romdb_close( db );
+        return false;
+    }
+
+    // a count that doesn't fit into the file is rejected before any
+    // size is computed from it, long may be 32 bits
+    image_off_t count = get_le32( hdr + 8 );
+    if( count > (db->view.size - ROMDB_HDR_SIZE) / (image_off_t)ROMDB_RECORD_SIZE )
+    {
+        romdb_close( db );
+        return false;
+    }
+
+    db->count = (long)count;
+    db->records = image_slice( &db->view, ROMDB_HDR_SIZE, count * (image_off_t)ROMDB_RECORD_SIZE );
+    if( db->records == NULL )
+    {
+        romdb_close( db );
+        return false;
+    }
+    return true;
+}
+
+
+
+void romdb_close( romdb *db )
+{
+    image_release( &db->view );
+    free( db->buffer );
+    memset( db, 0, sizeof(*db) );
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      binary search for a fingerprint
+//
+const ines_hdr *romdb_lookup( const romdb *db, const rom_fingerprint *fp )
+{
+    long lo = 0, hi = db->count;
+
+    while( lo < hi )
+    {
+        long mid = lo + (hi - lo) / 2;
+        const uchar *rec = db->records + mid * ROMDB_RECORD_SIZE;
+        int cmp = compare_key( rec, fp->crc, fp->sha1 );
+
+        if( cmp == 0 )
+            return (const ines_hdr *)(rec + 4 + SHA1_SIZE);
+        if( cmp < 0 )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      writes a sorted database, duplicate fingerprints are
+//      stored once
+//
+bool romdb_write( const char *path, const rom_fingerprint *fps, const ines_hdr *hdrs, long count )
+{
+    uchar hdr[ROMDB_HDR_SIZE];
+    uchar *records;
+    long i, unique = 0;
+    bool ok;
+    FILE *fp;
+
+    records = (uchar *)malloc( count * ROMDB_RECORD_SIZE + 1 );
+    if( records == NULL )
+        return false;
+
+    for( i=0; i<count; i++ )
+    {
+        uchar *rec = records + i * ROMDB_RECORD_SIZE;
+        put_le32( rec, fps[i].crc );
+        memcpy( rec + 4, fps[i].sha1, SHA1_SIZE );
+        memcpy( rec + 4 + SHA1_SIZE, &hdrs[i], INES_HDR_SIZE );
+    }
+
+    qsort( records, count, ROMDB_RECORD_SIZE, compare_records );
+    for( i=0; i<count; i++ )
+    {
+        const uchar *rec = records + i * ROMDB_RECORD_SIZE;
+
+        if( unique == 0 || compare_records( records + (unique - 1) * ROMDB_RECORD_SIZE, rec ) != 0 )
+            memmove( records + unique++ * ROMDB_RECORD_SIZE, rec, ROMDB_RECORD_SIZE );
+    }
+
+    memcpy( hdr, ROMDB_MAGIC, 8 );
+    put_le32( hdr + 8, (crc32_t)unique );
+    put_le32( hdr + 12, ROMDB_RECORD_SIZE );
+
+    fp = fopen( path, "wb" );
+    ok = fp != NULL &&
+         fwrite( hdr, 1, sizeof(hdr), fp ) == sizeof(hdr) &&
+         fwrite( records, ROMDB_RECORD_SIZE, unique, fp ) == (size_t)unique;
+    if( fp != NULL && fclose( fp ) != 0 )
+        ok = false;
+
+    free( records );
+    return ok;
+}
@@ -0,0 +1,83 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    ROM fingerprints and the database of known-good headers.
+
+    A fingerprint is the CRC32 and SHA-1 of everything behind the
+    header and the trainer, i.e. the PRG and CHR data. That is what
+    the usual ROM sets list, so the same dumps with differently
+    broken headers get the same fingerprint. UNIF images hash their
+    PRG and CHR chunk, like the same dump in iNES format.
+
+    The database file (nesdb.bin) is memory mapped and searched
+    in place. Layout, all numbers little endian:
+
+        8 bytes     "NESDB\x1A", version (1), 0
+        4 bytes     number of records
+        4 bytes     size of a record (ROMDB_RECORD_SIZE)
+
+    followed by the records, sorted by CRC32 and SHA-1:
+
+        4 bytes     CRC32 of the PRG and CHR data
+        20 bytes    SHA-1 of the PRG and CHR data
+        16 bytes    known-good iNES header
+
+*/
+
+
+#ifndef _ROMDB_H
+#define _ROMDB_H
+
+#include "ines.h"
+#include "hash.h"
+
+
+#define ROMDB_FILE_NAME                     "nesdb.bin"
+#define ROMDB_MAGIC                         "NESDB\x1A\x01"
+#define ROMDB_HDR_SIZE                      16
+#define ROMDB_RECORD_SIZE                   (4 + SHA1_SIZE + INES_HDR_SIZE)
+
+
+// fingerprint of the PRG and CHR data of an image
+typedef struct _rom_fingerprint_t {
+
+    crc32_t crc;
+    uchar sha1[SHA1_SIZE];
+    image_off_t size;                       // number of bytes hashed
+
+} rom_fingerprint;
+
+
+// opened database
+typedef struct _romdb_t {
+
+    image_t view;
+    void *buffer;                           // if the file couldn't be mapped
+    long count;
+    const uchar *records;
+
+} romdb;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for romdb.cpp
+//
+
+void romdb_fingerprint( const ines_ctx *ctx, rom_fingerprint *fp );
+
+bool romdb_open( romdb *db, const char *path );
+void romdb_close( romdb *db );
+
+// returns the stored header or NULL if the ROM isn't known
+const ines_hdr *romdb_lookup( const romdb *db, const rom_fingerprint *fp );
+
+// writes a database of 'count' fingerprints and their headers
+bool romdb_write( const char *path, const rom_fingerprint *fps, const ines_hdr *hdrs, long count );
+
+#endif // _ROMDB_H
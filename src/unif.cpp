@@ -0,0 +1,322 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    UNIF ROM images.
+    See unif.h.
+
+*/
+
+
+#include <string.h>
+
+#include "unif.h"
+
+
+// iNES pages, more need a NES 2.0 header
+#define INES_MAX_PAGES                      255
+
+// NES 2.0 RAM size shift of 8k (64 << 7)
+#define NES20_SHIFT_8K                      7
+
+
+// iNES mapper of a board, without the "NES-", "HVC-", ... prefix
+typedef struct _unif_board_t {
+
+    const char *name;
+    ushort mapper;
+
+} unif_board;
+
+static const unif_board unif_boards[] =
+{
+    { "NROM", 0 },      { "NROM-128", 0 },  { "NROM-256", 0 },  { "RROM", 0 },
+    { "SAROM", 1 },     { "SBROM", 1 },     { "SCROM", 1 },     { "SEROM", 1 },
+    { "SFROM", 1 },     { "SGROM", 1 },     { "SHROM", 1 },     { "SJROM", 1 },
+    { "SKROM", 1 },     { "SLROM", 1 },     { "SL1ROM", 1 },    { "SNROM", 1 },
+    { "SOROM", 1 },     { "SUROM", 1 },     { "SXROM", 1 },
+    { "UNROM", 2 },     { "UOROM", 2 },
+    { "CNROM", 3 },
+    { "TBROM", 4 },     { "TEROM", 4 },     { "TFROM", 4 },     { "TGROM", 4 },
+    { "TKROM", 4 },     { "TLROM", 4 },     { "TL1ROM", 4 },    { "TR1ROM", 4 },
+    { "TSROM", 4 },     { "TVROM", 4 },     { "HKROM", 4 },
+    { "EKROM", 5 },     { "ELROM", 5 },     { "ETROM", 5 },     { "EWROM", 5 },
+    { "AMROM", 7 },     { "ANROM", 7 },     { "AOROM", 7 },
+    { "PNROM", 9 },     { "PEEOROM", 9 },
+    { "FJROM", 10 },    { "FKROM", 10 },
+    { "CPROM", 13 },
+    { "BNROM", 34 },
+    { "GNROM", 66 },    { "MHROM", 66 },
+    { "TLSROM", 118 },  { "TKSROM", 118 },
+    { "TQROM", 119 }
+};
+
+// manufacturer prefixes of board names
+static const char *const unif_prefixes[] = { "NES-", "HVC-", "UNL-", "BTL-", "BMC-" };
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for unif.cpp
+//
+
+static unsigned int read_le32( const uchar *p );
+static int rom_chunk_number( const char *tag, const char *kind );
+static void copy_rom( const image_t *image, const unif_index *index, const int *chunks, image_off_t size, uchar *buf, image_off_t padded );
+
+
+
+//----------------------------------------------------------------------
+//
+//      check for the UNIF signature
+//
+bool unif_is_unif_image( const void *buf, size_t size )
+{
+    return size >= 4 && memcmp( buf, UNIF_MAGIC, 4 ) == 0;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      walks the chunk list once and records where every chunk is
+//
+bool unif_index_image( const image_t *image, unif_index *index )
+{
+    image_off_t offset = UNIF_HDR_SIZE;
+    const uchar *hdr;
+
+    memset( index, 0, sizeof(*index) );
+    for( int i=0; i<UNIF_ROM_CHUNKS; i++ )
+        index->prg[i] = index->chr[i] = -1;
+    index->mirroring = -1;
+
+    hdr = image_slice( image, 0, UNIF_HDR_SIZE );
+    if( hdr == NULL || !unif_is_unif_image( hdr, UNIF_HDR_SIZE ) )
+        return false;
+    index->revision = read_le32( hdr + 4 );
+
+    while( offset + UNIF_CHUNK_HDR_SIZE <= image->size )
+    {
+        const uchar *p = image_slice( image, offset, UNIF_CHUNK_HDR_SIZE );
+        unif_chunk *chunk;
+        int n;
+
+        // a chunk running past the end of the file breaks the list
+        if( index->count == UNIF_MAX_CHUNKS || offset + UNIF_CHUNK_HDR_SIZE + read_le32( p + 4 ) > image->size )
+            return false;
+
+        chunk = &index->chunks[index->count];
+        memcpy( chunk->tag, p, 4 );
+        chunk->tag[4] = '\0';
+        chunk->offset = offset + UNIF_CHUNK_HDR_SIZE;
+        chunk->length = read_le32( p + 4 );
+
+        // the first chunk of a kind counts
+        if( (n = rom_chunk_number( chunk->tag, "PRG" )) >= 0 && index->prg[n] < 0 )
+        {
+            index->prg[n] = index->count;
+            index->prg_chunks++;
+            index->prg_size += chunk->length;
+        }
+        else if( (n = rom_chunk_number( chunk->tag, "CHR" )) >= 0 && index->chr[n] < 0 )
+        {
+            index->chr[n] = index->count;
+            index->chr_chunks++;
+            index->chr_size += chunk->length;
+        }
+        else if( strcmp( chunk->tag, "MAPR" ) == 0 && index->board[0] == '\0' )
+        {
+            size_t length = chunk->length < INES_BOARD_SIZE - 1 ? chunk->length : INES_BOARD_SIZE - 1;
+
+            memcpy( index->board, image_slice( image, chunk->offset, length ), length );
+            index->board[length] = '\0';
+        }
+        else if( strcmp( chunk->tag, "MIRR" ) == 0 && chunk->length > 0 )
+            index->mirroring = *image_slice( image, chunk->offset, 1 );
+        else if( strcmp( chunk->tag, "BATR" ) == 0 )
+            index->battery = chunk->length == 0 || *image_slice( image, chunk->offset, 1 ) != 0;
+
+        index->count++;
+        offset = chunk->offset + chunk->length;
+    }
+
+    return index->prg_size > 0;
+}
+
+const unif_chunk *unif_find_chunk( const unif_index *index, const char *tag )
+{
+    for( int i=0; i<index->count; i++ )
+        if( strcmp( index->chunks[i].tag, tag ) == 0 )
+            return &index->chunks[i];
+    return NULL;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      iNES mapper of a board name
+//
+int unif_board_mapper( const char *board )
+{
+    for( size_t i=0; i<sizeof(unif_prefixes)/sizeof(unif_prefixes[0]); i++ )
+    {
+        size_t length = strlen( unif_prefixes[i] );
+
+        if( strncmp( board, unif_prefixes[i], length ) == 0 )
+        {
+            board += length;
+            break;
+        }
+    }
+
+    for( size_t i=0; i<sizeof(unif_boards)/sizeof(unif_boards[0]); i++ )
+        if( strcmp( board, unif_boards[i].name ) == 0 )
+            return unif_boards[i].mapper;
+    return UNIF_MAPPER_UNKNOWN;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      makes up the iNES header of an image, NES 2.0 if the ROM
+//      sizes don't fit into iNES
+//
+void unif_make_hdr( const unif_index *index, ines_hdr *hdr )
+{
+    long long prg_pages = (index->prg_size + PRG_PAGE_SIZE - 1) / PRG_PAGE_SIZE;
+    long long chr_pages = (index->chr_size + CHR_PAGE_SIZE - 1) / CHR_PAGE_SIZE;
+    int mapper = unif_board_mapper( index->board );
+
+    memset( hdr, 0, sizeof(*hdr) );
+    memcpy( hdr->id, "NES", 3 );
+    hdr->term = 0x1A;
+    hdr->prg_page_count_16k = (uchar)prg_pages;
+    hdr->chr_page_count_8k = (uchar)chr_pages;
+    hdr->rom_control_byte_0 = (uchar)((mapper & 0x0F) << 4);
+    hdr->rom_control_byte_1 = (uchar)(mapper & 0xF0);
+
+    if( index->mirroring == UNIF_MIRR_VERTICAL )
+        hdr->rom_control_byte_0 |= 0x01;
+    else if( index->mirroring == UNIF_MIRR_FOUR_SCREEN )
+        hdr->rom_control_byte_0 |= 0x08;
+    if( index->battery )
+        hdr->rom_control_byte_0 |= 0x02;
+
+    if( prg_pages > INES_MAX_PAGES || chr_pages > INES_MAX_PAGES )
+    {
+        hdr->rom_control_byte_1 |= 0x08;
+        hdr->reserved[0] = (uchar)((prg_pages >> 8) & 0x0F) | (uchar)(((chr_pages >> 8) & 0x0F) << 4);
+        hdr->reserved[1] = (uchar)(index->battery ? NES20_SHIFT_8K << 4 : NES20_SHIFT_8K);
+        hdr->reserved[2] = (uchar)(chr_pages == 0 ? NES20_SHIFT_8K : 0);
+    }
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      points a context at the PRG and CHR chunk of an image, if
+//      there is one of each and they are whole pages
+//
+bool unif_init( ines_ctx *ctx, const image_t *image, const unif_index *index )
+{
+    int prg = -1, chr = -1;
+
+    if( index->prg_chunks != 1 || index->chr_chunks > 1
+        || index->prg_size % PRG_PAGE_SIZE != 0 || index->chr_size % CHR_PAGE_SIZE != 0 )
+        return false;
+
+    for( int i=0; i<UNIF_ROM_CHUNKS; i++ )
+    {
+        if( index->prg[i] >= 0 )
+            prg = index->prg[i];
+        if( index->chr[i] >= 0 )
+            chr = index->chr[i];
+    }
+
+    memset( ctx, 0, sizeof(*ctx) );
+    ctx->image = image;
+    ctx->file_size = image->size;
+    ctx->chunked = true;
+    ctx->chunk_prg_offset = index->chunks[prg].offset;
+    ctx->chunk_chr_offset = chr >= 0 ? index->chunks[chr].offset : ctx->chunk_prg_offset + index->prg_size;
+    memcpy( ctx->board, index->board, sizeof(ctx->board) );
+
+    unif_make_hdr( index, &ctx->hdr );
+    ines_parse_hdr( ctx );
+    return true;
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      puts an image together as iNES image: the header, PRG and
+//      CHR-ROM, each padded to whole pages
+//
+image_off_t unif_ines_size( const unif_index *index )
+{
+    image_off_t prg = (index->prg_size + PRG_PAGE_SIZE - 1) / PRG_PAGE_SIZE * PRG_PAGE_SIZE;
+    image_off_t chr = (index->chr_size + CHR_PAGE_SIZE - 1) / CHR_PAGE_SIZE * CHR_PAGE_SIZE;
+
+    return INES_HDR_SIZE + prg + chr;
+}
+
+void unif_to_ines( const image_t *image, const unif_index *index, uchar *buf )
+{
+    image_off_t prg = (index->prg_size + PRG_PAGE_SIZE - 1) / PRG_PAGE_SIZE * PRG_PAGE_SIZE;
+    image_off_t chr = (index->chr_size + CHR_PAGE_SIZE - 1) / CHR_PAGE_SIZE * CHR_PAGE_SIZE;
+
+    unif_make_hdr( index, (ines_hdr *)buf );
+    copy_rom( image, index, index->prg, index->prg_size, buf + INES_HDR_SIZE, prg );
+    copy_rom( image, index, index->chr, index->chr_size, buf + INES_HDR_SIZE + prg, chr );
+}
+
+// the chunks in the order of their digit, then mirrors of them
+static void copy_rom( const image_t *image, const unif_index *index, const int *chunks, image_off_t size, uchar *buf, image_off_t padded )
+{
+    image_off_t pos = 0;
+
+    for( int i=0; i<UNIF_ROM_CHUNKS; i++ )
+    {
+        if( chunks[i] < 0 )
+            continue;
+
+        const unif_chunk *chunk = &index->chunks[chunks[i]];
+        memcpy( buf + pos, image_slice( image, chunk->offset, chunk->length ), chunk->length );
+        pos += chunk->length;
+    }
+
+    for( ; pos<padded && size > 0; pos++ )
+        buf[pos] = buf[pos % size];
+}
+
+
+
+//----------------------------------------------------------------------
+//
+//      little helpers
+//
+static unsigned int read_le32( const uchar *p )
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// 0-15 for "PRG0".."PRGF", -1 for other tags
+static int rom_chunk_number( const char *tag, const char *kind )
+{
+    if( strncmp( tag, kind, 3 ) != 0 )
+        return -1;
+    if( tag[3] >= '0' && tag[3] <= '9' )
+        return tag[3] - '0';
+    if( tag[3] >= 'A' && tag[3] <= 'F' )
+        return tag[3] - 'A' + 10;
+    return -1;
+}
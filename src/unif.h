@@ -0,0 +1,110 @@
+/*
+
+	Nintendo Entertainment System (NES) loader module
+	------------------------------------------------------
+	Copyright 2006, Dennis Elser (dennis@backtrace.de)
+
+
+    UNIF ROM images.
+
+    A UNIF image is a 32 byte header ("UNIF", revision, zeros)
+    followed by chunks of a 4 byte tag, a 32 bit length (little
+    endian) and the data:
+
+        PRG0..PRGF      PRG-ROM, concatenated in the order of the
+                        digit
+        CHR0..CHRF      CHR-ROM, likewise
+        MAPR            board name, e.g. "NES-TLROM", NUL terminated
+        MIRR            mirroring: 0 horizontal, 1 vertical, 2/3
+                        single screen, 4 four screen, 5 by mapper
+        BATR            battery backed PRG-RAM
+        NAME, READ, DINF, TVCI, CTRL, PCKn, CCKn, ...
+
+    unif_index_image() walks the chunk list once and keeps the tag,
+    file offset and length of every chunk, nothing is copied. Most
+    images have one PRG and one CHR chunk, unif_init() then points
+    an ines_ctx at them (ines_ctx.chunked) and makes up an iNES
+    header with the mapper of the board, so the image is loaded
+    from the mapped file like an iNES image.
+
+    Images with PRG or CHR-ROM spread over several chunks, or with
+    sizes that aren't whole pages, are put together as an iNES
+    image in memory by unif_to_ines() (pages too short are filled
+    with mirrors of the data).
+
+*/
+
+
+#ifndef _UNIF_H
+#define _UNIF_H
+
+#include "ines.h"
+
+
+#define UNIF_HDR_SIZE                       32
+#define UNIF_CHUNK_HDR_SIZE                 8
+#define UNIF_MAGIC                          "UNIF"
+
+// chunks kept per image, PRGn and CHRn chunks
+#define UNIF_MAX_CHUNKS                     128
+#define UNIF_ROM_CHUNKS                     16
+
+// iNES mapper number of boards that aren't known, not in mappers.h
+#define UNIF_MAPPER_UNKNOWN                 255
+
+// MIRR values
+#define UNIF_MIRR_HORIZONTAL                0
+#define UNIF_MIRR_VERTICAL                  1
+#define UNIF_MIRR_FOUR_SCREEN               4
+
+
+typedef struct _unif_chunk_t {
+
+    char tag[5];                            // NUL terminated
+    image_off_t offset;                     // of the data, behind the chunk header
+    unsigned int length;
+
+} unif_chunk;
+
+
+typedef struct _unif_index_t {
+
+    unsigned int revision;
+    int count;
+    unif_chunk chunks[UNIF_MAX_CHUNKS];     // in file order
+
+    int prg[UNIF_ROM_CHUNKS];               // chunk of PRGn, -1 if there is none
+    int chr[UNIF_ROM_CHUNKS];
+    int prg_chunks;
+    int chr_chunks;
+    image_off_t prg_size;                   // of all PRGn chunks
+    image_off_t chr_size;
+
+    char board[INES_BOARD_SIZE];            // MAPR, "" if missing
+    int mirroring;                          // MIRR, -1 if missing
+    bool battery;                           // BATR
+
+} unif_index;
+
+
+
+//----------------------------------------------------------------------
+//
+//      function prototypes for unif.cpp
+//
+
+bool unif_is_unif_image( const void *buf, size_t size );
+bool unif_index_image( const image_t *image, unif_index *index ); // false for broken chunk lists
+const unif_chunk *unif_find_chunk( const unif_index *index, const char *tag );
+
+int unif_board_mapper( const char *board ); // UNIF_MAPPER_UNKNOWN if the board isn't known
+void unif_make_hdr( const unif_index *index, ines_hdr *hdr );
+
+// points 'ctx' at the chunks, false if the image has to be put
+// together with unif_to_ines() first
+bool unif_init( ines_ctx *ctx, const image_t *image, const unif_index *index );
+
+image_off_t unif_ines_size( const unif_index *index );
+void unif_to_ines( const image_t *image, const unif_index *index, uchar *buf );
+
+#endif // _UNIF_H